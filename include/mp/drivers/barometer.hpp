@@ -0,0 +1,30 @@
+#pragma once
+
+namespace mp {
+
+/**
+ * Optional barometric pressure sensor, used for the altitude
+ */
+class barometer {
+
+public:
+    virtual ~barometer() = default;
+
+    /**
+     * Check if the sensor is connected and responding
+     */
+    virtual bool probe() noexcept = 0;
+
+    /**
+     * Read the static air pressure in pascals
+     * @returns false if the read failed
+     */
+    virtual bool read_pressure(float& pressure) noexcept = 0;
+
+    /**
+     * Standard deviation of the pressure noise in pascals
+     */
+    virtual float get_pressure_noise() const noexcept = 0;
+};
+
+}
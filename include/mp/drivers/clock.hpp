@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace mp {
+
+/**
+ * Time since an arbitrary (but fixed) point, usually the system start
+ */
+using timestamp_t = std::chrono::duration<int64_t, std::micro>;
+
+/**
+ * Monotonic time source used to timestamp sensor samples
+ *
+ * Usually implemented with a free running hardware timer, and must be
+ * safe to call from any task, and from interrupts if sensors provide
+ * data-ready interrupts (the interrupt time is the sample timestamp)
+ */
+class monotonic_clock {
+
+public:
+    virtual ~monotonic_clock() = default;
+
+    /**
+     * Current time, never decreasing
+     */
+    virtual timestamp_t now() const noexcept = 0;
+};
+
+/**
+ * Convert a timestamp difference to seconds
+ */
+inline float to_seconds(timestamp_t duration) noexcept
+{
+    return std::chrono::duration<float>(duration).count();
+}
+
+}
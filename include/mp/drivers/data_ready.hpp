@@ -0,0 +1,28 @@
+#pragma once
+
+#include <functional>
+
+namespace mp {
+
+/**
+ * Optional data-ready interrupt of a sensor
+ *
+ * Sensor raises the interrupt when a new sample (or a FIFO watermark) is
+ * available, which lets the sensor task sleep until there is data instead
+ * of polling. Usually implemented by the same driver as the sensor itself.
+ */
+class data_ready_interrupt {
+
+public:
+    using callback_t = std::function<void()>;
+
+    virtual ~data_ready_interrupt() = default;
+
+    /**
+     * Enable the interrupt and call `callback` (from the interrupt) on every data-ready event
+     * @returns false if the interrupt could not be enabled
+     */
+    virtual bool enable_data_ready(const callback_t& callback) noexcept = 0;
+};
+
+}
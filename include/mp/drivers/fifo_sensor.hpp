@@ -0,0 +1,40 @@
+#pragma once
+
+#include "clock.hpp"
+#include <cstddef>
+
+namespace mp {
+
+/**
+ * Optional interface of three axis sensors with a hardware FIFO
+ *
+ * Sensor keeps sampling at its output data rate on its own, and all
+ * samples buffered since the last read can be read in one transfer. This
+ * is usually implemented by the same driver which implements the
+ * `emblib::three_axis_sensor`, but only used if passed in `devices_s`.
+ */
+template <typename data_type>
+class fifo_sensor {
+
+public:
+    virtual ~fifo_sensor() = default;
+
+    /**
+     * Number of complete samples currently in the FIFO
+     */
+    virtual size_t get_fifo_count() noexcept = 0;
+
+    /**
+     * Read up to `max_count` oldest samples from the FIFO in a single transfer
+     * @returns Number of samples read, 0 if the transfer failed
+     * @note Samples are ordered from the oldest to the newest
+     */
+    virtual size_t read_fifo(data_type (*samples)[3], size_t max_count) noexcept = 0;
+
+    /**
+     * Time between two consecutive samples (inverse of the output data rate)
+     */
+    virtual timestamp_t get_sample_period() const noexcept = 0;
+};
+
+}
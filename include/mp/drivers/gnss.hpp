@@ -0,0 +1,51 @@
+#pragma once
+
+#include "mp/util/math.hpp"
+
+namespace mp {
+
+/**
+ * Position and velocity solution of a GNSS receiver
+ *
+ * Accuracies are the standard deviations estimated by the receiver
+ */
+struct gnss_fix_s {
+    // Geodetic coordinates in degrees, double since a float
+    // has a resolution of about a meter at these magnitudes
+    double latitude;
+    double longitude;
+    // Height above the mean sea level in meters
+    float altitude;
+    // Velocity in the north, east and down directions in m/s
+    vector3f velocity_ned;
+
+    float horizontal_accuracy;
+    float vertical_accuracy;
+    float speed_accuracy;
+};
+
+/**
+ * Optional GNSS (GPS, Galileo, ...) receiver
+ *
+ * Receivers usually produce a solution a few times per second,
+ * and the driver keeps the latest one until it is read
+ */
+class gnss {
+
+public:
+    virtual ~gnss() = default;
+
+    /**
+     * Check if the receiver is connected and responding
+     */
+    virtual bool probe() noexcept = 0;
+
+    /**
+     * Take the newest solution
+     * @returns false if there is no new solution since the
+     * last call, or the receiver does not have a fix
+     */
+    virtual bool read_fix(gnss_fix_s& fix) noexcept = 0;
+};
+
+}
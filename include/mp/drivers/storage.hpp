@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+namespace mp {
+
+/**
+ * Optional non-volatile storage (flash, EEPROM, a file in the simulator)
+ *
+ * Used for keeping the data which should survive a reboot, like the sensor
+ * calibration. Addresses start from 0 at the beginning of the region given
+ * to minipilot. Writes can be slow, so they are only done from low priority tasks.
+ */
+class storage {
+
+public:
+    virtual ~storage() = default;
+
+    /**
+     * Size of the storage region in bytes
+     */
+    virtual size_t get_size() const noexcept = 0;
+
+    /**
+     * Read `size` bytes starting at `address`
+     * @returns false if the read failed
+     */
+    virtual bool read(size_t address, void* data, size_t size) noexcept = 0;
+
+    /**
+     * Write (erasing first if needed) `size` bytes starting at `address`
+     * @returns false if the write failed
+     */
+    virtual bool write(size_t address, const void* data, size_t size) noexcept = 0;
+};
+
+}
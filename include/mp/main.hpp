@@ -1,32 +1,57 @@
 #pragma once
 
 #include "vehicles/vehicle.hpp"
+#include "mp/util/constants.hpp"
+#include "mp/drivers/clock.hpp"
+#include "mp/drivers/fifo_sensor.hpp"
+#include "mp/drivers/data_ready.hpp"
+#include "mp/drivers/storage.hpp"
+#include "mp/drivers/gnss.hpp"
+#include "mp/drivers/barometer.hpp"
 #include "emblib/driver/io/char_dev.hpp"
 #include "emblib/driver/sensor/accelerometer.hpp"
 #include "emblib/driver/sensor/gyroscope.hpp"
 
 namespace mp {
 
+/**
+ * Drivers of a single three axis sensor
+ */
+template <typename sensor_type>
+struct three_axis_device_s {
+    sensor_type* sensor = nullptr;
+    // Map the sensor reading to the mp coordinate frame, identity if `nullptr`
+    const matrix3f* transform = nullptr;
+    // FIFO of the same sensor, read in bursts if available
+    fifo_sensor<float>* fifo = nullptr;
+    // Data-ready (or FIFO watermark) interrupt of the same sensor, if available
+    data_ready_interrupt* data_ready = nullptr;
+};
+
 /**
  * Device drivers required by minipilot
  * 
  * @note Drivers taken as a pointer are optional,
  * and `nullptr` can be passed.
+ * @note Boards with redundant IMUs provide up to `MAX_SENSOR_INSTANCES`
+ * accelerometers and gyroscopes, unused entries are left with a `nullptr`
+ * sensor. At least one of each must be available.
  */
 struct devices_s {
-    struct {
-        emblib::accelerometer& sensor;
-        // Map the sensor reading to the mp coordinate frame
-        const matrix3f& transform;
-    } accelerometer;
-    struct {
-        emblib::gyroscope& sensor;
-        // Map the sensor reading to the mp coordinate frame
-        const matrix3f& transform;
-    } gyroscope;
+    three_axis_device_s<emblib::accelerometer> accelerometers[MAX_SENSOR_INSTANCES];
+    three_axis_device_s<emblib::gyroscope> gyroscopes[MAX_SENSOR_INSTANCES];
+    three_axis_device_s<emblib::three_axis_sensor<float>> magnetometer;
+    gnss* gnss_device = nullptr;
+    barometer* barometer_device = nullptr;
+    // Timestamps the sensor samples
+    const monotonic_clock& clock;
     emblib::char_dev* log_device;
     emblib::char_dev* telemetry_device;
+    // Records the sensor samples, states and control outputs at full rate
+    emblib::char_dev* blackbox_device = nullptr;
     emblib::char_dev& receiver_device;
+    // Keeps the sensor calibration between boots
+    storage* storage_device = nullptr;
 };
 
 /**
@@ -1,2 +1,4 @@
 #include "state/ekf_inertial.hpp"
-#include "state/ekf_ahrs.hpp"
\ No newline at end of file
+#include "state/ekf_error_state.hpp"
+#include "state/ekf_ahrs.hpp"
+#include "state/mahony_ahrs.hpp"
\ No newline at end of file
@@ -13,6 +13,11 @@ inline const vector3f BACKWARD   = -FORWARD;
 inline const vector3f RIGHT      = -LEFT;
 inline const vector3f DOWN       = -UP;
 
+inline constexpr float PI = 3.14159265358979f;
+
+// Maximum number of redundant instances of each sensor (boards with multiple IMUs)
+inline constexpr size_t MAX_SENSOR_INSTANCES = 3;
+
 // Gravity const G = 9.80665
 inline constexpr float G = emblib::accelerometer::G_TO_MPS2;
 // Gravity vector = G * DOWN
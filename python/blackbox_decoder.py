@@ -0,0 +1,207 @@
+"""
+Decodes a blackbox recording of minipilot to csv files
+
+The recording is a sequence of blocks (see `src/blackbox/blackbox_encoder.hpp`),
+each with its own CRC, so blocks which are damaged (or cut off at the end of
+the recording) are skipped and the rest is still decoded. Every stream is
+written to its own csv file in the output directory (`accelerometer0.csv`,
+`gyroscope0.csv`, `state.csv`, `control.csv`, ...), with the time in seconds.
+
+Usage (from the repository root):
+    python python/blackbox_decoder.py <recording> -o <output directory>
+"""
+
+import argparse
+import csv
+import math
+import os
+import struct
+import sys
+import zlib
+
+
+SYNC = b"\xB8\x0C"
+HEADER_SIZE = 4
+CRC_SIZE = 4
+
+ACCELEROMETER, GYROSCOPE, MAGNETOMETER, STATE, CONTROL, DROPPED = range(6)
+SENSOR_NAMES = ["accelerometer", "gyroscope", "magnetometer"]
+
+# Resolution of the quantized fields, must match src/blackbox/blackbox_encoder.cpp
+SENSOR_RESOLUTION = [1e-3, 1e-4, 1e-3]
+STATE_RESOLUTION = [1e-3] * 3 + [1e-3] * 3 + [1e-3] * 3 + [1e-4] * 3 + [1e-5] * 4
+THRUST_RESOLUTION = 1e-3
+TORQUE_RESOLUTION = 1e-5
+MOTOR_RESOLUTION = 1e-4
+QUANTIZED_NAN = -2**31
+
+SENSOR_COLUMNS = ["time", "raw_x", "raw_y", "raw_z", "x", "y", "z"]
+STATE_COLUMNS = ["time", "px", "py", "pz", "vx", "vy", "vz", "ax", "ay", "az",
+                 "wx", "wy", "wz", "qw", "qx", "qy", "qz"]
+MAX_MOTORS = 8
+CONTROL_COLUMNS = ["time", "thrust", "torque_x", "torque_y", "torque_z"] + \
+                  [f"motor{i}" for i in range(MAX_MOTORS)]
+
+
+class Stream:
+    """
+    Previous record of a stream, which the next one is relative to
+    """
+    def __init__(self):
+        self.timestamp = 0
+        self.values = [0] * 16
+
+
+def read_varint(data, offset):
+    value, shift = 0, 0
+    while True:
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, offset
+
+
+def read_delta(data, offset, previous):
+    value, offset = read_varint(data, offset)
+    return previous + ((value >> 1) ^ -(value & 1)), offset
+
+
+def dequantize(value, resolution):
+    return math.nan if value == QUANTIZED_NAN else value * resolution
+
+
+def decode_payload(payload, rows, stats):
+    """
+    Decode the records of a single block into `rows` (stream name -> list of rows)
+    """
+    streams = {}
+    offset = 0
+    while offset < len(payload):
+        header = payload[offset]
+        offset += 1
+        record_type, instance = header >> 4, header & 0x0F
+
+        if record_type == DROPPED:
+            stats["dropped"], offset = read_varint(payload, offset)
+            continue
+        if record_type > CONTROL:
+            raise ValueError(f"unknown record type {record_type}")
+
+        stream = streams.setdefault(header, Stream())
+        stream.timestamp, offset = read_delta(payload, offset, stream.timestamp)
+
+        def read_fields(count):
+            nonlocal offset
+            for i in range(count):
+                stream.values[i], offset = read_delta(payload, offset, stream.values[i])
+            return stream.values[:count]
+
+        time = stream.timestamp * 1e-6
+        if record_type <= MAGNETOMETER:
+            values = read_fields(6)
+            resolution = SENSOR_RESOLUTION[record_type]
+            name = f"{SENSOR_NAMES[record_type]}{instance}"
+            rows.setdefault(name, []).append([time] + [dequantize(v, resolution) for v in values])
+        elif record_type == STATE:
+            values = read_fields(16)
+            rows.setdefault("state", []).append(
+                [time] + [dequantize(v, r) for v, r in zip(values, STATE_RESOLUTION)])
+        else:
+            values = read_fields(5)
+            motor_count = values[4]
+            if motor_count > MAX_MOTORS:
+                raise ValueError(f"invalid motor count {motor_count}")
+            # Motors follow the count, so they are read after it
+            for i in range(motor_count):
+                stream.values[5 + i], offset = read_delta(payload, offset, stream.values[5 + i])
+            motors = [dequantize(v, MOTOR_RESOLUTION) for v in stream.values[5:5 + motor_count]]
+            rows.setdefault("control", []).append(
+                [time, dequantize(values[0], THRUST_RESOLUTION)] +
+                [dequantize(v, TORQUE_RESOLUTION) for v in values[1:4]] +
+                motors + [""] * (MAX_MOTORS - motor_count))
+        stats["records"] += 1
+
+
+def decode(data):
+    """
+    Decode all valid blocks of the recording
+    @returns Rows of every stream and the decoding statistics
+    """
+    rows = {}
+    stats = {"blocks": 0, "records": 0, "bad_blocks": 0, "dropped": 0}
+    offset = 0
+    while True:
+        offset = data.find(SYNC, offset)
+        if offset < 0 or offset + HEADER_SIZE > len(data):
+            break
+
+        size = struct.unpack_from("<H", data, offset + 2)[0]
+        end = offset + HEADER_SIZE + size + CRC_SIZE
+        if end > len(data):
+            stats["bad_blocks"] += 1
+            offset += 1
+            continue
+
+        payload = data[offset + HEADER_SIZE:end - CRC_SIZE]
+        crc = struct.unpack_from("<I", data, end - CRC_SIZE)[0]
+        if zlib.crc32(payload) != crc:
+            stats["bad_blocks"] += 1
+            offset += 1
+            continue
+
+        # Records are only added once the whole block is decoded
+        block_rows = {}
+        block_stats = dict(stats, records=0)
+        try:
+            decode_payload(payload, block_rows, block_stats)
+        except (ValueError, IndexError):
+            stats["bad_blocks"] += 1
+            offset += 1
+            continue
+
+        for name, block in block_rows.items():
+            rows.setdefault(name, []).extend(block)
+        stats["records"] += block_stats["records"]
+        stats["dropped"] = block_stats["dropped"]
+        stats["blocks"] += 1
+        offset = end
+    return rows, stats
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("recording", help="blackbox recording file")
+    parser.add_argument("-o", "--output", default="blackbox", help="output directory for the csv files")
+    args = parser.parse_args()
+
+    with open(args.recording, "rb") as file:
+        data = file.read()
+    rows, stats = decode(data)
+    if not rows:
+        print("No records found in the recording", file=sys.stderr)
+        return 1
+
+    os.makedirs(args.output, exist_ok=True)
+    for name, stream_rows in sorted(rows.items()):
+        if name == "state":
+            columns = STATE_COLUMNS
+        elif name == "control":
+            columns = CONTROL_COLUMNS
+        else:
+            columns = SENSOR_COLUMNS
+        with open(os.path.join(args.output, f"{name}.csv"), "w", newline="") as file:
+            writer = csv.writer(file)
+            writer.writerow(columns)
+            writer.writerows(stream_rows)
+        print(f"{name}: {len(stream_rows)} records")
+
+    print(f"{stats['blocks']} blocks, {stats['records']} records, {len(data)} bytes "
+          f"({len(data) / max(stats['records'], 1):.1f} bytes per record), "
+          f"{stats['bad_blocks']} damaged blocks, {stats['dropped']} records dropped by the recorder")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,404 @@
+"""
+Generates C++ kernels for the jacobians of the model functions in `model.py`
+
+Each kernel is a jacobian of a model function with respect to one of the state
+variables. Subexpressions shared between its elements are computed only once
+(common subexpression elimination). Before anything is written every kernel is
+checked numerically against the finite differences of the model function, and
+the generated C++ is compiled on the host and compared with the sympy jacobian.
+
+Usage (from the repository root):
+    python python/codegen.py [--check-only] [--no-compile] [--cxx CXX] [-I DIR ...]
+"""
+
+import argparse
+import os
+import random
+import re
+import struct
+import subprocess
+import sys
+import tempfile
+
+import sympy
+from sympy.printing.c import C99CodePrinter
+
+import model
+
+
+OUTPUT_DIR = os.path.join(os.path.dirname(__file__), "..", "src", "model")
+OUTPUT_NAME = "model_jacobians"
+
+# Relative tolerance of the finite difference check
+CHECK_TOLERANCE = 1e-6
+CHECK_POINTS = 100
+# Relative tolerance of the compiled kernels, which are evaluated in single precision
+COMPILED_TOLERANCE = 1e-5
+# Include directories of the compiled check, relative to the repository root
+COMPILE_INCLUDES = ["src", "include", os.path.join("lib", "emblib", "include")]
+
+
+class argument:
+    """
+    C++ function argument and the symbols it provides
+
+    `symbols` are model symbols and `accessors` are the C++ expressions
+    which read them from the argument, unpacked into `locals` in the body.
+    `construct` returns the C++ expression of an argument with the given
+    literal values of the symbols, used by the compiled check.
+    """
+    def __init__(self, decl, symbols, accessors, locals, construct):
+        self.decl = decl
+        self.symbols = symbols
+        self.accessors = accessors
+        self.locals = locals
+        self.construct = construct
+
+def scalar(name, symbol):
+    return argument(f"float {name}", [symbol], [name], [name], lambda v: v[0])
+
+def vector3(name, symbols, locals):
+    return argument(f"const vector3f& {name}", list(symbols), [f"{name}({i})" for i in range(3)], locals,
+                    lambda v: f"vector3f {{{', '.join(v)}}}")
+
+def vector4(name, symbols, locals):
+    return argument(f"const vector4f& {name}", list(symbols), [f"{name}({i})" for i in range(4)], locals,
+                    lambda v: f"vector4f {{{', '.join(v)}}}")
+
+def diagonal3(name, symbols, locals):
+    return argument(f"const matrix3f& {name}", list(symbols), [f"{name}({i}, {i})" for i in range(3)], locals,
+                    lambda v: f"matrix3f {{{{{v[0]}, 0, 0}}, {{0, {v[1]}, 0}}, {{0, 0, {v[2]}}}}}")
+
+
+class kernel:
+    def __init__(self, name, doc, function, variable, args):
+        self.name = name
+        self.doc = doc
+        self.function = function
+        self.variable = variable
+        self.args = args
+        self.jacobian = function.jacobian(variable)
+
+
+# Shared arguments
+ARG_QV = vector4("qv", model.qv, ["qw", "qx", "qy", "qz"])
+ARG_W = vector3("w", model.w, ["wx", "wy", "wz"])
+ARG_A = vector3("a", model.a, ["ax", "ay", "az"])
+ARG_DT = scalar("dt", model.dt)
+
+KERNELS = [
+    kernel(
+        "copter_da_dq",
+        "Derivative of the copter acceleration with respect to the rotation quaternion",
+        model.copter_a, model.qv,
+        [scalar("thrust", model.T), scalar("mass", model.m), ARG_QV]
+    ),
+    kernel(
+        "copter_ddw_dw",
+        "Derivative of the copter angular acceleration with respect to the angular velocity\n"
+        " * @note Only the diagonal of the moment of inertia is used",
+        model.copter_dw, model.w,
+        [diagonal3("inertia", [model.Ix, model.Iy, model.Iz], ["Ix", "Iy", "Iz"]), ARG_W]
+    ),
+    kernel(
+        "rotation_dq_dq",
+        "Derivative of the rotation quaternion after `dt` with respect to the current one",
+        model.q_next, model.qv,
+        [ARG_W, ARG_DT]
+    ),
+    kernel(
+        "rotation_dq_dw",
+        "Derivative of the rotation quaternion after `dt` with respect to the angular velocity",
+        model.q_next, model.w,
+        [ARG_QV, ARG_DT]
+    ),
+    kernel(
+        "accel_obs_da_da",
+        "Derivative of the expected accelerometer reading with respect to the acceleration",
+        model.accel_obs, model.a,
+        [ARG_QV]
+    ),
+    kernel(
+        "accel_obs_da_dq",
+        "Derivative of the expected accelerometer reading with respect to the rotation quaternion",
+        model.accel_obs, model.qv,
+        [ARG_QV, ARG_A]
+    ),
+    kernel(
+        "mag_obs_dm_dq",
+        "Derivative of the expected magnetometer reading with respect to the rotation quaternion",
+        model.mag_obs, model.qv,
+        [ARG_QV, vector3("field", model.b, ["bx", "by", "bz"])]
+    ),
+]
+
+
+class cpp_printer(C99CodePrinter):
+    """
+    Prints single precision expressions with the argument local names,
+    and squares as multiplications
+    """
+    def __init__(self, names):
+        super().__init__()
+        self.names = names
+
+    def _print_Symbol(self, expr):
+        return self.names.get(expr, super()._print_Symbol(expr))
+
+    def _print_Pow(self, expr):
+        base = self.parenthesize(expr.base, sympy.printing.precedence.PRECEDENCE["Mul"])
+        if expr.exp == 2:
+            return f"{base}*{base}"
+        if expr.exp == -1:
+            return f"1.f/{base}"
+        return f"std::pow({self._print(expr.base)}, {self._print(expr.exp)})"
+
+    def _print_Rational(self, expr):
+        return f"{float(expr)!r}f"
+
+    def _print_Float(self, expr):
+        return f"{float(expr)!r}f"
+
+
+def eliminate(k):
+    """
+    Common subexpression elimination over all elements of the jacobian
+    """
+    elements = list(k.jacobian)
+    temps, reduced = sympy.cse(elements, symbols=sympy.numbered_symbols("t"))
+    return temps, sympy.Matrix(k.jacobian.rows, k.jacobian.cols, reduced)
+
+
+def count_ops(exprs):
+    return sum(sympy.count_ops(e) for e in exprs)
+
+
+def signature(k):
+    rows, cols = k.jacobian.shape
+    return_type = f"matrixf<{rows}>" if rows == cols else f"matrixf<{rows}, {cols}>"
+    args = ", ".join(a.decl for a in k.args)
+    return return_type, f"{k.name}({args}) noexcept"
+
+
+def generate_kernel(k):
+    temps, reduced = eliminate(k)
+
+    names = {model.g: "G"}
+    for a in k.args:
+        for symbol, local in zip(a.symbols, a.locals):
+            names[symbol] = local
+    printer = cpp_printer(names)
+
+    used = set().union(*(e.free_symbols for e in list(reduced) + [t for _, t in temps]))
+    lines = []
+    for a in k.args:
+        unpacked = [f"{local} = {accessor}" for symbol, accessor, local in zip(a.symbols, a.accessors, a.locals)
+                    if symbol in used and local != accessor]
+        if unpacked:
+            lines.append(f"    const float {', '.join(unpacked)};")
+    if lines:
+        lines.append("")
+
+    for symbol, value in temps:
+        names[symbol] = str(symbol)
+        lines.append(f"    const float {symbol} = {printer.doprint(value)};")
+    if temps:
+        lines.append("")
+
+    return_type, decl = signature(k)
+    rows = []
+    for i in range(reduced.rows):
+        rows.append("        {" + ", ".join(printer.doprint(reduced[i, j]) for j in range(reduced.cols)) + "}")
+    lines.append(f"    return {return_type} {{")
+    lines.append(",\n".join(rows))
+    lines.append("    };")
+
+    # Positive constants do not need the parentheses added by the printer
+    body = re.sub(r"\(([0-9.]+f)\)", r"\1", "\n".join(lines))
+    return f"{return_type}\n{decl}\n{{\n{body}\n}}\n"
+
+
+HEADER_NOTE = "// Generated by python/codegen.py from python/model.py, do not edit"
+
+def generate_header():
+    decls = []
+    for k in KERNELS:
+        return_type, decl = signature(k)
+        decls.append(f"/**\n * {k.doc}\n */\n{return_type} {decl};\n")
+    return (
+        f"#pragma once\n\n{HEADER_NOTE}\n\n#include \"mp/util/math.hpp\"\n\n"
+        f"namespace mp::model {{\n\n" + "\n".join(decls) + "\n}\n"
+    )
+
+def generate_source():
+    kernels = "\n".join(generate_kernel(k) for k in KERNELS)
+    return (
+        f"{HEADER_NOTE}\n\n#include \"{OUTPUT_NAME}.hpp\"\n#include \"mp/util/constants.hpp\"\n\n"
+        f"namespace mp::model {{\n\n{kernels}\n}}\n"
+    )
+
+
+def check_kernel(k, rng):
+    """
+    Compare the eliminated jacobian against central finite differences
+    of the model function at random points
+    @returns Maximum relative error
+    """
+    temps, reduced = eliminate(k)
+    symbols = sorted(k.function.free_symbols | k.jacobian.free_symbols | {model.g}, key=str)
+
+    f = sympy.lambdify(symbols, k.function.tolist(), "math")
+    temp_fns = [(t, sympy.lambdify(symbols + [s for s, _ in temps], v, "math")) for t, v in temps]
+    J = sympy.lambdify(symbols + [s for s, _ in temps], reduced.tolist(), "math")
+
+    variable = list(k.variable)
+    indices = [symbols.index(s) for s in variable]
+    worst = 0.0
+
+    for _ in range(CHECK_POINTS):
+        point = [rng.uniform(0.5, 2.0) * rng.choice([-1, 1]) for _ in symbols]
+        point[symbols.index(model.g)] = 9.80665
+
+        temp_values = [0.0] * len(temps)
+        for i, (_, fn) in enumerate(temp_fns):
+            temp_values[i] = fn(*point, *temp_values)
+        jacobian = J(*point, *temp_values)
+
+        for col, index in enumerate(indices):
+            h = 1e-6 * max(1.0, abs(point[index]))
+            plus, minus = list(point), list(point)
+            plus[index] += h
+            minus[index] -= h
+            f_plus, f_minus = f(*plus), f(*minus)
+            for row in range(k.jacobian.rows):
+                numeric = (f_plus[row][0] - f_minus[row][0]) / (2 * h)
+                error = abs(jacobian[row][col] - numeric) / max(1.0, abs(numeric))
+                worst = max(worst, error)
+
+    return worst
+
+
+def float32(value):
+    """
+    Round to the nearest single precision value, so that the
+    compiled kernels and sympy are evaluated at the same point
+    """
+    return struct.unpack("f", struct.pack("f", value))[0]
+
+
+def generate_check_main(points):
+    """
+    Program calling every kernel at its points and printing the elements of the results
+    @param points List of kernels and the values of their argument symbols
+    """
+    calls = []
+    for k, values in points:
+        args = ", ".join(a.construct([f"{values[s]!r}f" for s in a.symbols]) for a in k.args)
+        calls.append(f"    print({k.name}({args}));")
+    return (
+        f"#include \"{OUTPUT_NAME}.hpp\"\n#include <cstdio>\n\n"
+        "using namespace mp;\nusing namespace mp::model;\n\n"
+        "template <size_t R, size_t C>\n"
+        "static void print(const emblib::math::matrix<float, R, C>& m)\n{\n"
+        "    for (size_t i = 0; i < R; i++)\n"
+        "        for (size_t j = 0; j < C; j++)\n"
+        "            std::printf(\"%.9g\\n\", m(i, j));\n}\n\n"
+        "int main()\n{\n" + "\n".join(calls) + "\n    return 0;\n}\n"
+    )
+
+
+def check_compiled(rng, cxx, includes):
+    """
+    Compile the generated kernels on the host and compare their results
+    with the sympy jacobians at random points
+    @returns Maximum relative error of each kernel, None if the check could not be compiled
+    """
+    points = []
+    for k in KERNELS:
+        symbols = [s for a in k.args for s in a.symbols]
+        for _ in range(CHECK_POINTS):
+            points.append((k, {s: float32(rng.uniform(0.5, 2.0) * rng.choice([-1, 1])) for s in symbols}))
+
+    with tempfile.TemporaryDirectory() as directory:
+        with open(os.path.join(directory, f"{OUTPUT_NAME}.hpp"), "w") as file:
+            file.write(generate_header())
+        with open(os.path.join(directory, f"{OUTPUT_NAME}.cpp"), "w") as file:
+            file.write(generate_source())
+        with open(os.path.join(directory, "check.cpp"), "w") as file:
+            file.write(generate_check_main(points))
+
+        program = os.path.join(directory, "check")
+        command = [cxx, "-std=c++17", "-O2", f"-I{directory}"] + [f"-I{i}" for i in includes] + [
+            os.path.join(directory, f"{OUTPUT_NAME}.cpp"), os.path.join(directory, "check.cpp"), "-o", program]
+        build = subprocess.run(command, capture_output=True, text=True)
+        if build.returncode != 0:
+            print(build.stderr, file=sys.stderr)
+            return None
+        output = subprocess.run([program], capture_output=True, text=True, check=True).stdout.split()
+
+    values = iter(float(v) for v in output)
+    errors = {k.name: 0.0 for k in KERNELS}
+    jacobians = {}
+    for k, point in points:
+        if k.name not in jacobians:
+            symbols = sorted(k.jacobian.free_symbols | {model.g}, key=str)
+            jacobians[k.name] = (symbols, sympy.lambdify(symbols, k.jacobian.tolist(), "math"))
+        symbols, J = jacobians[k.name]
+        expected = J(*[9.80665 if s == model.g else point[s] for s in symbols])
+        for row in expected:
+            for element in row:
+                error = abs(next(values) - element) / max(1.0, abs(element))
+                errors[k.name] = max(errors[k.name], error)
+    return errors
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--check-only", action="store_true", help="only run the checks, do not write the kernels")
+    parser.add_argument("--no-compile", action="store_true", help="skip the check of the compiled kernels")
+    parser.add_argument("--cxx", default=os.environ.get("CXX", "c++"), help="host C++ compiler for the compiled check")
+    parser.add_argument("-I", dest="includes", action="append", default=[],
+                        help="additional include directory for the compiled check")
+    args = parser.parse_args()
+
+    rng = random.Random(0)
+    root = os.path.join(os.path.dirname(__file__), "..")
+    compiled = None
+    if not args.no_compile:
+        includes = [os.path.join(root, i) for i in COMPILE_INCLUDES] + args.includes
+        compiled = check_compiled(rng, args.cxx, includes)
+        if compiled is None:
+            print("Compiling the kernels failed, kernels not written", file=sys.stderr)
+            return 1
+
+    failed = False
+    for k in KERNELS:
+        temps, reduced = eliminate(k)
+        ops_before = count_ops(list(k.jacobian))
+        ops_after = count_ops(list(reduced) + [v for _, v in temps])
+        error = check_kernel(k, rng)
+        ok = error < CHECK_TOLERANCE
+        line = f"{k.name:20} ops {ops_before:4} -> {ops_after:4}  max rel error {error:.2e}"
+        if compiled is not None:
+            ok &= compiled[k.name] < COMPILED_TOLERANCE
+            line += f"  compiled {compiled[k.name]:.2e}"
+        failed |= not ok
+        print(f"{line}  {'ok' if ok else 'FAILED'}")
+
+    if failed:
+        print("Kernel check failed, kernels not written", file=sys.stderr)
+        return 1
+    if args.check_only:
+        return 0
+
+    os.makedirs(OUTPUT_DIR, exist_ok=True)
+    with open(os.path.join(OUTPUT_DIR, f"{OUTPUT_NAME}.hpp"), "w") as file:
+        file.write(generate_header())
+    with open(os.path.join(OUTPUT_DIR, f"{OUTPUT_NAME}.cpp"), "w") as file:
+        file.write(generate_source())
+    print(f"Written {OUTPUT_NAME}.hpp and {OUTPUT_NAME}.cpp to {os.path.normpath(OUTPUT_DIR)}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,247 @@
+"""
+Decodes the binary log of minipilot (built with MINIPILOT_BINARY_LOG) to text
+
+Records only contain the id of the logging call site and the values of its
+arguments, so the message text is taken from the sources the firmware was
+built from. Every `log_debug`/`log_info`/`log_warning`/`log_error` call is
+found in the sources, and its id is computed the same way as in
+`src/util/logger.hpp` (hash of the path relative to the repository root
+and the line of the call). Two call sites with the same id can not be told
+apart, so the decoder fails instead of guessing.
+
+Usage (from the repository root):
+    python python/log_decoder.py <log file> [--sources src include] [--root .]
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+
+SYNC = 0xA5
+HEADER_SIZE = 7
+LEVELS = ["DEBUG", "INFO", "WARNING", "ERROR"]
+
+TAG_LITERAL, TAG_BOOL, TAG_INT, TAG_UINT, TAG_FLOAT, TAG_DOUBLE, TAG_STRING = range(7)
+
+SOURCE_EXTENSIONS = (".cpp", ".hpp", ".h", ".cc")
+CALL_PATTERN = re.compile(r"\blog_(debug|info|warning|error)\s*\(")
+STRING_PATTERN = re.compile(r'"(?:[^"\\]|\\.)*"')
+
+
+def site_id(path, line):
+    """
+    FNV-1a hash of the relative path and the line, same as `binary_log::site_id`
+    """
+    value = 2166136261
+    for byte in path.replace("\\", "/").encode() + struct.pack("<I", line):
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def strip_comments(text):
+    """
+    Replace the comments with spaces, keeping the line numbers and the strings
+    """
+    pattern = re.compile(r'//[^\n]*|/\*.*?\*/|"(?:[^"\\]|\\.)*"|\'(?:[^\'\\]|\\.)*\'', re.DOTALL)
+    def replace(match):
+        token = match.group(0)
+        if token.startswith("/"):
+            return re.sub(r"[^\n]", " ", token)
+        return token
+    return pattern.sub(replace, text)
+
+
+def split_arguments(text, start):
+    """
+    Arguments of the call whose opening parenthesis is before `start`
+    @returns List of argument texts, or None if the call is not closed
+    """
+    args, depth, current, i = [], 0, "", start
+    while i < len(text):
+        c = text[i]
+        if c in "\"'":
+            end = i + 1
+            while end < len(text) and text[end] != c:
+                end += 2 if text[end] == "\\" else 1
+            current += text[i:end + 1]
+            i = end + 1
+            continue
+        if c in "([{":
+            depth += 1
+        elif c in ")]}":
+            if depth == 0:
+                args.append(current.strip())
+                return args
+            depth -= 1
+        elif c == "," and depth == 0:
+            args.append(current.strip())
+            current = ""
+            i += 1
+            continue
+        current += c
+        i += 1
+    return None
+
+
+def literal_text(arg):
+    """
+    Text of an argument made only of string literals, None for other arguments
+    """
+    if not arg or STRING_PATTERN.sub("", arg).strip():
+        return None
+    text = "".join(s[1:-1] for s in STRING_PATTERN.findall(arg))
+    return text.encode().decode("unicode_escape")
+
+
+def find_call_sites(source_dirs, root):
+    """
+    Map of the call site ids to the (location, arguments)
+    @param root Directory the firmware paths are relative to (`MP_SOURCE_ROOT`)
+    @raises ValueError if two call sites have the same id
+    """
+    sites = {}
+    for source_dir in source_dirs:
+        for directory, _, files in os.walk(source_dir):
+            for name in sorted(files):
+                if not name.endswith(SOURCE_EXTENSIONS):
+                    continue
+                path = os.path.join(directory, name)
+                with open(path, encoding="utf-8", errors="replace") as file:
+                    text = strip_comments(file.read())
+
+                for match in CALL_PATTERN.finditer(text):
+                    # Declarations and the macros themselves are not calls
+                    line_start = text.rfind("\n", 0, match.start()) + 1
+                    prefix = text[line_start:match.start()]
+                    if "#define" in prefix or "void" in prefix:
+                        continue
+                    args = split_arguments(text, match.end())
+                    if args is None:
+                        continue
+                    line = text.count("\n", 0, match.start()) + 1
+                    location = f"{path}:{line}"
+                    record_id = site_id(os.path.relpath(path, root), line)
+                    if record_id in sites and sites[record_id][0] != location:
+                        raise ValueError(f"call sites {sites[record_id][0]} and {location} have the same id {record_id:08x}")
+                    sites[record_id] = (location, args)
+    return sites
+
+
+def read_varint(data, offset):
+    value, shift = 0, 0
+    while True:
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, offset
+
+
+def decode_values(payload):
+    """
+    Tagged argument values of a record, `None` for the literals
+    """
+    values, offset = [], 0
+    while offset < len(payload):
+        tag = payload[offset]
+        offset += 1
+        if tag == TAG_LITERAL:
+            values.append(None)
+        elif tag == TAG_BOOL:
+            values.append("true" if payload[offset] else "false")
+            offset += 1
+        elif tag == TAG_INT:
+            value, offset = read_varint(payload, offset)
+            values.append(str((value >> 1) ^ -(value & 1)))
+        elif tag == TAG_UINT:
+            value, offset = read_varint(payload, offset)
+            values.append(str(value))
+        elif tag == TAG_FLOAT:
+            values.append(f"{struct.unpack_from('<f', payload, offset)[0]:g}")
+            offset += 4
+        elif tag == TAG_DOUBLE:
+            values.append(f"{struct.unpack_from('<d', payload, offset)[0]:g}")
+            offset += 8
+        elif tag == TAG_STRING:
+            length = payload[offset]
+            values.append(payload[offset + 1:offset + 1 + length].decode(errors="replace"))
+            offset += 1 + length
+        else:
+            raise ValueError(f"unknown tag {tag}")
+    return values
+
+
+def format_record(level, record_id, values, sites):
+    prefix = LEVELS[level] if level < len(LEVELS) else f"LEVEL{level}"
+    if record_id not in sites:
+        return f"{prefix}: <unknown call site {record_id:08x}> " + " ".join(v or "?" for v in values)
+
+    _, args = sites[record_id]
+    parts = []
+    for i, value in enumerate(values):
+        if value is None:
+            text = literal_text(args[i]) if i < len(args) else None
+            parts.append(text if text is not None else "?")
+        else:
+            parts.append(value)
+    # Arguments which did not fit the record
+    if len(values) < len(args):
+        parts.append("...")
+    return f"{prefix}: " + "".join(parts)
+
+
+def decode(data, sites):
+    """
+    Decode all records, skipping the bytes which are not part of a valid record
+    """
+    offset = 0
+    while offset + HEADER_SIZE <= len(data):
+        if data[offset] != SYNC:
+            offset += 1
+            continue
+        size = data[offset + 1]
+        end = offset + 2 + size
+        if size < HEADER_SIZE - 2 or end > len(data):
+            offset += 1
+            continue
+
+        level = data[offset + 2]
+        record_id = struct.unpack_from("<I", data, offset + 3)[0]
+        try:
+            values = decode_values(data[offset + HEADER_SIZE:end])
+        except (ValueError, IndexError, struct.error):
+            offset += 1
+            continue
+        yield format_record(level, record_id, values, sites)
+        offset = end
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log", help="binary log file")
+    parser.add_argument("--sources", nargs="+", default=["src", "include"], help="directories of the firmware sources")
+    parser.add_argument("--root", default=".", help="repository root the firmware was built from")
+    args = parser.parse_args()
+
+    try:
+        sites = find_call_sites(args.sources, args.root)
+    except ValueError as error:
+        print(f"Call site ids are not unique, rename or move one of the calls: {error}", file=sys.stderr)
+        return 1
+    if not sites:
+        print("No logging calls found in the sources", file=sys.stderr)
+        return 1
+
+    with open(args.log, "rb") as file:
+        data = file.read()
+    for line in decode(data, sites):
+        print(line)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
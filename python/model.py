@@ -36,4 +36,39 @@ qv = q.to_Matrix()
 
 # Angular velocity
 wx, wy, wz = sympy.symbols("omega_x omega_y omega_z")
-w = sympy.Matrix([wx, wy, wz])
\ No newline at end of file
+w = sympy.Matrix([wx, wy, wz])
+
+# Model functions used by the state estimators, C++ kernels
+# for their jacobians are generated from these by `codegen.py`
+
+# Time step
+dt = sympy.symbols("dt")
+
+# Copter parameters: mass, linear drag coefficient, thrust
+# and the moment of inertia (only the diagonal elements)
+m, c_d, T = sympy.symbols("m c_d T")
+Ix, Iy, Iz = sympy.symbols("I_x I_y I_z")
+I = sympy.diag(Ix, Iy, Iz)
+
+# Torque produced by the copter (in the local frame)
+tau = sympy.Matrix(sympy.symbols("tau_x tau_y tau_z"))
+
+# Copter acceleration in the global frame, thrust is in the local UP direction
+copter_a = gv + (T * rot_v(UP, q) - c_d * v) / m
+
+# Copter angular acceleration (Euler's equations for a rotating reference frame)
+copter_dw = I.inv() * (tau - w.cross(I * w))
+
+# Rotation after dt with a constant angular velocity in the local frame
+# (first order approximation, without the normalization)
+q_next = qv + dt / 2 * (q * sympy.Quaternion(0, wx, wy, wz)).to_Matrix()
+
+# Expected accelerometer reading, acceleration and gravity in the local frame
+accel_obs = rot_v(a - gv, q.inverse())
+
+# Earth magnetic field in the global frame
+bx, by, bz = sympy.symbols("b_x b_y b_z")
+b = sympy.Matrix([bx, by, bz])
+
+# Expected magnetometer reading, the magnetic field in the local frame
+mag_obs = rot_v(b, q.inverse())
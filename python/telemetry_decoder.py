@@ -0,0 +1,249 @@
+"""
+Decodes the telemetry streams of minipilot
+
+Compact state frames are described in `src/telemetry/telemetry_encoder.hpp`,
+the other streams are protobuf `TelemetryMessage`s in frames described in
+`src/tasks/task_telemetry.hpp`, which are collected per stream (payloads
+for the protobuf decoder of the ground station). Delta frames
+(which can carry several records) are reconstructed from the keyframe they reference, so the decoder keeps the
+received keyframes and reports their ids, which the ground station should
+acknowledge (`Command.telemetry_ack`) so that the following frames reference
+them. Every decoded frame is a full telemetry message with all the values of
+the frame (sensor values are the ones from the newest frame which had them).
+
+Usage (from the repository root), decoding the recorded state frames to csv:
+    python python/telemetry_decoder.py <telemetry file> -o telemetry.csv
+"""
+
+import argparse
+import csv
+import math
+import sys
+
+
+SYNC = 0xA7
+MESSAGE_SYNC = 0xA8
+STREAMS = ["state", "attitude", "position", "sensors", "vehicle", "estimator"]
+INFO_KEYFRAME = 0x80
+INFO_SENSORS = 0x40
+KEYFRAME_ID_MASK = 0x3F
+HEADER_SIZE = 3
+CRC_SIZE = 1
+WIDTH_BITS = 5
+DELTA_WIDTH_BITS = 4
+
+GROUPS = ["position", "velocity", "acceleration", "rotation", "angular_velocity",
+          "acc_raw", "acc_corrected", "gyro_raw", "gyro_corrected"]
+GROUP_SIZE = [3, 3, 3, 4, 3, 3, 3, 3, 3]
+STATE_GROUPS = 5
+FIELD_COUNT = 1 + sum(GROUP_SIZE)
+STATE_FIELD_COUNT = 1 + sum(GROUP_SIZE[:STATE_GROUPS])
+QUANTIZED_MAX = (1 << 29) - 1
+QUANTIZED_NAN = -(1 << 29)
+
+COLUMNS = ["time", "keyframe"] + [
+    f"{group}_{axis}" for group, size in zip(GROUPS, GROUP_SIZE)
+    for axis in ("wxyz" if size == 4 else "xyz")
+]
+
+
+def predict_position(position, velocity, dt_ms, exponents):
+    """
+    Position predicted from the keyframe, same as `predict_position` in the encoder
+    """
+    if position == QUANTIZED_NAN or velocity == QUANTIZED_NAN or dt_ms <= 0 or dt_ms > 100000:
+        return position
+    num, den = velocity * dt_ms, 1000
+    shift = exponents[1] - exponents[0]
+    if shift > 0:
+        num *= 10 ** shift
+    else:
+        den *= 10 ** -shift
+    predicted = position + (2 * num + den) // (2 * den)
+    return max(-QUANTIZED_MAX, min(QUANTIZED_MAX, predicted))
+
+
+def crc8(data):
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ (0x07 if crc & 0x80 else 0)) & 0xFF
+    return crc
+
+
+class BitReader:
+    def __init__(self, data):
+        self.value = int.from_bytes(data, "little")
+        self.size = len(data) * 8
+        self.offset = 0
+
+    def read(self, bits):
+        if self.offset + bits > self.size:
+            raise ValueError("frame too short")
+        value = (self.value >> self.offset) & ((1 << bits) - 1)
+        self.offset += bits
+        return value
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def read_fields(reader, count, width_bits):
+    """
+    Time and the groups up to `count` fields, zigzag decoded
+    """
+    fields = []
+    sizes = [1] + GROUP_SIZE
+    for size in sizes:
+        if len(fields) >= count:
+            break
+        width = reader.read(width_bits)
+        fields.extend(unzigzag(reader.read(width)) for _ in range(size))
+    return fields
+
+
+class TelemetryDecoder:
+    """
+    Decodes frames from a byte stream, fed in any chunks
+    """
+    def __init__(self):
+        self.buffer = bytearray()
+        # Quantized values and resolution exponents of the received keyframes, by id
+        self.keyframes = {}
+        self.sensors = [math.nan] * (FIELD_COUNT - STATE_FIELD_COUNT)
+        self.acks = []
+        # Protobuf payloads of the other streams, by stream name
+        self.streams = {}
+        self.frames = 0
+        self.bad_frames = 0
+        self.missing_keyframe = 0
+
+    def feed(self, data):
+        """
+        Decode all complete frames in the stream so far
+        @returns List of decoded messages (dicts of the values)
+        """
+        self.buffer.extend(data)
+        messages = []
+        while True:
+            start = next((i for i, b in enumerate(self.buffer) if b in (SYNC, MESSAGE_SYNC)), -1)
+            if start < 0:
+                self.buffer.clear()
+                break
+            del self.buffer[:start]
+            if len(self.buffer) < HEADER_SIZE:
+                break
+            end = HEADER_SIZE + self.buffer[1] + CRC_SIZE
+            if len(self.buffer) < end:
+                break
+
+            frame = bytes(self.buffer[:end])
+            if crc8(frame[1:-1]) != frame[-1]:
+                self.bad_frames += 1
+                del self.buffer[:1]
+                continue
+            del self.buffer[:end]
+
+            if frame[0] == MESSAGE_SYNC:
+                if frame[2] >= len(STREAMS):
+                    self.bad_frames += 1
+                    continue
+                self.streams.setdefault(STREAMS[frame[2]], []).append(frame[HEADER_SIZE:-1])
+                continue
+
+            try:
+                messages.extend(self.decode_frame(frame[2], frame[HEADER_SIZE:-1]))
+            except ValueError:
+                self.bad_frames += 1
+                continue
+        return messages
+
+    def decode_frame(self, info, payload):
+        """
+        @returns Messages of the records in the frame
+        """
+        keyframe_id = info & KEYFRAME_ID_MASK
+        if info & INFO_KEYFRAME:
+            exponents = [int.from_bytes(payload[i:i + 1], "little", signed=True) for i in range(len(GROUPS))]
+            reader = BitReader(payload[len(GROUPS):])
+            values = read_fields(reader, FIELD_COUNT, WIDTH_BITS)
+            self.keyframes[keyframe_id] = (values, exponents)
+            # Ids are reused, so the keyframes sent long ago with the following ids are stale
+            for stale in range(1, (KEYFRAME_ID_MASK + 1) // 2):
+                self.keyframes.pop((keyframe_id + stale) & KEYFRAME_ID_MASK, None)
+            self.acks.append(keyframe_id)
+            self.frames += 1
+            return [self.to_message(values, exponents, keyframe_id, True)]
+
+        if keyframe_id not in self.keyframes:
+            self.missing_keyframe += 1
+            return []
+
+        # First record is relative to the keyframe and the others to the record before them,
+        # records follow each other until only the padding of the last byte is left
+        base, exponents = self.keyframes[keyframe_id]
+        count = FIELD_COUNT if info & INFO_SENSORS else STATE_FIELD_COUNT
+        reader = BitReader(payload)
+        messages = []
+        while reader.size - reader.offset >= 8:
+            deltas = read_fields(reader, count, DELTA_WIDTH_BITS)
+            predicted = list(base[:count])
+            dt_ms = deltas[0]
+            for i in range(1, 4):
+                predicted[i] = predict_position(base[i], base[i + 3], dt_ms, exponents)
+            values = [p + d for p, d in zip(predicted, deltas)]
+            messages.append(self.to_message(values, exponents, keyframe_id, False))
+            self.frames += 1
+            base = values
+        if not messages:
+            raise ValueError("frame without records")
+        return messages
+
+    def to_message(self, values, exponents, keyframe_id, is_keyframe):
+        message = {"time": values[0] * 1e-3, "keyframe": keyframe_id if is_keyframe else ""}
+        field = 1
+        for group, size, exponent in zip(GROUPS, GROUP_SIZE, exponents):
+            axes = "wxyz" if size == 4 else "xyz"
+            for axis in axes:
+                if field < len(values):
+                    value = values[field]
+                    message[f"{group}_{axis}"] = math.nan if value == QUANTIZED_NAN else value * 10.0 ** exponent
+                field += 1
+
+        # Frames without the sensors show the newest received sensor values
+        sensor_columns = COLUMNS[2 + STATE_FIELD_COUNT - 1:]
+        if len(values) == FIELD_COUNT:
+            self.sensors = [message[c] for c in sensor_columns]
+        else:
+            message.update(zip(sensor_columns, self.sensors))
+        return message
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("telemetry", help="recorded telemetry stream")
+    parser.add_argument("-o", "--output", default="telemetry.csv", help="output csv file")
+    args = parser.parse_args()
+
+    with open(args.telemetry, "rb") as file:
+        data = file.read()
+    decoder = TelemetryDecoder()
+    messages = decoder.feed(data)
+
+    with open(args.output, "w", newline="") as file:
+        writer = csv.DictWriter(file, fieldnames=COLUMNS)
+        writer.writeheader()
+        writer.writerows(messages)
+
+    print(f"{decoder.frames} records ({len(decoder.keyframes)} keyframe ids), {len(data)} bytes "
+          f"({len(data) / max(decoder.frames, 1):.1f} bytes per record), {decoder.bad_frames} damaged frames, "
+          f"{decoder.missing_keyframe} frames with a missing keyframe")
+    for name, payloads in decoder.streams.items():
+        print(f"{name}: {len(payloads)} messages, {sum(len(p) for p in payloads)} bytes")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
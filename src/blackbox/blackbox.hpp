@@ -0,0 +1,55 @@
+#pragma once
+
+#include "mp/util/math.hpp"
+#include "mp/drivers/clock.hpp"
+#include "state/state_estimator.hpp"
+#include "vehicles/vehicle.hpp"
+#include "tasks/task_config.hpp"
+#include "util/ring_buffer.hpp"
+#include <cstdint>
+
+namespace mp {
+
+/**
+ * Type of a blackbox record, the upper nibble of the record header
+ * (the lower nibble is the sensor instance)
+ */
+enum blackbox_record_e : uint8_t {
+    BLACKBOX_ACCELEROMETER  = 0,
+    BLACKBOX_GYROSCOPE      = 1,
+    BLACKBOX_MAGNETOMETER   = 2,
+    BLACKBOX_STATE          = 3,
+    BLACKBOX_CONTROL        = 4,
+    // Total number of records dropped by the producers so far
+    BLACKBOX_DROPPED        = 5
+};
+
+/**
+ * Raw and corrected (calibrated and filtered) value of a sensor sample
+ */
+struct blackbox_sensor_s {
+    vector3f raw;
+    vector3f corrected;
+    timestamp_t timestamp;
+};
+
+/**
+ * Outputs of a vehicle update and the time of the update
+ */
+struct blackbox_control_s {
+    actuation_s actuation;
+    timestamp_t timestamp;
+};
+
+/**
+ * Buffers between the recorded tasks and the blackbox task, each
+ * recorded task pushes into its own channel (single producer)
+ *
+ * Pushing is lock free, so recording does not block the realtime tasks,
+ * and if the blackbox task is not keeping up the records are dropped
+ */
+using blackbox_sensor_channel = ring_buffer<blackbox_sensor_s, TASK_BLACKBOX_SENSOR_BUFFER>;
+using blackbox_state_channel = ring_buffer<state_s, TASK_BLACKBOX_STATE_BUFFER>;
+using blackbox_control_channel = ring_buffer<blackbox_control_s, TASK_BLACKBOX_CTRL_BUFFER>;
+
+}
@@ -0,0 +1,154 @@
+#include "blackbox_encoder.hpp"
+#include "util/crc32.hpp"
+#include <cmath>
+#include <cstring>
+
+namespace mp {
+
+// Resolution of the quantized fields, must match python/blackbox_decoder.py
+static constexpr float SENSOR_RESOLUTION[] = {
+    1e-3f,  // Accelerometer (m/s^2)
+    1e-4f,  // Gyroscope (rad/s)
+    1e-3f   // Magnetometer
+};
+static constexpr float POSITION_RESOLUTION = 1e-3f;
+static constexpr float VELOCITY_RESOLUTION = 1e-3f;
+static constexpr float ACCELERATION_RESOLUTION = 1e-3f;
+static constexpr float ANGULAR_VELOCITY_RESOLUTION = 1e-4f;
+static constexpr float QUATERNION_RESOLUTION = 1e-5f;
+static constexpr float THRUST_RESOLUTION = 1e-3f;
+static constexpr float TORQUE_RESOLUTION = 1e-5f;
+static constexpr float MOTOR_RESOLUTION = 1e-4f;
+
+// Not a number is kept as the smallest value, so that it is visible in the recording
+static constexpr int32_t QUANTIZED_NAN = INT32_MIN;
+
+static int32_t quantize(float value, float resolution) noexcept
+{
+    if (std::isnan(value))
+        return QUANTIZED_NAN;
+
+    const float scaled = value / resolution;
+    if (scaled >= static_cast<float>(INT32_MAX))
+        return INT32_MAX;
+    if (scaled <= -static_cast<float>(INT32_MAX))
+        return -INT32_MAX;
+    return static_cast<int32_t>(std::lround(scaled));
+}
+
+static void quantize(const vector3f& value, float resolution, int32_t* out) noexcept
+{
+    for (size_t i = 0; i < 3; i++)
+        out[i] = quantize(value(i), resolution);
+}
+
+void blackbox_encoder::begin() noexcept
+{
+    m_size = HEADER_SIZE;
+
+    // All streams start from zero in every block
+    memset(m_sensor_streams, 0, sizeof(m_sensor_streams));
+    m_state_stream = {};
+    m_control_stream = {};
+}
+
+bool blackbox_encoder::add_sensor(blackbox_record_e type, size_t instance, const blackbox_sensor_s& sample) noexcept
+{
+    assert(type <= BLACKBOX_MAGNETOMETER && instance < MAX_SENSOR_INSTANCES);
+
+    int32_t values[6];
+    quantize(sample.raw, SENSOR_RESOLUTION[type], values);
+    quantize(sample.corrected, SENSOR_RESOLUTION[type], values + 3);
+
+    const uint8_t header = static_cast<uint8_t>(type << 4 | instance);
+    return add(header, sample.timestamp, values, 6, m_sensor_streams[type][instance]);
+}
+
+bool blackbox_encoder::add_state(const state_s& state) noexcept
+{
+    int32_t values[16];
+    quantize(state.position, POSITION_RESOLUTION, values);
+    quantize(state.velocity, VELOCITY_RESOLUTION, values + 3);
+    quantize(state.acceleration, ACCELERATION_RESOLUTION, values + 6);
+    quantize(state.angular_velocity, ANGULAR_VELOCITY_RESOLUTION, values + 9);
+    const vector4f q = state.rotationq.as_vector();
+    for (size_t i = 0; i < 4; i++)
+        values[12 + i] = quantize(q(i), QUATERNION_RESOLUTION);
+
+    return add(BLACKBOX_STATE << 4, state.timestamp, values, 16, m_state_stream);
+}
+
+bool blackbox_encoder::add_control(const blackbox_control_s& control) noexcept
+{
+    const actuation_s& actuation = control.actuation;
+    const size_t motor_count = actuation.motor_count < motor_frequencies_s::MAX_MOTORS ?
+        actuation.motor_count : motor_frequencies_s::MAX_MOTORS;
+
+    // Motor count is a field as well, so the record layout only depends on it
+    int32_t values[5 + motor_frequencies_s::MAX_MOTORS];
+    values[0] = quantize(actuation.thrust, THRUST_RESOLUTION);
+    quantize(actuation.torque, TORQUE_RESOLUTION, values + 1);
+    values[4] = static_cast<int32_t>(motor_count);
+    for (size_t i = 0; i < motor_count; i++)
+        values[5 + i] = quantize(actuation.motors[i], MOTOR_RESOLUTION);
+
+    return add(BLACKBOX_CONTROL << 4, control.timestamp, values, 5 + motor_count, m_control_stream);
+}
+
+bool blackbox_encoder::add_dropped(uint32_t dropped) noexcept
+{
+    if (m_size + 1 + 5 + CRC_SIZE > TASK_BLACKBOX_BLOCK_SIZE)
+        return false;
+
+    m_block[m_size++] = BLACKBOX_DROPPED << 4;
+    put_varint(dropped);
+    return true;
+}
+
+bool blackbox_encoder::add(uint8_t header, timestamp_t timestamp, const int32_t* values, size_t count, stream_s& stream) noexcept
+{
+    if (m_size + MAX_RECORD_SIZE + CRC_SIZE > TASK_BLACKBOX_BLOCK_SIZE)
+        return false;
+
+    // Zigzag maps small differences of both signs to small unsigned values
+    const auto zigzag = [](int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    };
+
+    m_block[m_size++] = header;
+    put_varint(zigzag(timestamp.count() - stream.timestamp));
+    stream.timestamp = timestamp.count();
+
+    for (size_t i = 0; i < count; i++) {
+        put_varint(zigzag(static_cast<int64_t>(values[i]) - stream.values[i]));
+        stream.values[i] = values[i];
+    }
+    return true;
+}
+
+void blackbox_encoder::put_varint(uint64_t value) noexcept
+{
+    while (value >= 0x80) {
+        m_block[m_size++] = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    m_block[m_size++] = static_cast<uint8_t>(value);
+}
+
+size_t blackbox_encoder::finish(const uint8_t*& data) noexcept
+{
+    const size_t payload_size = m_size - HEADER_SIZE;
+    m_block[0] = SYNC[0];
+    m_block[1] = SYNC[1];
+    m_block[2] = static_cast<uint8_t>(payload_size);
+    m_block[3] = static_cast<uint8_t>(payload_size >> 8);
+
+    const uint32_t crc = crc32(m_block + HEADER_SIZE, payload_size);
+    for (size_t i = 0; i < CRC_SIZE; i++)
+        m_block[m_size++] = static_cast<uint8_t>(crc >> (8 * i));
+
+    data = m_block;
+    return m_size;
+}
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "blackbox/blackbox.hpp"
+#include "mp/util/constants.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace mp {
+
+/**
+ * Encodes the blackbox records into blocks written to the blackbox device
+ *
+ * A block is `SYNC` (2 bytes), the payload size (2 bytes), the payload and
+ * the CRC-32 of the payload (all little endian). The payload is a sequence
+ * of records, each being a header byte (type and instance), the timestamp
+ * and a fixed list of fields for the record type. Fields are quantized to
+ * integers with a fixed resolution per field, and every field (including
+ * the timestamp) is stored as a zigzag varint of the difference to the
+ * previous record of the same stream in the block. The first record of each
+ * stream in a block is stored as a difference to zero, so every block can
+ * be decoded on its own.
+ *
+ * @note Format is decoded by `python/blackbox_decoder.py`
+ */
+class blackbox_encoder {
+
+public:
+    static constexpr uint8_t SYNC[2] = {0xB8, 0x0C};
+    static constexpr size_t HEADER_SIZE = 4;
+    static constexpr size_t CRC_SIZE = 4;
+    static constexpr size_t MAX_FIELDS = 16;
+    // Header byte, timestamp and fields (the difference of two int32 fits in 5 bytes)
+    static constexpr size_t MAX_RECORD_SIZE = 1 + 10 + 5 * MAX_FIELDS;
+
+    static_assert(TASK_BLACKBOX_BLOCK_SIZE >= HEADER_SIZE + MAX_RECORD_SIZE + CRC_SIZE);
+    static_assert(TASK_BLACKBOX_BLOCK_SIZE <= HEADER_SIZE + UINT16_MAX + CRC_SIZE);
+
+    blackbox_encoder() noexcept
+    {
+        begin();
+    }
+
+    /**
+     * Start a new block
+     */
+    void begin() noexcept;
+
+    /**
+     * Add a sensor sample, `type` is one of the sensor record types
+     * @returns false if the block is full, in which case nothing is added
+     */
+    bool add_sensor(blackbox_record_e type, size_t instance, const blackbox_sensor_s& sample) noexcept;
+
+    /**
+     * Add a state estimator state
+     * @returns false if the block is full
+     */
+    bool add_state(const state_s& state) noexcept;
+
+    /**
+     * Add the outputs of a vehicle update
+     * @returns false if the block is full
+     */
+    bool add_control(const blackbox_control_s& control) noexcept;
+
+    /**
+     * Add the total number of records dropped so far
+     * @returns false if the block is full
+     */
+    bool add_dropped(uint32_t dropped) noexcept;
+
+    /**
+     * @returns true if no records were added since `begin`
+     */
+    bool is_empty() const noexcept
+    {
+        return m_size == HEADER_SIZE;
+    }
+
+    /**
+     * Complete the block with its header and checksum
+     * @returns Size of the block at `data`, valid until the next `begin`
+     */
+    size_t finish(const uint8_t*& data) noexcept;
+
+private:
+    // Previous record of a stream, which the next record is encoded relative to
+    struct stream_s {
+        int64_t timestamp;
+        int32_t values[MAX_FIELDS];
+    };
+
+    /**
+     * Encode a record relative to the previous one of the same stream
+     */
+    bool add(uint8_t header, timestamp_t timestamp, const int32_t* values, size_t count, stream_s& stream) noexcept;
+
+    void put_varint(uint64_t value) noexcept;
+
+private:
+    uint8_t m_block[TASK_BLACKBOX_BLOCK_SIZE];
+    size_t m_size;
+
+    stream_s m_sensor_streams[BLACKBOX_MAGNETOMETER + 1][MAX_SENSOR_INSTANCES];
+    stream_s m_state_stream;
+    stream_s m_control_stream;
+};
+
+}
@@ -0,0 +1,62 @@
+#include "accel_calibrator.hpp"
+#include "mp/util/constants.hpp"
+#include <cmath>
+
+namespace mp {
+
+bool accel_calibrator::add(const vector3f& sample) noexcept
+{
+    m_window.add(sample);
+    if (m_window.get_count() < m_params.window_samples)
+        return is_complete();
+
+    const size_t position = m_window.get_max_variance() <= m_params.max_variance ?
+        classify(m_window.get_mean()) : POSITIONS;
+
+    // Captured positions are not extended, so holding one position
+    // for long does not matter and the others are still required
+    if (position < POSITIONS && !(m_captured & (1u << position))) {
+        m_positions[position].merge(m_window);
+        if (m_positions[position].get_count() >= m_params.required_samples)
+            m_captured |= 1u << position;
+    }
+
+    m_window.reset();
+    return is_complete();
+}
+
+void accel_calibrator::reset() noexcept
+{
+    m_window.reset();
+    for (welford<3>& position : m_positions)
+        position.reset();
+    m_captured = 0;
+}
+
+sensor_calibration_s accel_calibrator::get_result() const noexcept
+{
+    sensor_calibration_s result;
+    for (size_t axis = 0; axis < 3; axis++) {
+        const float up = m_positions[2 * axis].get_mean()(axis);
+        const float down = m_positions[2 * axis + 1].get_mean()(axis);
+        result.bias(axis) = (up + down) / 2.f;
+        result.scale(axis) = 2.f * G / (up - down);
+    }
+    return result;
+}
+
+size_t accel_calibrator::classify(const vector3f& mean) const noexcept
+{
+    // Scale and bias errors are small, so the magnitude is still close to G
+    const float magnitude = mean.norm();
+    if (std::fabs(magnitude - G) > m_params.gravity_tolerance * G)
+        return POSITIONS;
+
+    for (size_t axis = 0; axis < 3; axis++) {
+        if (std::fabs(mean(axis)) >= m_params.min_alignment * magnitude)
+            return 2 * axis + (mean(axis) < 0.f ? 1 : 0);
+    }
+    return POSITIONS;
+}
+
+}
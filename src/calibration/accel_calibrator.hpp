@@ -0,0 +1,85 @@
+#pragma once
+
+#include "calibration/sensor_calibration.hpp"
+#include "util/welford.hpp"
+#include <cstdint>
+
+namespace mp {
+
+/**
+ * Six position accelerometer calibration of the bias and scale of each axis
+ *
+ * The sensor is held still with each of its axes pointing up and then
+ * down, in any order. Stationary windows are classified by the axis which
+ * measures (nearly) all of the gravity and merged into the statistics of
+ * that position. With the mean readings `p` (pointing up) and `n` (pointing
+ * down) of an axis, `bias = (p + n) / 2` and `scale = 2G / (p - n)`.
+ */
+class accel_calibrator {
+
+public:
+    static constexpr size_t POSITIONS = 6;
+    static constexpr uint8_t ALL_POSITIONS = (1u << POSITIONS) - 1;
+
+    struct params_s {
+        // Duration of a single window in samples
+        uint32_t window_samples;
+        // Largest variance of an axis within a stationary window in (m/s^2)^2
+        float max_variance;
+        // Largest relative difference of the measured magnitude from G
+        float gravity_tolerance;
+        // Smallest fraction of the magnitude measured by the axis pointing up or down
+        float min_alignment;
+        // Samples needed in each position
+        uint32_t required_samples;
+    };
+
+    explicit accel_calibrator(const params_s& params) noexcept :
+        m_params(params)
+    {}
+
+    /**
+     * Add a raw sample in the sensor frame
+     * @returns true once all positions are captured
+     */
+    bool add(const vector3f& sample) noexcept;
+
+    /**
+     * Drop all positions and start again
+     */
+    void reset() noexcept;
+
+    /**
+     * Positions with enough samples, bit `2 * axis` for the axis pointing
+     * up (positive reading) and bit `2 * axis + 1` for pointing down
+     */
+    uint8_t get_captured() const noexcept
+    {
+        return m_captured;
+    }
+
+    bool is_complete() const noexcept
+    {
+        return m_captured == ALL_POSITIONS;
+    }
+
+    /**
+     * Bias and scale from the captured positions
+     * @note Only valid once complete
+     */
+    sensor_calibration_s get_result() const noexcept;
+
+private:
+    /**
+     * Position of a stationary window, or `POSITIONS` if not aligned with an axis
+     */
+    size_t classify(const vector3f& mean) const noexcept;
+
+private:
+    params_s m_params;
+    welford<3> m_window;
+    welford<3> m_positions[POSITIONS];
+    uint8_t m_captured = 0;
+};
+
+}
@@ -0,0 +1,76 @@
+#include "calibration_store.hpp"
+#include "util/crc32.hpp"
+#include <cmath>
+#include <cstddef>
+
+namespace mp {
+
+bool calibration_store::load(calibration_s& calibration) noexcept
+{
+    record_s record;
+    if (m_address + sizeof(record) > m_storage.get_size())
+        return false;
+    if (!m_storage.read(m_address, &record, sizeof(record)))
+        return false;
+
+    if (record.magic != MAGIC || record.version != VERSION)
+        return false;
+    if (record.crc != crc32(&record, offsetof(record_s, crc)))
+        return false;
+    for (float value : record.values) {
+        if (!std::isfinite(value))
+            return false;
+    }
+
+    for (size_t i = 0; i < MAX_SENSOR_INSTANCES; i++) {
+        const float* v = &record.values[i * VALUES_PER_INSTANCE];
+        calibration.accelerometers[i].bias = vector3f {v[0], v[1], v[2]};
+        calibration.accelerometers[i].scale = vector3f {v[3], v[4], v[5]};
+        calibration.gyroscopes[i].bias = vector3f {v[6], v[7], v[8]};
+        calibration.gyroscopes[i].scale = vector3f {v[9], v[10], v[11]};
+    }
+
+    const float* m = &record.values[VALUES_PER_INSTANCE * MAX_SENSOR_INSTANCES];
+    calibration.has_magnetometer = record.flags & FLAG_MAGNETOMETER;
+    if (calibration.has_magnetometer) {
+        calibration.magnetometer.bias = vector3f {m[0], m[1], m[2]};
+        calibration.magnetometer.scale = vector3f {m[3], m[4], m[5]};
+    }
+    return true;
+}
+
+bool calibration_store::save(const calibration_s& calibration) noexcept
+{
+    if (m_address + sizeof(record_s) > m_storage.get_size())
+        return false;
+
+    record_s record;
+    record.magic = MAGIC;
+    record.version = VERSION;
+    record.flags = calibration.has_magnetometer ? FLAG_MAGNETOMETER : 0;
+    for (size_t i = 0; i < MAX_SENSOR_INSTANCES; i++) {
+        const sensor_calibration_s& a = calibration.accelerometers[i];
+        const sensor_calibration_s& g = calibration.gyroscopes[i];
+        const float values[VALUES_PER_INSTANCE] = {
+            a.bias(0), a.bias(1), a.bias(2),
+            a.scale(0), a.scale(1), a.scale(2),
+            g.bias(0), g.bias(1), g.bias(2),
+            g.scale(0), g.scale(1), g.scale(2)
+        };
+        for (size_t j = 0; j < VALUES_PER_INSTANCE; j++)
+            record.values[i * VALUES_PER_INSTANCE + j] = values[j];
+    }
+
+    const sensor_calibration_s& m = calibration.magnetometer;
+    const float magnetometer[MAGNETOMETER_VALUES] = {
+        m.bias(0), m.bias(1), m.bias(2),
+        m.scale(0), m.scale(1), m.scale(2)
+    };
+    for (size_t j = 0; j < MAGNETOMETER_VALUES; j++)
+        record.values[VALUES_PER_INSTANCE * MAX_SENSOR_INSTANCES + j] = magnetometer[j];
+    record.crc = crc32(&record, offsetof(record_s, crc));
+
+    return m_storage.write(m_address, &record, sizeof(record));
+}
+
+}
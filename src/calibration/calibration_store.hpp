@@ -0,0 +1,59 @@
+#pragma once
+
+#include "calibration/sensor_calibration.hpp"
+#include "mp/drivers/storage.hpp"
+#include <cstdint>
+
+namespace mp {
+
+/**
+ * Keeps the sensor calibration in the non-volatile storage
+ *
+ * Record is a header with the format version, the calibration values and
+ * a CRC of both, so a missing, partially written or outdated record
+ * is detected on load and the defaults are used instead.
+ */
+class calibration_store {
+
+public:
+    explicit calibration_store(storage& storage, size_t address = 0) noexcept :
+        m_storage(storage), m_address(address)
+    {}
+
+    /**
+     * Read the stored calibration
+     * @returns false if there is no valid record, leaving `calibration` unchanged
+     */
+    bool load(calibration_s& calibration) noexcept;
+
+    /**
+     * Replace the stored calibration
+     */
+    bool save(const calibration_s& calibration) noexcept;
+
+private:
+    static constexpr uint32_t MAGIC = 0x4C43504D; // "MPCL"
+    // Incremented whenever the layout of the values changes
+    static constexpr uint32_t VERSION = 3;
+    // Bias and scale of an accelerometer and a gyroscope
+    static constexpr size_t VALUES_PER_INSTANCE = 12;
+    // Bias and scale of the magnetometer, after all instances
+    static constexpr size_t MAGNETOMETER_VALUES = 6;
+    static constexpr size_t VALUE_COUNT = VALUES_PER_INSTANCE * MAX_SENSOR_INSTANCES + MAGNETOMETER_VALUES;
+    static constexpr uint32_t FLAG_MAGNETOMETER = 1u << 0;
+
+    struct record_s {
+        uint32_t magic;
+        uint32_t version;
+        // Which of the optional calibrations are valid
+        uint32_t flags;
+        float values[VALUE_COUNT];
+        uint32_t crc;
+    };
+
+private:
+    storage& m_storage;
+    size_t m_address;
+};
+
+}
@@ -0,0 +1,23 @@
+#include "gyro_bias_estimator.hpp"
+
+namespace mp {
+
+bool gyro_bias_estimator::add(const vector3f& sample) noexcept
+{
+    m_window.add(sample);
+    if (m_window.get_count() < m_params.window_samples)
+        return is_converged();
+
+    // Windows with motion (or an implausible mean) are dropped
+    // without discarding the rest windows accepted before them
+    const bool at_rest =
+        m_window.get_max_variance() <= m_params.max_variance &&
+        m_window.get_mean().norm() <= m_params.max_bias;
+    if (at_rest)
+        m_rest.merge(m_window);
+
+    m_window.reset();
+    return is_converged();
+}
+
+}
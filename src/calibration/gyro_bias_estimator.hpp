@@ -0,0 +1,77 @@
+#pragma once
+
+#include "util/welford.hpp"
+#include <cstdint>
+
+namespace mp {
+
+/**
+ * Gyroscope bias estimation while the vehicle is at rest
+ *
+ * Samples are split into short windows, and a window is only used if the
+ * variance of each axis is low enough that the vehicle was not moving
+ * (and the mean is a plausible bias). Statistics of the accepted windows
+ * are merged, so rest periods interrupted by motion still add up. Bias is
+ * the mean of all accepted samples, so nothing is buffered.
+ */
+class gyro_bias_estimator {
+
+public:
+    struct params_s {
+        // Duration of a single window in samples
+        uint32_t window_samples;
+        // Largest variance of an axis within a window at rest in (rad/s)^2
+        float max_variance;
+        // Largest plausible bias magnitude in rad/s
+        float max_bias;
+        // Accepted samples needed for a converged estimate
+        uint32_t required_samples;
+    };
+
+    explicit gyro_bias_estimator(const params_s& params) noexcept :
+        m_params(params)
+    {}
+
+    /**
+     * Add a raw sample in the sensor frame
+     * @returns true once the estimate has converged
+     */
+    bool add(const vector3f& sample) noexcept;
+
+    /**
+     * Drop all samples and start again
+     */
+    void reset() noexcept
+    {
+        m_window.reset();
+        m_rest.reset();
+    }
+
+    bool is_converged() const noexcept
+    {
+        return m_rest.get_count() >= m_params.required_samples;
+    }
+
+    /**
+     * Mean of all samples taken at rest
+     */
+    vector3f get_bias() const noexcept
+    {
+        return m_rest.get_mean();
+    }
+
+    /**
+     * Variance of the samples taken at rest, which is the gyroscope noise
+     */
+    vector3f get_noise_variance() const noexcept
+    {
+        return m_rest.get_variance();
+    }
+
+private:
+    params_s m_params;
+    welford<3> m_window;
+    welford<3> m_rest;
+};
+
+}
@@ -0,0 +1,59 @@
+#include "mag_calibrator.hpp"
+#include <limits>
+
+namespace mp {
+
+bool mag_calibrator::add(const vector3f& sample) noexcept
+{
+    m_window.add(sample);
+    if (m_window.get_count() < m_params.window_samples)
+        return is_complete();
+
+    const vector3f mean = m_window.get_mean();
+    for (size_t axis = 0; axis < 3; axis++) {
+        m_min(axis) = mean(axis) < m_min(axis) ? mean(axis) : m_min(axis);
+        m_max(axis) = mean(axis) > m_max(axis) ? mean(axis) : m_max(axis);
+    }
+    m_windows++;
+    m_window.reset();
+
+    float largest = 0.f;
+    for (size_t axis = 0; axis < 3; axis++) {
+        const float half_range = (m_max(axis) - m_min(axis)) / 2.f;
+        largest = half_range > largest ? half_range : largest;
+    }
+
+    // Taken again every window, since an axis can fall behind when another one grows
+    m_covered = 0;
+    for (size_t axis = 0; axis < 3; axis++) {
+        const float half_range = (m_max(axis) - m_min(axis)) / 2.f;
+        if (half_range >= m_params.min_field && half_range >= m_params.min_coverage * largest)
+            m_covered |= 1u << axis;
+    }
+
+    return is_complete();
+}
+
+void mag_calibrator::reset() noexcept
+{
+    m_window.reset();
+    m_min = vector3f(std::numeric_limits<float>::infinity());
+    m_max = vector3f(-std::numeric_limits<float>::infinity());
+    m_windows = 0;
+    m_covered = 0;
+}
+
+sensor_calibration_s mag_calibrator::get_result() const noexcept
+{
+    const vector3f half_range = (m_max - m_min) / 2.f;
+    const float mean_half_range = (half_range(0) + half_range(1) + half_range(2)) / 3.f;
+
+    sensor_calibration_s result;
+    for (size_t axis = 0; axis < 3; axis++) {
+        result.bias(axis) = (m_max(axis) + m_min(axis)) / 2.f;
+        result.scale(axis) = mean_half_range / half_range(axis);
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "calibration/sensor_calibration.hpp"
+#include "util/welford.hpp"
+#include <cstdint>
+
+namespace mp {
+
+/**
+ * Magnetometer hard-iron and soft-iron calibration from the extremes of each axis
+ *
+ * The sensor is rotated through all orientations, so that each axis points
+ * along the field and against it. Without distortions the readings lie on a
+ * sphere around zero, a hard-iron offset moves its center and soft-iron
+ * stretches it into an (axis aligned) ellipsoid. The center is in the middle
+ * of the smallest and largest reading of each axis, and each axis is scaled
+ * so that its half range is the mean half range of the three axes, which
+ * keeps the field strength. Only the means of short windows are compared,
+ * so a noise spike does not move the extremes. Nothing is buffered.
+ */
+class mag_calibrator {
+
+public:
+    static constexpr uint8_t ALL_AXES = (1u << 3) - 1;
+
+    struct params_s {
+        // Duration of a single window in samples
+        uint32_t window_samples;
+        // Smallest half range of an axis relative to the largest one, below it
+        // the axis has not been rotated through the field direction yet
+        float min_coverage;
+        // Smallest half range of the axes, a weaker field is not plausible
+        float min_field;
+        // Windows needed before the calibration can complete
+        uint32_t required_windows;
+    };
+
+    explicit mag_calibrator(const params_s& params) noexcept :
+        m_params(params)
+    {
+        reset();
+    }
+
+    /**
+     * Add a raw sample in the sensor frame
+     * @returns true once all axes are covered
+     */
+    bool add(const vector3f& sample) noexcept;
+
+    /**
+     * Drop all extremes and start again
+     */
+    void reset() noexcept;
+
+    /**
+     * Axes which have been rotated through the field, bit `axis` for each
+     */
+    uint8_t get_covered() const noexcept
+    {
+        return m_covered;
+    }
+
+    bool is_complete() const noexcept
+    {
+        return m_covered == ALL_AXES && m_windows >= m_params.required_windows;
+    }
+
+    /**
+     * Bias and scale from the extremes
+     * @note Only valid once complete
+     */
+    sensor_calibration_s get_result() const noexcept;
+
+private:
+    params_s m_params;
+    welford<3> m_window;
+    vector3f m_min;
+    vector3f m_max;
+    uint32_t m_windows;
+    uint8_t m_covered;
+};
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "mp/util/math.hpp"
+#include "mp/util/constants.hpp"
+
+namespace mp {
+
+/**
+ * Per axis correction of a three axis sensor in the sensor frame
+ *
+ * Corrected value is `(raw - bias) * scale` for each axis,
+ * applied before mapping the sample to the mp coordinate frame
+ */
+struct sensor_calibration_s {
+    vector3f bias = vector3f(0);
+    vector3f scale = vector3f(1);
+
+    vector3f apply(const vector3f& raw) const noexcept
+    {
+        return {
+            (raw(0) - bias(0)) * scale(0),
+            (raw(1) - bias(1)) * scale(1),
+            (raw(2) - bias(2)) * scale(2)
+        };
+    }
+};
+
+/**
+ * Calibration of all sensors (each redundant instance separately), as stored between boots
+ */
+struct calibration_s {
+    sensor_calibration_s accelerometers[MAX_SENSOR_INSTANCES];
+    sensor_calibration_s gyroscopes[MAX_SENSOR_INSTANCES];
+    // Hard and soft iron corrections, without them the magnetometer is not fused
+    sensor_calibration_s magnetometer;
+    bool has_magnetometer = false;
+};
+
+}
@@ -3,16 +3,30 @@
 #include "tasks/task_telemetry.hpp"
 #include "tasks/task_accelerometer.hpp"
 #include "tasks/task_gyroscope.hpp"
+#include "tasks/task_magnetometer.hpp"
+#include "tasks/task_gnss.hpp"
+#include "tasks/task_barometer.hpp"
 #include "tasks/task_state_estimator.hpp"
 #include "tasks/task_receiver.hpp"
 #include "tasks/task_vehicle.hpp"
+#include "tasks/task_calibration.hpp"
+#include "tasks/task_blackbox.hpp"
 #include "util/logger.hpp"
+#include <optional>
 
 namespace mp {
 
 // Timeout for checking if the device is properly working
 inline constexpr auto DEVICE_PROBE_TIMEOUT = std::chrono::milliseconds(10);
 
+// Sensors without a transform are already in the mp coordinate frame
+template <typename sensor_type>
+static const matrix3f& get_transform(const three_axis_device_s<sensor_type>& device) noexcept
+{
+    static const matrix3f identity = matrix3f::identity();
+    return device.transform ? *device.transform : identity;
+}
+
 int main(const devices_s& devices, state_estimator& state_estimator, vehicle& vehicle)
 {
     // If the logging task is not created, this stays uninitialized
@@ -29,27 +43,133 @@ int main(const devices_s& devices, state_estimator& state_estimator, vehicle& ve
         log_info("Logging available!");
     }
 
-    // Accelerometer is required
-    if (!devices.accelerometer.sensor.probe()) {
+    // Read the stored sensor calibration, so the sensors start already calibrated
+    calibration_s calibration;
+    calibration_store* calibration_store_ptr = nullptr;
+    if (devices.storage_device) {
+        static calibration_store calibration_store(*devices.storage_device);
+        calibration_store_ptr = &calibration_store;
+
+        if (!calibration_store.load(calibration))
+            log_warning("No stored calibration, accelerometer calibration needed!");
+    } else {
+        log_warning("Storage not available, calibration will not be kept!");
+    }
+
+    // Blackbox is optional, recorded tasks are connected to it as they are created
+    task_blackbox* task_blackbox_ptr = nullptr;
+    if (devices.blackbox_device && devices.blackbox_device->probe(DEVICE_PROBE_TIMEOUT)) {
+        static task_blackbox task_blackbox(*devices.blackbox_device);
+        task_blackbox_ptr = &task_blackbox;
+        log_info("Blackbox available!");
+    }
+
+    // Motor frequencies are published by the vehicle task for the gyroscope notches
+    static seqlock<motor_frequencies_s> motor_frequencies;
+
+    // Create a task for each working instance of the sensors, a failed
+    // redundant instance is skipped, but at least one of each is required
+    static std::optional<task_accelerometer> accelerometer_tasks[MAX_SENSOR_INSTANCES];
+    static std::optional<task_gyroscope> gyroscope_tasks[MAX_SENSOR_INSTANCES];
+    sensor_instances_s<task_accelerometer> accelerometers;
+    sensor_instances_s<task_gyroscope> gyroscopes;
+
+    for (size_t i = 0; i < MAX_SENSOR_INSTANCES; i++) {
+        const auto& device = devices.accelerometers[i];
+        if (!device.sensor)
+            continue;
+        if (!device.sensor->probe()) {
+            log_warning("Accelerometer ", static_cast<int>(i), " not available!");
+            continue;
+        }
+        accelerometers.tasks[i] = &accelerometer_tasks[i].emplace(
+            *device.sensor,
+            device.fifo,
+            device.data_ready,
+            devices.clock,
+            get_transform(device),
+            calibration.accelerometers[i]
+        );
+        if (task_blackbox_ptr)
+            accelerometers.tasks[i]->set_recorder(&task_blackbox_ptr->get_sensor_channel(BLACKBOX_ACCELEROMETER, i));
+    }
+    if (!accelerometers.get_count()) {
         log_error("Accelerometer not available!");
         return 1;
     }
-    // TODO: Read bias from the configuration if exists, else warn the user
-    vector3f accelerometer_bias = 0;
-    // Create the accelerometer task
-    static task_accelerometer task_accelerometer(
-        devices.accelerometer.sensor,
-        devices.accelerometer.transform,
-        accelerometer_bias
-    );
 
-    // Gyroscope is required
-    if (!devices.gyroscope.sensor.probe()) {
+    for (size_t i = 0; i < MAX_SENSOR_INSTANCES; i++) {
+        const auto& device = devices.gyroscopes[i];
+        if (!device.sensor)
+            continue;
+        if (!device.sensor->probe()) {
+            log_warning("Gyroscope ", static_cast<int>(i), " not available!");
+            continue;
+        }
+        gyroscopes.tasks[i] = &gyroscope_tasks[i].emplace(
+            *device.sensor,
+            device.fifo,
+            device.data_ready,
+            devices.clock,
+            get_transform(device),
+            calibration.gyroscopes[i],
+            motor_frequencies
+        );
+        if (task_blackbox_ptr)
+            gyroscopes.tasks[i]->set_recorder(&task_blackbox_ptr->get_sensor_channel(BLACKBOX_GYROSCOPE, i));
+    }
+    if (!gyroscopes.get_count()) {
         log_error("Gyroscope not available!");
         return 1;
     }
-    // Create the gyroscope task
-    static task_gyroscope task_gyroscope(devices.gyroscope.sensor, devices.gyroscope.transform);
+
+    // Magnetometer, GNSS and barometer are optional, and only fused if available. An
+    // uncalibrated magnetometer would pull the heading off, so it is only fused once
+    // it has a calibration, stored or estimated after a calibration command.
+    task_magnetometer* task_magnetometer_ptr = nullptr;
+    if (!devices.magnetometer.sensor || !devices.magnetometer.sensor->probe()) {
+        log_warning("Magnetometer not available!");
+    } else {
+        if (!calibration.has_magnetometer)
+            log_warning("No stored magnetometer calibration, magnetometer not used until calibrated!");
+        static task_magnetometer task_magnetometer(
+            *devices.magnetometer.sensor,
+            devices.magnetometer.fifo,
+            devices.magnetometer.data_ready,
+            devices.clock,
+            get_transform(devices.magnetometer),
+            calibration.magnetometer,
+            calibration.has_magnetometer
+        );
+        task_magnetometer_ptr = &task_magnetometer;
+        if (task_blackbox_ptr)
+            task_magnetometer.set_recorder(&task_blackbox_ptr->get_sensor_channel(BLACKBOX_MAGNETOMETER, 0));
+    }
+
+    task_gnss* task_gnss_ptr = nullptr;
+    if (devices.gnss_device && devices.gnss_device->probe()) {
+        static task_gnss task_gnss(*devices.gnss_device, devices.clock);
+        task_gnss_ptr = &task_gnss;
+    } else {
+        log_warning("GNSS not available!");
+    }
+
+    task_barometer* task_barometer_ptr = nullptr;
+    if (devices.barometer_device && devices.barometer_device->probe()) {
+        static task_barometer task_barometer(*devices.barometer_device, devices.clock);
+        task_barometer_ptr = &task_barometer;
+    } else {
+        log_warning("Barometer not available!");
+    }
+
+    // Create the calibration task
+    static task_calibration task_calibration(
+        calibration_store_ptr,
+        accelerometers,
+        gyroscopes,
+        task_magnetometer_ptr,
+        calibration
+    );
 
     // Receiver is required
     if (!devices.receiver_device.probe(DEVICE_PROBE_TIMEOUT)) {
@@ -62,26 +182,40 @@ int main(const devices_s& devices, state_estimator& state_estimator, vehicle& ve
     // Create the state estimator task
     static task_state_estimator task_state_estimator(
         state_estimator,
-        task_accelerometer,
-        task_gyroscope
+        accelerometers,
+        gyroscopes,
+        task_magnetometer_ptr,
+        task_gnss_ptr,
+        task_barometer_ptr,
+        devices.clock
     );
+    if (task_blackbox_ptr)
+        task_state_estimator.set_recorder(&task_blackbox_ptr->get_state_channel());
 
     // Create the vehicle task
     static task_vehicle task_vehicle(
         vehicle,
         task_receiver,
-        task_state_estimator
+        task_state_estimator,
+        task_calibration,
+        devices.clock,
+        motor_frequencies
     );
+    if (task_blackbox_ptr)
+        task_vehicle.set_recorder(&task_blackbox_ptr->get_control_channel());
 
     // If there is a telemetry device available, create the telemetry task
     // Telemetry could also be required (not optional)
     if (devices.telemetry_device && devices.telemetry_device->probe(DEVICE_PROBE_TIMEOUT)) {
         static task_telemetry task_telemetry(
             *devices.telemetry_device,
-            task_accelerometer,
-            task_gyroscope,
-            task_state_estimator
+            *accelerometers.get_first(),
+            *gyroscopes.get_first(),
+            task_state_estimator,
+            task_vehicle,
+            vehicle
         );
+        task_vehicle.set_telemetry(&task_telemetry);
         log_info("Telemetry available!");
     } else {
         log_warning("Telemetry not available!");
@@ -0,0 +1,164 @@
+// Generated by python/codegen.py from python/model.py, do not edit
+
+#include "model_jacobians.hpp"
+#include "mp/util/constants.hpp"
+
+namespace mp::model {
+
+matrixf<3, 4>
+copter_da_dq(float thrust, float mass, const vector4f& qv) noexcept
+{
+    const float qw = qv(0), qx = qv(1), qy = qv(2), qz = qv(3);
+
+    const float t0 = 2*thrust/mass;
+    const float t1 = qy*t0;
+    const float t2 = qz*t0;
+    const float t3 = qw*t0;
+    const float t4 = qx*t0;
+    const float t5 = -t4;
+
+    return matrixf<3, 4> {
+        {t1, t2, t3, t4},
+        {t5, -t3, t2, t1},
+        {t3, t5, -t1, t2}
+    };
+}
+
+matrixf<3>
+copter_ddw_dw(const matrix3f& inertia, const vector3f& w) noexcept
+{
+    const float Ix = inertia(0, 0), Iy = inertia(1, 1), Iz = inertia(2, 2);
+    const float wx = w(0), wy = w(1), wz = w(2);
+
+    const float t0 = 1.f/Ix;
+    const float t1 = -Iz*wz;
+    const float t2 = Iy*wy;
+    const float t3 = 1.f/Iy;
+    const float t4 = Ix*wx;
+    const float t5 = 1.f/Iz;
+
+    return matrixf<3> {
+        {0, t0*(Iy*wz + t1), t0*(-Iz*wy + t2)},
+        {t3*(-Ix*wz - t1), 0, t3*(Iz*wx - t4)},
+        {t5*(Ix*wy - t2), t5*(-Iy*wx + t4), 0}
+    };
+}
+
+matrixf<4>
+rotation_dq_dq(const vector3f& w, float dt) noexcept
+{
+    const float wx = w(0), wy = w(1), wz = w(2);
+
+    const float t0 = 0.5f*dt;
+    const float t1 = wx*t0;
+    const float t2 = -t1;
+    const float t3 = wy*t0;
+    const float t4 = -t3;
+    const float t5 = wz*t0;
+    const float t6 = -t5;
+
+    return matrixf<4> {
+        {1, t2, t4, t6},
+        {t1, 1, t5, t4},
+        {t3, t6, 1, t1},
+        {t5, t3, t2, 1}
+    };
+}
+
+matrixf<4, 3>
+rotation_dq_dw(const vector4f& qv, float dt) noexcept
+{
+    const float qw = qv(0), qx = qv(1), qy = qv(2), qz = qv(3);
+
+    const float t0 = 0.5f*dt;
+    const float t1 = qx*t0;
+    const float t2 = -t1;
+    const float t3 = qy*t0;
+    const float t4 = -t3;
+    const float t5 = qz*t0;
+    const float t6 = -t5;
+    const float t7 = qw*t0;
+
+    return matrixf<4, 3> {
+        {t2, t4, t6},
+        {t7, t6, t3},
+        {t5, t7, t2},
+        {t4, t1, t7}
+    };
+}
+
+matrixf<3>
+accel_obs_da_da(const vector4f& qv) noexcept
+{
+    const float qw = qv(0), qx = qv(1), qy = qv(2), qz = qv(3);
+
+    const float t0 = qx*qx;
+    const float t1 = qy*qy;
+    const float t2 = -t1;
+    const float t3 = qw*qw;
+    const float t4 = qz*qz;
+    const float t5 = t3 - t4;
+    const float t6 = 2*qw;
+    const float t7 = qz*t6;
+    const float t8 = 2*qx;
+    const float t9 = qy*t6;
+    const float t10 = -t0;
+    const float t11 = qx*t6;
+
+    return matrixf<3> {
+        {t0 + t2 + t5, qy*t8 + t7, 2*qx*qz - t9},
+        {2*qx*qy - t7, t1 + t10 + t5, 2*qy*qz + t11},
+        {qz*t8 + t9, 2*qy*qz - t11, t10 + t2 + t3 + t4}
+    };
+}
+
+matrixf<3, 4>
+accel_obs_da_dq(const vector4f& qv, const vector3f& a) noexcept
+{
+    const float qw = qv(0), qx = qv(1), qy = qv(2), qz = qv(3);
+    const float ax = a(0), ay = a(1), az = a(2);
+
+    const float t0 = az + G;
+    const float t1 = qy*t0;
+    const float t2 = 2*ax;
+    const float t3 = 2*ay;
+    const float t4 = qw*t2 + qz*t3;
+    const float t5 = -2*t1 + t4;
+    const float t6 = 2*t0;
+    const float t7 = qx*t2 + qy*t3 + qz*t6;
+    const float t8 = qw*t0;
+    const float t9 = -t0;
+    const float t10 = -qx*t3 + qy*t2;
+    const float t11 = qw*t3 + qx*t6 - qz*t2;
+    const float t12 = t10 + 2*t8;
+
+    return matrixf<3, 4> {
+        {t5, t7, qw*t9 - t10 - t8, t11},
+        {t11, t12, t7, -t5},
+        {t12, -t11, qy*t9 - t1 + t4, t7}
+    };
+}
+
+matrixf<3, 4>
+mag_obs_dm_dq(const vector4f& qv, const vector3f& field) noexcept
+{
+    const float qw = qv(0), qx = qv(1), qy = qv(2), qz = qv(3);
+    const float bx = field(0), by = field(1), bz = field(2);
+
+    const float t0 = 2*bx;
+    const float t1 = 2*qz;
+    const float t2 = 2*qy;
+    const float t3 = by*t1 - bz*t2 + qw*t0;
+    const float t4 = by*t2 + bz*t1 + qx*t0;
+    const float t5 = 2*qw;
+    const float t6 = bx*t2 - 2*by*qx + bz*t5;
+    const float t7 = by*t5 + 2*bz*qx - qz*t0;
+
+    return matrixf<3, 4> {
+        {t3, t4, -t6, t7},
+        {t7, t6, t4, -t3},
+        {t6, -t7, t3, t4}
+    };
+}
+
+}
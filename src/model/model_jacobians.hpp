@@ -0,0 +1,45 @@
+#pragma once
+
+// Generated by python/codegen.py from python/model.py, do not edit
+
+#include "mp/util/math.hpp"
+
+namespace mp::model {
+
+/**
+ * Derivative of the copter acceleration with respect to the rotation quaternion
+ */
+matrixf<3, 4> copter_da_dq(float thrust, float mass, const vector4f& qv) noexcept;
+
+/**
+ * Derivative of the copter angular acceleration with respect to the angular velocity
+ * @note Only the diagonal of the moment of inertia is used
+ */
+matrixf<3> copter_ddw_dw(const matrix3f& inertia, const vector3f& w) noexcept;
+
+/**
+ * Derivative of the rotation quaternion after `dt` with respect to the current one
+ */
+matrixf<4> rotation_dq_dq(const vector3f& w, float dt) noexcept;
+
+/**
+ * Derivative of the rotation quaternion after `dt` with respect to the angular velocity
+ */
+matrixf<4, 3> rotation_dq_dw(const vector4f& qv, float dt) noexcept;
+
+/**
+ * Derivative of the expected accelerometer reading with respect to the acceleration
+ */
+matrixf<3> accel_obs_da_da(const vector4f& qv) noexcept;
+
+/**
+ * Derivative of the expected accelerometer reading with respect to the rotation quaternion
+ */
+matrixf<3, 4> accel_obs_da_dq(const vector4f& qv, const vector3f& a) noexcept;
+
+/**
+ * Derivative of the expected magnetometer reading with respect to the rotation quaternion
+ */
+matrixf<3, 4> mag_obs_dm_dq(const vector4f& qv, const vector3f& field) noexcept;
+
+}
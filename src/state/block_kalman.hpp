@@ -0,0 +1,634 @@
+#pragma once
+
+#include "mp/util/math.hpp"
+#include "util/sym_matrix.hpp"
+#include <algorithm>
+#include <assert.h>
+#include <bitset>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace mp {
+
+/**
+ * Measurement update algorithm used by the kalman filter
+ */
+enum class kalman_update_e {
+    // All observations at once, requires a cholesky
+    // decomposition of the innovation covariance
+    BATCH,
+    // One scalar observation at a time, valid only for
+    // a diagonal observation noise covariance
+    SEQUENTIAL
+};
+
+/**
+ * Partitioning of a state vector into consecutive segments
+ *
+ * Each segment is a group of state variables which are treated
+ * as a single block in the jacobian (for example 3 velocity
+ * components or 4 quaternion components)
+ */
+template <size_t ...segment_sizes>
+struct block_layout {
+    static constexpr size_t SEGMENTS = sizeof...(segment_sizes);
+    static constexpr size_t DIM = (segment_sizes + ...);
+    static constexpr size_t MAX_SEGMENT_DIM = std::max({segment_sizes...});
+
+    // Number of state variables in the segment
+    static constexpr size_t size(size_t segment) noexcept
+    {
+        constexpr size_t sizes[] = {segment_sizes...};
+        return sizes[segment];
+    }
+
+    // Index of the first state variable of the segment
+    static constexpr size_t offset(size_t segment) noexcept
+    {
+        size_t result = 0;
+        for (size_t i = 0; i < segment; i++)
+            result += size(i);
+        return result;
+    }
+};
+
+/**
+ * State transition jacobian with a known block structure
+ *
+ * Every (row segment, column segment) block is either zero, a scaled
+ * identity or a dense matrix, and only dense blocks have storage.
+ * Multiplication kernels skip zero blocks entirely, so the cost of
+ * covariance propagation is proportional to the number of non-zero
+ * entries instead of `DIM^3`.
+ *
+ * @note `MAX_DENSE` is the maximum number of dense blocks
+ */
+template <typename layout_t, size_t MAX_DENSE>
+class block_jacobian {
+
+    static constexpr size_t DIM = layout_t::DIM;
+    static constexpr size_t SEGMENTS = layout_t::SEGMENTS;
+    static constexpr size_t BLOCK_DIM = layout_t::MAX_SEGMENT_DIM;
+
+    enum class block_type_e : uint8_t {
+        ZERO,
+        IDENTITY,
+        DENSE
+    };
+
+    struct block_s {
+        block_type_e type = block_type_e::ZERO;
+        // Index into the dense block storage
+        uint8_t index = 0;
+        // Scale of the identity block
+        float scale = 0.f;
+    };
+
+public:
+    /**
+     * Set the block to `scale * I`
+     * @note Only valid for square (diagonal) blocks
+     */
+    void set_identity(size_t row, size_t col, float scale = 1.f) noexcept
+    {
+        assert(layout_t::size(row) == layout_t::size(col));
+        m_blocks[row][col].type = block_type_e::IDENTITY;
+        m_blocks[row][col].scale = scale;
+    }
+
+    /**
+     * Set the block to a dense matrix
+     * @note Dimensions must match the sizes of the segments
+     */
+    template <size_t R, size_t C>
+    void set_dense(size_t row, size_t col, const matrixf<R, C>& block) noexcept
+    {
+        assert(layout_t::size(row) == R && layout_t::size(col) == C);
+        float (&data)[BLOCK_DIM][BLOCK_DIM] = allocate_dense(row, col);
+
+        for (size_t i = 0; i < R; i++)
+            for (size_t j = 0; j < C; j++)
+                data[i][j] = block(i, j);
+    }
+
+    /**
+     * Add `scale * I` to the (square) block
+     */
+    void add_identity(size_t row, size_t col, float scale = 1.f) noexcept
+    {
+        assert(layout_t::size(row) == layout_t::size(col));
+        block_s& block = m_blocks[row][col];
+
+        if (block.type == block_type_e::DENSE) {
+            for (size_t i = 0; i < layout_t::size(row); i++)
+                m_dense[block.index][i][i] += scale;
+        } else {
+            block.type = block_type_e::IDENTITY;
+            block.scale += scale;
+        }
+    }
+
+    /**
+     * Element of the full jacobian matrix
+     */
+    float operator()(size_t i, size_t j) const noexcept
+    {
+        const size_t row = segment_of(i);
+        const size_t col = segment_of(j);
+        const size_t a = i - layout_t::offset(row);
+        const size_t b = j - layout_t::offset(col);
+        const block_s& block = m_blocks[row][col];
+
+        switch (block.type) {
+        case block_type_e::IDENTITY:
+            return a == b ? block.scale : 0.f;
+        case block_type_e::DENSE:
+            return m_dense[block.index][a][b];
+        default:
+            return 0.f;
+        }
+    }
+
+    /**
+     * Full (dense) jacobian matrix
+     * @note Only meant for debugging and comparison with the dense filter
+     */
+    matrixf<DIM> as_dense() const noexcept
+    {
+        matrixf<DIM> result(0);
+        for (size_t i = 0; i < DIM; i++)
+            for (size_t j = 0; j < DIM; j++)
+                result(i, j) = (*this)(i, j);
+        return result;
+    }
+
+    /**
+     * Compute `result = F * P`
+     *
+     * Each row of `P` is unpacked once and used for the whole
+     * column of `F` which multiplies it
+     */
+    void multiply(const sym_matrix<DIM>& P, matrixf<DIM>& result) const noexcept
+    {
+        for (size_t i = 0; i < DIM; i++)
+            for (size_t c = 0; c < DIM; c++)
+                result(i, c) = 0.f;
+
+        float P_row[DIM];
+        for (size_t col = 0; col < SEGMENTS; col++) {
+            const size_t k0 = layout_t::offset(col);
+            const size_t kn = layout_t::size(col);
+
+            for (size_t b = 0; b < kn; b++) {
+                P.copy_row(k0 + b, P_row);
+
+                for (size_t row = 0; row < SEGMENTS; row++) {
+                    const block_s& block = m_blocks[row][col];
+                    const size_t r0 = layout_t::offset(row);
+                    const size_t rn = layout_t::size(row);
+
+                    if (block.type == block_type_e::IDENTITY) {
+                        for (size_t c = 0; c < DIM; c++)
+                            result(r0 + b, c) += block.scale * P_row[c];
+                    } else if (block.type == block_type_e::DENSE) {
+                        const auto& data = m_dense[block.index];
+                        for (size_t a = 0; a < rn; a++) {
+                            const float f = data[a][b];
+                            if (f == 0.f)
+                                continue;
+                            for (size_t c = 0; c < DIM; c++)
+                                result(r0 + a, c) += f * P_row[c];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Compute `result = M * F^T` assuming the result is symmetric
+     *
+     * Only the upper triangle is computed, which is the
+     * case for `M = F * P` with a symmetric `P`
+     */
+    void multiply_transposed_symmetric(const matrixf<DIM>& M, sym_matrix<DIM>& result) const noexcept
+    {
+        for (size_t col = 0; col < SEGMENTS; col++) {
+            const size_t c0 = layout_t::offset(col);
+            const size_t cn = layout_t::size(col);
+
+            for (size_t a = 0; a < cn; a++) {
+                const size_t c = c0 + a;
+                float* result_col = result.column(c);
+                for (size_t r = 0; r <= c; r++)
+                    result_col[r] = 0.f;
+
+                // Row `a` of the jacobian row segment `col` is column `c` of F^T
+                for (size_t seg = 0; seg < SEGMENTS; seg++) {
+                    const block_s& block = m_blocks[col][seg];
+                    const size_t k0 = layout_t::offset(seg);
+                    const size_t kn = layout_t::size(seg);
+
+                    if (block.type == block_type_e::IDENTITY) {
+                        for (size_t r = 0; r <= c; r++)
+                            result_col[r] += block.scale * M(r, k0 + a);
+                    } else if (block.type == block_type_e::DENSE) {
+                        const auto& data = m_dense[block.index];
+                        for (size_t b = 0; b < kn; b++) {
+                            const float f = data[a][b];
+                            if (f == 0.f)
+                                continue;
+                            for (size_t r = 0; r <= c; r++)
+                                result_col[r] += f * M(r, k0 + b);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    // Find the segment which contains the state variable
+    static size_t segment_of(size_t index) noexcept
+    {
+        size_t segment = 0;
+        while (index >= layout_t::offset(segment) + layout_t::size(segment))
+            segment++;
+        return segment;
+    }
+
+    // Get the storage for a dense block, reusing it if the block was already dense
+    float (&allocate_dense(size_t row, size_t col) noexcept)[BLOCK_DIM][BLOCK_DIM]
+    {
+        block_s& block = m_blocks[row][col];
+        if (block.type != block_type_e::DENSE) {
+            assert(m_dense_count < MAX_DENSE);
+            block.type = block_type_e::DENSE;
+            block.index = m_dense_count++;
+        }
+        return m_dense[block.index];
+    }
+
+private:
+    block_s m_blocks[SEGMENTS][SEGMENTS];
+    float m_dense[MAX_DENSE][BLOCK_DIM][BLOCK_DIM];
+    size_t m_dense_count = 0;
+};
+
+/**
+ * Extended kalman filter with a structured state transition jacobian
+ *
+ * Same algorithm as `emblib::kalman`, but the covariance prediction
+ * `P = F*P*F^T + Q*dt` only touches the non-zero blocks of `F`, and `Q`
+ * is given as a diagonal. Covariance is stored as a packed symmetric
+ * matrix, so only its upper triangle is ever computed.
+ */
+template <typename layout_t, size_t MAX_DENSE>
+class block_kalman {
+
+public:
+    static constexpr size_t DIM = layout_t::DIM;
+
+    using state_vec_t = vectorf<DIM>;
+    using jacobian_t = block_jacobian<layout_t, MAX_DENSE>;
+
+    /**
+     * @param joseph_form Use the Joseph form of the covariance correction,
+     * which is insensitive to (first order) errors in the kalman gain, so
+     * the covariance stays positive definite for longer with single precision
+     * at the cost of about 3x more work in the covariance correction
+     */
+    explicit block_kalman(
+        const state_vec_t& state,
+        float initial_variance = 1.f,
+        bool joseph_form = false
+    ) noexcept :
+        m_state(state),
+        m_covariance(sym_matrix<DIM>::diagonal(initial_variance)),
+        m_joseph_form(joseph_form)
+    {}
+
+    /**
+     * Time update
+     * @param f State transition function
+     * @param F State transition jacobian function returning a `jacobian_t`
+     * @param Q Diagonal of the process noise spectral density (variance
+     * per second), so the same values can be used with any step size
+     * @param dt Time step used to scale the process noise
+     */
+    template <typename f_t, typename F_t>
+    void predict(f_t f, F_t F, const state_vec_t& Q, float dt) noexcept
+    {
+        // Jacobian is computed at the state before the transition
+        const jacobian_t jacobian = F(m_state);
+        m_state = f(m_state);
+
+        matrixf<DIM> FP;
+        jacobian.multiply(m_covariance, FP);
+        jacobian.multiply_transposed_symmetric(FP, m_covariance);
+
+        for (size_t i = 0; i < DIM; i++)
+            m_covariance(i, i) += Q(i) * dt;
+    }
+
+    /**
+     * Measurement update
+     * @param h State to observation function
+     * @param H State to observation jacobian function
+     * @param R Observation noise covariance
+     * @param z Observation
+     */
+    template <size_t OBS_DIM, typename h_t, typename H_t>
+    void correct(h_t h, H_t H, const matrixf<OBS_DIM>& R, const vectorf<OBS_DIM>& z) noexcept
+    {
+        const matrixf<OBS_DIM, DIM> H_x = H(m_state);
+        const vectorf<OBS_DIM> h_x = h(m_state);
+
+        // PHt = P * H^T, skipping the (many) zeros of the jacobian
+        matrixf<DIM, OBS_DIM> PHt(0);
+        for (size_t j = 0; j < OBS_DIM; j++) {
+            for (size_t k = 0; k < DIM; k++) {
+                const float h_jk = H_x(j, k);
+                if (h_jk == 0.f)
+                    continue;
+                const float* P_col = m_covariance.column(k);
+                for (size_t i = 0; i <= k; i++)
+                    PHt(i, j) += P_col[i] * h_jk;
+                for (size_t i = k + 1; i < DIM; i++)
+                    PHt(i, j) += m_covariance.column(i)[k] * h_jk;
+            }
+        }
+
+        // Innovation covariance S = H * P * H^T + R, which is then
+        // replaced with its cholesky factor L (S = L * L^T)
+        matrixf<OBS_DIM> S;
+        for (size_t i = 0; i < OBS_DIM; i++) {
+            for (size_t j = 0; j <= i; j++) {
+                float sum = R(i, j);
+                for (size_t k = 0; k < DIM; k++)
+                    sum += H_x(i, k) * PHt(k, j);
+                S(i, j) = S(j, i) = sum;
+            }
+        }
+        matrixf<OBS_DIM> L = S;
+        if (!cholesky_decompose(L))
+            return;
+
+        // Innovation is whitened through L so that the gain is never formed
+        // explicitly: x += PHt * S^-1 * y and P -= PHt * S^-1 * PHt^T
+        vectorf<OBS_DIM> y;
+        for (size_t i = 0; i < OBS_DIM; i++)
+            y(i) = z(i) - h_x(i);
+        cholesky_solve(L, y);
+
+        matrixf<DIM, OBS_DIM> U = PHt;
+        for (size_t i = 0; i < DIM; i++) {
+            // Row of U is L^-1 applied to the row of PHt
+            for (size_t j = 0; j < OBS_DIM; j++) {
+                float sum = U(i, j);
+                for (size_t k = 0; k < j; k++)
+                    sum -= L(j, k) * U(i, k);
+                U(i, j) = sum / L(j, j);
+            }
+        }
+
+        for (size_t i = 0; i < DIM; i++) {
+            float dx = 0.f;
+            for (size_t j = 0; j < OBS_DIM; j++)
+                dx += U(i, j) * y(j);
+            m_state(i) += dx;
+        }
+
+        if (m_joseph_form) {
+            correct_covariance_joseph(PHt, U, L, S);
+            return;
+        }
+
+        for (size_t k = 0; k < DIM; k++) {
+            float* P_col = m_covariance.column(k);
+            for (size_t i = 0; i <= k; i++) {
+                float dp = 0.f;
+                for (size_t j = 0; j < OBS_DIM; j++)
+                    dp += U(i, j) * U(k, j);
+                P_col[i] -= dp;
+            }
+        }
+    }
+
+    /**
+     * Measurement update processing one scalar observation at a time
+     *
+     * Equivalent to `correct` when `R` is diagonal, but no matrix is decomposed
+     * or inverted, and each observation costs `O(DIM^2)`. The jacobian is
+     * evaluated once, and the innovation of each observation is corrected
+     * for the state change caused by the previous ones.
+     * @param R Diagonal of the observation noise covariance
+     * @param valid Observations which are available, others are skipped
+     */
+    template <size_t OBS_DIM, typename h_t, typename H_t>
+    void correct_sequential(
+        h_t h,
+        H_t H,
+        const vectorf<OBS_DIM>& R,
+        const vectorf<OBS_DIM>& z,
+        const std::bitset<OBS_DIM>& valid = std::bitset<OBS_DIM>().set()
+    ) noexcept
+    {
+        const matrixf<OBS_DIM, DIM> H_x = H(m_state);
+        const vectorf<OBS_DIM> h_x = h(m_state);
+
+        state_vec_t dx(0);
+        state_vec_t PHt;
+        state_vec_t K;
+
+        for (size_t i = 0; i < OBS_DIM; i++) {
+            if (!valid.test(i))
+                continue;
+
+            // PHt = P * H_i^T, skipping the (many) zeros of the jacobian row
+            for (size_t j = 0; j < DIM; j++)
+                PHt(j) = 0.f;
+            for (size_t k = 0; k < DIM; k++) {
+                const float h_ik = H_x(i, k);
+                if (h_ik == 0.f)
+                    continue;
+                const float* P_col = m_covariance.column(k);
+                for (size_t j = 0; j <= k; j++)
+                    PHt(j) += P_col[j] * h_ik;
+                for (size_t j = k + 1; j < DIM; j++)
+                    PHt(j) += m_covariance.column(j)[k] * h_ik;
+            }
+
+            // Scalar innovation and its variance
+            float s = R(i);
+            float y = z(i) - h_x(i);
+            for (size_t k = 0; k < DIM; k++) {
+                s += H_x(i, k) * PHt(k);
+                y -= H_x(i, k) * dx(k);
+            }
+            if (!(s > 0.f))
+                continue;
+
+            // K = PHt / s, dx += K * y
+            for (size_t j = 0; j < DIM; j++) {
+                K(j) = PHt(j) / s;
+                dx(j) += K(j) * y;
+            }
+
+            if (m_joseph_form) {
+                // P = (I - K*H) * P * (I - K*H)^T + K * r * K^T
+                for (size_t k = 0; k < DIM; k++) {
+                    float* P_col = m_covariance.column(k);
+                    for (size_t j = 0; j <= k; j++)
+                        P_col[j] -= K(j) * PHt(k) + PHt(j) * K(k) - s * K(j) * K(k);
+                }
+            } else {
+                // P -= K * PHt^T
+                for (size_t k = 0; k < DIM; k++) {
+                    float* P_col = m_covariance.column(k);
+                    for (size_t j = 0; j <= k; j++)
+                        P_col[j] -= K(j) * PHt(k);
+                }
+            }
+        }
+
+        for (size_t i = 0; i < DIM; i++)
+            m_state(i) += dx(i);
+    }
+
+    /**
+     * Run a full iteration of the filter
+     * @note Arguments are the same as for `emblib::kalman::update`,
+     * except for the process noise which is scaled by `dt`
+     */
+    template <size_t OBS_DIM, typename f_t, typename F_t, typename h_t, typename H_t>
+    void update(
+        f_t f,
+        F_t F,
+        h_t h,
+        H_t H,
+        const state_vec_t& Q,
+        float dt,
+        const matrixf<OBS_DIM>& R,
+        const vectorf<OBS_DIM>& z
+    ) noexcept
+    {
+        predict(f, F, Q, dt);
+        correct<OBS_DIM>(h, H, R, z);
+    }
+
+    const state_vec_t& get_state() const noexcept
+    {
+        return m_state;
+    }
+
+    /**
+     * Overwrite the state without changing the covariance
+     * @note Used by error state filters to reset the error after injecting it
+     */
+    void set_state(const state_vec_t& state) noexcept
+    {
+        m_state = state;
+    }
+
+    const sym_matrix<DIM>& get_covariance() const noexcept
+    {
+        return m_covariance;
+    }
+
+private:
+    /**
+     * Joseph form of the batch covariance correction
+     *
+     * `P = (I - K*H) * P * (I - K*H)^T + K*R*K^T` expanded to
+     * `P - K*PHt^T - PHt*K^T + K*S*K^T`, which stays symmetric and
+     * is only affected by the second order errors of the gain
+     */
+    template <size_t OBS_DIM>
+    void correct_covariance_joseph(
+        const matrixf<DIM, OBS_DIM>& PHt,
+        const matrixf<DIM, OBS_DIM>& U,
+        const matrixf<OBS_DIM>& L,
+        const matrixf<OBS_DIM>& S
+    ) noexcept
+    {
+        // K = PHt * S^-1 = U * L^-1, row by row with back substitution
+        matrixf<DIM, OBS_DIM> K;
+        for (size_t i = 0; i < DIM; i++) {
+            for (size_t j = OBS_DIM; j-- > 0;) {
+                float sum = U(i, j);
+                for (size_t k = j + 1; k < OBS_DIM; k++)
+                    sum -= L(k, j) * K(i, k);
+                K(i, j) = sum / L(j, j);
+            }
+        }
+
+        // KS = K * S
+        matrixf<DIM, OBS_DIM> KS;
+        for (size_t i = 0; i < DIM; i++) {
+            for (size_t j = 0; j < OBS_DIM; j++) {
+                float sum = 0.f;
+                for (size_t k = 0; k < OBS_DIM; k++)
+                    sum += K(i, k) * S(k, j);
+                KS(i, j) = sum;
+            }
+        }
+
+        for (size_t k = 0; k < DIM; k++) {
+            float* P_col = m_covariance.column(k);
+            for (size_t i = 0; i <= k; i++) {
+                float dp = 0.f;
+                for (size_t j = 0; j < OBS_DIM; j++)
+                    dp += K(i, j) * PHt(k, j) + PHt(i, j) * K(k, j) - KS(i, j) * K(k, j);
+                P_col[i] -= dp;
+            }
+        }
+    }
+
+    /**
+     * In place cholesky decomposition of the lower triangle
+     * @returns false if the matrix is not positive definite
+     */
+    template <size_t N>
+    static bool cholesky_decompose(matrixf<N>& A) noexcept
+    {
+        for (size_t j = 0; j < N; j++) {
+            float d = A(j, j);
+            for (size_t k = 0; k < j; k++)
+                d -= A(j, k) * A(j, k);
+            if (!(d > 0.f))
+                return false;
+            A(j, j) = std::sqrt(d);
+
+            for (size_t i = j + 1; i < N; i++) {
+                float sum = A(i, j);
+                for (size_t k = 0; k < j; k++)
+                    sum -= A(i, k) * A(j, k);
+                A(i, j) = sum / A(j, j);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Solve `L * x = b` in place (forward substitution)
+     */
+    template <size_t N>
+    static void cholesky_solve(const matrixf<N>& L, vectorf<N>& b) noexcept
+    {
+        for (size_t i = 0; i < N; i++) {
+            float sum = b(i);
+            for (size_t k = 0; k < i; k++)
+                sum -= L(i, k) * b(k);
+            b(i) = sum / L(i, i);
+        }
+    }
+
+private:
+    state_vec_t m_state;
+    sym_matrix<DIM> m_covariance;
+    bool m_joseph_form;
+};
+
+}
@@ -1,52 +1,85 @@
 #include "ekf_ahrs.hpp"
 #include "mp/util/constants.hpp"
+#include "model/model_jacobians.hpp"
 
 namespace mp {
 
-ekf_ahrs::ekf_ahrs() noexcept :
-    m_kalman({0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0})
-{}
+ekf_ahrs::ekf_ahrs(kalman_update_e update_mode, const process_noise_s& process_noise) noexcept :
+    m_kalman({0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0}),
+    m_update_mode(update_mode)
+{
+    set_process_noise(process_noise);
+}
 
 void
-ekf_ahrs::update(const sensor_data_s& input, float dt) noexcept
+ekf_ahrs::set_process_noise(const process_noise_s& noise) noexcept
 {
-    // TODO: Validate accel and gyro input not nullptr
-    const vector3f a_in = *input.accelerometer;
-    const vector3f w_in = *input.gyroscope;
-    const vectorf<OBS_DIM> observation {
-        a_in(0), a_in(1), a_in(2),
-        w_in(0), w_in(1), w_in(2)
+    // Only the diagonal is stored since the filter adds it directly to the covariance
+    const float a = noise.acceleration, q = noise.rotation;
+    const float w = noise.angular_velocity, wd = noise.gyro_drift;
+    m_process_noise = state_vec_t {
+        a, a, a,
+        q, q, q, q,
+        w, w, w,
+        wd, wd, wd
     };
+}
 
-    // Measurement (observation) variance
-    matrixf<OBS_DIM> R(0);
-    R.set_submatrix(0, 0, *input.accelerometer_cov);
-    R.set_submatrix(3, 3, *input.gyroscope_cov);
-
-    // TODO: Assign values using the kalman_state_e
-    constexpr float a_noise = 5e-1;
-    constexpr float q_noise = 1e-1;
-    constexpr float w_noise = 5e-1;
-    constexpr float wd_noise = 1e-1;
-    const auto Q = vectorf<KALMAN_DIM>({
-        a_noise, a_noise, a_noise,
-        q_noise, q_noise, q_noise, q_noise,
-        w_noise, w_noise, w_noise,
-        wd_noise, wd_noise, wd_noise
-    }).as_diagonal();
-
-    // Run the kalman filter iteration
-    m_kalman.update<OBS_DIM>(
+void
+ekf_ahrs::predict(const sensor_data_s& input, float dt) noexcept
+{
+    m_kalman.predict(
         [this, &dt](const state_vec_t& state) {return state_transition(state, dt);},
         [this, &dt](const state_vec_t& state) {return state_transition_jacob(state, dt);},
-        [this, &dt](const state_vec_t& state) {return state_to_obs(state, dt);},
-        [this, &dt](const state_vec_t& state) {return state_to_obs_jacob(state, dt);},
-        Q,
-        R,
-        observation
+        m_process_noise,
+        dt
     );
 }
 
+void
+ekf_ahrs::correct(const sensor_data_s& input) noexcept
+{
+    const bool has_accel = input.accelerometer && input.accelerometer_cov;
+    const bool has_gyro = input.gyroscope && input.gyroscope_cov;
+    if (!has_accel && !has_gyro)
+        return;
+
+    // Missing readings are left as zeros and are skipped by the update
+    const vector3f a_in = has_accel ? *input.accelerometer : vector3f(0);
+    const vector3f w_in = has_gyro ? *input.gyroscope : vector3f(0);
+    const vectorf<OBS_DIM> observation {
+        a_in(0), a_in(1), a_in(2),
+        w_in(0), w_in(1), w_in(2)
+    };
+
+    const auto h = [this](const state_vec_t& state) {return state_to_obs(state);};
+    const auto H = [this](const state_vec_t& state) {return state_to_obs_jacob(state);};
+
+    // Batch update needs the full observation, partial ones are fused sequentially
+    if (m_update_mode == kalman_update_e::BATCH && has_accel && has_gyro) {
+        // Measurement (observation) variance
+        matrixf<OBS_DIM> R(0);
+        R.set_submatrix(0, 0, *input.accelerometer_cov);
+        R.set_submatrix(3, 3, *input.gyroscope_cov);
+
+        m_kalman.correct<OBS_DIM>(h, H, R, observation);
+    } else {
+        // Only the variances are used since sensor axes are assumed independent
+        vectorf<OBS_DIM> R(0);
+        std::bitset<OBS_DIM> valid;
+        for (size_t i = 0; i < 3; i++) {
+            if (has_accel)
+                R(i) = (*input.accelerometer_cov)(i, i);
+            if (has_gyro)
+                R(3 + i) = (*input.gyroscope_cov)(i, i);
+            valid[i] = has_accel;
+            valid[3 + i] = has_gyro;
+        }
+
+        m_kalman.correct_sequential<OBS_DIM>(h, H, R, observation, valid);
+    }
+}
+
 // For implementation details view docs for this task
 ekf_ahrs::state_vec_t
 ekf_ahrs::state_transition(const state_vec_t& state, float dt) const noexcept
@@ -81,47 +114,28 @@ ekf_ahrs::state_transition(const state_vec_t& state, float dt) const noexcept
     };
 }
 
-matrixf<ekf_ahrs::KALMAN_DIM>
+ekf_ahrs::jacobian_t
 ekf_ahrs::state_transition_jacob(const state_vec_t& state, float dt) const noexcept
 {
-    matrixf<KALMAN_DIM> result {0};
+    jacobian_t result;
 
-    const auto a = get_linear_acceleration(state);
     const auto q = get_rotation_q(state);
     const auto w = get_angular_velocity(state);
     const auto qv = q.as_vector();
 
     // da_da
-    result(0, 0) = result(1, 1) = result(2, 2) = 1;
+    result.set_identity(SEG_A, SEG_A);
     
     // q_next = q + (dt/2) b(w)*q
-    const float wx = w(0), wy = w(1), wz = w(2);
-    const float qw = qv(0), qx = qv(1), qy = qv(2), qz = qv(3);
-    const matrixf<4> dq_dq {
-        {1, -dt/2*wx, -dt/2*wy, -dt/2*wz},
-        {dt/2*wx, 1, dt/2*wz, -dt/2*wy},
-        {dt/2*wy, -dt/2*wz, 1, dt/2*wx},
-        {dt/2*wz, dt/2*wy, -dt/2*wx, 1}
-    };
-    const matrixf<4, 3> dq_dw = matrixf<4, 3> {
-        {-qx, -qy, -qz},
-        {qw, -qz, qy},
-        {qz, qw, -qx},
-        {-qy, qx, qw}
-    } * (dt/2);
-    result.set_submatrix(3, 3, dq_dq);
-    result.set_submatrix(3, 7, dq_dw);
+    result.set_dense(SEG_Q, SEG_Q, model::rotation_dq_dq(w, dt));
+    result.set_dense(SEG_Q, SEG_W, model::rotation_dq_dw(qv, dt));
     
     // dw_dw
     // TODO: Add angular drag coefficient
-    result(7, 7) = 1.f;
-    result(8, 8) = 1.f;
-    result(9, 9) = 1.f;
+    result.set_identity(SEG_W, SEG_W);
 
     // dwd_dwd
-    result(10, 10) = 1.f;
-    result(11, 11) = 1.f;
-    result(12, 12) = 1.f;
+    result.set_identity(SEG_WD, SEG_WD);
 
     return result;
 }
@@ -129,7 +143,7 @@ ekf_ahrs::state_transition_jacob(const state_vec_t& state, float dt) const noexc
 // This implementation assumes only 2 readings:
 // acceleration and angular velocity
 vectorf<ekf_ahrs::OBS_DIM>
-ekf_ahrs::state_to_obs(const state_vec_t& state, float dt) const noexcept
+ekf_ahrs::state_to_obs(const state_vec_t& state) const noexcept
 {
     const auto a = get_linear_acceleration(state);
     const auto q = get_rotation_q(state);
@@ -152,7 +166,7 @@ ekf_ahrs::state_to_obs(const state_vec_t& state, float dt) const noexcept
 // This implementation assumes only 2 readings:
 // acceleration and angular velocity
 matrixf<ekf_ahrs::OBS_DIM, ekf_ahrs::KALMAN_DIM>
-ekf_ahrs::state_to_obs_jacob(const state_vec_t& state, float dt) const noexcept
+ekf_ahrs::state_to_obs_jacob(const state_vec_t& state) const noexcept
 {
     matrixf<OBS_DIM, KALMAN_DIM> result {0};
 
@@ -160,22 +174,9 @@ ekf_ahrs::state_to_obs_jacob(const state_vec_t& state, float dt) const noexcept
     const auto q = get_rotation_q(state);
     const auto qv = q.as_vector();
 
-    const float ax = a(0), ay = a(1), az = a(2);
-    const float qw = qv(0), qx = qv(1), qy = qv(2), qz = qv(3);
-    
-    // d(a_exp)/d(a)
-    const matrixf<3> da_da {
-        {qw*qw + qx*qx - qy*qy - qz*qz, 2.f*(qw*qz + qx*qy), 2.f*(-qw*qy + qx*qz)},
-        {2.f*(-qw*qz + qx*qy), qw*qw - qx*qx + qy*qy - qz*qz, 2.f*(qw*qx + qy*qz)},
-        {2.f*(qw*qy + qx*qz), 2.f*(-qw*qx + qy*qz), qw*qw - qx*qx - qy*qy + qz*qz}
-    };
-
-    // d(a_exp)/d(qv)
-    const matrixf<3, 4> da_dq {
-        {2.f*(ax*qw + ay*qz - qy*(az + G)), 2.f*(ax*qx + ay*qy + qz*(az + G)), 2.f*(-ax*qy + ay*qx - qw*(az + G)), 2*(-ax*qz + ay*qw + qx*(az + G))},
-        {2.f*(-ax*qz + ay*qw + qx*(az + G)), 2.f*(ax*qy - ay*qx + qw*(az + G)), 2.f*(ax*qx + ay*qy + qz*(az + G)), 2*(-ax*qw - ay*qz + qy*(az + G))},
-        {2.f*(ax*qy - ay*qx + qw*(az + G)), 2.f*(ax*qz - ay*qw - qx*(az + G)), 2.f*(ax*qw + ay*qz - qy*(az + G)), 2*(ax*qx + ay*qy + qz*(az + G))}
-    };
+    // d(a_exp)/d(a) and d(a_exp)/d(qv)
+    const matrixf<3> da_da = model::accel_obs_da_da(qv);
+    const matrixf<3, 4> da_dq = model::accel_obs_da_dq(qv, a);
 
     result.set_submatrix(0, 0, da_da);
     result.set_submatrix(0, 3, da_dq);
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "state_estimator.hpp"
-#include "emblib/dsp/kalman.hpp"
+#include "block_kalman.hpp"
 
 namespace mp {
 
@@ -28,17 +28,60 @@ class ekf_ahrs : public state_estimator {
      */
     static constexpr size_t OBS_DIM = 6;
 
+    /**
+     * Segments of the state vector as listed above, used to
+     * describe the block structure of the state transition jacobian
+     */
+    enum segment_e : size_t {
+        SEG_A,
+        SEG_Q,
+        SEG_W,
+        SEG_WD
+    };
+    using layout_t = block_layout<3, 4, 3, 3>;
+    static_assert(layout_t::DIM == KALMAN_DIM);
+
+    /**
+     * Number of dense blocks in the state transition jacobian
+     * dq_dq, dq_dw
+     */
+    static constexpr size_t JACOBIAN_DENSE_BLOCKS = 2;
+
 
-    // Convenience typedef
-    using state_vec_t = vectorf<KALMAN_DIM>;
+    // Convenience typedefs
+    using kalman_t = block_kalman<layout_t, JACOBIAN_DENSE_BLOCKS>;
+    using state_vec_t = kalman_t::state_vec_t;
+    using jacobian_t = kalman_t::jacobian_t;
 
 public:
-    explicit ekf_ahrs() noexcept;
+    /**
+     * @param update_mode Sequential mode ignores the off-diagonal
+     * elements of the sensor covariance matrices
+     * @param process_noise There is no vehicle model, so the
+     * default values describe a generic moving body
+     */
+    explicit ekf_ahrs(
+        kalman_update_e update_mode = kalman_update_e::BATCH,
+        const process_noise_s& process_noise = {}
+    ) noexcept;
 
     /**
-     * Algorithm iteration
+     * Replace the process noise, for example when the vehicle parameters change
      */
-    void update(const sensor_data_s& input, float dt) noexcept override;
+    void set_process_noise(const process_noise_s& noise) noexcept;
+
+    /**
+     * Time update of the kalman filter
+     * @note Sensor readings are not used
+     */
+    void predict(const sensor_data_s& input, float dt) noexcept override;
+
+    /**
+     * Measurement update of the kalman filter
+     * @note If only one of accelerometer and gyroscope is provided,
+     * the other is skipped using the sequential update
+     */
+    void correct(const sensor_data_s& input) noexcept override;
 
     /**
      * Get the current state
@@ -65,18 +108,19 @@ private:
      * Kalman filter state transition jacobian - `F`
      * 
      * Represents the derivative of `state_transition` function with respect to the state vector
+     * @note Only the non-zero blocks are set
      */
-    matrixf<KALMAN_DIM> state_transition_jacob(const state_vec_t& state, float dt) const noexcept;
+    jacobian_t state_transition_jacob(const state_vec_t& state, float dt) const noexcept;
 
     /**
      * Kalman filter state to observation mapping - `h`
      */
-    vectorf<OBS_DIM> state_to_obs(const state_vec_t& state, float dt) const noexcept;
+    vectorf<OBS_DIM> state_to_obs(const state_vec_t& state) const noexcept;
 
     /**
      * Kalman filter state to observation mapping jacobian - `H`
      */
-    matrixf<OBS_DIM, KALMAN_DIM> state_to_obs_jacob(const state_vec_t& state, float dt) const noexcept;
+    matrixf<OBS_DIM, KALMAN_DIM> state_to_obs_jacob(const state_vec_t& state) const noexcept;
     
     // Extract the acceleration vector from the kalman state vector
     static vector3f get_linear_acceleration(const state_vec_t& state) noexcept
@@ -103,7 +147,11 @@ private:
     }
 
 private:
-    emblib::kalman<KALMAN_DIM> m_kalman;
+    kalman_t m_kalman;
+    kalman_update_e m_update_mode;
+
+    // Diagonal of the process noise spectral density
+    state_vec_t m_process_noise;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,288 @@
+#include "ekf_error_state.hpp"
+#include "mp/util/constants.hpp"
+#include "model/model_jacobians.hpp"
+#include <cmath>
+
+namespace mp {
+
+ekf_error_state::ekf_error_state(const ekf_vehicle& vehicle, kalman_update_e update_mode) noexcept :
+    m_vehicle(vehicle),
+    m_kalman({0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}),
+    m_update_mode(update_mode),
+    m_rotationq(1, 0, 0, 0)
+{
+    set_process_noise(m_vehicle.get_process_noise());
+}
+
+void
+ekf_error_state::set_process_noise(const process_noise_s& noise) noexcept
+{
+    // Only the diagonal is stored since the filter adds it directly to the covariance
+    const float v = noise.velocity, a = noise.acceleration, q = noise.rotation;
+    const float w = noise.angular_velocity, wd = noise.gyro_drift;
+    m_process_noise = state_vec_t {
+        v, v, v,
+        a, a, a,
+        q, q, q,
+        w, w, w,
+        wd, wd, wd
+    };
+}
+
+void
+ekf_error_state::predict(const sensor_data_s& input, float dt) noexcept
+{
+    // Nominal rotation is propagated with the angular velocity used by the
+    // filter transition, after the filter (which needs the previous rotation)
+    const vector3f w = get_angular_velocity(m_kalman.get_state());
+    m_kalman.predict(
+        [this, &dt](const state_vec_t& state) {return state_transition(state, dt);},
+        [this, &dt](const state_vec_t& state) {return state_transition_jacob(state, dt);},
+        m_process_noise,
+        dt
+    );
+    propagate_rotation(w, dt);
+
+    // Position is integration of velocity and acceleration
+    const auto v = get_linear_velocity(m_kalman.get_state());
+    const auto a = get_linear_acceleration(m_kalman.get_state());
+    m_position += v * dt + a * (dt * dt / 2.f);
+}
+
+void
+ekf_error_state::correct(const sensor_data_s& input) noexcept
+{
+    const bool has_accel = input.accelerometer && input.accelerometer_cov;
+    const bool has_gyro = input.gyroscope && input.gyroscope_cov;
+    if (!has_accel && !has_gyro)
+        return;
+
+    // Missing readings are left as zeros and are skipped by the update
+    const vector3f a_in = has_accel ? *input.accelerometer : vector3f(0);
+    const vector3f w_in = has_gyro ? *input.gyroscope : vector3f(0);
+    const vectorf<OBS_DIM> observation {
+        a_in(0), a_in(1), a_in(2),
+        w_in(0), w_in(1), w_in(2)
+    };
+
+    const auto h = [this](const state_vec_t& state) {return state_to_obs(state);};
+    const auto H = [this](const state_vec_t& state) {return state_to_obs_jacob(state);};
+
+    // Batch update needs the full observation, partial ones are fused sequentially
+    if (m_update_mode == kalman_update_e::BATCH && has_accel && has_gyro) {
+        // Measurement (observation) variance
+        matrixf<OBS_DIM> R(0);
+        R.set_submatrix(0, 0, *input.accelerometer_cov);
+        R.set_submatrix(3, 3, *input.gyroscope_cov);
+
+        m_kalman.correct<OBS_DIM>(h, H, R, observation);
+    } else {
+        // Only the variances are used since sensor axes are assumed independent
+        vectorf<OBS_DIM> R(0);
+        std::bitset<OBS_DIM> valid;
+        for (size_t i = 0; i < 3; i++) {
+            if (has_accel)
+                R(i) = (*input.accelerometer_cov)(i, i);
+            if (has_gyro)
+                R(3 + i) = (*input.gyroscope_cov)(i, i);
+            valid[i] = has_accel;
+            valid[3 + i] = has_gyro;
+        }
+
+        m_kalman.correct_sequential<OBS_DIM>(h, H, R, observation, valid);
+    }
+
+    inject_rotation_error();
+}
+
+void
+ekf_error_state::propagate_rotation(const vector3f& w, float dt) noexcept
+{
+    // Exact rotation by the angle |w|*dt around the w axis
+    const float angle = w.norm() * dt;
+    const float c = std::cos(angle / 2.f);
+    const float s = angle > 1e-6f ? std::sin(angle / 2.f) / w.norm() : dt / 2.f;
+
+    const vector4f qv = m_rotationq.as_vector();
+    const vector4f dq {c, s * w(0), s * w(1), s * w(2)};
+
+    // q_next = q * dq
+    const float qw = qv(0), qx = qv(1), qy = qv(2), qz = qv(3);
+    const matrixf<4> q_left {
+        {qw, -qx, -qy, -qz},
+        {qx, qw, -qz, qy},
+        {qy, qz, qw, -qx},
+        {qz, -qy, qx, qw}
+    };
+    vector4f qv_next = q_left.matmul(dq);
+    // Normalize the quaternion due to numerical errors
+    qv_next /= qv_next.norm();
+
+    m_rotationq = quaternionf(qv_next(0), qv_next(1), qv_next(2), qv_next(3));
+}
+
+void
+ekf_error_state::inject_rotation_error() noexcept
+{
+    state_vec_t state = m_kalman.get_state();
+    const vector3f e = get_rotation_error(state);
+
+    // q = q * dq(e) with the small angle approximation dq(e) = [1, e/2]
+    vector4f qv_next = m_rotationq.as_vector() + get_dq_de(m_rotationq.as_vector()).matmul(e);
+    qv_next /= qv_next.norm();
+    m_rotationq = quaternionf(qv_next(0), qv_next(1), qv_next(2), qv_next(3));
+
+    // Error is now part of the nominal rotation
+    state(6) = state(7) = state(8) = 0.f;
+    m_kalman.set_state(state);
+}
+
+matrixf<4, 3>
+ekf_error_state::get_dq_de(const vector4f& qv) noexcept
+{
+    const float qw = qv(0), qx = qv(1), qy = qv(2), qz = qv(3);
+    return matrixf<4, 3> {
+        {-qx, -qy, -qz},
+        {qw, -qz, qy},
+        {qz, qw, -qx},
+        {-qy, qx, qw}
+    } * 0.5f;
+}
+
+// For implementation details view docs for this task
+ekf_error_state::state_vec_t
+ekf_error_state::state_transition(const state_vec_t& state, float dt) const noexcept
+{
+    const auto v = get_linear_velocity(state);
+    const auto a = get_linear_acceleration(state);
+    const auto e = get_rotation_error(state);
+    const auto w = get_angular_velocity(state);
+    const auto& q = m_rotationq;
+
+    // Acceleration is computed by the vehicle based on current actuator settings and the
+    // dynamical model of the vehicle, and the velocity is the integration of acceleration
+    vector3f v_next = v + dt * a;
+    vector3f a_next = m_vehicle.get_linear_acceleration(v, q);
+
+    // Error is expressed in the local frame which rotates with w
+    vector3f e_next = e + dt * e.cross(w);
+
+    // Angular acceleration is the first derivative of angular velocity and
+    // is calculated according to the Euler's equations for a rotating reference frame
+    vector3f dw = m_vehicle.get_angular_acceleration(v, w, q);
+    vector3f w_next = w + dt * dw;
+
+    // We're not expecting the drift to change from iteration to iteration
+    const vector3f wd = get_gyro_drift(state);
+
+    return {
+        v_next(0), v_next(1), v_next(2),
+        a_next(0), a_next(1), a_next(2),
+        e_next(0), e_next(1), e_next(2),
+        w_next(0), w_next(1), w_next(2),
+        wd(0), wd(1), wd(2)
+    };
+}
+
+ekf_error_state::jacobian_t
+ekf_error_state::state_transition_jacob(const state_vec_t& state, float dt) const noexcept
+{
+    jacobian_t result;
+
+    const auto v = get_linear_velocity(state);
+    const auto w = get_angular_velocity(state);
+    const auto qv = m_rotationq.as_vector();
+
+    // Vehicle jacobian is w.r.t. the quaternion, so it is mapped to the rotation error
+    const auto jacobian = m_vehicle.get_jacobian(v, w, qv);
+    const matrixf<4, 3> dq_de = get_dq_de(qv);
+
+    // v_next = v + dt * a
+    result.set_identity(SEG_V, SEG_V); // dv_dv
+    result.set_identity(SEG_V, SEG_A, dt); // dv_da
+
+    // a_next = f(v, q)
+    result.set_dense(SEG_A, SEG_V, jacobian.da_dv);
+    result.set_dense(SEG_A, SEG_E, jacobian.da_dq.matmul(dq_de));
+
+    // e_next = e - dt * w x e, and the error grows with the angular velocity error
+    const float wx = w(0), wy = w(1), wz = w(2);
+    const matrixf<3> de_de {
+        {1, dt*wz, -dt*wy},
+        {-dt*wz, 1, dt*wx},
+        {dt*wy, -dt*wx, 1}
+    };
+    result.set_dense(SEG_E, SEG_E, de_de);
+    result.set_identity(SEG_E, SEG_W, dt);
+
+    // w_next = w + dt * dw(v, q, w)
+    result.set_dense(SEG_W, SEG_V, jacobian.ddw_dv * dt);
+    result.set_dense(SEG_W, SEG_E, jacobian.ddw_dq.matmul(dq_de) * dt);
+    result.set_dense(SEG_W, SEG_W, jacobian.ddw_dw * dt);
+
+    // dw_dw
+    result.add_identity(SEG_W, SEG_W);
+
+    // dwd_dwd
+    result.set_identity(SEG_WD, SEG_WD);
+
+    return result;
+}
+
+// This implementation assumes only 2 readings:
+// acceleration and angular velocity
+vectorf<ekf_error_state::OBS_DIM>
+ekf_error_state::state_to_obs(const state_vec_t& state) const noexcept
+{
+    const auto a = get_linear_acceleration(state);
+    const auto e = get_rotation_error(state);
+    const auto w = get_angular_velocity(state);
+    const auto wd = get_gyro_drift(state);
+
+    // Expected accelerometer reading = model acc + gravity mapped
+    // to the local reference frame, and then rotated by the error
+    const vector3f a_local = m_rotationq.conjugate().rotate_vec(a - GV);
+    const vector3f a_exp = a_local + a_local.cross(e);
+
+    // Expected gyroscope reading = model ang vel + gyro drift
+    const vector3f w_exp = w + wd;
+
+    return {
+        a_exp(0), a_exp(1), a_exp(2),
+        w_exp(0), w_exp(1), w_exp(2)
+    };
+}
+
+// This implementation assumes only 2 readings:
+// acceleration and angular velocity
+matrixf<ekf_error_state::OBS_DIM, ekf_error_state::KALMAN_DIM>
+ekf_error_state::state_to_obs_jacob(const state_vec_t& state) const noexcept
+{
+    matrixf<OBS_DIM, KALMAN_DIM> result {0};
+
+    const auto a = get_linear_acceleration(state);
+
+    // d(a_exp)/d(a)
+    const matrixf<3> da_da = model::accel_obs_da_da(m_rotationq.as_vector());
+
+    // d(a_exp)/d(e) = [a_local x] evaluated at e = 0
+    const vector3f u = m_rotationq.conjugate().rotate_vec(a - GV);
+    const matrixf<3> da_de {
+        {0, -u(2), u(1)},
+        {u(2), 0, -u(0)},
+        {-u(1), u(0), 0}
+    };
+
+    result.set_submatrix(0, 3, da_da);
+    result.set_submatrix(0, 6, da_de);
+
+    // d(w_exp)/d(w)
+    result(3, 9) = result(4, 10) = result(5, 11) = 1.f;
+
+    // d(w_exp)/d(wd)
+    result(3, 12) = result(4, 13) = result(5, 14) = 1.f;
+
+    return result;
+}
+
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include "state_estimator.hpp"
+#include "vehicles/ekf_vehicle.hpp"
+#include "block_kalman.hpp"
+
+namespace mp {
+
+/**
+ * Error state (multiplicative) extended kalman filter used for inertial navigation
+ *
+ * Same model as `ekf_inertial`, but the rotation is kept as a nominal quaternion
+ * outside of the filter, and the filter only estimates a 3 parameter rotation
+ * error (small angle vector in the local frame). After every correction the error
+ * is injected into the nominal quaternion and reset to zero. This removes the
+ * quaternion norm constraint from the filter, so the covariance stays full rank
+ * and the state is one element smaller than in `ekf_inertial`.
+ */
+class ekf_error_state : public state_estimator {
+
+    /**
+     * Dimension of the state vector used by the kalman filter
+     * 3 - velocity
+     * 3 - acceleration
+     * 3 - rotation error
+     * 3 - angular velocity
+     * 3 - gyro drift
+     */
+    static constexpr size_t KALMAN_DIM = 15;
+
+    /**
+     * Dimension of the measurement vector
+     * 3 - accelerometer
+     * 3 - gyroscope
+     */
+    static constexpr size_t OBS_DIM = 6;
+
+    /**
+     * Segments of the state vector as listed above, used to
+     * describe the block structure of the state transition jacobian
+     */
+    enum segment_e : size_t {
+        SEG_V,
+        SEG_A,
+        SEG_E,
+        SEG_W,
+        SEG_WD
+    };
+    using layout_t = block_layout<3, 3, 3, 3, 3>;
+    static_assert(layout_t::DIM == KALMAN_DIM);
+
+    /**
+     * Number of dense blocks in the state transition jacobian
+     * da_dv, da_de, de_de, dw_dv, dw_de, dw_dw
+     */
+    static constexpr size_t JACOBIAN_DENSE_BLOCKS = 6;
+
+
+    // Convenience typedefs
+    using kalman_t = block_kalman<layout_t, JACOBIAN_DENSE_BLOCKS>;
+    using state_vec_t = kalman_t::state_vec_t;
+    using jacobian_t = kalman_t::jacobian_t;
+
+public:
+    /**
+     * @param update_mode Sequential mode ignores the off-diagonal
+     * elements of the sensor covariance matrices
+     */
+    explicit ekf_error_state(
+        const ekf_vehicle& vehicle,
+        kalman_update_e update_mode = kalman_update_e::BATCH
+    ) noexcept;
+
+    /**
+     * Replace the process noise, for example when the vehicle parameters change
+     */
+    void set_process_noise(const process_noise_s& noise) noexcept;
+
+    /**
+     * Time update of the kalman filter
+     * @note Sensor readings are not used
+     */
+    void predict(const sensor_data_s& input, float dt) noexcept override;
+
+    /**
+     * Measurement update of the kalman filter
+     * @note If only one of accelerometer and gyroscope is provided,
+     * the other is skipped using the sequential update
+     */
+    void correct(const sensor_data_s& input) noexcept override;
+
+    /**
+     * Get the current state
+     */
+    state_s get_state() const noexcept override
+    {
+        return {
+            .position = m_position,
+            .velocity = get_linear_velocity(m_kalman.get_state()),
+            .acceleration = get_linear_acceleration(m_kalman.get_state()),
+            .angular_velocity = get_angular_velocity(m_kalman.get_state()),
+            .rotationq = m_rotationq
+        };
+    }
+
+private:
+    /**
+     * Kalman filter state transition - `f`
+     * @note Rotation error is always zero before the transition, so it stays zero
+     */
+    state_vec_t state_transition(const state_vec_t& state, float dt) const noexcept;
+
+    /**
+     * Kalman filter state transition jacobian - `F`
+     *
+     * Represents the derivative of `state_transition` function with respect to the state vector
+     * @note Only the non-zero blocks are set
+     */
+    jacobian_t state_transition_jacob(const state_vec_t& state, float dt) const noexcept;
+
+    /**
+     * Kalman filter state to observation mapping - `h`
+     */
+    vectorf<OBS_DIM> state_to_obs(const state_vec_t& state) const noexcept;
+
+    /**
+     * Kalman filter state to observation mapping jacobian - `H`
+     */
+    matrixf<OBS_DIM, KALMAN_DIM> state_to_obs_jacob(const state_vec_t& state) const noexcept;
+
+    /**
+     * Propagate the nominal rotation by a constant angular velocity
+     */
+    void propagate_rotation(const vector3f& w, float dt) noexcept;
+
+    /**
+     * Apply the estimated rotation error to the nominal rotation and reset it
+     */
+    void inject_rotation_error() noexcept;
+
+    /**
+     * Derivative of the nominal quaternion rotated by a small angle error
+     * with respect to that error, `d(q * dq(e))/de` at `e = 0`
+     */
+    static matrixf<4, 3> get_dq_de(const vector4f& qv) noexcept;
+
+
+    // Extract the velocity vector from the kalman state vector
+    static vector3f get_linear_velocity(const state_vec_t& state) noexcept
+    {
+        return {state(0), state(1), state(2)};
+    }
+
+    // Extract the acceleration vector from the kalman state vector
+    static vector3f get_linear_acceleration(const state_vec_t& state) noexcept
+    {
+        return {state(3), state(4), state(5)};
+    }
+
+    // Extract the rotation error vector from the kalman state vector
+    static vector3f get_rotation_error(const state_vec_t& state) noexcept
+    {
+        return {state(6), state(7), state(8)};
+    }
+
+    // Extract the angular velocity vector from the kalman state vector
+    static vector3f get_angular_velocity(const state_vec_t& state) noexcept
+    {
+        return {state(9), state(10), state(11)};
+    }
+
+    // Extract the gyro drift vector from the kalman state vector
+    static vector3f get_gyro_drift(const state_vec_t& state) noexcept
+    {
+        return {state(12), state(13), state(14)};
+    }
+
+private:
+    const ekf_vehicle& m_vehicle;
+    kalman_t m_kalman;
+    kalman_update_e m_update_mode;
+
+    // Diagonal of the process noise spectral density
+    state_vec_t m_process_noise;
+
+    // Nominal rotation, the filter only estimates the error
+    quaternionf m_rotationq;
+
+    // Kept separately as it's not computed as part
+    // of the kalman filter vector
+    vector3f m_position;
+
+};
+
+}
@@ -1,58 +1,173 @@
 #include "ekf_inertial.hpp"
 #include "mp/util/constants.hpp"
+#include "model/model_jacobians.hpp"
+#include <algorithm>
+#include <cmath>
 
 namespace mp {
 
-ekf_inertial::ekf_inertial(const ekf_vehicle& vehicle) noexcept :
+ekf_inertial::ekf_inertial(const ekf_vehicle& vehicle, kalman_update_e update_mode) noexcept :
     m_vehicle(vehicle),
-    m_kalman({0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0})
-{}
+    m_kalman({0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}),
+    m_update_mode(update_mode),
+    m_mag_field(0)
+{
+    set_process_noise(m_vehicle.get_process_noise());
+}
 
 void
-ekf_inertial::update(const sensor_data_s& input, float dt) noexcept
+ekf_inertial::set_process_noise(const process_noise_s& noise) noexcept
 {
-    // TODO: Validate accel and gyro input not nullptr
-    const vector3f a_in = *input.accelerometer;
-    const vector3f w_in = *input.gyroscope;
-    const vectorf<OBS_DIM> observation {
-        a_in(0), a_in(1), a_in(2),
-        w_in(0), w_in(1), w_in(2)
+    // Only the diagonal is stored since the filter adds it directly to the covariance
+    const float v = noise.velocity, a = noise.acceleration, q = noise.rotation;
+    const float w = noise.angular_velocity, wd = noise.gyro_drift, p = noise.position;
+    m_process_noise = state_vec_t {
+        v, v, v,
+        a, a, a,
+        q, q, q, q,
+        w, w, w,
+        wd, wd, wd,
+        p, p, p
     };
+}
 
-    // Measurement (observation) variance
-    matrixf<OBS_DIM> R(0);
-    R.set_submatrix(0, 0, *input.accelerometer_cov);
-    R.set_submatrix(3, 3, *input.gyroscope_cov);
-
-    // TODO: Get Q from the vehicle
-    constexpr float v_noise = 1;
-    constexpr float a_noise = 5e-1;
-    constexpr float q_noise = 1e-1;
-    constexpr float w_noise = 5e-1;
-    constexpr float wd_noise = 1e-1;
-    const auto Q = vectorf<KALMAN_DIM>({
-        v_noise, v_noise, v_noise,
-        a_noise, a_noise, a_noise,
-        q_noise, q_noise, q_noise, q_noise,
-        w_noise, w_noise, w_noise,
-        wd_noise, wd_noise, wd_noise
-    }).as_diagonal();
-
-    // Run the kalman filter iteration
-    m_kalman.update<OBS_DIM>(
+void
+ekf_inertial::predict(const sensor_data_s& input, float dt) noexcept
+{
+    m_kalman.predict(
         [this, &dt](const state_vec_t& state) {return state_transition(state, dt);},
         [this, &dt](const state_vec_t& state) {return state_transition_jacob(state, dt);},
-        [this, &dt](const state_vec_t& state) {return state_to_obs(state, dt);},
-        [this, &dt](const state_vec_t& state) {return state_to_obs_jacob(state, dt);},
-        Q,
-        R,
-        observation
+        m_process_noise,
+        dt
     );
+}
 
-    // Position is integration of velocity and acceleration
-    const auto v = get_linear_velocity(m_kalman.get_state());
-    const auto a = get_linear_acceleration(m_kalman.get_state());
-    m_position += v * dt + a * (dt * dt / 2.f);
+void
+ekf_inertial::correct(const sensor_data_s& input) noexcept
+{
+    // Slow sensors are only fused when they have new data
+    correct_imu(input);
+    if (input.magnetometer && input.magnetometer_cov)
+        correct_magnetometer(*input.magnetometer, *input.magnetometer_cov, input.accelerometer);
+    if (input.gnss && input.gnss_cov)
+        correct_gnss(*input.gnss, *input.gnss_cov);
+    if (input.gnss_velocity && input.gnss_velocity_cov)
+        correct_gnss_velocity(*input.gnss_velocity, *input.gnss_velocity_cov);
+    if (input.barometer && input.barometer_var)
+        correct_barometer(*input.barometer, *input.barometer_var);
+}
+
+void
+ekf_inertial::correct_imu(const sensor_data_s& input) noexcept
+{
+    const bool has_accel = input.accelerometer && input.accelerometer_cov;
+    const bool has_gyro = input.gyroscope && input.gyroscope_cov;
+    if (!has_accel && !has_gyro)
+        return;
+
+    // Missing readings are left as zeros and are skipped by the update
+    const vector3f a_in = has_accel ? *input.accelerometer : vector3f(0);
+    const vector3f w_in = has_gyro ? *input.gyroscope : vector3f(0);
+    const vectorf<OBS_DIM> observation {
+        a_in(0), a_in(1), a_in(2),
+        w_in(0), w_in(1), w_in(2)
+    };
+
+    const auto h = [this](const state_vec_t& state) {return state_to_obs(state);};
+    const auto H = [this](const state_vec_t& state) {return state_to_obs_jacob(state);};
+
+    // Batch update needs the full observation, partial ones are fused sequentially
+    if (m_update_mode == kalman_update_e::BATCH && has_accel && has_gyro) {
+        // Measurement (observation) variance
+        matrixf<OBS_DIM> R(0);
+        R.set_submatrix(0, 0, *input.accelerometer_cov);
+        R.set_submatrix(3, 3, *input.gyroscope_cov);
+
+        m_kalman.correct<OBS_DIM>(h, H, R, observation);
+    } else {
+        // Only the variances are used since sensor axes are assumed independent
+        vectorf<OBS_DIM> R(0);
+        std::bitset<OBS_DIM> valid;
+        for (size_t i = 0; i < 3; i++) {
+            if (has_accel)
+                R(i) = (*input.accelerometer_cov)(i, i);
+            if (has_gyro)
+                R(3 + i) = (*input.gyroscope_cov)(i, i);
+            valid[i] = has_accel;
+            valid[3 + i] = has_gyro;
+        }
+
+        m_kalman.correct_sequential<OBS_DIM>(h, H, R, observation, valid);
+    }
+}
+
+void
+ekf_inertial::correct_magnetometer(const vector3f& field, const matrix3f& cov, const vector3f* accel) noexcept
+{
+    const float norm = field.norm();
+    if (!(norm > 0.f))
+        return;
+    const vector3f direction = field / norm;
+
+    // At rest the accelerometer measures the up direction, and its angle to the field
+    // is the same in every frame, so the field is north and down at that angle
+    if (m_mag_field.norm_sq() == 0.f) {
+        if (!accel || !(accel->norm() > 0.f))
+            return;
+        const float vertical = std::clamp(direction.dot(*accel / accel->norm()), -1.f, 1.f);
+        m_mag_field = vector3f {std::sqrt(1.f - vertical * vertical), 0.f, vertical};
+    }
+
+    // Field is expected in the local frame, only the direction is compared
+    const auto h = [this](const state_vec_t& state) -> vector3f {
+        return get_rotation_q(state).conjugate().rotate_vec(m_mag_field);
+    };
+    const auto H = [this](const state_vec_t& state) {
+        matrixf<3, KALMAN_DIM> result(0);
+        result.set_submatrix(0, 6, model::mag_obs_dm_dq(get_rotation_q(state).as_vector(), m_mag_field));
+        return result;
+    };
+
+    correct_observation<3>(h, H, cov / (norm * norm), direction);
+}
+
+void
+ekf_inertial::correct_gnss(const vector3f& position, const matrix3f& cov) noexcept
+{
+    const auto h = [](const state_vec_t& state) {return get_position(state);};
+    const auto H = [](const state_vec_t& state) {
+        matrixf<3, KALMAN_DIM> result(0);
+        result(0, 16) = result(1, 17) = result(2, 18) = 1.f;
+        return result;
+    };
+
+    correct_observation<3>(h, H, cov, position);
+}
+
+void
+ekf_inertial::correct_gnss_velocity(const vector3f& velocity, const matrix3f& cov) noexcept
+{
+    const auto h = [](const state_vec_t& state) {return get_linear_velocity(state);};
+    const auto H = [](const state_vec_t& state) {
+        matrixf<3, KALMAN_DIM> result(0);
+        result(0, 0) = result(1, 1) = result(2, 2) = 1.f;
+        return result;
+    };
+
+    correct_observation<3>(h, H, cov, velocity);
+}
+
+void
+ekf_inertial::correct_barometer(float altitude, float variance) noexcept
+{
+    const auto h = [](const state_vec_t& state) {return vectorf<1> {state(18)};};
+    const auto H = [](const state_vec_t& state) {
+        matrixf<1, KALMAN_DIM> result(0);
+        result(0, 18) = 1.f;
+        return result;
+    };
+
+    correct_observation<1>(h, H, matrixf<1> {{variance}}, vectorf<1> {altitude});
 }
 
 // For implementation details view docs for this task
@@ -94,19 +209,23 @@ ekf_inertial::state_transition(const state_vec_t& state, float dt) const noexcep
     // We're not expecting the drift to change from iteration to iteration
     const vector3f wd = get_gyro_drift(state);
 
+    // Position is integration of velocity and acceleration
+    const vector3f p_next = get_position(state) + v * dt + a * (dt * dt / 2.f);
+
     return {
         v_next(0), v_next(1), v_next(2),
         a_next(0), a_next(1), a_next(2),
         qv_next(0), qv_next(1), qv_next(2), qv_next(3),
         w_next(0), w_next(1), w_next(2),
-        wd(0), wd(1), wd(2)
+        wd(0), wd(1), wd(2),
+        p_next(0), p_next(1), p_next(2)
     };
 }
 
-matrixf<ekf_inertial::KALMAN_DIM>
+ekf_inertial::jacobian_t
 ekf_inertial::state_transition_jacob(const state_vec_t& state, float dt) const noexcept
 {
-    matrixf<KALMAN_DIM> result {0};
+    jacobian_t result;
 
     const auto v = get_linear_velocity(state);
     const auto a = get_linear_acceleration(state);
@@ -119,49 +238,35 @@ ekf_inertial::state_transition_jacob(const state_vec_t& state, float dt) const n
     auto jacobian = m_vehicle.get_jacobian(v, w, qv);
 
     // v_next = v + dt * a
-    result(0, 0) = result(1, 1) = result(2, 2) = 1; // dv_dv
-    result(0, 3) = result(1, 4) = result (2, 5) = dt; // dv_da
+    result.set_identity(SEG_V, SEG_V); // dv_dv
+    result.set_identity(SEG_V, SEG_A, dt); // dv_da
 
     // a_next = f(v, q)
-    result.set_submatrix(3, 0, jacobian.da_dv);
-    result.set_submatrix(3, 6, jacobian.da_dq);
-    
-    const float wx = w(0), wy = w(1), wz = w(2);
-    const float qw = qv(0), qx = qv(1), qy = qv(2), qz = qv(3);
+    result.set_dense(SEG_A, SEG_V, jacobian.da_dv);
+    result.set_dense(SEG_A, SEG_Q, jacobian.da_dq);
     
     // q_next = q + (dt/2) b(w)*q
-    const matrixf<4> dq_dq {
-        {1, -dt/2*wx, -dt/2*wy, -dt/2*wz},
-        {dt/2*wx, 1, dt/2*wz, -dt/2*wy},
-        {dt/2*wy, -dt/2*wz, 1, dt/2*wx},
-        {dt/2*wz, dt/2*wy, -dt/2*wx, 1}
-    };
-    const matrixf<4, 3> dq_dw = matrixf<4, 3> {
-        {-qx, -qy, -qz},
-        {qw, -qz, qy},
-        {qz, qw, -qx},
-        {-qy, qx, qw}
-    } * (dt/2);
-    result.set_submatrix(6, 6, dq_dq);
-    result.set_submatrix(6, 10, dq_dw);
+    result.set_dense(SEG_Q, SEG_Q, model::rotation_dq_dq(w, dt));
+    result.set_dense(SEG_Q, SEG_W, model::rotation_dq_dw(qv, dt));
 
     // w_next = w + dt * dw(v, q, w)
     jacobian.ddw_dv *= dt;
     jacobian.ddw_dq *= dt;
     jacobian.ddw_dw *= dt;
-    result.set_submatrix(10, 0, jacobian.ddw_dv);
-    result.set_submatrix(10, 6, jacobian.ddw_dq);
-    result.set_submatrix(10, 10, jacobian.ddw_dw);
+    result.set_dense(SEG_W, SEG_V, jacobian.ddw_dv);
+    result.set_dense(SEG_W, SEG_Q, jacobian.ddw_dq);
+    result.set_dense(SEG_W, SEG_W, jacobian.ddw_dw);
     
     // dw_dw
-    result(10, 10) += 1.f;
-    result(11, 11) += 1.f;
-    result(12, 12) += 1.f;
+    result.add_identity(SEG_W, SEG_W);
 
     // dwd_dwd
-    result(13, 13) = 1.f;
-    result(14, 14) = 1.f;
-    result(15, 15) = 1.f;
+    result.set_identity(SEG_WD, SEG_WD);
+
+    // p_next = p + dt * v + dt^2/2 * a
+    result.set_identity(SEG_P, SEG_P);
+    result.set_identity(SEG_P, SEG_V, dt);
+    result.set_identity(SEG_P, SEG_A, dt * dt / 2.f);
 
     return result;
 }
@@ -169,7 +274,7 @@ ekf_inertial::state_transition_jacob(const state_vec_t& state, float dt) const n
 // This implementation assumes only 2 readings:
 // acceleration and angular velocity
 vectorf<ekf_inertial::OBS_DIM>
-ekf_inertial::state_to_obs(const state_vec_t& state, float dt) const noexcept
+ekf_inertial::state_to_obs(const state_vec_t& state) const noexcept
 {
     const auto a = get_linear_acceleration(state);
     const auto q = get_rotation_q(state);
@@ -192,7 +297,7 @@ ekf_inertial::state_to_obs(const state_vec_t& state, float dt) const noexcept
 // This implementation assumes only 2 readings:
 // acceleration and angular velocity
 matrixf<ekf_inertial::OBS_DIM, ekf_inertial::KALMAN_DIM>
-ekf_inertial::state_to_obs_jacob(const state_vec_t& state, float dt) const noexcept
+ekf_inertial::state_to_obs_jacob(const state_vec_t& state) const noexcept
 {
     matrixf<OBS_DIM, KALMAN_DIM> result {0};
 
@@ -200,22 +305,9 @@ ekf_inertial::state_to_obs_jacob(const state_vec_t& state, float dt) const noexc
     const auto q = get_rotation_q(state);
     const auto qv = q.as_vector();
 
-    const float ax = a(0), ay = a(1), az = a(2);
-    const float qw = qv(0), qx = qv(1), qy = qv(2), qz = qv(3);
-    
-    // d(a_exp)/d(a)
-    const matrixf<3> da_da {
-        {qw*qw + qx*qx - qy*qy - qz*qz, 2.f*(qw*qz + qx*qy), 2.f*(-qw*qy + qx*qz)},
-        {2.f*(-qw*qz + qx*qy), qw*qw - qx*qx + qy*qy - qz*qz, 2.f*(qw*qx + qy*qz)},
-        {2.f*(qw*qy + qx*qz), 2.f*(-qw*qx + qy*qz), qw*qw - qx*qx - qy*qy + qz*qz}
-    };
-
-    // d(a_exp)/d(qv)
-    const matrixf<3, 4> da_dq {
-        {2.f*(ax*qw + ay*qz - qy*(az + G)), 2.f*(ax*qx + ay*qy + qz*(az + G)), 2.f*(-ax*qy + ay*qx - qw*(az + G)), 2*(-ax*qz + ay*qw + qx*(az + G))},
-        {2.f*(-ax*qz + ay*qw + qx*(az + G)), 2.f*(ax*qy - ay*qx + qw*(az + G)), 2.f*(ax*qx + ay*qy + qz*(az + G)), 2*(-ax*qw - ay*qz + qy*(az + G))},
-        {2.f*(ax*qy - ay*qx + qw*(az + G)), 2.f*(ax*qz - ay*qw - qx*(az + G)), 2.f*(ax*qw + ay*qz - qy*(az + G)), 2*(ax*qx + ay*qy + qz*(az + G))}
-    };
+    // d(a_exp)/d(a) and d(a_exp)/d(qv)
+    const matrixf<3> da_da = model::accel_obs_da_da(qv);
+    const matrixf<3, 4> da_dq = model::accel_obs_da_dq(qv, a);
 
     result.set_submatrix(0, 3, da_da);
     result.set_submatrix(0, 6, da_dq);
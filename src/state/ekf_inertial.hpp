@@ -2,16 +2,22 @@
 
 #include "state_estimator.hpp"
 #include "vehicles/ekf_vehicle.hpp"
-#include "emblib/dsp/kalman.hpp"
+#include "block_kalman.hpp"
 
 namespace mp {
 
 /**
  * Extended kalman filter used for inertial navigation
  * 
- * Uses only accelerometer, gyroscope and (optionally)
- * magnetometer data to compute the state, position is
- * just the integration of velocity
+ * Accelerometer and gyroscope are fused on every correction, and the
+ * magnetometer, GNSS and barometer only when the input has their data.
+ * Each sensor has its own measurement update with the observation size
+ * known at compile time, so a sensor without new data costs nothing.
+ * Without GNSS and barometer, position is just the integration of velocity.
+ *
+ * Magnetometer readings are only used as a direction. The reference field
+ * (north and down at the local inclination) is set from the first reading
+ * together with the accelerometer, so the vehicle should be still at that time.
  */
 class ekf_inertial : public state_estimator {
 
@@ -22,32 +28,82 @@ class ekf_inertial : public state_estimator {
      * 4 - rotation quaternion
      * 3 - angular velocity
      * 3 - gyro drift
+     * 3 - position
      */
-    static constexpr size_t KALMAN_DIM = 16;
+    static constexpr size_t KALMAN_DIM = 19;
 
     /**
-     * Dimension of the measurement vector
+     * Dimension of the IMU measurement vector
      * 3 - accelerometer
      * 3 - gyroscope
-     * 
-     * @note This dimension does not need to be fixed since we
-     * can have a GPS (or some other sensor) measurement every n-th iteration
      */
     static constexpr size_t OBS_DIM = 6;
 
+    /**
+     * Segments of the state vector as listed above, used to
+     * describe the block structure of the state transition jacobian
+     */
+    enum segment_e : size_t {
+        SEG_V,
+        SEG_A,
+        SEG_Q,
+        SEG_W,
+        SEG_WD,
+        SEG_P
+    };
+    using layout_t = block_layout<3, 3, 4, 3, 3, 3>;
+    static_assert(layout_t::DIM == KALMAN_DIM);
+
+    /**
+     * Number of dense blocks in the state transition jacobian
+     * da_dv, da_dq, dq_dq, dq_dw, dw_dv, dw_dq, dw_dw
+     */
+    static constexpr size_t JACOBIAN_DENSE_BLOCKS = 7;
 
-    // Convenience typedef
-    using state_vec_t = vectorf<KALMAN_DIM>;
+
+    // Convenience typedefs
+    using kalman_t = block_kalman<layout_t, JACOBIAN_DENSE_BLOCKS>;
+    using state_vec_t = kalman_t::state_vec_t;
+    using jacobian_t = kalman_t::jacobian_t;
 
 public:
     // Note: Maybe should not pass vehicle directly since it can
     // be read without mutex while being updated by the task_vehicle
-    explicit ekf_inertial(const ekf_vehicle& vehicle) noexcept;
+    /**
+     * @param update_mode Sequential mode ignores the off-diagonal
+     * elements of the sensor covariance matrices
+     */
+    explicit ekf_inertial(
+        const ekf_vehicle& vehicle,
+        kalman_update_e update_mode = kalman_update_e::BATCH
+    ) noexcept;
+
+    /**
+     * Replace the process noise, for example when the vehicle parameters change
+     */
+    void set_process_noise(const process_noise_s& noise) noexcept;
+
+    /**
+     * Time update of the kalman filter
+     * @note Sensor readings are not used
+     */
+    void predict(const sensor_data_s& input, float dt) noexcept override;
+
+    /**
+     * Measurement update of the kalman filter
+     * @note If only one of accelerometer and gyroscope is provided,
+     * the other is skipped using the sequential update
+     */
+    void correct(const sensor_data_s& input) noexcept override;
 
     /**
-     * Algorithm iteration
+     * Magnetic field direction in the global frame used
+     * for the magnetometer, zero until the first reading
      */
-    void update(const sensor_data_s& input, float dt) noexcept override;
+    vector3f get_magnetic_field() const noexcept
+    {
+        return m_mag_field;
+    }
 
     /**
      * Get the current state
@@ -55,7 +111,7 @@ public:
     state_s get_state() const noexcept override
     {
         return {
-            .position = m_position,
+            .position = get_position(m_kalman.get_state()),
             .velocity = get_linear_velocity(m_kalman.get_state()),
             .acceleration = get_linear_acceleration(m_kalman.get_state()),
             .angular_velocity = get_angular_velocity(m_kalman.get_state()),
@@ -74,18 +130,46 @@ private:
      * Kalman filter state transition jacobian - `F`
      * 
      * Represents the derivative of `state_transition` function with respect to the state vector
+     * @note Only the non-zero blocks are set
+     */
+    jacobian_t state_transition_jacob(const state_vec_t& state, float dt) const noexcept;
+
+    /**
+     * Kalman filter state to IMU observation mapping - `h`
+     */
+    vectorf<OBS_DIM> state_to_obs(const state_vec_t& state) const noexcept;
+
+    /**
+     * Kalman filter state to IMU observation mapping jacobian - `H`
      */
-    matrixf<KALMAN_DIM> state_transition_jacob(const state_vec_t& state, float dt) const noexcept;
+    matrixf<OBS_DIM, KALMAN_DIM> state_to_obs_jacob(const state_vec_t& state) const noexcept;
 
     /**
-     * Kalman filter state to observation mapping - `h`
+     * Measurement updates of the individual sensors
      */
-    vectorf<OBS_DIM> state_to_obs(const state_vec_t& state, float dt) const noexcept;
+    void correct_imu(const sensor_data_s& input) noexcept;
+    void correct_magnetometer(const vector3f& field, const matrix3f& cov, const vector3f* accel) noexcept;
+    void correct_gnss(const vector3f& position, const matrix3f& cov) noexcept;
+    void correct_gnss_velocity(const vector3f& velocity, const matrix3f& cov) noexcept;
+    void correct_barometer(float altitude, float variance) noexcept;
 
     /**
-     * Kalman filter state to observation mapping jacobian - `H`
+     * Update with an observation of `OBS` elements in the configured update mode
+     * @note Only the diagonal of `R` is used in the sequential mode
      */
-    matrixf<OBS_DIM, KALMAN_DIM> state_to_obs_jacob(const state_vec_t& state, float dt) const noexcept;
+    template <size_t OBS, typename h_t, typename H_t>
+    void correct_observation(h_t h, H_t H, const matrixf<OBS>& R, const vectorf<OBS>& z) noexcept
+    {
+        if (m_update_mode == kalman_update_e::BATCH) {
+            m_kalman.correct<OBS>(h, H, R, z);
+            return;
+        }
+
+        vectorf<OBS> R_diag;
+        for (size_t i = 0; i < OBS; i++)
+            R_diag(i) = R(i, i);
+        m_kalman.correct_sequential<OBS>(h, H, R_diag, z);
+    }
 
     
     // Extract the velocity vector from the kalman state vector
@@ -118,13 +202,22 @@ private:
         return {state(13), state(14), state(15)};
     }
 
+    // Extract the position vector from the kalman state vector
+    static vector3f get_position(const state_vec_t& state) noexcept
+    {
+        return {state(16), state(17), state(18)};
+    }
+
 private:
     const ekf_vehicle& m_vehicle;
-    emblib::kalman<KALMAN_DIM> m_kalman;
+    kalman_t m_kalman;
+    kalman_update_e m_update_mode;
+
+    // Diagonal of the process noise spectral density
+    state_vec_t m_process_noise;
 
-    // Kept separately as it's not computed as part
-    // of the kalman filter vector
-    vector3f m_position;
+    // Unit vector, zero until the first magnetometer reading
+    vector3f m_mag_field;
 
 };
 
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "state_estimator.hpp"
+#include <cmath>
+
+namespace mp {
+
+/**
+ * Accumulates the IMU samples into rotation and velocity increments
+ *
+ * Each paired gyroscope and accelerometer sample is integrated as it arrives.
+ * The rotation since the start of the interval is kept as a quaternion and
+ * updated with every sample, so the velocity increment of each sample is
+ * rotated to the start frame exactly, as if every sample had its own prediction
+ * step. Within a sample the increments are corrected from the previous sample
+ * for the effects of the rotation during the sample period: coning (rotation
+ * around an axis which itself rotates, which is not captured by the angle
+ * increment) and sculling (acceleration which rotates together with the local
+ * frame), so each sample costs a few cross products and a quaternion product.
+ *
+ * Increments are expressed in the local frame at the start of the interval.
+ */
+class imu_preintegrator {
+
+public:
+    imu_preintegrator() noexcept
+    {
+        reset();
+    }
+
+    /**
+     * Start a new interval
+     */
+    void reset() noexcept
+    {
+        m_rotation = vector4f {1, 0, 0, 0};
+        m_velocity = vector3f(0);
+        m_last_dtheta = vector3f(0);
+        m_last_dv = vector3f(0);
+        m_dt = 0.f;
+    }
+
+    /**
+     * Add a pair of samples
+     * @param w Angular velocity
+     * @param a Specific force (accelerometer reading)
+     * @param dt Time since the previous sample
+     */
+    void integrate(const vector3f& w, const vector3f& a, float dt) noexcept
+    {
+        const vector3f dtheta = w * dt;
+        const vector3f dv = a * dt;
+
+        // Rotation and velocity over the sample period in the frame at its
+        // start, with the coning and sculling terms of the two-sample algorithm
+        const vector3f phi = dtheta + m_last_dtheta.cross(dtheta) / 12.f;
+        const vector3f dv_sample = dv + dtheta.cross(dv) * 0.5f +
+            (m_last_dtheta.cross(dv) + m_last_dv.cross(dtheta)) / 12.f;
+
+        const vector4f& q = m_rotation;
+        m_velocity += quaternionf(q(0), q(1), q(2), q(3)).rotate_vec(dv_sample);
+
+        // q = q * dq(phi), with the series expansion of dq which is accurate
+        // to 3e-7 for the angles of a single sample (up to about 0.1 rad)
+        const float angle_sq = phi.dot(phi);
+        const float c = 1.f - angle_sq / 8.f;
+        const float s = 0.5f - angle_sq / 48.f;
+        const float hx = s * phi(0), hy = s * phi(1), hz = s * phi(2);
+        m_rotation = vector4f {
+            q(0)*c - q(1)*hx - q(2)*hy - q(3)*hz,
+            q(1)*c + q(0)*hx + q(2)*hz - q(3)*hy,
+            q(2)*c + q(0)*hy - q(1)*hz + q(3)*hx,
+            q(3)*c + q(0)*hz + q(1)*hy - q(2)*hx
+        };
+
+        m_last_dtheta = dtheta;
+        m_last_dv = dv;
+        m_dt += dt;
+    }
+
+    /**
+     * Increments since the last `reset`
+     */
+    imu_delta_s get_delta() const noexcept
+    {
+        // Rotation vector of the accumulated quaternion (shorter of the two rotations)
+        const float sign = m_rotation(0) < 0.f ? -1.f : 1.f;
+        const vector3f v {m_rotation(1) * sign, m_rotation(2) * sign, m_rotation(3) * sign};
+        const float v_norm = v.norm();
+        const float angle = 2.f * std::atan2(v_norm, m_rotation(0) * sign);
+
+        return {
+            .delta_angle = v_norm > 1e-9f ? v * (angle / v_norm) : v * 2.f,
+            .delta_velocity = m_velocity,
+            .dt = m_dt
+        };
+    }
+
+private:
+    // Rotation since the start of the interval
+    vector4f m_rotation;
+    // Velocity increment in the frame at the start of the interval
+    vector3f m_velocity;
+
+    vector3f m_last_dtheta;
+    vector3f m_last_dv;
+    float m_dt;
+};
+
+}
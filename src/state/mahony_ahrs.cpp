@@ -0,0 +1,107 @@
+#include "mahony_ahrs.hpp"
+#include "mp/util/constants.hpp"
+#include <cmath>
+
+namespace mp {
+
+// Accelerometer readings are used only if their magnitude is in this range
+static constexpr float ACCEL_MIN_G = 0.5f * G;
+static constexpr float ACCEL_MAX_G = 1.5f * G;
+
+mahony_ahrs::mahony_ahrs(float kp, float ki) noexcept :
+    m_kp(kp),
+    m_ki(ki),
+    m_rotationq(1, 0, 0, 0),
+    m_gyro_drift(0),
+    m_error(0),
+    m_angular_velocity(0),
+    m_acceleration(0)
+{}
+
+void
+mahony_ahrs::predict(const sensor_data_s& input, float dt) noexcept
+{
+    if (input.imu_delta) {
+        // Pre-integrated increments already contain the rotation
+        // within the interval, so they are applied as a whole
+        const imu_delta_s& delta = *input.imu_delta;
+        if (!(delta.dt > 0.f))
+            return;
+
+        m_gyro_drift -= m_error * (m_ki * delta.dt);
+        m_angular_velocity = delta.delta_angle / delta.dt - m_gyro_drift;
+        rotate(delta.delta_angle + (m_error * m_kp - m_gyro_drift) * delta.dt);
+        return;
+    }
+
+    if (!input.gyroscope)
+        return;
+
+    // Drift estimate is the integral of the error
+    m_gyro_drift -= m_error * (m_ki * dt);
+    m_angular_velocity = *input.gyroscope - m_gyro_drift;
+
+    rotate((m_angular_velocity + m_error * m_kp) * dt);
+}
+
+void
+mahony_ahrs::correct(const sensor_data_s& input) noexcept
+{
+    if (!input.accelerometer)
+        return;
+
+    const vector3f& a = *input.accelerometer;
+    const float a_norm = a.norm();
+    if (a_norm < ACCEL_MIN_G || a_norm > ACCEL_MAX_G) {
+        m_error = vector3f(0);
+        return;
+    }
+
+    // Acceleration in the global frame, since accelerometer measures a - GV
+    m_acceleration = m_rotationq.rotate_vec(a) + GV;
+
+    // Rotating with w = measured x expected turns the expected
+    // up direction towards the measured one
+    const vector3f up_measured = a / a_norm;
+    const vector3f up_expected = m_rotationq.conjugate().rotate_vec(UP);
+    m_error = up_measured.cross(up_expected);
+}
+
+void
+mahony_ahrs::rotate(const vector3f& rotation) noexcept
+{
+    // Exact rotation by the angle |rotation| around the rotation axis
+    const float angle = rotation.norm();
+    const float c = std::cos(angle / 2.f);
+    const float s = angle > 1e-6f ? std::sin(angle / 2.f) / angle : 0.5f;
+
+    // q_next = q * dq
+    const vector4f qv = m_rotationq.as_vector();
+    const float qw = qv(0), qx = qv(1), qy = qv(2), qz = qv(3);
+    const float hx = s * rotation(0), hy = s * rotation(1), hz = s * rotation(2);
+
+    vector4f qv_next {
+        qw*c - qx*hx - qy*hy - qz*hz,
+        qx*c + qw*hx + qy*hz - qz*hy,
+        qy*c + qw*hy - qx*hz + qz*hx,
+        qz*c + qw*hz + qx*hy - qy*hx
+    };
+    // Normalize the quaternion due to numerical errors
+    qv_next /= qv_next.norm();
+
+    m_rotationq = quaternionf(qv_next(0), qv_next(1), qv_next(2), qv_next(3));
+}
+
+state_s
+mahony_ahrs::get_state() const noexcept
+{
+    return {
+        .position = 0,
+        .velocity = 0,
+        .acceleration = m_acceleration,
+        .angular_velocity = m_angular_velocity,
+        .rotationq = m_rotationq
+    };
+}
+
+}
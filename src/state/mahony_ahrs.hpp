@@ -0,0 +1,71 @@
+#pragma once
+
+#include "state_estimator.hpp"
+
+namespace mp {
+
+/**
+ * Mahony (nonlinear complementary filter) based AHRS estimation
+ * 
+ * Gyroscope is integrated at the full sensor rate, and the direction of
+ * gravity measured by the accelerometer pulls the rotation back with a
+ * proportional and integral feedback, where the integral term estimates
+ * the gyro drift. State is only a few vectors and each step is a handful
+ * of vector operations, so it is meant for targets which cannot afford
+ * the kalman filter based estimators.
+ * 
+ * @note Sensor covariances are not used, the gains set the trust
+ * between the gyroscope and the accelerometer
+ * @note Does not assume any vehicle physics
+ */
+class mahony_ahrs : public state_estimator {
+
+public:
+    /**
+     * @param kp Proportional gain, crossover frequency in rad/s between the
+     * gyroscope (above) and the accelerometer (below)
+     * @param ki Integral gain, how fast the gyro drift estimate changes
+     */
+    explicit mahony_ahrs(float kp = 1.f, float ki = 0.05f) noexcept;
+
+    /**
+     * Integrate the gyroscope sample (or the pre-integrated increments),
+     * corrected by the feedback computed in the last `correct`
+     */
+    void predict(const sensor_data_s& input, float dt) noexcept override;
+
+    /**
+     * Compute the feedback from the accelerometer
+     * @note Accelerometer readings far from 1G are ignored since
+     * they do not point in the direction of gravity
+     */
+    void correct(const sensor_data_s& input) noexcept override;
+
+    /**
+     * Get the current state
+     */
+    state_s get_state() const noexcept override;
+
+private:
+    /**
+     * Rotate the local frame by a rotation vector
+     */
+    void rotate(const vector3f& rotation) noexcept;
+
+private:
+    float m_kp;
+    float m_ki;
+
+    // Maps the local frame to the global frame
+    quaternionf m_rotationq;
+    // Gyro drift estimate (integral term)
+    vector3f m_gyro_drift;
+    // Rotation error from the last accelerometer reading, held until the next one
+    vector3f m_error;
+
+    // Last readings, used to provide the rest of the state
+    vector3f m_angular_velocity;
+    vector3f m_acceleration;
+};
+
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include "mp/util/math.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace mp {
+
+/**
+ * Consistency voting between redundant instances of a three axis sensor
+ *
+ * Updated once per estimator iteration with the mean reading of every
+ * instance over that iteration. With three or more healthy instances the
+ * reference is their per axis median. With fewer, each instance is compared
+ * to the other ones instead (an instance is never its own reference), so
+ * when two instances disagree there is no telling which one is wrong and
+ * both become suspect. The consistency metric of an instance is a moving
+ * average of its squared deviation from the reference, relative to the
+ * tolerance, so a single outlier does not drop a sensor but a persistent
+ * offset or a stuck output does. Instances which stop producing samples
+ * are dropped after `max_missed` iterations.
+ *
+ * While no instance is healthy, the primary is the one with the lowest
+ * metric, and the previous primary is kept on a tie so that the estimator
+ * does not switch between the suspect instances. An instance is restored
+ * once it is consistent again, and the cost of an update is fixed for a
+ * given number of instances.
+ */
+template <size_t MAX_INSTANCES>
+class sensor_voter {
+
+    static_assert(MAX_INSTANCES > 0);
+
+public:
+    struct params_s {
+        // Deviation from the reference at which the metric reaches 1
+        float tolerance;
+        // Weight of the newest deviation in the moving average, in (0, 1]
+        float smoothing;
+        // Iterations without samples before an instance is dropped
+        uint32_t max_missed;
+    };
+
+    // Metric above which an instance is dropped, and below which it is restored
+    static constexpr float DROP_METRIC = 1.f;
+    static constexpr float RESTORE_METRIC = 0.25f;
+    // Largest contribution of a single iteration (twice the tolerance)
+    static constexpr float MAX_DEVIATION = 4.f;
+
+    explicit sensor_voter(const params_s& params, size_t count) noexcept :
+        m_params(params),
+        m_count(count < MAX_INSTANCES ? count : MAX_INSTANCES)
+    {
+        for (size_t i = 0; i < MAX_INSTANCES; i++)
+            m_healthy[i] = true;
+    }
+
+    /**
+     * Vote on the readings of one iteration
+     * @param means Mean reading of each instance
+     * @param valid False for the instances without samples in this iteration
+     * @returns Index of the primary instance for this iteration,
+     * or the instance count if no instance has samples
+     */
+    size_t update(const vector3f* means, const bool* valid) noexcept
+    {
+        // Stalled instances are dropped before voting, so they can not hold the reference
+        for (size_t i = 0; i < m_count; i++) {
+            m_missed[i] = valid[i] ? 0 : m_missed[i] + 1;
+            if (m_missed[i] > m_params.max_missed)
+                m_healthy[i] = false;
+        }
+
+        // References are taken before any health changes, so they do not depend on the order
+        // of the instances. The median of the healthy instances if they can outvote a single
+        // wrong one, without it the other instances.
+        vector3f references[MAX_INSTANCES];
+        bool has_reference[MAX_INSTANCES];
+        vector3f median;
+        const bool has_median = get_median(means, valid, median);
+        for (size_t i = 0; i < m_count; i++) {
+            references[i] = median;
+            has_reference[i] = has_median || get_other_mean(means, valid, i, references[i]);
+        }
+
+        const float inv_tolerance_sq = 1.f / (m_params.tolerance * m_params.tolerance);
+        for (size_t i = 0; i < m_count; i++) {
+            if (!valid[i])
+                continue;
+
+            // Without another instance to compare to only the instances dropped for stalling are restored
+            if (!has_reference[i]) {
+                if (m_metric[i] < RESTORE_METRIC)
+                    m_healthy[i] = true;
+                continue;
+            }
+
+            // Capped so that a single outlier can not drop a sensor, and a dropped
+            // sensor which agrees again is restored in a bounded number of iterations
+            float deviation = (means[i] - references[i]).norm_sq() * inv_tolerance_sq;
+            deviation = deviation < MAX_DEVIATION ? deviation : MAX_DEVIATION;
+            m_metric[i] += m_params.smoothing * (deviation - m_metric[i]);
+
+            if (m_metric[i] > DROP_METRIC)
+                m_healthy[i] = false;
+            else if (m_metric[i] < RESTORE_METRIC)
+                m_healthy[i] = true;
+        }
+
+        m_primary = select_primary(valid);
+        return m_primary;
+    }
+
+    size_t get_count() const noexcept
+    {
+        return m_count;
+    }
+
+    bool is_healthy(size_t instance) const noexcept
+    {
+        return m_healthy[instance];
+    }
+
+    /**
+     * Consistency metric of an instance, 0 if it agrees with the reference
+     * and above `DROP_METRIC` if it has been dropped for inconsistency
+     */
+    float get_metric(size_t instance) const noexcept
+    {
+        return m_metric[instance];
+    }
+
+private:
+    /**
+     * Per axis median of the healthy instances
+     * @returns false if there are less than three healthy instances
+     */
+    bool get_median(const vector3f* means, const bool* valid, vector3f& median) const noexcept
+    {
+        size_t indices[MAX_INSTANCES];
+        size_t count = 0;
+        for (size_t i = 0; i < m_count; i++) {
+            if (valid[i] && m_healthy[i])
+                indices[count++] = i;
+        }
+
+        if (count < 3)
+            return false;
+
+        // Median of each axis, with insertion sort since there are only a few instances
+        for (size_t axis = 0; axis < 3; axis++) {
+            float values[MAX_INSTANCES];
+            for (size_t k = 0; k < count; k++) {
+                const float value = means[indices[k]](axis);
+                size_t j = k;
+                for (; j > 0 && values[j - 1] > value; j--)
+                    values[j] = values[j - 1];
+                values[j] = value;
+            }
+            median(axis) = count % 2 ? values[count / 2] :
+                (values[count / 2 - 1] + values[count / 2]) / 2.f;
+        }
+        return true;
+    }
+
+    /**
+     * Mean of the healthy instances other than `instance`,
+     * or if there are none of the other instances with samples
+     * @returns false if `instance` is the only instance with samples
+     */
+    bool get_other_mean(const vector3f* means, const bool* valid, size_t instance, vector3f& mean) const noexcept
+    {
+        vector3f sum(0), healthy_sum(0);
+        size_t count = 0, healthy_count = 0;
+        for (size_t i = 0; i < m_count; i++) {
+            if (i == instance || !valid[i])
+                continue;
+            sum += means[i];
+            count++;
+            if (m_healthy[i]) {
+                healthy_sum += means[i];
+                healthy_count++;
+            }
+        }
+
+        if (healthy_count) {
+            mean = healthy_sum / static_cast<float>(healthy_count);
+            return true;
+        }
+        if (count) {
+            mean = sum / static_cast<float>(count);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * First healthy instance with samples, or if there is none the suspect
+     * instance with the lowest metric, since a suspect reading is still
+     * better than stalling the estimator
+     */
+    size_t select_primary(const bool* valid) const noexcept
+    {
+        size_t fallback = m_count;
+        for (size_t i = 0; i < m_count; i++) {
+            if (valid[i] && m_healthy[i])
+                return i;
+            if (valid[i] && (fallback == m_count || m_metric[i] < m_metric[fallback]))
+                fallback = i;
+        }
+
+        // Equal metrics (two instances which disagree) keep the previous primary
+        if (m_primary < m_count && valid[m_primary] && !(m_metric[fallback] < m_metric[m_primary]))
+            return m_primary;
+        return fallback;
+    }
+
+private:
+    params_s m_params;
+    size_t m_count;
+
+    bool m_healthy[MAX_INSTANCES];
+    float m_metric[MAX_INSTANCES] = {};
+    uint32_t m_missed[MAX_INSTANCES] = {};
+    // Primary of the last update, `m_count` if there was none
+    size_t m_primary = MAX_INSTANCES;
+};
+
+}
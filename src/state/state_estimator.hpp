@@ -1,6 +1,7 @@
 #pragma once
 
 #include "mp/util/math.hpp"
+#include "mp/drivers/clock.hpp"
 
 namespace mp {
 
@@ -33,6 +34,22 @@ struct state_s {
     vector3f angular_velocity {0, 0, 0};
     // Quaternion which maps the local frame to the global frame
     quaternionf rotationq {1, 0, 0, 0};
+    // Time of the last sensor sample included in the state
+    timestamp_t timestamp {0};
+};
+
+/**
+ * Rotation and velocity change measured by the IMU over `dt`
+ *
+ * Integrated at the sensor rate, and expressed in the
+ * local frame at the start of the interval
+ */
+struct imu_delta_s {
+    // Rotation vector of the local frame over the interval
+    vector3f delta_angle;
+    // Integral of the specific force (accelerometer reading)
+    vector3f delta_velocity;
+    float dt;
 };
 
 /**
@@ -50,8 +67,36 @@ struct sensor_data_s {
     const vector3f* magnetometer = nullptr;
     const matrix3f* magnetometer_cov = nullptr;
     
+    // GNSS position and velocity in the global frame
     const vector3f* gnss = nullptr;
     const matrix3f* gnss_cov = nullptr;
+    const vector3f* gnss_velocity = nullptr;
+    const matrix3f* gnss_velocity_cov = nullptr;
+
+    // Barometric altitude above the starting point
+    const float* barometer = nullptr;
+    const float* barometer_var = nullptr;
+
+    // IMU increments since the previous prediction, if the
+    // samples were pre-integrated instead of passed one by one
+    const imu_delta_s* imu_delta = nullptr;
+};
+
+/**
+ * Process noise of a dynamic model used by the kalman filter based estimators
+ * 
+ * Values are spectral densities (variance per second) of the unmodeled changes
+ * of each state variable, applied to all of its components. Estimators scale
+ * them by the step size, so they do not depend on the estimator period.
+ */
+struct process_noise_s {
+    float position = 0.1f;
+    float velocity = 50.f;
+    float acceleration = 25.f;
+    // Used for the quaternion components or the rotation error
+    float rotation = 5.f;
+    float angular_velocity = 25.f;
+    float gyro_drift = 5.f;
 };
 
 /**
@@ -60,10 +105,28 @@ struct sensor_data_s {
 class state_estimator {
 
 public:
+    /**
+     * Propagate the state forward by `dt`
+     * @note Called once before each correction with the increments of all IMU
+     * samples since the previous prediction (`imu_delta`), or with an empty input
+     * when there were no samples. Estimators which track the angular velocity in
+     * their state may ignore the increments, the mean rates are also fused in `correct`.
+     */
+    virtual void predict(const sensor_data_s& input, float dt) noexcept = 0;
+
+    /**
+     * Fuse the sensor measurements into the current state
+     */
+    virtual void correct(const sensor_data_s& input) noexcept = 0;
+
     /**
      * Algorithm iteration
      */
-    virtual void update(const sensor_data_s& input, float dt) noexcept = 0;
+    virtual void update(const sensor_data_s& input, float dt) noexcept
+    {
+        predict(input, dt);
+        correct(input);
+    }
 
     /**
      * Get the current state
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "mp/util/constants.hpp"
+#include <cstddef>
+
+namespace mp {
+
+/**
+ * Tasks of the redundant instances of a sensor
+ *
+ * Indexed the same as the devices in `devices_s`, with `nullptr`
+ * for the instances which are not present or failed to probe
+ */
+template <typename task_type>
+struct sensor_instances_s {
+    task_type* tasks[MAX_SENSOR_INSTANCES] = {};
+
+    size_t get_count() const noexcept
+    {
+        size_t count = 0;
+        for (task_type* task : tasks)
+            count += task != nullptr;
+        return count;
+    }
+
+    /**
+     * First available instance
+     */
+    task_type* get_first() const noexcept
+    {
+        for (task_type* task : tasks) {
+            if (task)
+                return task;
+        }
+        return nullptr;
+    }
+};
+
+}
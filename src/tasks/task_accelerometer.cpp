@@ -4,24 +4,53 @@ namespace mp {
 
 task_accelerometer::task_accelerometer(
     emblib::accelerometer& accelerometer,
+    fifo_sensor<float>* fifo,
+    data_ready_interrupt* data_ready,
+    const monotonic_clock& clock,
     matrix_t transform,
-    vector_t bias
+    const sensor_calibration_s& calibration
 ) :
     task_three_axis_sensor(
         accelerometer,
+        fifo,
+        data_ready,
+        clock,
+        calibration,
+        TASK_ACCEL_FILTERS,
         "Task accelerometer",
         TASK_ACCEL_PRIORITY,
         TASK_ACCEL_PERIOD
     ),
-    m_bias(bias),
-    m_transform(transform)
+    m_transform(transform),
+    m_calibrator({
+        .window_samples = static_cast<uint32_t>(CALIBRATION_WINDOW / get_sample_period()),
+        .max_variance = CALIBRATION_ACCEL_MAX_VAR,
+        .gravity_tolerance = CALIBRATION_ACCEL_G_TOL,
+        .min_alignment = CALIBRATION_ACCEL_ALIGNMENT,
+        .required_samples = static_cast<uint32_t>(CALIBRATION_ACCEL_DURATION / get_sample_period())
+    })
 {}
 
 task_accelerometer::vector_t
-task_accelerometer::process(const vector_t& raw_data) const noexcept
+task_accelerometer::process(const vector_t& raw_data) noexcept
 {
-    // TODO: Add (conditional) low-pass filtering
-    return m_transform.matmul(raw_data - m_bias);
+    if (take_calibration_request()) {
+        m_calibrator.reset();
+        m_calibrating = true;
+    }
+
+    // Calibration works on the raw samples in the sensor frame, and
+    // the previous calibration stays in use until all positions are captured
+    if (m_calibrating) {
+        if (m_calibrator.add(raw_data)) {
+            set_calibration(m_calibrator.get_result());
+            m_calibrating = false;
+        }
+        m_calibration_progress.store(m_calibrator.get_captured(), std::memory_order_relaxed);
+    }
+
+    // Low-pass filtering is done by the task filter chain
+    return m_transform.matmul(get_active_calibration().apply(raw_data));
 }
 
-}
\ No newline at end of file
+}
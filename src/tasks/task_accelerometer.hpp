@@ -2,27 +2,45 @@
 
 #include "task_config.hpp"
 #include "task_three_axis_sensor.hpp"
+#include "calibration/accel_calibrator.hpp"
 #include "emblib/driver/sensor/accelerometer.hpp"
 
 namespace mp {
 
-// TODO: Replace float data_type with m/s^2
+/**
+ * Accelerometer task, which runs the six position calibration when requested
+ * @todo Replace float data_type with m/s^2
+ */
 class task_accelerometer : public task_three_axis_sensor<float> {
 
 public:
     explicit task_accelerometer(
         emblib::accelerometer& accelerometer,
+        fifo_sensor<float>* fifo,
+        data_ready_interrupt* data_ready,
+        const monotonic_clock& clock,
         matrix_t transform,
-        vector_t bias
+        const sensor_calibration_s& calibration
     );
 
+    /**
+     * Positions captured by the running calibration
+     * @see accel_calibrator::get_captured
+     */
+    uint8_t get_calibration_progress() const noexcept
+    {
+        return m_calibration_progress.load(std::memory_order_relaxed);
+    }
+
 private:
-    vector_t process(const vector_t& raw_data) const noexcept override;
+    vector_t process(const vector_t& raw_data) noexcept override;
 
 private:
-    vector_t m_bias;
     matrix_t m_transform;
-    // TODO: Add low-pass filter
+
+    accel_calibrator m_calibrator;
+    bool m_calibrating = false;
+    std::atomic<uint8_t> m_calibration_progress {0};
 };
 
-}
\ No newline at end of file
+}
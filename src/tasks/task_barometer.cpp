@@ -0,0 +1,45 @@
+#include "task_barometer.hpp"
+#include "util/logger.hpp"
+#include <cmath>
+
+namespace mp {
+
+// International barometric formula h = A * (1 - (p/p0)^B)
+inline constexpr float BARO_A = 44330.77f;
+inline constexpr float BARO_B = 0.190263f;
+
+void task_barometer::run() noexcept
+{
+    assert(m_barometer.probe());
+
+    // Reference pressure at the starting point
+    float reference = 0.f;
+    size_t reference_count = 0;
+
+    while (true) {
+        float pressure;
+        if (!m_barometer.read_pressure(pressure)) {
+            log_warning("Barometer reading failed");
+        } else if (reference_count < TASK_BARO_REFERENCE_SAMPLES) {
+            m_pressure.store(pressure, std::memory_order_relaxed);
+            reference += (pressure - reference) / static_cast<float>(++reference_count);
+        } else {
+            m_pressure.store(pressure, std::memory_order_relaxed);
+
+            // Noise is mapped through the derivative of the formula, about 8m per hPa
+            const float ratio = std::pow(pressure / reference, BARO_B);
+            const float dh_dp = BARO_A * BARO_B * ratio / pressure;
+            const float noise = m_barometer.get_pressure_noise();
+
+            m_samples.push({
+                .altitude = BARO_A * (1.f - ratio),
+                .variance = dh_dp * dh_dp * noise * noise,
+                .timestamp = m_clock.now()
+            });
+        }
+
+        sleep_periodic(TASK_BARO_PERIOD);
+    }
+}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "task_config.hpp"
+#include "mp/drivers/clock.hpp"
+#include "mp/drivers/barometer.hpp"
+#include "util/ring_buffer.hpp"
+#include "emblib/rtos/task.hpp"
+#include <atomic>
+
+namespace mp {
+
+/**
+ * Task which reads the barometer and converts the pressure to altitude
+ *
+ * Altitude is relative to the starting point, whose pressure is the mean
+ * of the first readings (the vehicle must not move for that long after boot),
+ * so it shares the origin of the state estimate, which starts at zero.
+ * Weather changes the pressure slowly, so the altitude also drifts slowly.
+ */
+class task_barometer : public emblib::task {
+
+public:
+    /**
+     * Altitude above the starting point and the time it was read
+     */
+    struct sample_s {
+        float altitude;
+        float variance;
+        timestamp_t timestamp;
+    };
+
+    explicit task_barometer(barometer& barometer, const monotonic_clock& clock) noexcept :
+        task("Task barometer", TASK_BARO_PRIORITY, m_task_stack),
+        m_barometer(barometer),
+        m_clock(clock)
+    {}
+
+    /**
+     * Move all samples since the last call into `samples`
+     * @returns Number of samples read
+     * @note Must only be called from a single task
+     */
+    size_t read_samples(sample_s* samples, size_t max_count) noexcept
+    {
+        return m_samples.pop_all(samples, max_count);
+    }
+
+    /**
+     * Last read pressure in pascals, 0 before the first reading
+     */
+    float get_pressure() const noexcept
+    {
+        return m_pressure.load(std::memory_order_relaxed);
+    }
+
+private:
+    void run() noexcept override;
+
+private:
+    emblib::task_stack_t<TASK_BARO_STACK_SIZE> m_task_stack;
+    barometer& m_barometer;
+    const monotonic_clock& m_clock;
+
+    std::atomic<float> m_pressure {0.f};
+    ring_buffer<sample_s, TASK_BARO_BUFFER_SIZE> m_samples;
+};
+
+}
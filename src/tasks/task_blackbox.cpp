@@ -0,0 +1,101 @@
+#include "task_blackbox.hpp"
+#include "util/logger.hpp"
+
+namespace mp {
+
+void task_blackbox::run() noexcept
+{
+    assert(m_blackbox_device.probe(emblib::milliseconds(0)));
+    m_use_async = m_blackbox_device.is_async_available();
+
+    // Adds a record, writing out the block first if it is full
+    const auto add = [this](const auto& add_record) {
+        if (!add_record()) {
+            flush();
+            add_record();
+        }
+    };
+
+    uint32_t dropped = 0;
+    while (true) {
+        for (size_t type = 0; type <= BLACKBOX_MAGNETOMETER; type++) {
+            for (size_t instance = 0; instance < MAX_SENSOR_INSTANCES; instance++) {
+                blackbox_sensor_s sample;
+                while (m_sensor_channels[type][instance].pop(sample)) {
+                    add([&]() {
+                        return m_encoder.add_sensor(static_cast<blackbox_record_e>(type), instance, sample);
+                    });
+                }
+            }
+        }
+
+        state_s state;
+        while (m_state_channel.pop(state))
+            add([&]() { return m_encoder.add_state(state); });
+
+        blackbox_control_s control;
+        while (m_control_channel.pop(control))
+            add([&]() { return m_encoder.add_control(control); });
+
+        // Drops are recorded as they happen, so the gaps can be found in the recording
+        const uint32_t total_dropped = get_dropped();
+        if (total_dropped != dropped) {
+            if (dropped == 0)
+                log_warning("Blackbox buffers overflowed, records are dropped");
+            dropped = total_dropped;
+            add([&]() { return m_encoder.add_dropped(dropped); });
+        }
+
+        if (!m_encoder.is_empty())
+            flush();
+
+        sleep_periodic(TASK_BLACKBOX_PERIOD);
+    }
+}
+
+bool task_blackbox::flush() noexcept
+{
+    const uint8_t* block;
+    const ssize_t size = static_cast<ssize_t>(m_encoder.finish(block));
+    const char* data = reinterpret_cast<const char*>(block);
+
+    // Block is written synchronously if the async write could not be started
+    m_write_done.store(false, std::memory_order_relaxed);
+    const bool started = m_use_async && m_blackbox_device.write_async(data, size, [this](ssize_t status) {
+        m_write_status.store(status, std::memory_order_relaxed);
+        m_write_done.store(true, std::memory_order_release);
+        notify_from_isr();
+    });
+
+    bool written;
+    if (started) {
+        // Device which does not complete a write in time is only written synchronously after
+        while (!m_write_done.load(std::memory_order_acquire)) {
+            if (!wait_notification(TASK_BLACKBOX_WRITE_TIMEOUT)) {
+                m_use_async = false;
+                break;
+            }
+        }
+        written = m_write_done.load(std::memory_order_acquire) &&
+            m_write_status.load(std::memory_order_relaxed) >= 0;
+    } else {
+        written = m_blackbox_device.write(data, size, emblib::milliseconds(0)) == size;
+    }
+    m_encoder.begin();
+
+    if (!written && m_dropped_blocks.fetch_add(1, std::memory_order_relaxed) == 0)
+        log_warning("Blackbox write failed, blocks are dropped");
+    return written;
+}
+
+uint32_t task_blackbox::get_dropped() const noexcept
+{
+    size_t dropped = m_state_channel.get_dropped() + m_control_channel.get_dropped();
+    for (const auto& channels : m_sensor_channels) {
+        for (const auto& channel : channels)
+            dropped += channel.get_dropped();
+    }
+    return static_cast<uint32_t>(dropped);
+}
+
+}
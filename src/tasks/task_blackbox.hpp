@@ -0,0 +1,93 @@
+#pragma once
+
+#include "task_config.hpp"
+#include "blackbox/blackbox.hpp"
+#include "blackbox/blackbox_encoder.hpp"
+#include "emblib/driver/io/char_dev.hpp"
+#include "emblib/rtos/task.hpp"
+#include <atomic>
+
+namespace mp {
+
+/**
+ * Task recording the sensor samples, the estimator states and the vehicle
+ * control outputs to a blackbox device (usually a flash or an SD card)
+ *
+ * Recorded tasks push every record into their own channel, and this (low
+ * priority) task periodically drains all channels, encodes the records
+ * (see `blackbox_encoder`) and writes the blocks to the device. Records
+ * dropped because of full channels are counted in the recording, and blocks
+ * which the device failed to write are counted by `get_dropped_blocks`.
+ */
+class task_blackbox : public emblib::task {
+
+public:
+    explicit task_blackbox(emblib::char_dev& blackbox_device) noexcept :
+        task("Task blackbox", TASK_BLACKBOX_PRIORITY, m_task_stack),
+        m_blackbox_device(blackbox_device)
+    {}
+
+    /**
+     * Channel for the samples of a sensor instance
+     * @param type One of the sensor record types
+     */
+    blackbox_sensor_channel& get_sensor_channel(blackbox_record_e type, size_t instance) noexcept
+    {
+        assert(type <= BLACKBOX_MAGNETOMETER && instance < MAX_SENSOR_INSTANCES);
+        return m_sensor_channels[type][instance];
+    }
+
+    blackbox_state_channel& get_state_channel() noexcept
+    {
+        return m_state_channel;
+    }
+
+    blackbox_control_channel& get_control_channel() noexcept
+    {
+        return m_control_channel;
+    }
+
+    /**
+     * Total number of records dropped by all channels
+     */
+    uint32_t get_dropped() const noexcept;
+
+    /**
+     * Number of blocks which were not written to the device
+     * @note Safe to call from other tasks
+     */
+    uint32_t get_dropped_blocks() const noexcept
+    {
+        return m_dropped_blocks.load(std::memory_order_relaxed);
+    }
+
+private:
+    /**
+     * Task thread
+     */
+    void run() noexcept override;
+
+    /**
+     * Write the current block to the device and start a new one
+     * @returns false if the block was not written
+     */
+    bool flush() noexcept;
+
+private:
+    emblib::task_stack_t<TASK_BLACKBOX_STACK_SIZE> m_task_stack;
+    emblib::char_dev& m_blackbox_device;
+    bool m_use_async = false;
+    // Completion and result (negative on failure) of the last async write
+    std::atomic<bool> m_write_done = false;
+    std::atomic<ssize_t> m_write_status = 0;
+    std::atomic<uint32_t> m_dropped_blocks = 0;
+
+    blackbox_sensor_channel m_sensor_channels[BLACKBOX_MAGNETOMETER + 1][MAX_SENSOR_INSTANCES];
+    blackbox_state_channel m_state_channel;
+    blackbox_control_channel m_control_channel;
+
+    // Only accessed by this task
+    blackbox_encoder m_encoder;
+};
+
+}
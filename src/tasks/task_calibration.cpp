@@ -0,0 +1,141 @@
+#include "task_calibration.hpp"
+#include "util/logger.hpp"
+#include <algorithm>
+#include <iterator>
+
+namespace mp {
+
+task_calibration::task_calibration(
+    calibration_store* store,
+    const sensor_instances_s<task_accelerometer>& accelerometers,
+    const sensor_instances_s<task_gyroscope>& gyroscopes,
+    task_magnetometer* magnetometer,
+    const calibration_s& calibration
+) noexcept :
+    task("Task calibration", TASK_CALIBRATION_PRIORITY, m_task_stack),
+    m_store(store),
+    m_accelerometers(accelerometers),
+    m_gyroscopes(gyroscopes),
+    m_magnetometer(magnetometer),
+    m_calibration(calibration)
+{}
+
+bool task_calibration::handle_command(const pb::Command& command) noexcept
+{
+    if (!command.has_calibrate()) {
+        return false;
+    }
+
+    switch (command.calibrate().sensor()) {
+    case pb::CommandCalibrate::ACCELEROMETER:
+        for (task_accelerometer* task : m_accelerometers.tasks) {
+            if (task)
+                task->start_calibration();
+        }
+        return true;
+    case pb::CommandCalibrate::GYROSCOPE:
+        m_gyro_save_requested = true;
+        for (task_gyroscope* task : m_gyroscopes.tasks) {
+            if (task)
+                task->start_calibration();
+        }
+        return true;
+    case pb::CommandCalibrate::MAGNETOMETER:
+        if (!m_magnetometer) {
+            log_warning("Magnetometer not available for calibration");
+            return true;
+        }
+        m_magnetometer->start_calibration();
+        return true;
+    default:
+        return false;
+    }
+}
+
+void task_calibration::run() noexcept
+{
+    // Calibrations set before this task started are still picked up
+    uint32_t accel_versions[MAX_SENSOR_INSTANCES] = {};
+    uint32_t gyro_versions[MAX_SENSOR_INSTANCES] = {};
+    uint8_t accel_progress[MAX_SENSOR_INSTANCES] = {};
+    bool gyro_save_pending[MAX_SENSOR_INSTANCES] = {};
+    uint32_t mag_version = 0;
+    uint8_t mag_progress = 0;
+
+    while (true) {
+        bool changed = false;
+        // Next bias of every gyroscope is saved, even if it is close to the stored one
+        if (m_gyro_save_requested.exchange(false)) {
+            std::fill(std::begin(gyro_save_pending), std::end(gyro_save_pending), true);
+        }
+
+        for (size_t i = 0; i < MAX_SENSOR_INSTANCES; i++) {
+            task_accelerometer* accel = m_accelerometers.tasks[i];
+            if (!accel)
+                continue;
+
+            // Progress is reported so the operator knows when to change the position
+            const uint8_t progress = accel->get_calibration_progress();
+            if (progress & ~accel_progress[i]) {
+                log_info("Accelerometer ", static_cast<int>(i), " calibration positions: ", static_cast<int>(progress));
+            }
+            accel_progress[i] = progress;
+
+            const uint32_t version = accel->get_calibration_version();
+            if (version != accel_versions[i]) {
+                m_calibration.accelerometers[i] = accel->get_calibration();
+                accel_versions[i] = version;
+                changed = true;
+                log_info("Accelerometer ", static_cast<int>(i), " calibrated");
+            }
+        }
+
+        for (size_t i = 0; i < MAX_SENSOR_INSTANCES; i++) {
+            task_gyroscope* gyro = m_gyroscopes.tasks[i];
+            if (!gyro)
+                continue;
+
+            const uint32_t version = gyro->get_calibration_version();
+            if (version != gyro_versions[i]) {
+                const sensor_calibration_s calibration = gyro->get_calibration();
+                const float diff = (calibration.bias - m_calibration.gyroscopes[i].bias).norm();
+                gyro_versions[i] = version;
+                log_info("Gyroscope ", static_cast<int>(i), " bias estimated");
+
+                if (gyro_save_pending[i] || diff > CALIBRATION_GYRO_SAVE_DIFF) {
+                    m_calibration.gyroscopes[i] = calibration;
+                    gyro_save_pending[i] = false;
+                    changed = true;
+                }
+            }
+        }
+
+        if (m_magnetometer) {
+            // Progress is reported so the operator knows which axes still need to be rotated
+            const uint8_t progress = m_magnetometer->get_calibration_progress();
+            if (progress & ~mag_progress) {
+                log_info("Magnetometer calibration axes: ", static_cast<int>(progress));
+            }
+            mag_progress = progress;
+
+            const uint32_t version = m_magnetometer->get_calibration_version();
+            if (version != mag_version) {
+                m_calibration.magnetometer = m_magnetometer->get_calibration();
+                m_calibration.has_magnetometer = true;
+                mag_version = version;
+                changed = true;
+                log_info("Magnetometer calibrated");
+            }
+        }
+
+        // All sensors are saved together, so a few
+        // calibrations finishing at once cause a single write
+        if (changed && m_store && !m_store->save(m_calibration)) {
+            log_error("Saving the calibration failed!");
+        }
+
+        sleep_periodic(TASK_CALIBRATION_PERIOD);
+    }
+}
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "task_config.hpp"
+#include "task_accelerometer.hpp"
+#include "task_gyroscope.hpp"
+#include "task_magnetometer.hpp"
+#include "sensor_instances.hpp"
+#include "calibration/calibration_store.hpp"
+#include "emblib/rtos/task.hpp"
+#include "pb/command.pb.h"
+#include <atomic>
+
+namespace mp {
+
+/**
+ * Task responsible for storing the sensor calibrations
+ *
+ * Calibrations are estimated by the sensor tasks themselves, since they need
+ * every raw sample. This task polls for new ones and writes them to the storage
+ * at a low priority, so the (possibly slow) writes never delay the sensors.
+ *
+ * Gyroscope bias is estimated again on every boot, and is only written when
+ * it differs from the stored one by more than `CALIBRATION_GYRO_SAVE_DIFF`,
+ * or when the estimation was started by a calibration command. Accelerometer
+ * and magnetometer calibrations only run on a calibration command.
+ */
+class task_calibration : public emblib::task {
+
+public:
+    /**
+     * @param store Where calibrations are saved, `nullptr` if there is no storage
+     * @param magnetometer Optional, `nullptr` if not available
+     * @param calibration Calibration the sensor tasks were created with
+     */
+    explicit task_calibration(
+        calibration_store* store,
+        const sensor_instances_s<task_accelerometer>& accelerometers,
+        const sensor_instances_s<task_gyroscope>& gyroscopes,
+        task_magnetometer* magnetometer,
+        const calibration_s& calibration
+    ) noexcept;
+
+    /**
+     * Start a calibration of all instances of the sensor if this is a calibration command
+     * @returns false if the command is not a calibration command
+     * @note Safe to call from other tasks
+     */
+    bool handle_command(const pb::Command& command) noexcept;
+
+private:
+    void run() noexcept override;
+
+private:
+    emblib::task_stack_t<TASK_CALIBRATION_STACK_SIZE> m_task_stack;
+    calibration_store* m_store;
+
+    sensor_instances_s<task_accelerometer> m_accelerometers;
+    sensor_instances_s<task_gyroscope> m_gyroscopes;
+    task_magnetometer* m_magnetometer;
+
+    // Last stored calibration, only accessed by this task
+    calibration_s m_calibration;
+    // Set by a gyroscope calibration command, the next estimated bias is saved
+    std::atomic<bool> m_gyro_save_requested = false;
+};
+
+}
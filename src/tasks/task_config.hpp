@@ -1,7 +1,11 @@
 #pragma once
 
+#include "util/biquad.hpp"
+#include "telemetry/telemetry_encoder.hpp"
+#include "telemetry/telemetry_scheduler.hpp"
 #include <assert.h>
 #include <cstddef>
+#include <cstdint>
 #include <chrono>
 
 namespace mp {
@@ -18,14 +22,39 @@ enum task_priority_e : size_t {
 
 inline constexpr size_t             COMMAND_MSG_MAX_SIZE        = 64;
 
-inline constexpr size_t             TASK_LOGGER_QUEUE_SIZE      = 8;
+inline constexpr size_t             TASK_LOGGER_BUFFER_SIZE     = 1024; // Power of two
+inline constexpr size_t             TASK_LOGGER_MAX_WRITERS     = 8;
 inline constexpr size_t             TASK_LOGGER_STACK_SIZE      = 1024;
 inline constexpr task_priority_e    TASK_LOGGER_PRIORITY        = TASK_PRIORITY_VERY_LOW;
+// Asynchronous writes which do not complete in time are abandoned, and the device is then written synchronously
+inline constexpr auto               TASK_LOGGER_WRITE_TIMEOUT   = std::chrono::milliseconds(100);
 
 inline constexpr size_t             TASK_TELEMETRY_STACK_SIZE   = 1024;
 inline constexpr size_t             TASK_TELEMETRY_ARENA_SIZE   = 256;
 inline constexpr task_priority_e    TASK_TELEMETRY_PRIORITY     = TASK_PRIORITY_LOW;
-inline constexpr auto               TASK_TELEMETRY_PERIOD       = std::chrono::milliseconds(200); // 5Hz
+// Transmission window, the highest rate of any stream
+inline constexpr auto               TASK_TELEMETRY_PERIOD       = std::chrono::milliseconds(20); // 50Hz
+// Bytes per second of the telemetry link for all streams, and the most bytes saved up for larger messages
+inline constexpr float              TASK_TELEMETRY_BUDGET       = 2000.f;
+inline constexpr float              TASK_TELEMETRY_BURST        = 256.f;
+// Rate (Hz) and priority of each stream in `telemetry_stream_e` order, the
+// compact state frames replace the protobuf attitude and position by default
+inline constexpr telemetry_stream_config_s TASK_TELEMETRY_STREAMS[TELEMETRY_STREAM_COUNT] = {
+    {50.f, 3}, // State
+    {0.f, 2},  // Attitude
+    {0.f, 2},  // Position
+    {5.f, 1},  // Sensors
+    {5.f, 1},  // Vehicle
+    {1.f, 0},  // Estimator
+};
+inline constexpr size_t             TASK_TELEMETRY_KEY_INTERVAL = 25;
+inline constexpr size_t             TASK_TELEMETRY_KEY_MAX_AGE  = 75;
+// State records per delta frame, each waits up to a period for the rest of its frame
+inline constexpr size_t             TASK_TELEMETRY_BATCH        = 2;
+// Position, velocity, acceleration, rotation, angular velocity and raw and corrected accelerometer and gyroscope
+inline constexpr telemetry_resolution_s TASK_TELEMETRY_RESOLUTION = {{-2, -2, -1, -3, -2, -1, -1, -2, -2}};
+// Asynchronous writes which do not complete in time are abandoned, and the device is then written synchronously
+inline constexpr auto               TASK_TELEMETRY_WRITE_TIMEOUT = TASK_TELEMETRY_PERIOD;
 
 inline constexpr task_priority_e    TASK_ACCEL_PRIORITY         = TASK_PRIORITY_REALTIME;
 inline constexpr auto               TASK_ACCEL_PERIOD           = std::chrono::milliseconds(5); // 200Hz
@@ -33,15 +62,102 @@ inline constexpr auto               TASK_ACCEL_PERIOD           = std::chrono::m
 inline constexpr task_priority_e    TASK_GYRO_PRIORITY          = TASK_PRIORITY_REALTIME;
 inline constexpr auto               TASK_GYRO_PERIOD            = std::chrono::milliseconds(5); // 200Hz
 
+inline constexpr task_priority_e    TASK_MAG_PRIORITY           = TASK_PRIORITY_HIGH;
+inline constexpr auto               TASK_MAG_PERIOD             = std::chrono::milliseconds(10); // 100Hz
+
+// Filters applied to every corrected sample, designed for the sensor sample rate
+inline constexpr biquad_spec_s      TASK_ACCEL_FILTERS[]        = {{biquad_type_e::LOW_PASS, 30.f}};
+inline constexpr biquad_spec_s      TASK_GYRO_FILTERS[]         = {{biquad_type_e::LOW_PASS, 80.f}};
+inline constexpr biquad_spec_s      TASK_MAG_FILTERS[]          = {{biquad_type_e::LOW_PASS, 10.f}};
+inline constexpr size_t             TASK_SENSOR_MAX_FILTERS     = 4;
+
+// Notches following the motor frequencies (and their harmonics) in the gyroscope data
+inline constexpr size_t             TASK_GYRO_NOTCH_HARMONICS   = 3;
+inline constexpr float              TASK_GYRO_NOTCH_Q           = 5.f;
+inline constexpr float              TASK_GYRO_NOTCH_MIN_FREQ    = 40.f; // Hz
+
+inline constexpr size_t             TASK_SENSOR_STACK_SIZE      = 1024;
+// Samples buffered by each sensor task between two state estimator iterations,
+// enough for a sensor FIFO running at up to 1.6kHz
+inline constexpr size_t             TASK_SENSOR_BUFFER_SIZE     = 32;
+// Samples read from a sensor FIFO in a single transfer
+inline constexpr size_t             TASK_SENSOR_FIFO_BURST_SIZE = 16;
+// Sensors with a data-ready interrupt wake their task on every interrupt, if false
+// the tasks stay periodic and the interrupt is only used for measuring the latency
+inline constexpr bool               TASK_SENSOR_WAKE_ON_READY   = true;
+// Missed interrupts are detected after this many task periods, and the sensor is read anyway
+inline constexpr size_t             TASK_SENSOR_READY_TIMEOUT   = 2;
+
+// Calibration works on windows of samples, and only uses the windows where the sensor
+// is still (variance of every axis under the limit), variances are of the raw samples
+inline constexpr auto               CALIBRATION_WINDOW          = std::chrono::milliseconds(500);
+inline constexpr float              CALIBRATION_GYRO_MAX_VAR    = 1e-4f; // (rad/s)^2
+inline constexpr float              CALIBRATION_GYRO_MAX_BIAS   = 0.2f; // rad/s
+inline constexpr auto               CALIBRATION_GYRO_DURATION   = std::chrono::seconds(5);
+// Bias estimated at boot is only saved if it moved this much from the stored one (or on command),
+// so the flash is not worn by a write on every boot
+inline constexpr float              CALIBRATION_GYRO_SAVE_DIFF  = 0.005f; // rad/s
+inline constexpr float              CALIBRATION_ACCEL_MAX_VAR   = 0.05f; // (m/s^2)^2
+inline constexpr float              CALIBRATION_ACCEL_G_TOL     = 0.1f; // Relative to G
+inline constexpr float              CALIBRATION_ACCEL_ALIGNMENT = 0.95f; // Of the magnitude
+inline constexpr auto               CALIBRATION_ACCEL_DURATION  = std::chrono::seconds(2); // Per position
+// Magnetometer is calibrated while it is rotated, on the extremes of short window means
+inline constexpr auto               CALIBRATION_MAG_WINDOW      = std::chrono::milliseconds(100);
+inline constexpr float              CALIBRATION_MAG_COVERAGE    = 0.8f; // Of the largest axis range
+inline constexpr float              CALIBRATION_MAG_MIN_FIELD   = 0.1f; // gauss
+inline constexpr auto               CALIBRATION_MAG_DURATION    = std::chrono::seconds(20); // At least
+
+// Slow sensors are polled, and their samples buffered until the next state estimator iteration
+inline constexpr size_t             TASK_GNSS_STACK_SIZE        = 1024;
+inline constexpr size_t             TASK_GNSS_BUFFER_SIZE       = 4;
+inline constexpr task_priority_e    TASK_GNSS_PRIORITY          = TASK_PRIORITY_MEDIUM;
+inline constexpr auto               TASK_GNSS_PERIOD            = std::chrono::milliseconds(100); // 10Hz
+
+inline constexpr size_t             TASK_BARO_STACK_SIZE        = 1024;
+inline constexpr size_t             TASK_BARO_BUFFER_SIZE       = 4;
+inline constexpr task_priority_e    TASK_BARO_PRIORITY          = TASK_PRIORITY_MEDIUM;
+inline constexpr auto               TASK_BARO_PERIOD            = std::chrono::milliseconds(20); // 50Hz
+// Readings averaged for the pressure at the starting point (zero altitude)
+inline constexpr size_t             TASK_BARO_REFERENCE_SAMPLES = 50;
+
+inline constexpr size_t             TASK_CALIBRATION_STACK_SIZE = 1024;
+inline constexpr task_priority_e    TASK_CALIBRATION_PRIORITY   = TASK_PRIORITY_VERY_LOW;
+inline constexpr auto               TASK_CALIBRATION_PERIOD     = std::chrono::milliseconds(500); // 2Hz
+
 inline constexpr size_t             TASK_STATE_STACK_SIZE       = 24576;
 inline constexpr task_priority_e    TASK_STATE_PRIORITY         = TASK_PRIORITY_REALTIME;
 inline constexpr auto               TASK_STATE_PERIOD           = std::chrono::milliseconds(20); // 50Hz
 
+// Voting between redundant sensors, tolerances are deviations of the mean
+// reading over one state task period (IMUs at different positions on the
+// vehicle also differ due to the rotation, which the accel tolerance must allow)
+inline constexpr float              TASK_STATE_VOTE_ACCEL_TOL   = 1.f; // m/s^2
+inline constexpr float              TASK_STATE_VOTE_GYRO_TOL    = 0.05f; // rad/s
+inline constexpr float              TASK_STATE_VOTE_SMOOTHING   = 0.1f;
+inline constexpr uint32_t           TASK_STATE_VOTE_MAX_MISSED  = 5; // Periods
+
 inline constexpr size_t             TASK_RECEIVER_STACK_SIZE    = 1024;
 inline constexpr size_t             TASK_RECEIVER_QUEUE_SIZE    = 4;
 inline constexpr size_t             TASK_RECEIVER_ARENA_SIZE    = TASK_RECEIVER_QUEUE_SIZE * COMMAND_MSG_MAX_SIZE;
 inline constexpr task_priority_e    TASK_RECEIVER_PRIORITY      = TASK_PRIORITY_HIGH;
 
+// Blackbox records are buffered by every producer until the blackbox task encodes them. Sensor
+// buffers hold 4 periods of the fastest sensor, so a drain delayed by a slow write or higher
+// priority tasks does not drop samples (a 1.6kHz sensor fills a buffer of 16 in every period).
+inline constexpr size_t             TASK_BLACKBOX_STACK_SIZE    = 1024;
+inline constexpr size_t             TASK_BLACKBOX_MAX_RATE      = 1600; // Hz
+inline constexpr size_t             TASK_BLACKBOX_DRAIN_PERIODS = 4;
+inline constexpr size_t             TASK_BLACKBOX_STATE_BUFFER  = 4;
+inline constexpr size_t             TASK_BLACKBOX_CTRL_BUFFER   = 4;
+// Records are written to the blackbox device in blocks of at most this size
+inline constexpr size_t             TASK_BLACKBOX_BLOCK_SIZE    = 512;
+inline constexpr task_priority_e    TASK_BLACKBOX_PRIORITY      = TASK_PRIORITY_LOW;
+inline constexpr auto               TASK_BLACKBOX_PERIOD        = std::chrono::milliseconds(10); // 100Hz
+inline constexpr size_t             TASK_BLACKBOX_SENSOR_BUFFER = TASK_BLACKBOX_MAX_RATE * TASK_BLACKBOX_DRAIN_PERIODS *
+                                                                  TASK_BLACKBOX_PERIOD.count() / 1000;
+// Asynchronous writes which do not complete in time are counted as dropped blocks
+inline constexpr auto               TASK_BLACKBOX_WRITE_TIMEOUT = std::chrono::milliseconds(100);
+
 inline constexpr size_t             TASK_VEHICLE_STACK_SIZE     = 4096;
 inline constexpr task_priority_e    TASK_VEHICLE_PRIORITY       = TASK_PRIORITY_HIGH;
 inline constexpr auto               TASK_VEHICLE_PERIOD         = std::chrono::milliseconds(50); // 20Hz
@@ -0,0 +1,58 @@
+#include "task_gnss.hpp"
+#include "util/logger.hpp"
+#include <cmath>
+
+namespace mp {
+
+// Mean radius of the Earth in meters
+inline constexpr double EARTH_RADIUS = 6371000.0;
+inline constexpr double DEG_TO_RAD = 3.14159265358979323846 / 180.0;
+
+void task_gnss::run() noexcept
+{
+    assert(m_receiver.probe());
+
+    while (true) {
+        gnss_fix_s fix;
+        if (m_receiver.read_fix(fix)) {
+            const timestamp_t timestamp = m_clock.now();
+            if (!m_has_origin) {
+                m_origin = fix;
+                m_has_origin = true;
+                log_info("GNSS fix acquired");
+            }
+            m_samples.push(to_global(fix, timestamp));
+        }
+
+        sleep_periodic(TASK_GNSS_PERIOD);
+    }
+}
+
+task_gnss::sample_s
+task_gnss::to_global(const gnss_fix_s& fix, timestamp_t timestamp) const noexcept
+{
+    // Differences are taken in double precision, only the result fits in a float
+    const double north = (fix.latitude - m_origin.latitude) * DEG_TO_RAD * EARTH_RADIUS;
+    const double east = (fix.longitude - m_origin.longitude) * DEG_TO_RAD * EARTH_RADIUS *
+        std::cos(m_origin.latitude * DEG_TO_RAD);
+
+    const float h_var = fix.horizontal_accuracy * fix.horizontal_accuracy;
+    const float v_var = fix.vertical_accuracy * fix.vertical_accuracy;
+    const float s_var = fix.speed_accuracy * fix.speed_accuracy;
+
+    sample_s sample;
+    sample.position = {
+        static_cast<float>(north),
+        static_cast<float>(-east),
+        fix.altitude - m_origin.altitude
+    };
+    sample.velocity = {fix.velocity_ned(0), -fix.velocity_ned(1), -fix.velocity_ned(2)};
+    sample.position_cov = matrix3f(0);
+    sample.position_cov(0, 0) = sample.position_cov(1, 1) = h_var;
+    sample.position_cov(2, 2) = v_var;
+    sample.velocity_cov = matrix3f::diagonal(s_var);
+    sample.timestamp = timestamp;
+    return sample;
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "task_config.hpp"
+#include "mp/util/math.hpp"
+#include "mp/drivers/clock.hpp"
+#include "mp/drivers/gnss.hpp"
+#include "util/ring_buffer.hpp"
+#include "emblib/rtos/task.hpp"
+
+namespace mp {
+
+/**
+ * Task which polls the GNSS receiver and converts its solutions to the global frame
+ *
+ * Position is relative to the first fix (the origin), on a plane tangent to
+ * the Earth at the origin, which is accurate enough within a few kilometers.
+ * The state estimator task anchors the origin to its estimate at the first fix.
+ * Global frame axes point north, west and up, and so for the state estimator
+ * to use a GNSS the heading must also be referenced to north (magnetometer).
+ */
+class task_gnss : public emblib::task {
+
+public:
+    /**
+     * Solution in the global frame and the time it was read
+     */
+    struct sample_s {
+        vector3f position;
+        vector3f velocity;
+        matrix3f position_cov;
+        matrix3f velocity_cov;
+        timestamp_t timestamp;
+    };
+
+    explicit task_gnss(gnss& receiver, const monotonic_clock& clock) noexcept :
+        task("Task GNSS", TASK_GNSS_PRIORITY, m_task_stack),
+        m_receiver(receiver),
+        m_clock(clock)
+    {}
+
+    /**
+     * Move all solutions since the last call into `samples`
+     * @returns Number of samples read
+     * @note Must only be called from a single task
+     */
+    size_t read_samples(sample_s* samples, size_t max_count) noexcept
+    {
+        return m_samples.pop_all(samples, max_count);
+    }
+
+private:
+    void run() noexcept override;
+
+    /**
+     * Convert the solution to the global frame relative to the origin
+     */
+    sample_s to_global(const gnss_fix_s& fix, timestamp_t timestamp) const noexcept;
+
+private:
+    emblib::task_stack_t<TASK_GNSS_STACK_SIZE> m_task_stack;
+    gnss& m_receiver;
+    const monotonic_clock& m_clock;
+
+    bool m_has_origin = false;
+    gnss_fix_s m_origin;
+
+    ring_buffer<sample_s, TASK_GNSS_BUFFER_SIZE> m_samples;
+};
+
+}
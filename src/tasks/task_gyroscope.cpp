@@ -4,22 +4,63 @@ namespace mp {
 
 task_gyroscope::task_gyroscope(
     emblib::gyroscope& gyroscope,
-    matrix_t transform
+    fifo_sensor<float>* fifo,
+    data_ready_interrupt* data_ready,
+    const monotonic_clock& clock,
+    matrix_t transform,
+    const sensor_calibration_s& calibration,
+    const seqlock<motor_frequencies_s>& motor_frequencies
 ) :
     task_three_axis_sensor(
         gyroscope,
+        fifo,
+        data_ready,
+        clock,
+        calibration,
+        TASK_GYRO_FILTERS,
         "Task gyroscope",
         TASK_GYRO_PRIORITY,
         TASK_GYRO_PERIOD
     ),
-    m_transform(transform)
-{}
+    m_transform(transform),
+    m_motor_frequencies(motor_frequencies),
+    m_bias_estimator({
+        .window_samples = static_cast<uint32_t>(CALIBRATION_WINDOW / get_sample_period()),
+        .max_variance = CALIBRATION_GYRO_MAX_VAR,
+        .max_bias = CALIBRATION_GYRO_MAX_BIAS,
+        .required_samples = static_cast<uint32_t>(CALIBRATION_GYRO_DURATION / get_sample_period())
+    })
+{
+    const float fs = 1.f / std::chrono::duration<float>(get_sample_period()).count();
+    m_notch.configure(fs, TASK_GYRO_NOTCH_Q, TASK_GYRO_NOTCH_MIN_FREQ);
+}
 
 task_gyroscope::vector_t
-task_gyroscope::process(const vector_t& raw_data) const noexcept
+task_gyroscope::process(const vector_t& raw_data) noexcept
 {
-    // TODO: Add (conditional) band-pass / high-pass filtering
-    return m_transform.matmul(raw_data);
+    if (take_calibration_request()) {
+        m_bias_estimator.reset();
+        m_bias_converged = false;
+    }
+
+    // Only the bias is estimated, the scale is kept
+    if (!m_bias_converged && m_bias_estimator.add(raw_data)) {
+        sensor_calibration_s calibration = get_active_calibration();
+        calibration.bias = m_bias_estimator.get_bias();
+        set_calibration(calibration);
+        m_bias_converged = true;
+    }
+
+    // Vehicle task has a lower priority, so if it is preempted during
+    // the write the previous frequencies are kept until the next sample
+    motor_frequencies_s motors;
+    if (m_motor_frequencies.try_read(motors))
+        m_motors = motors;
+
+    // Notches move a bounded step towards the motor frequencies every sample,
+    // the remaining filtering is done by the task filter chain
+    m_notch.update(m_motors.hz, m_motors.count);
+    return m_notch.process(m_transform.matmul(get_active_calibration().apply(raw_data)));
 }
 
 }
\ No newline at end of file
@@ -2,25 +2,47 @@
 
 #include "task_config.hpp"
 #include "task_three_axis_sensor.hpp"
+#include "vehicles/vehicle.hpp"
+#include "util/harmonic_notch.hpp"
+#include "util/seqlock.hpp"
+#include "calibration/gyro_bias_estimator.hpp"
 #include "emblib/driver/sensor/gyroscope.hpp"
 
 namespace mp {
 
-// TODO: Replace float data_type with rad/s
+/**
+ * Gyroscope task which also removes the motor vibrations from the samples
+ * with notches following the motor frequencies published by the vehicle task
+ *
+ * Bias is estimated at rest after every boot (and when requested), until
+ * then the calibration given on construction is used
+ * @todo Replace float data_type with rad/s
+ */
 class task_gyroscope : public task_three_axis_sensor<float> {
 
 public:
     explicit task_gyroscope(
         emblib::gyroscope& gyroscope,
-        matrix_t transform
+        fifo_sensor<float>* fifo,
+        data_ready_interrupt* data_ready,
+        const monotonic_clock& clock,
+        matrix_t transform,
+        const sensor_calibration_s& calibration,
+        const seqlock<motor_frequencies_s>& motor_frequencies
     );
 
 private:
-    vector_t process(const vector_t& raw_data) const noexcept override;
+    vector_t process(const vector_t& raw_data) noexcept override;
 
 private:
     matrix_t m_transform;
-    // TODO: Add band-pass filter
+
+    const seqlock<motor_frequencies_s>& m_motor_frequencies;
+    motor_frequencies_s m_motors;
+    harmonic_notch<motor_frequencies_s::MAX_MOTORS, TASK_GYRO_NOTCH_HARMONICS> m_notch;
+
+    gyro_bias_estimator m_bias_estimator;
+    bool m_bias_converged = false;
 };
 
 }
\ No newline at end of file
@@ -1,15 +1,18 @@
 #include "task_logger.hpp"
-#include <cstring>
 
 namespace mp {
 
 ssize_t task_logger::write(const char* data, size_t size, milliseconds_t timeout) noexcept
 {
     UNUSED(timeout);
-    log_msg_s msg;
-    msg.length = size;
-    memcpy(msg.data, data, size);
-    return m_log_msg_queue.send(msg) ? size : -1;
+    decltype(m_log_buffer)::reservation_s reservation;
+    if (!m_log_buffer.reserve(size, reservation))
+        return -1;
+
+    m_log_buffer.write(reservation, data);
+    m_log_buffer.commit(reservation);
+    notify();
+    return size;
 }
 
 void task_logger::run() noexcept
@@ -17,22 +20,36 @@ void task_logger::run() noexcept
     assert(m_log_device.probe(milliseconds_t(0)));
     bool use_async = m_log_device.is_async_available();
 
-    log_msg_s recv_msg;
     while (true) {
-        // TODO: Bypass this copying by reading the queue's top element data
-        // and removing the item from queue after write somehow
-        m_log_msg_queue.receive(recv_msg);
-
-        if (use_async) {
-            m_log_device.write_async(recv_msg.data, recv_msg.length, [this](ssize_t status) {
-                notify_from_isr();
-            });
-            // TODO: FIX: Only wait for notification if write_async started correctly (returned true)
+        // All committed messages up to the end of the buffer go out in a single write
+        const char* data;
+        const size_t size = m_log_buffer.peek(data);
+        if (size == 0) {
             wait_notification();
-        } else {
-            m_log_device.write(recv_msg.data, recv_msg.length, milliseconds_t(0));
+            continue;
+        }
+
+        // Messages are written synchronously if the async write could not be started
+        m_write_done.store(false, std::memory_order_relaxed);
+        const bool started = use_async && m_log_device.write_async(data, size, [this](ssize_t status) {
+            m_write_done.store(true, std::memory_order_release);
+            notify_from_isr();
+        });
+        if (!started) {
+            m_log_device.write(data, size, milliseconds_t(0));
         }
+
+        // Writers also notify the task, so wait until the write is actually done. Writers
+        // stop notifying once the buffer is full, so a write which never completes times
+        // out, and its messages are dropped and the device is only written synchronously.
+        while (started && !m_write_done.load(std::memory_order_acquire)) {
+            if (!wait_notification(TASK_LOGGER_WRITE_TIMEOUT)) {
+                use_async = false;
+                break;
+            }
+        }
+        m_log_buffer.release(size);
     }
 }
 
-}
\ No newline at end of file
+}
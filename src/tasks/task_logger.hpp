@@ -2,9 +2,9 @@
 
 #include "task_config.hpp"
 #include "util/logger.hpp"
+#include "util/byte_ring.hpp"
 #include "emblib/driver/io/char_dev.hpp"
 #include "emblib/rtos/task.hpp"
-#include "emblib/rtos/queue.hpp"
 
 namespace mp {
 
@@ -20,6 +20,10 @@ public:
 
     /**
      * Char dev write interface override
+     *
+     * Message is copied once into the log buffer, from which it is sent to
+     * the log device without copying
+     * @returns -1 if the buffer is full and the message was dropped
      */
     ssize_t write(const char* data, size_t size, milliseconds_t timeout = milliseconds_t(0)) noexcept override;
 
@@ -40,12 +44,8 @@ private:
     void run() noexcept override;
 
 private:
-    struct log_msg_s {
-        char data[LOGGER_MAX_TOTAL_SIZE];
-        size_t length;
-    };
-
-    emblib::queue<log_msg_s, TASK_LOGGER_QUEUE_SIZE> m_log_msg_queue;
+    byte_ring<TASK_LOGGER_BUFFER_SIZE, TASK_LOGGER_MAX_WRITERS> m_log_buffer;
+    std::atomic<bool> m_write_done = false;
     emblib::task_stack_t<TASK_LOGGER_STACK_SIZE> m_task_stack;
     emblib::char_dev& m_log_device;
 
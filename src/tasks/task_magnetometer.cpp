@@ -0,0 +1,57 @@
+#include "task_magnetometer.hpp"
+
+namespace mp {
+
+task_magnetometer::task_magnetometer(
+    emblib::three_axis_sensor<float>& magnetometer,
+    fifo_sensor<float>* fifo,
+    data_ready_interrupt* data_ready,
+    const monotonic_clock& clock,
+    matrix_t transform,
+    const sensor_calibration_s& calibration,
+    bool calibrated
+) :
+    task_three_axis_sensor(
+        magnetometer,
+        fifo,
+        data_ready,
+        clock,
+        calibration,
+        TASK_MAG_FILTERS,
+        "Task magnetometer",
+        TASK_MAG_PRIORITY,
+        TASK_MAG_PERIOD
+    ),
+    m_transform(transform),
+    m_calibrator({
+        .window_samples = static_cast<uint32_t>(CALIBRATION_MAG_WINDOW / get_sample_period()),
+        .min_coverage = CALIBRATION_MAG_COVERAGE,
+        .min_field = CALIBRATION_MAG_MIN_FIELD,
+        .required_windows = static_cast<uint32_t>(CALIBRATION_MAG_DURATION / CALIBRATION_MAG_WINDOW)
+    }),
+    m_calibrated(calibrated)
+{}
+
+task_magnetometer::vector_t
+task_magnetometer::process(const vector_t& raw_data) noexcept
+{
+    if (take_calibration_request()) {
+        m_calibrator.reset();
+        m_calibrating = true;
+    }
+
+    // Calibration works on the raw samples in the sensor frame, and
+    // the previous calibration stays in use until all axes are covered
+    if (m_calibrating) {
+        if (m_calibrator.add(raw_data)) {
+            set_calibration(m_calibrator.get_result());
+            m_calibrated.store(true, std::memory_order_release);
+            m_calibrating = false;
+        }
+        m_calibration_progress.store(m_calibrator.get_covered(), std::memory_order_relaxed);
+    }
+
+    return m_transform.matmul(get_active_calibration().apply(raw_data));
+}
+
+}
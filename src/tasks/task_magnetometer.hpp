@@ -0,0 +1,66 @@
+#pragma once
+
+#include "task_config.hpp"
+#include "task_three_axis_sensor.hpp"
+#include "calibration/mag_calibrator.hpp"
+#include "emblib/driver/sensor/three_axis_sensor.hpp"
+#include <atomic>
+
+namespace mp {
+
+/**
+ * Magnetometer task, which runs the hard-iron and soft-iron calibration when requested
+ *
+ * Hard-iron (bias) and soft-iron (per axis scale) corrections are applied
+ * through the sensor calibration. Magnetometers usually run much slower than
+ * the IMU, so the state estimator only fuses them on iterations with new samples,
+ * and only once the magnetometer is calibrated (stored or estimated since the boot).
+ * @todo Replace float data_type with gauss
+ */
+class task_magnetometer : public task_three_axis_sensor<float> {
+
+public:
+    /**
+     * @param calibrated Whether `calibration` was estimated for this magnetometer,
+     * and not the default one
+     */
+    explicit task_magnetometer(
+        emblib::three_axis_sensor<float>& magnetometer,
+        fifo_sensor<float>* fifo,
+        data_ready_interrupt* data_ready,
+        const monotonic_clock& clock,
+        matrix_t transform,
+        const sensor_calibration_s& calibration,
+        bool calibrated
+    );
+
+    /**
+     * Whether the samples are corrected by an estimated calibration
+     */
+    bool is_calibrated() const noexcept
+    {
+        return m_calibrated.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Axes covered by the running calibration
+     * @see mag_calibrator::get_covered
+     */
+    uint8_t get_calibration_progress() const noexcept
+    {
+        return m_calibration_progress.load(std::memory_order_relaxed);
+    }
+
+private:
+    vector_t process(const vector_t& raw_data) noexcept override;
+
+private:
+    matrix_t m_transform;
+
+    mag_calibrator m_calibrator;
+    bool m_calibrating = false;
+    std::atomic<bool> m_calibrated;
+    std::atomic<uint8_t> m_calibration_progress {0};
+};
+
+}
@@ -1,5 +1,7 @@
 #include "mp/util/constants.hpp"
 #include "task_state_estimator.hpp"
+#include "state/imu_preintegrator.hpp"
+#include "state/sensor_voter.hpp"
 #include "util/logger.hpp"
 #include <cmath>
 
@@ -8,33 +10,262 @@ namespace mp {
 // Conversion of the task period to floating point delta time
 inline constexpr float DT = std::chrono::duration<float>(TASK_STATE_PERIOD).count();
 
+// Longer gaps (a stalled task or sensor) are clamped so that
+// a single prediction step can not destabilize the estimator
+inline constexpr float MAX_DT = 5 * DT;
+
+// Measured time step clamped to a valid range
+static float get_dt(timestamp_t from, timestamp_t to) noexcept
+{
+    const float dt = to_seconds(to - from);
+    return dt < 0.f ? 0.f : (dt > MAX_DT ? MAX_DT : dt);
+}
+
+// Average of the buffered sensor samples
+template <typename sample_type>
+static vector3f get_mean(const sample_type* samples, size_t count) noexcept
+{
+    vector3f sum(0);
+    for (size_t i = 0; i < count; i++)
+        sum += samples[i].value;
+    return sum / static_cast<float>(count);
+}
+
+// Samples and votes of the redundant instances of one sensor
+template <typename task_type>
+struct instances_s {
+    // Available instances, and their index in `devices_s`
+    task_type* tasks[MAX_SENSOR_INSTANCES];
+    size_t device_index[MAX_SENSOR_INSTANCES];
+    size_t count = 0;
+
+    matrix3f cov[MAX_SENSOR_INSTANCES];
+    typename task_type::sample_s samples[MAX_SENSOR_INSTANCES][TASK_SENSOR_BUFFER_SIZE];
+    size_t sample_count[MAX_SENSOR_INSTANCES];
+    vector3f mean[MAX_SENSOR_INSTANCES];
+    bool valid[MAX_SENSOR_INSTANCES];
+
+    sensor_voter<MAX_SENSOR_INSTANCES> voter;
+    bool healthy[MAX_SENSOR_INSTANCES];
+
+    instances_s(const sensor_instances_s<task_type>& instances, float tolerance) noexcept :
+        voter({tolerance, TASK_STATE_VOTE_SMOOTHING, TASK_STATE_VOTE_MAX_MISSED}, instances.get_count())
+    {
+        for (size_t i = 0; i < MAX_SENSOR_INSTANCES; i++) {
+            if (!instances.tasks[i])
+                continue;
+            tasks[count] = instances.tasks[i];
+            device_index[count] = i;
+            // Assuming that sensor covariances won't change during runtime
+            cov[count] = instances.tasks[i]->get_noise_variance();
+            healthy[count] = true;
+            count++;
+        }
+    }
+
+    /**
+     * Read the samples of all instances and vote
+     * @returns Primary instance, `count` if there are no samples
+     */
+    size_t read(const char* name) noexcept
+    {
+        for (size_t i = 0; i < count; i++) {
+            sample_count[i] = tasks[i]->read_samples(samples[i], TASK_SENSOR_BUFFER_SIZE);
+            valid[i] = sample_count[i] > 0;
+            if (valid[i])
+                mean[i] = get_mean(samples[i], sample_count[i]);
+        }
+
+        const size_t primary = voter.update(mean, valid);
+        for (size_t i = 0; i < count; i++) {
+            if (voter.is_healthy(i) != healthy[i]) {
+                healthy[i] = voter.is_healthy(i);
+                if (healthy[i])
+                    log_info(name, " ", static_cast<int>(device_index[i]), " restored");
+                else
+                    log_warning(name, " ", static_cast<int>(device_index[i]), " dropped");
+            }
+        }
+        return primary;
+    }
+
+    /**
+     * Mean of the healthy instances, where the primary
+     * contributes `primary_mean` instead of its sample mean
+     * @returns Number of samples in the fused mean, 0 if there are none
+     */
+    size_t fuse(size_t primary, const vector3f& primary_mean, vector3f& fused, matrix3f& fused_cov) const noexcept
+    {
+        if (primary >= count)
+            return 0;
+
+        // Instances are assumed independent, so the variance of the
+        // mean of k means is the sum of their variances divided by k^2
+        fused = primary_mean;
+        fused_cov = cov[primary] / static_cast<float>(sample_count[primary]);
+        size_t instances = 1;
+        size_t samples = sample_count[primary];
+        for (size_t i = 0; i < count; i++) {
+            if (i == primary || !valid[i] || !voter.is_healthy(i))
+                continue;
+            fused += mean[i];
+            fused_cov = fused_cov + cov[i] / static_cast<float>(sample_count[i]);
+            instances++;
+            samples += sample_count[i];
+        }
+
+        const float k = static_cast<float>(instances);
+        fused = fused / k;
+        fused_cov = fused_cov / (k * k);
+        return samples;
+    }
+
+    void get_status(bool* status_healthy, float* status_metric) const noexcept
+    {
+        for (size_t i = 0; i < count; i++) {
+            status_healthy[device_index[i]] = voter.is_healthy(i);
+            status_metric[device_index[i]] = voter.get_metric(i);
+        }
+    }
+};
+
 void task_state_estimator::run() noexcept
 {
+    // Large, so kept static instead of on the task stack (there is a single estimator task)
+    static instances_s<task_accelerometer> accels(m_accelerometers, TASK_STATE_VOTE_ACCEL_TOL);
+    static instances_s<task_gyroscope> gyros(m_gyroscopes, TASK_STATE_VOTE_GYRO_TOL);
+
+    imu_preintegrator integrator;
+
     // Assuming that sensor covariances won't change during runtime
-    const matrix3f accel_cov = m_task_accel.get_noise_variance();
-    const matrix3f gyro_cov = m_task_gyro.get_noise_variance();
-    
+    const matrix3f mag_noise = m_magnetometer ? m_magnetometer->get_noise_variance() : matrix3f(0);
+
+    // Time up to which the estimator state has been predicted
+    timestamp_t state_time = m_clock.now();
+    timestamp_t last_wakeup = state_time;
+
+    // Estimated position at the GNSS origin, taken when the first solution arrives,
+    // so that GNSS positions continue the estimate instead of jumping to the origin
+    bool has_gnss_origin = false;
+    vector3f gnss_origin(0);
+    // Magnetometer was calibrated before the last read of its samples
+    bool mag_calibrated = false;
+
     while (true) {
-        // Get latest sensor measurements
-        vector3f a_read = m_task_accel.get_corrected();
-        vector3f w_read = m_task_gyro.get_corrected();
-        // TODO: Get rest of the sensors here
-        
+        // Samples of the primary instances are integrated
+        const size_t a_primary = accels.read("Accelerometer");
+        const size_t w_primary = gyros.read("Gyroscope");
+        const size_t a_count = a_primary < accels.count ? accels.sample_count[a_primary] : 0;
+        const size_t w_count = w_primary < gyros.count ? gyros.sample_count[w_primary] : 0;
+        const task_accelerometer::sample_s* a_samples = a_count ? accels.samples[a_primary] : nullptr;
+        const task_gyroscope::sample_s* w_samples = w_count ? gyros.samples[w_primary] : nullptr;
+
+        // All samples are integrated at the sensor rate, each gyroscope sample
+        // paired with the latest accelerometer sample not newer than it
+        integrator.reset();
+        size_t a_index = 0;
+        for (size_t i = 0; i < w_count; i++) {
+            const timestamp_t t = w_samples[i].timestamp;
+            while (a_index + 1 < a_count && a_samples[a_index + 1].timestamp <= t)
+                a_index++;
+
+            const vector3f a = a_count ? a_samples[a_index].value : vector3f(0);
+            integrator.integrate(w_samples[i].value, a, get_dt(state_time, t));
+            if (t > state_time)
+                state_time = t;
+        }
+
+        // Single prediction step with the increments, and if there are
+        // no samples a step without them so that the estimator time keeps up
+        const imu_delta_s delta = integrator.get_delta();
+        if (w_count) {
+            m_sample_age.record(m_clock.now() - w_samples[w_count - 1].timestamp);
+            m_state_estimator.predict(sensor_data_s {.imu_delta = &delta}, delta.dt);
+        } else {
+            const timestamp_t now = m_clock.now();
+            m_state_estimator.predict(sensor_data_s {}, get_dt(state_time, now));
+            state_time = now;
+        }
+
+        // Expensive correction once per period with the mean of all samples of
+        // the healthy instances, whose variance is the variance of a single sample
+        // divided by the count. Means of the primary instances over the interval
+        // come from the compensated increments if possible.
+        const bool has_delta = w_count && delta.dt > 0.f;
+        const vector3f a_primary_mean = has_delta && a_count ? delta.delta_velocity / delta.dt :
+            (a_count ? accels.mean[a_primary] : vector3f(0));
+        const vector3f w_primary_mean = has_delta ? delta.delta_angle / delta.dt :
+            (w_count ? gyros.mean[w_primary] : vector3f(0));
+
+        vector3f a_mean, w_mean;
+        matrix3f a_mean_cov, w_mean_cov;
+        const bool has_accel = accels.fuse(a_primary, a_primary_mean, a_mean, a_mean_cov) > 0;
+        const bool has_gyro = gyros.fuse(w_primary, w_primary_mean, w_mean, w_mean_cov) > 0;
+
+        // Slow sensors are passed only on the iterations where they have new samples
+        // Magnetometer samples are also taken before it is calibrated, so its buffer does not overflow.
+        // Samples read now were taken after the previous read, so they are only fused if the magnetometer
+        // was already calibrated before it (on the iteration it is calibrated the samples are mixed).
+        const bool mag_fused = mag_calibrated;
+        mag_calibrated = m_magnetometer && m_magnetometer->is_calibrated();
+        task_magnetometer::sample_s mag_samples[TASK_SENSOR_BUFFER_SIZE];
+        const size_t mag_read = m_magnetometer ? m_magnetometer->read_samples(mag_samples, TASK_SENSOR_BUFFER_SIZE) : 0;
+        const size_t mag_count = mag_fused ? mag_read : 0;
+        const vector3f mag_mean = mag_count ? get_mean(mag_samples, mag_count) : vector3f(0);
+        const matrix3f mag_mean_cov = mag_count ? mag_noise / static_cast<float>(mag_count) : matrix3f(0);
+
+        // Only the newest GNSS solution is used, since consecutive ones are correlated
+        task_gnss::sample_s gnss_samples[TASK_GNSS_BUFFER_SIZE];
+        const size_t gnss_count = m_gnss ? m_gnss->read_samples(gnss_samples, TASK_GNSS_BUFFER_SIZE) : 0;
+        const task_gnss::sample_s* gnss = gnss_count ? &gnss_samples[gnss_count - 1] : nullptr;
+        if (gnss && !has_gnss_origin) {
+            gnss_origin = m_state_estimator.get_state().position - gnss->position;
+            has_gnss_origin = true;
+        }
+        const vector3f gnss_position = gnss ? gnss->position + gnss_origin : vector3f(0);
+
+        task_barometer::sample_s baro_samples[TASK_BARO_BUFFER_SIZE];
+        const size_t baro_count = m_barometer ? m_barometer->read_samples(baro_samples, TASK_BARO_BUFFER_SIZE) : 0;
+        float altitude = 0.f, altitude_var = 0.f;
+        for (size_t i = 0; i < baro_count; i++) {
+            altitude += baro_samples[i].altitude / static_cast<float>(baro_count);
+            altitude_var += baro_samples[i].variance / static_cast<float>(baro_count * baro_count);
+        }
+
         sensor_data_s sensor_data {
-            .accelerometer = &a_read,
-            .accelerometer_cov = &accel_cov,
-            .gyroscope = &w_read,
-            .gyroscope_cov = &gyro_cov
+            .accelerometer = has_accel ? &a_mean : nullptr,
+            .accelerometer_cov = has_accel ? &a_mean_cov : nullptr,
+            .gyroscope = has_gyro ? &w_mean : nullptr,
+            .gyroscope_cov = has_gyro ? &w_mean_cov : nullptr,
+            .magnetometer = mag_count ? &mag_mean : nullptr,
+            .magnetometer_cov = mag_count ? &mag_mean_cov : nullptr,
+            .gnss = gnss ? &gnss_position : nullptr,
+            .gnss_cov = gnss ? &gnss->position_cov : nullptr,
+            .gnss_velocity = gnss ? &gnss->velocity : nullptr,
+            .gnss_velocity_cov = gnss ? &gnss->velocity_cov : nullptr,
+            .barometer = baro_count ? &altitude : nullptr,
+            .barometer_var = baro_count ? &altitude_var : nullptr
         };
-        m_state_estimator.update(sensor_data, DT);
+        m_state_estimator.correct(sensor_data);
+
+        // Publish the estimator state to the readers
+        state_s state = m_state_estimator.get_state();
+        state.timestamp = state_time;
+        m_state.write(state);
+        if (m_recorder)
+            m_recorder->push(state);
 
-        // Assign the estimator state to the readable state struct
-        m_state_mutex.lock();
-        m_state = m_state_estimator.get_state();
-        m_state_mutex.unlock();
+        voting_status_s status;
+        accels.get_status(status.accelerometer_healthy, status.accelerometer_metric);
+        gyros.get_status(status.gyroscope_healthy, status.gyroscope_metric);
+        m_voting_status.write(status);
 
         sleep_periodic(TASK_STATE_PERIOD);
+
+        const timestamp_t wakeup = m_clock.now();
+        m_period_stats.record(wakeup - last_wakeup);
+        last_wakeup = wakeup;
     }
 }
 
-}
\ No newline at end of file
+}
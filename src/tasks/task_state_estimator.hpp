@@ -4,37 +4,115 @@
 #include "state/state_estimator.hpp"
 #include "tasks/task_accelerometer.hpp"
 #include "tasks/task_gyroscope.hpp"
-#include "emblib/rtos/mutex.hpp"
+#include "tasks/task_magnetometer.hpp"
+#include "tasks/task_gnss.hpp"
+#include "tasks/task_barometer.hpp"
+#include "tasks/sensor_instances.hpp"
+#include "util/seqlock.hpp"
+#include "util/period_stats.hpp"
+#include "util/latency_histogram.hpp"
+#include "blackbox/blackbox.hpp"
 #include "emblib/rtos/task.hpp"
 
 namespace mp {
 
 /**
  * Task responsible for getting the sensor data and estimating the model state
+ * 
+ * Pre-integrates all IMU samples buffered since the last iteration (with
+ * coning and sculling compensation), and runs a single prediction step with
+ * the increments and a correction step once per task period. Integration
+ * uses the measured time between the sample timestamps, so the estimate
+ * stays correct when the task (or a sensor task) misses its period.
+ *
+ * With redundant IMUs, the instances of each sensor are voted on every
+ * iteration (see `sensor_voter`). Samples of the primary (first healthy)
+ * instance are integrated, and the correction uses the mean of all healthy
+ * instances, so a failing or stalled sensor is dropped without a gap.
+ *
+ * Magnetometer, GNSS and barometer samples are passed to the correction
+ * only on the iterations where their (slower) tasks produced new samples.
+ * The estimate starts at the origin, which is also the barometer origin (the
+ * starting point). The GNSS origin is the first fix, which may come after the
+ * vehicle moved, so it is placed at the position estimated when it arrives.
  */
 class task_state_estimator : public emblib::task {
 
 public:
+    /**
+     * Voting result of each sensor instance, in the `devices_s` order
+     */
+    struct voting_status_s {
+        bool accelerometer_healthy[MAX_SENSOR_INSTANCES] = {};
+        float accelerometer_metric[MAX_SENSOR_INSTANCES] = {};
+        bool gyroscope_healthy[MAX_SENSOR_INSTANCES] = {};
+        float gyroscope_metric[MAX_SENSOR_INSTANCES] = {};
+    };
+
     // TODO: Add an initial state parameter
+    /**
+     * @param magnetometer Optional, `nullptr` if not available (same for `gnss` and `barometer`)
+     */
     explicit task_state_estimator(
         state_estimator& state_estimator,
-        task_accelerometer& task_accel,
-        task_gyroscope& task_gyro
+        const sensor_instances_s<task_accelerometer>& accelerometers,
+        const sensor_instances_s<task_gyroscope>& gyroscopes,
+        task_magnetometer* magnetometer,
+        task_gnss* gnss,
+        task_barometer* barometer,
+        const monotonic_clock& clock
     ) noexcept :
         task("Task state estimator", TASK_STATE_PRIORITY, m_task_stack),
         m_state_estimator(state_estimator),
-        m_task_accel(task_accel),
-        m_task_gyro(task_gyro)
+        m_accelerometers(accelerometers),
+        m_gyroscopes(gyroscopes),
+        m_magnetometer(magnetometer),
+        m_gnss(gnss),
+        m_barometer(barometer),
+        m_clock(clock),
+        m_period_stats(std::chrono::duration_cast<timestamp_t>(TASK_STATE_PERIOD))
     {}
 
     /**
      * Get the current state
      * @todo Maybe return as reference
      */
-    state_s get_state() noexcept
+    state_s get_state() const noexcept
+    {
+        return m_state.read();
+    }
+
+    /**
+     * Health and consistency of the redundant sensor instances
+     */
+    voting_status_s get_voting_status() const noexcept
     {
-        emblib::scoped_lock lock(m_state_mutex);
-        return m_state;
+        return m_voting_status.read();
+    }
+
+    /**
+     * Age of the newest gyroscope sample when the prediction step runs
+     */
+    latency_histogram_s get_sample_age() const noexcept
+    {
+        return m_sample_age.get();
+    }
+
+    /**
+     * Statistics of the measured task period
+     */
+    period_stats_s get_period_stats() const noexcept
+    {
+        return m_period_stats.get();
+    }
+
+    /**
+     * Record every published state to the blackbox through `channel`
+     * @note Must be set before the scheduler starts
+     */
+    void set_recorder(blackbox_state_channel* channel) noexcept
+    {
+        m_recorder = channel;
     }
 
 private:
@@ -46,12 +124,21 @@ private:
 private:
     emblib::task_stack_t<TASK_STATE_STACK_SIZE> m_task_stack;
 
-    state_s m_state;
+    seqlock<state_s> m_state;
     state_estimator& m_state_estimator;
-    emblib::mutex m_state_mutex;
     
-    task_accelerometer& m_task_accel;
-    task_gyroscope& m_task_gyro;
+    sensor_instances_s<task_accelerometer> m_accelerometers;
+    sensor_instances_s<task_gyroscope> m_gyroscopes;
+    seqlock<voting_status_s> m_voting_status;
+
+    task_magnetometer* m_magnetometer;
+    task_gnss* m_gnss;
+    task_barometer* m_barometer;
+
+    const monotonic_clock& m_clock;
+    period_stats m_period_stats;
+    latency_histogram m_sample_age;
+    blackbox_state_channel* m_recorder = nullptr;
 };
 
 }
\ No newline at end of file
@@ -1,54 +1,198 @@
 #include "task_telemetry.hpp"
 #include "util/pb_types.hpp"
+#include "util/crc8.hpp"
+#include "util/logger.hpp"
 #include "pb/telemetry.pb.h"
+#include <algorithm>
 
 namespace mp {
 
 
-void task_telemetry::run() noexcept
+bool task_telemetry::handle_command(const pb::Command& command) noexcept
 {
-    // This doesn't have to be an assert
-    // Can just exit and turn off the telemetry task
-    assert(m_telemetry_device.probe(emblib::milliseconds(0)));
+    if (command.has_telemetry_ack()) {
+        m_acknowledged_id.store(static_cast<int>(command.telemetry_ack().keyframe()), std::memory_order_relaxed);
+        return true;
+    }
 
-    while (true) {
-        pb::TelemetryMessage* msg = m_arena.Create<pb::TelemetryMessage>(&m_arena);
+    if (command.has_telemetry_rate()) {
+        const size_t stream = command.telemetry_rate().stream();
+        if (stream >= TELEMETRY_STREAM_COUNT) {
+            return false;
+        }
+        m_requested_rates[stream].store(command.telemetry_rate().rate(), std::memory_order_relaxed);
+        return true;
+    }
 
-        // State data
-        state_s state = m_task_state.get_state();
+    return false;
+}
+
+void task_telemetry::apply_commands() noexcept
+{
+    const int acknowledged_id = m_acknowledged_id.exchange(-1, std::memory_order_relaxed);
+    if (acknowledged_id >= 0) {
+        m_encoder.acknowledge(static_cast<uint8_t>(acknowledged_id));
+    }
+
+    for (size_t i = 0; i < TELEMETRY_STREAM_COUNT; i++) {
+        const float rate = m_requested_rates[i].exchange(NAN, std::memory_order_relaxed);
+        if (!std::isnan(rate)) {
+            m_scheduler.set_rate(static_cast<telemetry_stream_e>(i), rate);
+            log_info("Telemetry stream ", static_cast<int>(i), " rate: ", m_scheduler.get_rate(static_cast<telemetry_stream_e>(i)));
+        }
+    }
+}
+
+size_t task_telemetry::serialize_message(telemetry_stream_e stream) noexcept
+{
+    pb::TelemetryMessage* msg = m_arena.Create<pb::TelemetryMessage>(&m_arena);
+
+    switch (stream) {
+    case TELEMETRY_STREAM_ATTITUDE: {
+        const state_s state = m_task_state.get_state();
+        set_pb_vector4f(msg->mutable_state()->mutable_rotation(), state.rotationq.as_vector());
+        set_pb_vector3f(msg->mutable_state()->mutable_angular_velocity(), state.angular_velocity);
+        break;
+    }
+    case TELEMETRY_STREAM_POSITION: {
+        const state_s state = m_task_state.get_state();
         set_pb_vector3f(msg->mutable_state()->mutable_position(), state.position);
         set_pb_vector3f(msg->mutable_state()->mutable_velocity(), state.velocity);
         set_pb_vector3f(msg->mutable_state()->mutable_acceleration(), state.acceleration);
-        set_pb_vector3f(msg->mutable_state()->mutable_angular_velocity(), state.angular_velocity);
-        set_pb_vector4f(msg->mutable_state()->mutable_rotation(), state.rotationq.as_vector());
-        
-        // Sensor data
-        set_pb_vector3f(msg->mutable_sensor_data()->mutable_acc_raw(), m_task_accel.get_raw());
-        set_pb_vector3f(msg->mutable_sensor_data()->mutable_acc_corrected(), m_task_accel.get_corrected());
-        set_pb_vector3f(msg->mutable_sensor_data()->mutable_gyro_raw(), m_task_gyro.get_raw());
-        set_pb_vector3f(msg->mutable_sensor_data()->mutable_gyro_corrected(), m_task_gyro.get_corrected());
-
-        // TODO: Send vehicle specific telemetry here
-
-        // Try to serialize, if successful, transmit
-        if (msg->SerializeToArray(m_out_msg_buffer, sizeof(m_out_msg_buffer))) {
-            size_t msg_size = msg->ByteSizeLong();
-
-            if (m_telemetry_device.is_async_available()) {
-                m_telemetry_device.write_async(m_out_msg_buffer, msg_size, [this](ssize_t status) {
-                    notify_from_isr();
-                });
-                // TODO: FIX: Only wait for notification if write_async started correctly (returned true)
-                wait_notification();
-            } else {
-                m_telemetry_device.write(m_out_msg_buffer, msg_size);
-            }
+        break;
+    }
+    case TELEMETRY_STREAM_SENSORS: {
+        const auto accel = m_task_accel.get_reading();
+        const auto gyro = m_task_gyro.get_reading();
+        set_pb_vector3f(msg->mutable_sensor_data()->mutable_acc_raw(), accel.raw);
+        set_pb_vector3f(msg->mutable_sensor_data()->mutable_acc_corrected(), accel.corrected);
+        set_pb_vector3f(msg->mutable_sensor_data()->mutable_gyro_raw(), gyro.raw);
+        set_pb_vector3f(msg->mutable_sensor_data()->mutable_gyro_corrected(), gyro.corrected);
+        break;
+    }
+    case TELEMETRY_STREAM_VEHICLE:
+        if (!m_vehicle.get_telemetry(m_task_vehicle.get_actuation(), *msg)) {
+            m_arena.Reset();
+            return 0;
         }
+        break;
+    case TELEMETRY_STREAM_ESTIMATOR: {
+        const period_stats_s period = m_task_state.get_period_stats();
+        const latency_histogram_s sample_age = m_task_state.get_sample_age();
+        const task_state_estimator::voting_status_s voting = m_task_state.get_voting_status();
 
-        // Clear the protobuf allocation buffer
+        pb::TelemetryEstimator* estimator = msg->mutable_estimator();
+        estimator->set_period_mean(to_seconds(period.get_mean()));
+        estimator->set_period_max(to_seconds(period.max));
+        estimator->set_overruns(period.overruns);
+        estimator->set_sample_age_mean(to_seconds(sample_age.get_mean()));
+        estimator->set_sample_age_max(to_seconds(sample_age.max));
+
+        uint32_t accelerometers = 0, gyroscopes = 0;
+        for (size_t i = 0; i < MAX_SENSOR_INSTANCES; i++) {
+            accelerometers |= voting.accelerometer_healthy[i] ? 1u << i : 0u;
+            gyroscopes |= voting.gyroscope_healthy[i] ? 1u << i : 0u;
+        }
+        estimator->set_accelerometers_healthy(accelerometers);
+        estimator->set_gyroscopes_healthy(gyroscopes);
+        break;
+    }
+    default:
         m_arena.Reset();
+        return 0;
+    }
+
+    // Payload size has to fit the single size byte of the frame
+    uint8_t* frame = reinterpret_cast<uint8_t*>(m_out_msg_buffer);
+    const size_t max_size = std::min<size_t>(sizeof(m_out_msg_buffer) - MESSAGE_HEADER_SIZE - MESSAGE_CRC_SIZE, UINT8_MAX);
+    size_t frame_size = 0;
+    if (msg->SerializeToArray(frame + MESSAGE_HEADER_SIZE, max_size)) {
+        const size_t msg_size = msg->ByteSizeLong();
+        frame[0] = MESSAGE_SYNC;
+        frame[1] = static_cast<uint8_t>(msg_size);
+        frame[2] = static_cast<uint8_t>(stream);
+        frame[MESSAGE_HEADER_SIZE + msg_size] = crc8(frame + 1, MESSAGE_HEADER_SIZE - 1 + msg_size);
+        frame_size = MESSAGE_HEADER_SIZE + msg_size + MESSAGE_CRC_SIZE;
+    }
+
+    // Clear the protobuf allocation buffer
+    m_arena.Reset();
+    return frame_size;
+}
+
+size_t task_telemetry::encode_frame(const uint8_t*& data) noexcept
+{
+    const state_s state = m_task_state.get_state();
+    const auto accel = m_task_accel.get_reading();
+    const auto gyro = m_task_gyro.get_reading();
+    const telemetry_frame_s frame {
+        .timestamp = state.timestamp,
+        .position = state.position,
+        .velocity = state.velocity,
+        .acceleration = state.acceleration,
+        .rotation = state.rotationq.as_vector(),
+        .angular_velocity = state.angular_velocity,
+        .acc_raw = accel.raw,
+        .acc_corrected = accel.corrected,
+        .gyro_raw = gyro.raw,
+        .gyro_corrected = gyro.corrected
+    };
+
+    // Sensor values have their own stream, so they are only in the keyframes
+    return m_encoder.encode(frame, false, data);
+}
+
+size_t task_telemetry::send(telemetry_stream_e stream) noexcept
+{
+    const char* data = m_out_msg_buffer;
+    size_t size;
+    if (stream == TELEMETRY_STREAM_STATE) {
+        const uint8_t* frame;
+        size = encode_frame(frame);
+        data = reinterpret_cast<const char*>(frame);
+    } else {
+        size = serialize_message(stream);
+    }
+
+    if (size == 0)
+        return 0;
+
+    // Message is written synchronously if the async write could not be started
+    m_write_done.store(false, std::memory_order_relaxed);
+    const bool started = m_use_async && m_telemetry_device.write_async(data, size, [this](ssize_t status) {
+        m_write_done.store(true, std::memory_order_release);
+        notify_from_isr();
+    });
+    if (!started) {
+        m_telemetry_device.write(data, size, emblib::milliseconds(0));
+    }
+
+    // Stale notifications of an earlier write are skipped, a write which does not complete
+    // in time is abandoned and the device is then only written synchronously
+    while (started && !m_write_done.load(std::memory_order_acquire)) {
+        if (!wait_notification(TASK_TELEMETRY_WRITE_TIMEOUT)) {
+            m_use_async = false;
+            break;
+        }
+    }
+    return size;
+}
+
+void task_telemetry::run() noexcept
+{
+    // This doesn't have to be an assert
+    // Can just exit and turn off the telemetry task
+    assert(m_telemetry_device.probe(emblib::milliseconds(0)));
+    m_use_async = m_telemetry_device.is_async_available();
+
+    while (true) {
+        apply_commands();
+        m_scheduler.run_window([this](telemetry_stream_e stream) {
+            return send(stream);
+        });
+
         sleep_periodic(TASK_TELEMETRY_PERIOD);
     }
 }
 
-}
\ No newline at end of file
+}
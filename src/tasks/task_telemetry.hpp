@@ -4,37 +4,100 @@
 #include "task_accelerometer.hpp"
 #include "task_gyroscope.hpp"
 #include "task_state_estimator.hpp"
+#include "task_vehicle.hpp"
+#include "vehicles/vehicle.hpp"
 #include "emblib/driver/io/char_dev.hpp"
 #include "emblib/rtos/task.hpp"
 #include "emblib/rtos/queue.hpp"
+#include "telemetry/telemetry_encoder.hpp"
+#include "telemetry/telemetry_scheduler.hpp"
 #include "pb/telemetry.pb.h"
+#include "pb/command.pb.h"
+#include <atomic>
+#include <cmath>
 
 namespace mp {
 
+/**
+ * Task sending the telemetry streams (see `telemetry_stream_e`)
+ *
+ * Every `TASK_TELEMETRY_PERIOD` the scheduler picks the due streams which
+ * fit the byte budget of the link (see `telemetry_scheduler`). The state
+ * stream is sent as compact frames (see `telemetry_encoder`), the other
+ * streams as protobuf `TelemetryMessage`s with only the fields of the stream,
+ * each in a frame of `MESSAGE_SYNC`, the payload size, the stream, the
+ * payload and the CRC-8 of everything after the sync byte.
+ *
+ * Compact keyframes acknowledged by the receiver and stream rate changes
+ * are passed in through `handle_command`.
+ */
 class task_telemetry : public emblib::task {
 
 public:
+    static constexpr uint8_t MESSAGE_SYNC = 0xA8;
+    static constexpr size_t MESSAGE_HEADER_SIZE = 3;
+    static constexpr size_t MESSAGE_CRC_SIZE = 1;
+
     explicit task_telemetry(
         emblib::char_dev& telemetry_device,
         task_accelerometer& task_accelerometer,
         task_gyroscope& task_gyroscope,
-        task_state_estimator& task_state_estimator
+        task_state_estimator& task_state_estimator,
+        task_vehicle& task_vehicle,
+        const vehicle& vehicle
     ) :
         task("Task telemetry", TASK_TELEMETRY_PRIORITY, m_task_stack),
         m_telemetry_device(telemetry_device),
         m_task_accel(task_accelerometer),
         m_task_gyro(task_gyroscope),
         m_task_state(task_state_estimator),
+        m_task_vehicle(task_vehicle),
+        m_vehicle(vehicle),
         m_arena(google::protobuf::ArenaOptions {
             .max_block_size = TASK_TELEMETRY_ARENA_SIZE,
             .initial_block = m_arena_buffer,
             .initial_block_size = TASK_TELEMETRY_ARENA_SIZE
-        })
-    {}
+        }),
+        m_encoder(TASK_TELEMETRY_RESOLUTION, TASK_TELEMETRY_KEY_INTERVAL, TASK_TELEMETRY_KEY_MAX_AGE, TASK_TELEMETRY_BATCH),
+        m_scheduler(TASK_TELEMETRY_STREAMS, TASK_TELEMETRY_BUDGET, TASK_TELEMETRY_BURST,
+            std::chrono::duration_cast<timestamp_t>(TASK_TELEMETRY_PERIOD))
+    {
+        for (std::atomic<float>& rate : m_requested_rates)
+            rate.store(NAN, std::memory_order_relaxed);
+    }
+
+    /**
+     * Handle the telemetry commands, called from the task which receives the commands
+     * @returns false if the command is not a telemetry command
+     */
+    bool handle_command(const pb::Command& command) noexcept;
 
 private:
     void run() noexcept override;
 
+    /**
+     * Send a message of the stream
+     * @returns Number of bytes sent, 0 if there was nothing to send
+     */
+    size_t send(telemetry_stream_e stream) noexcept;
+
+    /**
+     * Serialize a protobuf stream message into a frame in `m_out_msg_buffer`
+     * @returns Size of the frame, 0 if the message didn't fit
+     */
+    size_t serialize_message(telemetry_stream_e stream) noexcept;
+
+    /**
+     * Encode the state into a compact frame
+     * @returns Size of the frame at `data`
+     */
+    size_t encode_frame(const uint8_t*& data) noexcept;
+
+    /**
+     * Apply the acknowledgements and rate changes received since the last window
+     */
+    void apply_commands() noexcept;
+
 private:
     emblib::task_stack_t<TASK_TELEMETRY_STACK_SIZE> m_task_stack;
     emblib::char_dev& m_telemetry_device;
@@ -42,11 +105,21 @@ private:
     task_accelerometer& m_task_accel;
     task_gyroscope& m_task_gyro;
     task_state_estimator& m_task_state;
+    task_vehicle& m_task_vehicle;
+    const vehicle& m_vehicle;
 
     char m_arena_buffer[TASK_TELEMETRY_ARENA_SIZE];
     char m_out_msg_buffer[TASK_TELEMETRY_ARENA_SIZE];
     google::protobuf::Arena m_arena;
 
+    telemetry_encoder m_encoder;
+    telemetry_scheduler m_scheduler;
+    bool m_use_async = false;
+    std::atomic<bool> m_write_done = false;
+    // Newest acknowledged keyframe id, negative if none since the last frame
+    std::atomic<int> m_acknowledged_id {-1};
+    // Stream rates requested by command, NAN if unchanged since the last window
+    std::atomic<float> m_requested_rates[TELEMETRY_STREAM_COUNT];
 };
 
-}
\ No newline at end of file
+}
@@ -2,16 +2,49 @@
 
 #include "task_config.hpp"
 #include "mp/util/math.hpp"
+#include "mp/drivers/clock.hpp"
+#include "mp/drivers/fifo_sensor.hpp"
+#include "mp/drivers/data_ready.hpp"
 #include "util/logger.hpp"
+#include "util/ring_buffer.hpp"
+#include "util/seqlock.hpp"
+#include "util/period_stats.hpp"
+#include "util/latency_histogram.hpp"
+#include "util/biquad.hpp"
+#include "calibration/sensor_calibration.hpp"
+#include "blackbox/blackbox.hpp"
 #include "emblib/driver/sensor/three_axis_sensor.hpp"
 #include "emblib/rtos/task.hpp"
-#include "emblib/rtos/mutex.hpp"
+#include <atomic>
 
 namespace mp {
 
 /**
  * Template task for reading three axis sensors
- * Allows for raw data correction through the `process` method
+ * Allows for raw data correction through the `process` method, after
+ * which the sample goes through a chain of biquad filters
+ * 
+ * Every corrected sample is also pushed into a buffer so that a slower
+ * consumer (state estimator) can process all samples since its last read
+ *
+ * If the sensor has a hardware FIFO, every wakeup reads all the samples
+ * buffered by the sensor in bursts, so the sensor can sample much faster
+ * than the task runs. Each sample is timestamped, and the samples from
+ * a burst are spaced by the sensor sample period back from the read time.
+ *
+ * If the sensor has a data-ready interrupt, the task sleeps until the
+ * interrupt instead of a fixed period, so samples are read as soon as they
+ * are available and the task does not wake without data. Interrupt time is
+ * then also the sample timestamp (without a FIFO). The latency from the
+ * interrupt to the published sample is recorded in both modes.
+ *
+ * If a blackbox channel is set, the raw and corrected value of every
+ * sample is also pushed into it for recording.
+ *
+ * Sensor calibration is applied by the `process` implementation, which
+ * can also estimate a new one from the raw samples when requested. A new
+ * calibration is published with an incremented version, so a lower priority
+ * task can detect it and store it.
  */
 template <typename data_type>
 class task_three_axis_sensor : public emblib::task {
@@ -20,33 +53,160 @@ public:
     using vector_t = vector<data_type, 3>;
     using matrix_t = matrix<data_type, 3>;
 
+    /**
+     * Corrected sample and the time it was taken
+     */
+    struct sample_s {
+        vector_t value;
+        timestamp_t timestamp;
+    };
+
+    /**
+     * Last raw value and its corrected value
+     */
+    struct reading_s {
+        vector_t raw;
+        vector_t corrected;
+    };
+
+    /**
+     * @param fifo Optional FIFO interface of the same sensor,
+     * if `nullptr` one sample is read per task period
+     * @param data_ready Optional data-ready interrupt of the same sensor,
+     * the task period is then the timeout for a missed interrupt
+     * @param calibration Calibration to start with, usually the stored one
+     * @param filters Filters designed for the sensor sample rate, applied in order
+     */
+    template <size_t FILTER_COUNT>
     explicit task_three_axis_sensor(
         emblib::three_axis_sensor<data_type>& sensor,
+        fifo_sensor<data_type>* fifo,
+        data_ready_interrupt* data_ready,
+        const monotonic_clock& clock,
+        const sensor_calibration_s& calibration,
+        const biquad_spec_s (&filters)[FILTER_COUNT],
         const char* task_name,
         task_priority_e task_priority,
         emblib::ticks_t task_period
     ) :
         task(task_name, task_priority, m_task_stack),
         m_sensor(sensor),
-        m_task_period(task_period)
-    {}
+        m_fifo(fifo),
+        m_data_ready(data_ready),
+        m_clock(clock),
+        m_task_period(task_period),
+        m_period_stats(std::chrono::duration_cast<timestamp_t>(task_period)),
+        m_calibration(calibration),
+        m_published_calibration(calibration)
+    {
+        static_assert(FILTER_COUNT <= TASK_SENSOR_MAX_FILTERS);
+        const float fs = 1.f / std::chrono::duration<float>(get_sample_period()).count();
+        if (m_filter.configure(filters, FILTER_COUNT, fs) != FILTER_COUNT)
+            log_warning("Sensor filter above the Nyquist frequency skipped");
+    }
+
+    /**
+     * Get last read raw value and its corrected value together
+     */
+    reading_s get_reading() const noexcept
+    {
+        return m_last_reading.read();
+    }
 
     /**
      * Get last read raw value
      */
-    vector_t get_raw() noexcept
+    vector_t get_raw() const noexcept
     {
-        emblib::scoped_lock lock{m_read_mutex};
-        return m_last_raw;
+        return m_last_reading.read().raw;
     }
 
     /**
      * Get last corrected value
      */
-    vector_t get_corrected() noexcept
+    vector_t get_corrected() const noexcept
+    {
+        return m_last_reading.read().corrected;
+    }
+
+    /**
+     * Move all corrected samples since the last call into `samples`
+     * @returns Number of samples read
+     * @note Must only be called from a single task
+     */
+    size_t read_samples(sample_s* samples, size_t max_count) noexcept
+    {
+        return m_samples.pop_all(samples, max_count);
+    }
+
+    /**
+     * Sampling period of the sensor task
+     */
+    emblib::ticks_t get_period() const noexcept
+    {
+        return m_task_period;
+    }
+
+    /**
+     * Statistics of the measured task period
+     */
+    period_stats_s get_period_stats() const noexcept
+    {
+        return m_period_stats.get();
+    }
+
+    /**
+     * Latency from the data-ready interrupt until the sample is published,
+     * empty if the sensor has no data-ready interrupt
+     */
+    latency_histogram_s get_latency() const noexcept
+    {
+        return m_latency.get();
+    }
+
+    /**
+     * Record every sample to the blackbox through `channel`
+     * @note Must be set before the scheduler starts
+     */
+    void set_recorder(blackbox_sensor_channel* channel) noexcept
+    {
+        m_recorder = channel;
+    }
+
+    /**
+     * Request a new calibration, started with the next sample
+     */
+    void start_calibration() noexcept
     {
-        emblib::scoped_lock lock{m_read_mutex};
-        return m_last_corrected;
+        m_calibration_requested.store(true, std::memory_order_relaxed);
+    }
+
+    /**
+     * Calibration currently applied to the samples
+     */
+    sensor_calibration_s get_calibration() const noexcept
+    {
+        return m_published_calibration.read();
+    }
+
+    /**
+     * Number of calibrations set since the task was created,
+     * changes whenever a new calibration is available
+     */
+    uint32_t get_calibration_version() const noexcept
+    {
+        return m_calibration_version.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Sampling period of the sensor, which is the
+     * task period if the sensor FIFO is not used
+     */
+    timestamp_t get_sample_period() const noexcept
+    {
+        if (m_fifo)
+            return m_fifo->get_sample_period();
+        return std::chrono::duration_cast<timestamp_t>(m_task_period);
     }
 
     /**
@@ -58,36 +218,108 @@ public:
      */
     matrix3f get_noise_variance() const noexcept
     {
-        // TODO: Change this to sensor output data rate
-        float fs = 1.f / std::chrono::duration<float>(m_task_period).count();
+        float fs = 1.f / std::chrono::duration<float>(get_sample_period()).count();
 
         float noise_density = m_sensor.get_noise_density();
         float noise_variance = fs * noise_density * noise_density;
         return matrix3f::diagonal(noise_variance);
     }
 
-    /// @todo Add calculate_bias method
+protected:
+    /**
+     * Calibration to apply in `process`
+     */
+    const sensor_calibration_s& get_active_calibration() const noexcept
+    {
+        return m_calibration;
+    }
+
+    /**
+     * Apply and publish a new calibration
+     * @note Must only be called from `process`
+     */
+    void set_calibration(const sensor_calibration_s& calibration) noexcept
+    {
+        // Filters start again from the next sample, so their state
+        // does not carry the samples corrected by the old calibration
+        m_filter_started = false;
+        m_calibration = calibration;
+        m_published_calibration.write(calibration);
+        m_calibration_version.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * @returns true once for every `start_calibration` call
+     */
+    bool take_calibration_request() noexcept
+    {
+        return m_calibration_requested.exchange(false, std::memory_order_relaxed);
+    }
 
 private:
     /**
      * Apply processing to the raw input value
-     * This can be a filter, bias subtraction, ...
+     * This can be calibration, estimation of the calibration, filtering, ...
      */
-    virtual vector_t process(const vector_t& raw_data) const noexcept = 0;
+    virtual vector_t process(const vector_t& raw_data) noexcept = 0;
 
     /**
      * Task thread
      */
     void run() noexcept override;
 
+    /**
+     * Data-ready interrupt handler
+     */
+    void on_data_ready() noexcept
+    {
+        m_ready_time.store(m_clock.now().count(), std::memory_order_release);
+        if (m_wake_on_ready.load(std::memory_order_relaxed))
+            notify_from_isr();
+    }
+
+    /**
+     * Read a single sample with `read_all_axes`
+     */
+    void read_single(timestamp_t timestamp) noexcept;
+
+    /**
+     * Read all samples buffered in the sensor FIFO
+     */
+    void read_fifo() noexcept;
+
+    /**
+     * Process a raw sample and publish it
+     */
+    void publish(const data_type (&raw)[3], timestamp_t timestamp) noexcept;
+
 private:
-    emblib::task_stack_t<512> m_task_stack;
+    emblib::task_stack_t<TASK_SENSOR_STACK_SIZE> m_task_stack;
     emblib::ticks_t m_task_period;
     emblib::three_axis_sensor<data_type>& m_sensor;
+    fifo_sensor<data_type>* m_fifo;
+    data_ready_interrupt* m_data_ready;
+    const monotonic_clock& m_clock;
+
+    // Time of the last data-ready interrupt in microseconds, written by the interrupt
+    std::atomic<int64_t> m_ready_time {-1};
+    std::atomic<bool> m_wake_on_ready {false};
+    latency_histogram m_latency;
     
-    emblib::mutex m_read_mutex;
-    vector_t m_last_raw;
-    vector_t m_last_corrected;
+    seqlock<reading_s> m_last_reading;
+    period_stats m_period_stats;
+
+    // Only accessed by this task
+    biquad_chain<TASK_SENSOR_MAX_FILTERS> m_filter;
+    bool m_filter_started = false;
+    sensor_calibration_s m_calibration;
+
+    seqlock<sensor_calibration_s> m_published_calibration;
+    std::atomic<uint32_t> m_calibration_version {0};
+    std::atomic<bool> m_calibration_requested {false};
+
+    ring_buffer<sample_s, TASK_SENSOR_BUFFER_SIZE> m_samples;
+    blackbox_sensor_channel* m_recorder = nullptr;
 };
 
 /**
@@ -100,19 +332,114 @@ inline void task_three_axis_sensor<data_type>::run() noexcept
     // so assert that the sensor is actually working
     assert(m_sensor.probe());
 
-    data_type read_data[3];
+    // Interrupt is enabled even if the task stays periodic, so that
+    // the latency of both modes can be measured and compared
+    if (m_data_ready) {
+        m_wake_on_ready.store(TASK_SENSOR_WAKE_ON_READY, std::memory_order_relaxed);
+        if (!m_data_ready->enable_data_ready([this]() { on_data_ready(); })) {
+            log_warning("Sensor data-ready interrupt not available");
+            m_wake_on_ready.store(false, std::memory_order_relaxed);
+            m_data_ready = nullptr;
+        }
+    }
+
+    int64_t last_ready = -1;
+    bool timed_out = false;
+    timestamp_t last_wakeup = m_clock.now();
     while (true) {
-        if (m_sensor.read_all_axes(read_data)) {
-            emblib::scoped_lock lock(m_read_mutex);
-            m_last_raw = vector_t {read_data[0], read_data[1], read_data[2]};
-            m_last_corrected = process(m_last_raw);
+        // Taken before the read, so an interrupt during the read
+        // is left for the next iteration (its sample was not read yet)
+        const int64_t ready = m_ready_time.load(std::memory_order_acquire);
+        const bool new_ready = ready >= 0 && ready != last_ready;
+
+        if (m_fifo)
+            read_fifo();
+        else
+            read_single(new_ready ? timestamp_t(ready) : m_clock.now());
+
+        if (new_ready) {
+            m_latency.record(m_clock.now() - timestamp_t(ready));
+            last_ready = ready;
+        }
+
+        if (m_wake_on_ready.load(std::memory_order_relaxed)) {
+            // A missed interrupt only delays the next read, the sensor is then polled
+            const bool notified = wait_notification(m_task_period * TASK_SENSOR_READY_TIMEOUT);
+            if (!notified && !timed_out)
+                log_warning("Sensor data-ready interrupt timed out");
+            timed_out = !notified;
         } else {
+            sleep_periodic(m_task_period);
+        }
+
+        const timestamp_t wakeup = m_clock.now();
+        m_period_stats.record(wakeup - last_wakeup);
+        last_wakeup = wakeup;
+    }
+}
+
+template <typename data_type>
+inline void task_three_axis_sensor<data_type>::read_single(timestamp_t timestamp) noexcept
+{
+    data_type read_data[3];
+    if (m_sensor.read_all_axes(read_data)) {
+        publish(read_data, timestamp);
+    } else {
+        // TODO: Add information about sensor type to the log
+        log_warning("Sensor reading failed");
+    }
+}
+
+template <typename data_type>
+inline void task_three_axis_sensor<data_type>::read_fifo() noexcept
+{
+    const timestamp_t sample_period = m_fifo->get_sample_period();
+    data_type read_data[TASK_SENSOR_FIFO_BURST_SIZE][3];
+
+    // Only the samples present at wakeup are read, so a sensor sampling
+    // faster than expected can not keep this task running forever
+    const size_t total = m_fifo->get_fifo_count();
+    // Newest of them was taken (at most one period) before the count was read,
+    // and all are timestamped back from it, so the times keep increasing across the bursts
+    const timestamp_t newest_time = m_clock.now();
+
+    size_t index = 0;
+    while (index < total) {
+        const size_t remaining = total - index;
+        const size_t burst = remaining < TASK_SENSOR_FIFO_BURST_SIZE ? remaining : TASK_SENSOR_FIFO_BURST_SIZE;
+        const size_t count = m_fifo->read_fifo(read_data, burst);
+        if (count == 0) {
             // TODO: Add information about sensor type to the log
-            log_warning("Sensor reading failed");
+            log_warning("Sensor FIFO reading failed");
+            return;
         }
 
-        sleep_periodic(m_task_period);
+        for (size_t i = 0; i < count; i++, index++)
+            publish(read_data[i], newest_time - sample_period * static_cast<int64_t>(total - 1 - index));
     }
 }
 
+template <typename data_type>
+inline void task_three_axis_sensor<data_type>::publish(const data_type (&raw)[3], timestamp_t timestamp) noexcept
+{
+    reading_s reading;
+    reading.raw = vector_t {raw[0], raw[1], raw[2]};
+    const vector_t corrected = process(reading.raw);
+
+    // Filters start from the first sample instead of zero to avoid the transient
+    if (!m_filter_started) {
+        m_filter.reset(corrected);
+        m_filter_started = true;
+    }
+    reading.corrected = m_filter.process(corrected);
+    m_last_reading.write(reading);
+
+    // If the buffer is full the consumer is not keeping up,
+    // the newest sample is dropped and the drop is counted
+    m_samples.push({reading.corrected, timestamp});
+
+    if (m_recorder)
+        m_recorder->push({reading.raw, reading.corrected, timestamp});
+}
+
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "task_vehicle.hpp"
+#include "task_telemetry.hpp"
 #include "util/logger.hpp"
 
 namespace mp {
@@ -6,15 +7,26 @@ namespace mp {
 // Conversion of the task period to floating point delta time
 static constexpr float DT = std::chrono::duration<float>(TASK_VEHICLE_PERIOD).count();
 
+// Longer gaps are clamped so that a stalled task
+// does not produce a huge controller step
+static constexpr float MAX_DT = 5 * DT;
+
 task_vehicle::task_vehicle(
     vehicle& vehicle,
     task_receiver& task_receiver,
-    task_state_estimator& task_state_estimator
+    task_state_estimator& task_state_estimator,
+    task_calibration& task_calibration,
+    const monotonic_clock& clock,
+    seqlock<motor_frequencies_s>& motor_frequencies
 ) noexcept :
     task("Task vehicle", TASK_VEHICLE_PRIORITY, m_task_stack),
     m_vehicle(vehicle),
     m_task_receiver(task_receiver),
     m_task_state_estimator(task_state_estimator),
+    m_task_calibration(task_calibration),
+    m_clock(clock),
+    m_period_stats(std::chrono::duration_cast<timestamp_t>(TASK_VEHICLE_PERIOD)),
+    m_motor_frequencies(motor_frequencies),
     m_arena(google::protobuf::ArenaOptions {
         .max_block_size = COMMAND_MSG_MAX_SIZE,
         .initial_block = m_arena_buffer,
@@ -31,6 +43,10 @@ void task_vehicle::run() noexcept
         assert(false);
     }
 
+    // First update uses the planned period since there is no previous one
+    timestamp_t last_wakeup = m_clock.now();
+    timestamp_t last_update = last_wakeup - m_period_stats.get_planned();
+
     while (true) {
         // Clear any leftover data
         m_arena.Reset();
@@ -45,16 +61,35 @@ void task_vehicle::run() noexcept
                 break;
             }
             
-            // TODO: If false is returned, this command was not for this
-            // vehicle, try to handle it globally
-            m_vehicle.handle_command(*command);
+            // If false is returned, this command was not for this
+            // vehicle, so try to handle it globally
+            if (!m_vehicle.handle_command(*command) && !m_task_calibration.handle_command(*command) &&
+                !(m_task_telemetry && m_task_telemetry->handle_command(*command))) {
+                log_warning("Command not handled");
+            }
             m_arena.Destroy(command);
         }
         
+        const timestamp_t now = m_clock.now();
+        const float dt = to_seconds(now - last_update);
+        last_update = now;
+
         state_s state = m_task_state_estimator.get_state();
-        m_vehicle.update(state, DT);
+        m_vehicle.update(state, dt < MAX_DT ? dt : MAX_DT);
+        m_motor_frequencies.write(m_vehicle.get_motor_frequencies());
+        // Outputs are only read back when something uses them
+        if (m_recorder || m_task_telemetry) {
+            const actuation_s actuation = m_vehicle.get_actuation();
+            m_actuation.write(actuation);
+            if (m_recorder)
+                m_recorder->push({actuation, now});
+        }
 
         sleep_periodic(TASK_VEHICLE_PERIOD);
+
+        const timestamp_t wakeup = m_clock.now();
+        m_period_stats.record(wakeup - last_wakeup);
+        last_wakeup = wakeup;
     }
 }
 
@@ -4,12 +4,22 @@
 #include "vehicles/vehicle.hpp"
 #include "task_receiver.hpp"
 #include "task_state_estimator.hpp"
+#include "task_calibration.hpp"
+#include "util/period_stats.hpp"
+#include "util/seqlock.hpp"
+#include "blackbox/blackbox.hpp"
 
 namespace mp {
 
+class task_telemetry;
+
 /**
  * Task responsible for running the vehicle update iterations
- * and passing the received commands to the vehicle for processing
+ * and passing the received commands to the vehicle for processing,
+ * commands not meant for the vehicle are handled globally
+ *
+ * Vehicle is updated with the measured time since its last update,
+ * after which the motor frequencies are published for the sensor filters
  * @todo Should be the only task with a reference to the vehicle
  */
 class task_vehicle : public emblib::task {
@@ -18,9 +28,47 @@ public:
     explicit task_vehicle(
         vehicle& vehicle,
         task_receiver& task_receiver,
-        task_state_estimator& task_state_estimator
+        task_state_estimator& task_state_estimator,
+        task_calibration& task_calibration,
+        const monotonic_clock& clock,
+        seqlock<motor_frequencies_s>& motor_frequencies
     ) noexcept;
 
+    /**
+     * Statistics of the measured task period
+     */
+    period_stats_s get_period_stats() const noexcept
+    {
+        return m_period_stats.get();
+    }
+
+    /**
+     * Vehicle outputs of the last update
+     */
+    actuation_s get_actuation() const noexcept
+    {
+        return m_actuation.read();
+    }
+
+    /**
+     * Record the vehicle outputs of every update to the blackbox through `channel`
+     * @note Must be set before the scheduler starts
+     */
+    void set_recorder(blackbox_control_channel* channel) noexcept
+    {
+        m_recorder = channel;
+    }
+
+    /**
+     * Pass the telemetry commands (keyframe acknowledgements and stream rates)
+     * to the telemetry task, and publish the vehicle outputs for its vehicle stream
+     * @note Must be set before the scheduler starts
+     */
+    void set_telemetry(task_telemetry* task_telemetry) noexcept
+    {
+        m_task_telemetry = task_telemetry;
+    }
+
 private:
     void run() noexcept override;
 
@@ -30,6 +78,14 @@ private:
 
     task_receiver& m_task_receiver;
     task_state_estimator& m_task_state_estimator;
+    task_calibration& m_task_calibration;
+    task_telemetry* m_task_telemetry = nullptr;
+
+    const monotonic_clock& m_clock;
+    period_stats m_period_stats;
+    seqlock<motor_frequencies_s>& m_motor_frequencies;
+    seqlock<actuation_s> m_actuation;
+    blackbox_control_channel* m_recorder = nullptr;
 
     // Command receive arena
     google::protobuf::Arena m_arena;
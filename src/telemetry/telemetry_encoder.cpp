@@ -0,0 +1,310 @@
+#include "telemetry_encoder.hpp"
+#include "util/crc8.hpp"
+#include <cmath>
+#include <cstring>
+
+namespace mp {
+
+// Number of fields in each group
+static constexpr size_t GROUP_SIZE[TELEMETRY_GROUP_COUNT] = {3, 3, 3, 4, 3, 3, 3, 3, 3};
+static constexpr size_t STATE_FIELD_COUNT = 1 + 3 + 3 + 3 + 4 + 3;
+
+// Quantized values are limited so that the zigzag encoded
+// difference of any two fits in the 31 bits of the widest group
+static constexpr int32_t QUANTIZED_MAX = (1 << 29) - 1;
+// Not a number is kept as a value outside the range, so that it is visible on the receiver
+static constexpr int32_t QUANTIZED_NAN = -(1 << 29);
+
+// Deltas are small, so their groups have a narrower width field, and a frame
+// with any wider delta is sent as a keyframe instead
+static constexpr unsigned WIDTH_BITS = 5;
+static constexpr unsigned DELTA_WIDTH_BITS = 4;
+static constexpr unsigned DELTA_MAX_WIDTH = (1 << DELTA_WIDTH_BITS) - 1;
+
+// Fields of the time and the position and velocity groups
+static constexpr size_t TIME_FIELD = 0;
+static constexpr size_t POSITION_FIELD = 1;
+static constexpr size_t VELOCITY_FIELD = 4;
+
+static int32_t quantize_value(float value, float scale) noexcept
+{
+    if (std::isnan(value))
+        return QUANTIZED_NAN;
+
+    const float scaled = value * scale;
+    if (scaled >= static_cast<float>(QUANTIZED_MAX))
+        return QUANTIZED_MAX;
+    if (scaled <= -static_cast<float>(QUANTIZED_MAX))
+        return -QUANTIZED_MAX;
+    return static_cast<int32_t>(std::lround(scaled));
+}
+
+static uint32_t zigzag(int32_t value) noexcept
+{
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+static int64_t floor_div(int64_t num, int64_t den) noexcept
+{
+    const int64_t q = num / den;
+    return (num % den != 0 && (num < 0) != (den < 0)) ? q - 1 : q;
+}
+
+/**
+ * Position predicted from the keyframe position and velocity after `dt_ms`,
+ * so that the delta only contains the change of the velocity since the keyframe
+ * @note Must give the same result as on the receiver
+ */
+static int32_t predict_position(int32_t position, int32_t velocity, int64_t dt_ms, const telemetry_resolution_s& resolution) noexcept
+{
+    if (position == QUANTIZED_NAN || velocity == QUANTIZED_NAN || dt_ms <= 0 || dt_ms > 100000)
+        return position;
+
+    int64_t num = static_cast<int64_t>(velocity) * dt_ms;
+    int64_t den = 1000;
+    const int shift = resolution.exponent[TELEMETRY_VELOCITY] - resolution.exponent[TELEMETRY_POSITION];
+    for (int i = 0; i < shift; i++)
+        num *= 10;
+    for (int i = 0; i > shift; i--)
+        den *= 10;
+
+    const int64_t predicted = position + floor_div(2 * num + den, 2 * den);
+    if (predicted > QUANTIZED_MAX)
+        return QUANTIZED_MAX;
+    if (predicted < -QUANTIZED_MAX)
+        return -QUANTIZED_MAX;
+    return static_cast<int32_t>(predicted);
+}
+
+/**
+ * Writes values of any width into a byte buffer, least significant bit first
+ */
+class bit_writer {
+public:
+    explicit bit_writer(uint8_t* buffer) noexcept : m_buffer(buffer) {}
+
+    void write(uint32_t value, unsigned bits) noexcept
+    {
+        m_bits |= static_cast<uint64_t>(value) << m_count;
+        m_count += bits;
+        while (m_count >= 8) {
+            m_buffer[m_size++] = static_cast<uint8_t>(m_bits);
+            m_bits >>= 8;
+            m_count -= 8;
+        }
+    }
+
+    /**
+     * Write out the last partial byte
+     * @returns Number of bytes written
+     */
+    size_t finish() noexcept
+    {
+        if (m_count > 0)
+            m_buffer[m_size++] = static_cast<uint8_t>(m_bits);
+        m_bits = 0;
+        m_count = 0;
+        return m_size;
+    }
+
+private:
+    uint8_t* m_buffer;
+    size_t m_size = 0;
+    uint64_t m_bits = 0;
+    unsigned m_count = 0;
+};
+
+/**
+ * Bits needed for the widest of the values
+ */
+static unsigned get_width(const uint32_t* values, size_t count) noexcept
+{
+    uint32_t combined = 0;
+    for (size_t i = 0; i < count; i++)
+        combined |= values[i];
+
+    unsigned width = 0;
+    while (width < 31 && (combined >> width) != 0)
+        width++;
+    return width;
+}
+
+/**
+ * Write a group as the width of its widest value and all values with that width
+ */
+static void write_group(bit_writer& writer, const uint32_t* values, size_t count, unsigned width_bits) noexcept
+{
+    const unsigned width = get_width(values, count);
+    writer.write(width, width_bits);
+    for (size_t i = 0; i < count; i++)
+        writer.write(values[i], width);
+}
+
+/**
+ * Write the time and the groups of a record up to `field_count` fields
+ */
+static void write_record(bit_writer& writer, const uint32_t* encoded, size_t field_count, unsigned width_bits) noexcept
+{
+    write_group(writer, encoded, 1, width_bits);
+    size_t field = 1;
+    for (size_t group = 0; group < TELEMETRY_GROUP_COUNT && field < field_count; group++) {
+        write_group(writer, encoded + field, GROUP_SIZE[group], width_bits);
+        field += GROUP_SIZE[group];
+    }
+}
+
+/**
+ * Fill in the header and the CRC of a frame around its payload
+ * @returns Size of the frame
+ */
+static size_t finish_frame(uint8_t* frame, uint8_t info, size_t payload_size) noexcept
+{
+    frame[0] = telemetry_encoder::SYNC;
+    frame[1] = static_cast<uint8_t>(payload_size);
+    frame[2] = info;
+    frame[telemetry_encoder::HEADER_SIZE + payload_size] = crc8(frame + 1, telemetry_encoder::HEADER_SIZE - 1 + payload_size);
+    return telemetry_encoder::HEADER_SIZE + payload_size + telemetry_encoder::CRC_SIZE;
+}
+
+telemetry_encoder::telemetry_encoder(
+    const telemetry_resolution_s& resolution,
+    size_t keyframe_interval,
+    size_t keyframe_max_age,
+    size_t batch_size
+) noexcept :
+    m_resolution(resolution),
+    m_keyframe_interval(keyframe_interval),
+    m_keyframe_max_age(keyframe_max_age),
+    m_batch_size(batch_size < 1 ? 1 : (batch_size > MAX_BATCH_SIZE ? MAX_BATCH_SIZE : batch_size))
+{
+    for (size_t i = 0; i < TELEMETRY_GROUP_COUNT; i++)
+        m_scale[i] = std::pow(10.f, -static_cast<float>(resolution.exponent[i]));
+}
+
+void telemetry_encoder::quantize(const telemetry_frame_s& frame, int32_t* values) const noexcept
+{
+    const vector3f* vectors[] = {
+        &frame.position, &frame.velocity, &frame.acceleration, nullptr, &frame.angular_velocity,
+        &frame.acc_raw, &frame.acc_corrected, &frame.gyro_raw, &frame.gyro_corrected
+    };
+
+    // Time in milliseconds, wrapping around in the quantized range
+    *values++ = static_cast<int32_t>((frame.timestamp.count() / 1000) % QUANTIZED_MAX);
+    for (size_t group = 0; group < TELEMETRY_GROUP_COUNT; group++) {
+        for (size_t i = 0; i < GROUP_SIZE[group]; i++) {
+            const float value = group == TELEMETRY_ROTATION ? frame.rotation(i) : (*vectors[group])(i);
+            *values++ = quantize_value(value, m_scale[group]);
+        }
+    }
+}
+
+const telemetry_encoder::keyframe_s* telemetry_encoder::get_reference() const noexcept
+{
+    for (const keyframe_s& keyframe : m_keyframes) {
+        if (keyframe.valid && keyframe.id == m_acknowledged_id &&
+            m_frame_index - keyframe.frame_index <= m_keyframe_max_age)
+            return &keyframe;
+    }
+    return m_keyframes[m_newest].valid ? &m_keyframes[m_newest] : nullptr;
+}
+
+bool telemetry_encoder::add_record(const int32_t* values, const int32_t* base, size_t field_count) noexcept
+{
+    uint32_t* encoded = m_batch[m_batch_count];
+    const int64_t dt_ms = static_cast<int64_t>(values[TIME_FIELD]) - base[TIME_FIELD];
+    for (size_t i = 0; i < field_count; i++) {
+        int32_t predicted = base[i];
+        if (i >= POSITION_FIELD && i < VELOCITY_FIELD)
+            predicted = predict_position(base[i], base[i + 3], dt_ms, m_resolution);
+        encoded[i] = zigzag(values[i] - predicted);
+    }
+    if (get_width(encoded, field_count) > DELTA_MAX_WIDTH)
+        return false;
+
+    memcpy(m_previous, values, sizeof(m_previous));
+    m_batch_field_count = field_count;
+    m_batch_count++;
+    return true;
+}
+
+size_t telemetry_encoder::finish_batch(uint8_t* frame) noexcept
+{
+    bit_writer writer(frame + HEADER_SIZE);
+    for (size_t i = 0; i < m_batch_count; i++)
+        write_record(writer, m_batch[i], m_batch_field_count, DELTA_WIDTH_BITS);
+
+    const uint8_t info = (m_batch_field_count == FIELD_COUNT ? INFO_SENSORS : 0) | m_batch_reference_id;
+    m_batch_count = 0;
+    return finish_frame(frame, info, writer.finish());
+}
+
+size_t telemetry_encoder::write_keyframe(const int32_t* values, uint8_t* frame) noexcept
+{
+    m_newest = (m_newest + 1) % KEYFRAME_HISTORY;
+    keyframe_s& keyframe = m_keyframes[m_newest];
+    memcpy(keyframe.values, values, sizeof(keyframe.values));
+    keyframe.frame_index = m_frame_index;
+    keyframe.id = m_next_id;
+    keyframe.valid = true;
+    m_next_id = (m_next_id + 1) & KEYFRAME_ID_MASK;
+
+    uint8_t* payload = frame + HEADER_SIZE;
+    for (size_t i = 0; i < TELEMETRY_GROUP_COUNT; i++)
+        *payload++ = static_cast<uint8_t>(m_resolution.exponent[i]);
+
+    uint32_t encoded[FIELD_COUNT];
+    for (size_t i = 0; i < FIELD_COUNT; i++)
+        encoded[i] = zigzag(values[i]);
+
+    bit_writer writer(payload);
+    write_record(writer, encoded, FIELD_COUNT, WIDTH_BITS);
+    return finish_frame(frame, INFO_KEYFRAME | INFO_SENSORS | keyframe.id, TELEMETRY_GROUP_COUNT + writer.finish());
+}
+
+size_t telemetry_encoder::encode(const telemetry_frame_s& frame, bool with_sensors, const uint8_t*& data) noexcept
+{
+    int32_t values[FIELD_COUNT];
+    quantize(frame, values);
+
+    const size_t field_count = with_sensors ? FIELD_COUNT : STATE_FIELD_COUNT;
+    const keyframe_s& newest = m_keyframes[m_newest];
+    const bool is_keyframe_due = !newest.valid || m_frame_index - newest.frame_index >= m_keyframe_interval;
+
+    // Record continues the pending delta frame relative to the previous record if it can,
+    // otherwise the pending frame is sent and the record starts a new one
+    size_t size = 0;
+    bool added = false;
+    if (m_batch_count > 0) {
+        added = !is_keyframe_due && field_count == m_batch_field_count && add_record(values, m_previous, field_count);
+        if (!added)
+            size += finish_batch(m_frame);
+    }
+
+    // First record of a delta frame is relative to the keyframe, or is sent as a keyframe
+    if (!added) {
+        const keyframe_s* reference = get_reference();
+        if (!is_keyframe_due && add_record(values, reference->values, field_count))
+            m_batch_reference_id = reference->id;
+        else
+            size += write_keyframe(values, m_frame + size);
+    }
+
+    if (m_batch_count == m_batch_size)
+        size += finish_batch(m_frame + size);
+
+    m_frame_index++;
+    data = m_frame;
+    return size;
+}
+
+void telemetry_encoder::acknowledge(uint8_t keyframe_id) noexcept
+{
+    for (const keyframe_s& keyframe : m_keyframes) {
+        if (keyframe.valid && keyframe.id == keyframe_id) {
+            m_acknowledged_id = keyframe_id;
+            return;
+        }
+    }
+}
+
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "mp/util/math.hpp"
+#include "mp/drivers/clock.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace mp {
+
+/**
+ * Groups of the compact telemetry fields, in the order they are encoded
+ */
+enum telemetry_group_e : uint8_t {
+    TELEMETRY_POSITION,
+    TELEMETRY_VELOCITY,
+    TELEMETRY_ACCELERATION,
+    TELEMETRY_ROTATION,
+    TELEMETRY_ANGULAR_VELOCITY,
+    // Sensor groups are only sent in some of the frames
+    TELEMETRY_ACC_RAW,
+    TELEMETRY_ACC_CORRECTED,
+    TELEMETRY_GYRO_RAW,
+    TELEMETRY_GYRO_CORRECTED,
+    TELEMETRY_GROUP_COUNT
+};
+
+/**
+ * Resolution of every field group as a power of ten (-2 is 0.01),
+ * indexed by `telemetry_group_e`
+ */
+struct telemetry_resolution_s {
+    int8_t exponent[TELEMETRY_GROUP_COUNT];
+};
+
+/**
+ * Values sent in a telemetry frame
+ */
+struct telemetry_frame_s {
+    timestamp_t timestamp;
+    vector3f position;
+    vector3f velocity;
+    vector3f acceleration;
+    vector4f rotation;
+    vector3f angular_velocity;
+    vector3f acc_raw;
+    vector3f acc_corrected;
+    vector3f gyro_raw;
+    vector3f gyro_corrected;
+};
+
+/**
+ * Encodes the telemetry into compact frames for slow links
+ *
+ * Every field is quantized to the configured resolution. Keyframes are sent
+ * periodically with all the values, and the other frames only contain the
+ * differences to a keyframe. Delta frames reference the newest keyframe
+ * acknowledged by the receiver, so a lost frame (even a keyframe) does not
+ * affect the following ones. Without acknowledgements (or if the newest one
+ * is too old) the newest sent keyframe is referenced instead.
+ *
+ * Delta frames carry up to `batch_size` consecutive records under a single
+ * header and CRC, which take a large part of a short frame. The first record
+ * is relative to the keyframe and each following one to the record before it,
+ * so the later records are only the changes over a frame period. Records wait
+ * in the encoder until the frame is full, which delays them by up to
+ * `batch_size - 1` frame periods. A frame lost on the link loses its records,
+ * but not the records of the following frames.
+ *
+ * A frame is `SYNC`, the payload size, an info byte (keyframe and sensor
+ * flags and the keyframe id) and the payload, followed by the CRC-8 of
+ * everything after the sync byte. The payload is bit packed (least
+ * significant bit first). Keyframes start with the resolution exponents of
+ * all groups. Then for each group in a record there is a width (5 bits in
+ * keyframes, 4 bits in delta frames) and that many bits of every zigzag
+ * encoded value (absolute for keyframes, difference otherwise), with the time
+ * in milliseconds as the first group. Delta records follow each other until
+ * less than a byte of padding is left. Position differences are to the
+ * referenced position moved by the referenced velocity. Records with a
+ * difference too wide for a delta frame are sent as keyframes.
+ *
+ * @note Format is decoded by `python/telemetry_decoder.py`
+ */
+class telemetry_encoder {
+
+public:
+    static constexpr uint8_t SYNC = 0xA7;
+    static constexpr uint8_t INFO_KEYFRAME = 0x80;
+    static constexpr uint8_t INFO_SENSORS = 0x40;
+    static constexpr uint8_t KEYFRAME_ID_MASK = 0x3F;
+    static constexpr size_t HEADER_SIZE = 3;
+    static constexpr size_t CRC_SIZE = 1;
+
+    // Time and all groups
+    static constexpr size_t FIELD_COUNT = 1 + 3 * 8 + 4;
+    static constexpr size_t MAX_FRAME_SIZE = HEADER_SIZE + TELEMETRY_GROUP_COUNT + (5 * (TELEMETRY_GROUP_COUNT + 1) + 31 * FIELD_COUNT + 7) / 8 + CRC_SIZE;
+    // Records of a delta frame, so that the payload size fits its byte
+    static constexpr size_t MAX_BATCH_SIZE = 4;
+    static constexpr size_t MAX_DELTA_FRAME_SIZE = HEADER_SIZE + (MAX_BATCH_SIZE * (4 * (TELEMETRY_GROUP_COUNT + 1) + 15 * FIELD_COUNT) + 7) / 8 + CRC_SIZE;
+    static_assert(MAX_DELTA_FRAME_SIZE - HEADER_SIZE - CRC_SIZE <= UINT8_MAX);
+
+    /**
+     * @param keyframe_interval Frames from one keyframe to the next
+     * @param keyframe_max_age Frames after which an acknowledged keyframe is no longer
+     * referenced if no newer one was acknowledged
+     * @param batch_size Records in a delta frame, at most `MAX_BATCH_SIZE`
+     */
+    explicit telemetry_encoder(
+        const telemetry_resolution_s& resolution,
+        size_t keyframe_interval,
+        size_t keyframe_max_age,
+        size_t batch_size = 1
+    ) noexcept;
+
+    /**
+     * Encode the next record, sensor groups are only included if `with_sensors`
+     * (keyframes always include them)
+     * @returns Size of the completed frames at `data` (a delta frame, a keyframe
+     * or a delta frame ended early followed by a keyframe), 0 if the record
+     * waits for the rest of its delta frame. Valid until the next call.
+     */
+    size_t encode(const telemetry_frame_s& frame, bool with_sensors, const uint8_t*& data) noexcept;
+
+    /**
+     * Receiver has the keyframe with the id, ids of keyframes which are
+     * no longer kept are ignored
+     */
+    void acknowledge(uint8_t keyframe_id) noexcept;
+
+private:
+    // Keyframes sent recently, which the receiver can acknowledge
+    static constexpr size_t KEYFRAME_HISTORY = 4;
+
+    struct keyframe_s {
+        int32_t values[FIELD_COUNT];
+        size_t frame_index;
+        uint8_t id;
+        bool valid;
+    };
+
+    /**
+     * Quantize all fields of the frame
+     */
+    void quantize(const telemetry_frame_s& frame, int32_t* values) const noexcept;
+
+    /**
+     * Keyframe which the delta frame is relative to
+     */
+    const keyframe_s* get_reference() const noexcept;
+
+    /**
+     * Add a record to the pending delta frame as the differences to `base`
+     * @returns false if a difference is too wide for a delta frame
+     */
+    bool add_record(const int32_t* values, const int32_t* base, size_t field_count) noexcept;
+
+    /**
+     * Write the pending delta frame to `frame` and start a new one
+     * @returns Size of the frame
+     */
+    size_t finish_batch(uint8_t* frame) noexcept;
+
+    /**
+     * Write a keyframe with the values to `frame`
+     * @returns Size of the frame
+     */
+    size_t write_keyframe(const int32_t* values, uint8_t* frame) noexcept;
+
+private:
+    telemetry_resolution_s m_resolution;
+    float m_scale[TELEMETRY_GROUP_COUNT];
+    size_t m_keyframe_interval;
+    size_t m_keyframe_max_age;
+    size_t m_batch_size;
+
+    keyframe_s m_keyframes[KEYFRAME_HISTORY] = {};
+    size_t m_newest = 0;
+    int m_acknowledged_id = -1;
+    size_t m_frame_index = 0;
+    uint8_t m_next_id = 0;
+
+    // Delta frame being filled, the records are the encoded differences
+    uint32_t m_batch[MAX_BATCH_SIZE][FIELD_COUNT];
+    size_t m_batch_count = 0;
+    size_t m_batch_field_count = 0;
+    uint8_t m_batch_reference_id = 0;
+    // Values of the newest record in the delta frame, which the next one is relative to
+    int32_t m_previous[FIELD_COUNT];
+
+    uint8_t m_frame[MAX_DELTA_FRAME_SIZE + MAX_FRAME_SIZE];
+};
+
+}
@@ -0,0 +1,89 @@
+#include "telemetry_scheduler.hpp"
+
+namespace mp {
+
+telemetry_scheduler::telemetry_scheduler(
+    const telemetry_stream_config_s (&streams)[TELEMETRY_STREAM_COUNT],
+    float budget,
+    float burst,
+    timestamp_t window
+) noexcept :
+    m_budget(budget),
+    m_burst(burst),
+    m_window(window)
+{
+    for (size_t i = 0; i < TELEMETRY_STREAM_COUNT; i++) {
+        m_streams[i] = {};
+        m_streams[i].priority = streams[i].priority;
+        set_rate(static_cast<telemetry_stream_e>(i), streams[i].rate);
+    }
+}
+
+void telemetry_scheduler::set_rate(telemetry_stream_e stream, float rate) noexcept
+{
+    const float max_rate = 1.f / to_seconds(m_window);
+    if (!(rate > 0.f))
+        rate = 0.f;
+    else if (rate > max_rate)
+        rate = max_rate;
+
+    stream_s& s = m_streams[stream];
+    s.rate = rate;
+    s.period = rate > 0.f ? std::chrono::duration_cast<timestamp_t>(std::chrono::duration<float>(1.f / rate)) : m_window;
+    // Send a boosted stream right away instead of after the old period
+    s.next_due = m_time;
+    s.waiting = 0;
+}
+
+size_t telemetry_scheduler::begin_window(telemetry_stream_e* order) noexcept
+{
+    m_tokens += m_budget * to_seconds(m_window);
+    if (m_tokens > m_burst)
+        m_tokens = m_burst;
+
+    size_t count = 0;
+    for (size_t i = 0; i < TELEMETRY_STREAM_COUNT; i++) {
+        stream_s& s = m_streams[i];
+        s.due = s.rate > 0.f && s.next_due <= m_time;
+        if (!s.due)
+            continue;
+
+        // Insertion sort by the aged priority, streams with the
+        // same priority keep the order of `telemetry_stream_e`
+        const uint32_t priority = s.priority + s.waiting;
+        size_t j = count++;
+        for (; j > 0; j--) {
+            const stream_s& other = m_streams[order[j - 1]];
+            if (other.priority + other.waiting >= priority)
+                break;
+            order[j] = order[j - 1];
+        }
+        order[j] = static_cast<telemetry_stream_e>(i);
+    }
+    return count;
+}
+
+void telemetry_scheduler::mark_sent(telemetry_stream_e stream, size_t size) noexcept
+{
+    stream_s& s = m_streams[stream];
+    m_tokens -= static_cast<float>(size);
+    s.due = false;
+    s.waiting = 0;
+
+    // Keep the phase unless the stream fell more than a period behind,
+    // the messages missed by then are not worth catching up on
+    s.next_due += s.period;
+    if (s.next_due <= m_time)
+        s.next_due = m_time + s.period;
+}
+
+void telemetry_scheduler::end_window() noexcept
+{
+    for (stream_s& s : m_streams) {
+        if (s.due)
+            s.waiting++;
+    }
+    m_time += m_window;
+}
+
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "mp/drivers/clock.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace mp {
+
+/**
+ * Independently scheduled telemetry streams
+ * @note Same order as `pb::TelemetryStream`
+ */
+enum telemetry_stream_e : uint8_t {
+    // Compact frames of the whole state (see `telemetry_encoder`)
+    TELEMETRY_STREAM_STATE,
+    TELEMETRY_STREAM_ATTITUDE,
+    TELEMETRY_STREAM_POSITION,
+    TELEMETRY_STREAM_SENSORS,
+    TELEMETRY_STREAM_VEHICLE,
+    TELEMETRY_STREAM_ESTIMATOR,
+    TELEMETRY_STREAM_COUNT
+};
+
+struct telemetry_stream_config_s {
+    // Messages per second, 0 turns the stream off
+    float rate;
+    // Higher priority streams are sent first when the budget is short
+    uint8_t priority;
+};
+
+/**
+ * Decides which telemetry streams are sent in each transmission window
+ *
+ * Every stream is due at its own rate. In each window the due streams are
+ * sent in the order of their priority for as long as the byte budget of the
+ * link allows, and the rest stay due for the next window. Each window a due
+ * stream is skipped raises its priority by one until it is sent, so boosting
+ * one stream slows the others down instead of starving them.
+ *
+ * The budget is a token bucket refilled every window with the bytes per
+ * second of the link and capped at `burst` bytes, so bytes not used by the
+ * quiet windows let the larger messages through without delaying the rest.
+ * A message is sent while any budget is left, so the message which
+ * overdraws the budget is paid for by the following windows.
+ */
+class telemetry_scheduler {
+
+public:
+    /**
+     * @param budget Bytes per second for all streams
+     * @param burst Most bytes saved up by the windows which did not use their budget
+     * @param window Time between the transmission windows
+     */
+    explicit telemetry_scheduler(
+        const telemetry_stream_config_s (&streams)[TELEMETRY_STREAM_COUNT],
+        float budget,
+        float burst,
+        timestamp_t window
+    ) noexcept;
+
+    /**
+     * Change the rate of a stream, limited to one message per window
+     */
+    void set_rate(telemetry_stream_e stream, float rate) noexcept;
+
+    float get_rate(telemetry_stream_e stream) const noexcept
+    {
+        return m_streams[stream].rate;
+    }
+
+    /**
+     * Run the next transmission window
+     * @param send Called as `size_t send(telemetry_stream_e)` for each stream to
+     * be sent, returns the number of bytes sent (0 if the stream had nothing to send)
+     */
+    template <typename FUNC>
+    void run_window(FUNC&& send) noexcept
+    {
+        telemetry_stream_e order[TELEMETRY_STREAM_COUNT];
+        const size_t due_count = begin_window(order);
+
+        for (size_t i = 0; i < due_count && m_tokens > 0.f; i++) {
+            const telemetry_stream_e stream = order[i];
+            mark_sent(stream, send(stream));
+        }
+
+        end_window();
+    }
+
+private:
+    struct stream_s {
+        float rate;
+        uint8_t priority;
+        timestamp_t period;
+        timestamp_t next_due;
+        // Windows the stream was due but not sent
+        uint32_t waiting;
+        bool due;
+    };
+
+    /**
+     * Refill the budget and order the due streams by priority
+     * @returns Number of due streams in `order`
+     */
+    size_t begin_window(telemetry_stream_e* order) noexcept;
+
+    /**
+     * Pay for the sent bytes and schedule the next message of the stream
+     */
+    void mark_sent(telemetry_stream_e stream, size_t size) noexcept;
+
+    /**
+     * Age the streams which were due but not sent and move to the next window
+     */
+    void end_window() noexcept;
+
+private:
+    stream_s m_streams[TELEMETRY_STREAM_COUNT];
+    float m_budget;
+    float m_burst;
+    timestamp_t m_window;
+    float m_tokens = 0.f;
+    timestamp_t m_time = timestamp_t::zero();
+};
+
+}
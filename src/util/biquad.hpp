@@ -0,0 +1,305 @@
+#pragma once
+
+#include "mp/util/math.hpp"
+#include "mp/util/constants.hpp"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace mp {
+
+enum class biquad_type_e {
+    LOW_PASS,
+    BAND_PASS,
+    NOTCH
+};
+
+/**
+ * Design parameters of a single biquad stage
+ * @note `frequency` is the cutoff frequency for the low-pass
+ * and the center frequency for the band-pass and the notch
+ */
+struct biquad_spec_s {
+    biquad_type_e type;
+    float frequency;
+    float q = 0.70710678f;
+};
+
+/**
+ * Biquad coefficients normalized by `a0`
+ */
+struct biquad_coeffs_s {
+    float b0 = 1.f, b1 = 0.f, b2 = 0.f;
+    float a1 = 0.f, a2 = 0.f;
+
+    /**
+     * Coefficients from the RBJ audio EQ cookbook
+     * @note Frequency must be below the Nyquist frequency (`sample_rate / 2`)
+     */
+    static biquad_coeffs_s design(const biquad_spec_s& spec, float sample_rate) noexcept
+    {
+        const float w0 = 2.f * PI * spec.frequency / sample_rate;
+        const float cos_w0 = std::cos(w0);
+        const float alpha = std::sin(w0) / (2.f * spec.q);
+        const float a0 = 1.f + alpha;
+
+        biquad_coeffs_s result;
+        switch (spec.type) {
+        case biquad_type_e::LOW_PASS:
+            result.b0 = (1.f - cos_w0) / 2.f / a0;
+            result.b1 = (1.f - cos_w0) / a0;
+            result.b2 = result.b0;
+            break;
+        case biquad_type_e::BAND_PASS:
+            result.b0 = alpha / a0;
+            result.b1 = 0.f;
+            result.b2 = -alpha / a0;
+            break;
+        case biquad_type_e::NOTCH:
+            result.b0 = 1.f / a0;
+            result.b1 = -2.f * cos_w0 / a0;
+            result.b2 = result.b0;
+            break;
+        }
+        result.a1 = -2.f * cos_w0 / a0;
+        result.a2 = (1.f - alpha) / a0;
+        return result;
+    }
+
+    /**
+     * Gain for a constant input
+     */
+    float get_dc_gain() const noexcept
+    {
+        return (b0 + b1 + b2) / (1.f + a1 + a2);
+    }
+};
+
+/**
+ * Cascade of up to `MAX_STAGES` biquad filters applied to each axis of a three axis sample
+ *
+ * Stages use the transposed direct form II, and the state of all three axes
+ * of a stage is stored next to each other, so the per axis loop of every
+ * stage is a single vectorizable kernel. Nothing is allocated, the number
+ * of active stages is set when configured.
+ */
+template <size_t MAX_STAGES>
+class biquad_chain {
+
+    static_assert(MAX_STAGES > 0);
+    static constexpr size_t AXES = 3;
+
+public:
+    biquad_chain() = default;
+
+    /**
+     * Design the stages for the given sample rate
+     * @note Stages with the frequency at or above the Nyquist frequency
+     * can not be realized and are skipped, as are the stages over `MAX_STAGES`
+     * @returns Number of active stages
+     */
+    size_t configure(const biquad_spec_s* specs, size_t count, float sample_rate) noexcept
+    {
+        m_stages = 0;
+        for (size_t i = 0; i < count && m_stages < MAX_STAGES; i++) {
+            if (!(specs[i].frequency > 0.f && specs[i].frequency < sample_rate / 2.f))
+                continue;
+            m_coeffs[m_stages++] = biquad_coeffs_s::design(specs[i], sample_rate);
+        }
+        reset(vector3f(0));
+        return m_stages;
+    }
+
+    /**
+     * Replace the coefficients of an active stage, keeping its state
+     */
+    void set_coeffs(size_t stage, const biquad_coeffs_s& coeffs) noexcept
+    {
+        m_coeffs[stage] = coeffs;
+    }
+
+    /**
+     * Change the number of active stages, stages which become
+     * active start from a cleared state
+     * @note Coefficients of the new stages must be set with `set_coeffs`
+     */
+    void set_stages(size_t count) noexcept
+    {
+        if (count > MAX_STAGES)
+            count = MAX_STAGES;
+        for (size_t s = m_stages; s < count; s++) {
+            for (size_t i = 0; i < AXES; i++)
+                m_s1[s][i] = m_s2[s][i] = 0.f;
+        }
+        m_stages = count;
+    }
+
+    /**
+     * Set the state as if the input had been constant at `value` forever,
+     * which avoids the startup transient
+     */
+    void reset(const vector3f& value) noexcept
+    {
+        float x[AXES] = {value(0), value(1), value(2)};
+        for (size_t s = 0; s < m_stages; s++) {
+            const biquad_coeffs_s& c = m_coeffs[s];
+            const float gain = c.get_dc_gain();
+            for (size_t i = 0; i < AXES; i++) {
+                const float y = gain * x[i];
+                m_s1[s][i] = y - c.b0 * x[i];
+                m_s2[s][i] = c.b2 * x[i] - c.a2 * y;
+                x[i] = y;
+            }
+        }
+    }
+
+    /**
+     * Filter one sample through all stages
+     */
+    vector3f process(const vector3f& sample) noexcept
+    {
+        float x[AXES] = {sample(0), sample(1), sample(2)};
+        for (size_t s = 0; s < m_stages; s++) {
+            const biquad_coeffs_s c = m_coeffs[s];
+            float* s1 = m_s1[s];
+            float* s2 = m_s2[s];
+            for (size_t i = 0; i < AXES; i++) {
+                const float y = c.b0 * x[i] + s1[i];
+                s1[i] = c.b1 * x[i] - c.a1 * y + s2[i];
+                s2[i] = c.b2 * x[i] - c.a2 * y;
+                x[i] = y;
+            }
+        }
+        return {x[0], x[1], x[2]};
+    }
+
+    size_t get_stages() const noexcept
+    {
+        return m_stages;
+    }
+
+private:
+    biquad_coeffs_s m_coeffs[MAX_STAGES];
+    float m_s1[MAX_STAGES][AXES];
+    float m_s2[MAX_STAGES][AXES];
+    size_t m_stages = 0;
+};
+
+/**
+ * Fixed point variant of `biquad_chain` for targets without an FPU
+ *
+ * Samples are integers (usually the raw sensor readings) and the coefficients
+ * are stored with `FRAC_BITS` fractional bits. Stages use the direct form I,
+ * whose state is just the past inputs and outputs (so no internal overflow),
+ * and the products are accumulated in 64 bits and rounded once per stage.
+ * Only the design (`configure`) uses floating point.
+ */
+template <size_t MAX_STAGES>
+class biquad_chain_fixed {
+
+    static_assert(MAX_STAGES > 0);
+    static constexpr size_t AXES = 3;
+
+public:
+    // Coefficients are in the range (-4, 4), which covers all stable biquads
+    static constexpr int FRAC_BITS = 29;
+
+    biquad_chain_fixed() = default;
+
+    /**
+     * Design the stages for the given sample rate
+     * @see biquad_chain::configure
+     */
+    size_t configure(const biquad_spec_s* specs, size_t count, float sample_rate) noexcept
+    {
+        m_stages = 0;
+        for (size_t i = 0; i < count && m_stages < MAX_STAGES; i++) {
+            if (!(specs[i].frequency > 0.f && specs[i].frequency < sample_rate / 2.f))
+                continue;
+            set_coeffs(m_stages++, biquad_coeffs_s::design(specs[i], sample_rate));
+        }
+        reset();
+        return m_stages;
+    }
+
+    /**
+     * Replace the coefficients of a stage, keeping its state
+     */
+    void set_coeffs(size_t stage, const biquad_coeffs_s& coeffs) noexcept
+    {
+        m_coeffs[stage] = {
+            to_fixed(coeffs.b0), to_fixed(coeffs.b1), to_fixed(coeffs.b2),
+            to_fixed(coeffs.a1), to_fixed(coeffs.a2)
+        };
+    }
+
+    /**
+     * Clear the filter state
+     */
+    void reset() noexcept
+    {
+        for (size_t s = 0; s < MAX_STAGES; s++) {
+            for (size_t i = 0; i < AXES; i++) {
+                m_x1[s][i] = m_x2[s][i] = 0;
+                m_y1[s][i] = m_y2[s][i] = 0;
+            }
+        }
+    }
+
+    /**
+     * Filter one sample through all stages, in place
+     */
+    void process(int32_t (&sample)[AXES]) noexcept
+    {
+        constexpr int64_t ROUND = int64_t(1) << (FRAC_BITS - 1);
+
+        for (size_t s = 0; s < m_stages; s++) {
+            const coeffs_s c = m_coeffs[s];
+            for (size_t i = 0; i < AXES; i++) {
+                const int32_t x = sample[i];
+                const int64_t acc =
+                    int64_t(c.b0) * x + int64_t(c.b1) * m_x1[s][i] + int64_t(c.b2) * m_x2[s][i] -
+                    int64_t(c.a1) * m_y1[s][i] - int64_t(c.a2) * m_y2[s][i];
+                const int32_t y = saturate((acc + ROUND) >> FRAC_BITS);
+
+                m_x2[s][i] = m_x1[s][i];
+                m_x1[s][i] = x;
+                m_y2[s][i] = m_y1[s][i];
+                m_y1[s][i] = y;
+                sample[i] = y;
+            }
+        }
+    }
+
+    size_t get_stages() const noexcept
+    {
+        return m_stages;
+    }
+
+private:
+    struct coeffs_s {
+        int32_t b0, b1, b2, a1, a2;
+    };
+
+    static int32_t to_fixed(float value) noexcept
+    {
+        return static_cast<int32_t>(std::lround(value * float(int64_t(1) << FRAC_BITS)));
+    }
+
+    static int32_t saturate(int64_t value) noexcept
+    {
+        if (value > INT32_MAX)
+            return INT32_MAX;
+        if (value < INT32_MIN)
+            return INT32_MIN;
+        return static_cast<int32_t>(value);
+    }
+
+private:
+    coeffs_s m_coeffs[MAX_STAGES];
+    int32_t m_x1[MAX_STAGES][AXES], m_x2[MAX_STAGES][AXES];
+    int32_t m_y1[MAX_STAGES][AXES], m_y2[MAX_STAGES][AXES];
+    size_t m_stages = 0;
+};
+
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace mp {
+
+/**
+ * Ring buffer of variable length messages for multiple producers and a
+ * single consumer, without locks
+ *
+ * Producers reserve the space for a message, write it in place and then
+ * commit it. The consumer reads the committed bytes directly from the
+ * ring (so a device can transmit from it without copying) and releases
+ * them after it is done. Messages are stored back to back without any
+ * headers or padding, a message can wrap around the end of the buffer.
+ *
+ * Messages become visible to the consumer in the order of reservation, so
+ * a message committed before an earlier reserved one waits until the
+ * earlier one is committed as well, and is then published by its writer.
+ * The head position and the sequence number of the next message share a
+ * single word, so a reservation is a single compare and swap, and each
+ * pending message has a slot with its end and the sequence number it was
+ * committed with. Nobody ever waits for another producer, so a realtime
+ * task is not blocked by a lower priority one preempted in the middle of
+ * its message (it retries the compare and swap at most once per message
+ * reserved by a task which interrupted it).
+ *
+ * @note `MAX_PENDING` limits the number of reserved but not yet committed
+ * messages, which is the number of producers writing at the same time
+ */
+template <size_t SIZE, size_t MAX_PENDING>
+class byte_ring {
+
+    // Positions are kept modulo 2^POSITION_BITS and sequence numbers modulo 2^SEQUENCE_BITS
+    static constexpr uint32_t POSITION_BITS = 24;
+    static constexpr uint32_t POSITION_MASK = (1u << POSITION_BITS) - 1;
+    static constexpr uint32_t SEQUENCE_MASK = (1u << (32 - POSITION_BITS)) - 1;
+    static constexpr uint32_t NOT_COMMITTED = ~0u;
+
+    static_assert(SIZE > 0 && (SIZE & (SIZE - 1)) == 0, "Size must be a power of two");
+    static_assert(SIZE <= POSITION_MASK / 2, "Size must fit the positions");
+    static_assert(MAX_PENDING > 0 && (MAX_PENDING & (MAX_PENDING - 1)) == 0, "Pending count must be a power of two");
+    static_assert(MAX_PENDING <= SEQUENCE_MASK / 2, "Pending count must fit the sequence numbers");
+
+public:
+    /**
+     * Space reserved for a message, split in two parts if it wraps around
+     * the end of the buffer (otherwise `second_size` is zero)
+     */
+    struct reservation_s {
+        char* first;
+        size_t first_size;
+        char* second;
+        size_t second_size;
+        uint32_t sequence;
+    };
+
+    byte_ring() noexcept
+    {
+        for (slot_s& slot : m_slots)
+            slot.committed.store(NOT_COMMITTED, std::memory_order_relaxed);
+    }
+
+    /**
+     * Reserve space for a message of `size` bytes
+     * @returns false if there is not enough free space, in which case the
+     * message is dropped and counted
+     */
+    bool reserve(size_t size, reservation_s& reservation) noexcept
+    {
+        uint32_t reserved = m_reserved.load(std::memory_order_acquire);
+        uint32_t head, sequence;
+        do {
+            head = reserved & POSITION_MASK;
+            sequence = reserved >> POSITION_BITS;
+
+            // Tail and published only increase, so older values only make the check stricter
+            const uint32_t tail = m_tail.load(std::memory_order_acquire);
+            const uint32_t published = m_published.load(std::memory_order_acquire);
+            if (size == 0 || ((head - tail) & POSITION_MASK) + size > SIZE ||
+                ((sequence - published) & SEQUENCE_MASK) >= MAX_PENDING) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        } while (!m_reserved.compare_exchange_weak(reserved,
+            (((sequence + 1) & SEQUENCE_MASK) << POSITION_BITS) | ((head + size) & POSITION_MASK),
+            std::memory_order_acq_rel, std::memory_order_acquire));
+
+        const size_t offset = head & (SIZE - 1);
+        reservation.first = m_data + offset;
+        reservation.first_size = size < SIZE - offset ? size : SIZE - offset;
+        reservation.second = m_data;
+        reservation.second_size = size - reservation.first_size;
+        reservation.sequence = sequence;
+
+        // The previous message of the slot is published, so nobody reads its end anymore
+        m_slots[sequence % MAX_PENDING].end.store((head + size) & POSITION_MASK, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * Copy a message from `data` into the reserved space
+     */
+    static void write(const reservation_s& reservation, const char* data) noexcept
+    {
+        memcpy(reservation.first, data, reservation.first_size);
+        memcpy(reservation.second, data + reservation.first_size, reservation.second_size);
+    }
+
+    /**
+     * Make the reserved message visible to the consumer, together with the
+     * messages after it which were committed while it was being written
+     */
+    void commit(const reservation_s& reservation) noexcept
+    {
+        // Sequentially consistent with the loads below, so of two producers committing
+        // at the same time at least one sees the message of the other as committed
+        m_slots[reservation.sequence % MAX_PENDING].committed.store(reservation.sequence);
+
+        uint32_t published = m_published.load(std::memory_order_acquire);
+        while (true) {
+            const slot_s& slot = m_slots[published % MAX_PENDING];
+            if (slot.committed.load() != (published & SEQUENCE_MASK))
+                break;
+
+            // The end is read before the message is published, and a failed
+            // exchange means someone else published it (and its slot may be reused)
+            const uint32_t end = slot.end.load(std::memory_order_relaxed);
+            if (m_published.compare_exchange_strong(published, published + 1,
+                std::memory_order_acq_rel, std::memory_order_acquire)) {
+                advance_committed(end);
+                published++;
+            }
+        }
+    }
+
+    /**
+     * Oldest committed bytes which are contiguous in memory
+     * @returns Number of bytes at `data`, up to the end of the buffer
+     * @note Only the consumer may call this
+     */
+    size_t peek(const char*& data) const noexcept
+    {
+        const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        const uint32_t committed = m_committed.load(std::memory_order_acquire);
+        const size_t offset = tail & (SIZE - 1);
+        const size_t size = (committed - tail) & POSITION_MASK;
+
+        data = m_data + offset;
+        return size < SIZE - offset ? size : SIZE - offset;
+    }
+
+    /**
+     * Free the `size` oldest bytes after the consumer is done with them
+     * @note Only the consumer may call this
+     */
+    void release(size_t size) noexcept
+    {
+        m_tail.store((m_tail.load(std::memory_order_relaxed) + size) & POSITION_MASK, std::memory_order_release);
+    }
+
+    /**
+     * Number of messages dropped because the buffer was full
+     */
+    size_t get_dropped() const noexcept
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct slot_s {
+        std::atomic<uint32_t> end;
+        // Sequence number of the committed message in the slot
+        std::atomic<uint32_t> committed;
+    };
+
+    /**
+     * Move the committed position forward to `end`, unless a producer which
+     * published a later message got there first
+     */
+    void advance_committed(uint32_t end) noexcept
+    {
+        uint32_t committed = m_committed.load(std::memory_order_relaxed);
+        while (committed != end && ((end - committed) & POSITION_MASK) <= SIZE) {
+            if (m_committed.compare_exchange_weak(committed, end, std::memory_order_release, std::memory_order_relaxed))
+                break;
+        }
+    }
+
+private:
+    char m_data[SIZE];
+
+    // Head position and sequence number of the next reservation
+    std::atomic<uint32_t> m_reserved = 0;
+    // Sequence number of the first message not yet visible to the consumer
+    std::atomic<uint32_t> m_published = 0;
+    // Positions modulo 2^POSITION_BITS, the offset in the buffer is the position modulo size
+    std::atomic<uint32_t> m_committed = 0;
+    std::atomic<uint32_t> m_tail = 0;
+
+    slot_s m_slots[MAX_PENDING];
+    std::atomic<size_t> m_dropped = 0;
+};
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mp {
+
+/**
+ * CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320) of a byte buffer
+ *
+ * Computed bit by bit without a table, which is slow but small, and is
+ * only meant for short records. Pass the previous result as `crc`
+ * to continue the checksum over multiple buffers.
+ */
+inline uint32_t crc32(const void* data, size_t size, uint32_t crc = 0) noexcept
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+    return ~crc;
+}
+
+}
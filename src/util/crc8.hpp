@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mp {
+
+/**
+ * CRC-8 (polynomial 0x07, no reflection) of a byte buffer
+ *
+ * Meant for short frames on slow links where every byte counts, and
+ * computed bit by bit like `crc32`. Pass the previous result as `crc`
+ * to continue the checksum over multiple buffers.
+ */
+inline uint8_t crc8(const void* data, size_t size, uint8_t crc = 0) noexcept
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++)
+            crc = static_cast<uint8_t>((crc << 1) ^ (0x07u & (0u - (crc >> 7))));
+    }
+    return crc;
+}
+
+}
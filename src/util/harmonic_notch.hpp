@@ -0,0 +1,154 @@
+#pragma once
+
+#include "util/biquad.hpp"
+
+namespace mp {
+
+/**
+ * Bank of notch filters following a set of frequencies and their harmonics
+ *
+ * Meant for removing the motor vibrations, whose frequencies follow the
+ * motor speeds. Every notch has the same `q`, so its coefficients depend only
+ * on the cosine and sine of its center frequency. These are updated without
+ * trigonometric functions: the fundamental of each source is rotated by the
+ * (small) change of its frequency, and the harmonics are computed from the
+ * fundamental with the Chebyshev recurrence.
+ *
+ * The change of a tracked frequency is limited to `MAX_STEP` radians per
+ * update, which keeps the rotation accurate and also smooths the jumps
+ * of the source frequencies.
+ */
+template <size_t MAX_SOURCES, size_t HARMONICS>
+class harmonic_notch {
+
+    static constexpr size_t MAX_NOTCHES = MAX_SOURCES * HARMONICS;
+
+    // Largest change of the tracked frequency per update in rad/sample
+    static constexpr float MAX_STEP = 0.25f;
+
+public:
+    harmonic_notch() = default;
+
+    /**
+     * @param q Quality factor of every notch, higher is narrower
+     * @param min_frequency Notches under this frequency are disabled,
+     * as are the ones close to the Nyquist frequency
+     */
+    void configure(float sample_rate, float q, float min_frequency) noexcept
+    {
+        m_sample_rate = sample_rate;
+        m_alpha_scale = 1.f / (2.f * q);
+        m_min_w = 2.f * PI * min_frequency / sample_rate;
+        m_max_w = 0.9f * PI;
+
+        for (source_s& source : m_sources)
+            source = source_s {};
+        m_chain.set_stages(0);
+        m_chain.reset(vector3f(0));
+    }
+
+    /**
+     * Move the notches towards the new source frequencies
+     * @param frequencies Fundamental frequency of each source in Hz
+     * @note Sources over `MAX_SOURCES` are ignored
+     */
+    void update(const float* frequencies, size_t count) noexcept
+    {
+        if (count > MAX_SOURCES)
+            count = MAX_SOURCES;
+
+        for (size_t i = 0; i < count; i++) {
+            source_s& source = m_sources[i];
+            track(source, 2.f * PI * frequencies[i] / m_sample_rate);
+
+            // cos(k*w) and sin(k*w) from the previous two harmonics
+            float c_prev = 1.f, s_prev = 0.f;
+            float c = source.cos_w, s = source.sin_w;
+            for (size_t k = 1; k <= HARMONICS; k++) {
+                m_chain.set_coeffs(i * HARMONICS + k - 1, get_coeffs(source.w * k, c, s));
+
+                const float c_next = 2.f * source.cos_w * c - c_prev;
+                const float s_next = 2.f * source.cos_w * s - s_prev;
+                c_prev = c;
+                s_prev = s;
+                c = c_next;
+                s = s_next;
+            }
+        }
+        m_chain.set_stages(count * HARMONICS);
+    }
+
+    /**
+     * Filter one sample through all active notches
+     */
+    vector3f process(const vector3f& sample) noexcept
+    {
+        return m_chain.process(sample);
+    }
+
+private:
+    struct source_s {
+        // Tracked frequency in rad/sample and its cosine and sine
+        float w = 0.f;
+        float cos_w = 1.f;
+        float sin_w = 0.f;
+    };
+
+    /**
+     * Rotate the tracked frequency towards the target
+     */
+    static void track(source_s& source, float target) noexcept
+    {
+        float d = target - source.w;
+        d = d > MAX_STEP ? MAX_STEP : (d < -MAX_STEP ? -MAX_STEP : d);
+        if (d == 0.f)
+            return;
+
+        // Taylor series are accurate to 1e-6 for |d| <= MAX_STEP
+        const float d2 = d * d;
+        const float cos_d = 1.f - d2 / 2.f + d2 * d2 / 24.f;
+        const float sin_d = d * (1.f - d2 / 6.f);
+
+        float c = source.cos_w * cos_d - source.sin_w * sin_d;
+        float s = source.sin_w * cos_d + source.cos_w * sin_d;
+
+        // One newton step back to the unit circle, so the errors do not accumulate
+        const float scale = (3.f - (c * c + s * s)) / 2.f;
+        source.cos_w = c * scale;
+        source.sin_w = s * scale;
+        source.w += d;
+    }
+
+    /**
+     * Notch coefficients for the center frequency `w` in rad/sample
+     * @see biquad_coeffs_s::design
+     */
+    biquad_coeffs_s get_coeffs(float w, float cos_w, float sin_w) const noexcept
+    {
+        // Pass-through outside of the valid range
+        if (w < m_min_w || w > m_max_w)
+            return biquad_coeffs_s {};
+
+        const float alpha = sin_w * m_alpha_scale;
+        const float inv_a0 = 1.f / (1.f + alpha);
+
+        biquad_coeffs_s result;
+        result.b0 = inv_a0;
+        result.b1 = -2.f * cos_w * inv_a0;
+        result.b2 = inv_a0;
+        result.a1 = result.b1;
+        result.a2 = (1.f - alpha) * inv_a0;
+        return result;
+    }
+
+private:
+    biquad_chain<MAX_NOTCHES> m_chain;
+    source_s m_sources[MAX_SOURCES];
+
+    float m_sample_rate = 1.f;
+    float m_alpha_scale = 0.f;
+    float m_min_w = 0.f;
+    float m_max_w = 0.f;
+};
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "mp/drivers/clock.hpp"
+#include "util/seqlock.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace mp {
+
+/**
+ * Distribution of measured latencies
+ *
+ * Bins are logarithmic, bin `i` counts the latencies in `[2^i, 2^(i+1))`
+ * microseconds (bin 0 also counts 0), and the last bin counts everything
+ * longer, so a few microseconds and tens of milliseconds both fit.
+ */
+struct latency_histogram_s {
+    static constexpr size_t BINS = 16;
+
+    uint32_t bins[BINS] = {};
+    uint32_t count = 0;
+    timestamp_t max = timestamp_t::zero();
+    // Sum of all latencies, used for the mean
+    timestamp_t total = timestamp_t::zero();
+
+    timestamp_t get_mean() const noexcept
+    {
+        return count ? total / count : timestamp_t::zero();
+    }
+
+    /**
+     * Lower bound of the bin
+     */
+    static timestamp_t get_bin_start(size_t bin) noexcept
+    {
+        return bin ? timestamp_t(int64_t(1) << bin) : timestamp_t::zero();
+    }
+};
+
+/**
+ * Records latencies into a histogram
+ *
+ * Updated by a single task and published without locking for the other tasks to read
+ * @see period_stats
+ */
+class latency_histogram {
+
+public:
+    /**
+     * Add a measured latency
+     * @note Must only be called from a single task
+     */
+    void record(timestamp_t latency) noexcept
+    {
+        // Timestamps from different sources can be slightly out of order
+        const int64_t us = latency.count() > 0 ? latency.count() : 0;
+
+        size_t bin = 0;
+        while (bin + 1 < latency_histogram_s::BINS && (us >> (bin + 1)) > 0)
+            bin++;
+
+        m_histogram.bins[bin]++;
+        m_histogram.count++;
+        if (timestamp_t(us) > m_histogram.max)
+            m_histogram.max = timestamp_t(us);
+        m_histogram.total += timestamp_t(us);
+
+        m_published.write(m_histogram);
+    }
+
+    /**
+     * Consistent copy of the histogram
+     */
+    latency_histogram_s get() const noexcept
+    {
+        return m_published.read();
+    }
+
+private:
+    // Working copy, only accessed by the recording task
+    latency_histogram_s m_histogram;
+    seqlock<latency_histogram_s> m_published;
+};
+
+}
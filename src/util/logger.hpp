@@ -1,9 +1,26 @@
 #pragma once
 
 #include "emblib/common/logger.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 
 #define MP_LOGGER_USE_PROTOBUF      0
 
+// Log records in the compact binary format instead of text,
+// usually set with the MINIPILOT_BINARY_LOG cmake option
+#ifndef MP_LOGGER_BINARY
+#define MP_LOGGER_BINARY            0
+#endif
+
+// Directory of the repository with a trailing separator, stripped from the
+// file of a binary log call site, set by cmake together with MP_LOGGER_BINARY
+#ifndef MP_SOURCE_ROOT
+#define MP_SOURCE_ROOT              ""
+#endif
+
 namespace mp {
 
 /**
@@ -16,22 +33,220 @@ inline constexpr size_t LOGGER_MAX_INPUT_SIZE = 110;
 // String size + prefix and suffix
 inline constexpr size_t LOGGER_MAX_TOTAL_SIZE = LOGGER_MAX_INPUT_SIZE + 16;
 
+// Binary record size limit in bytes, arguments which do not fit are dropped
+inline constexpr size_t LOGGER_BINARY_MAX_SIZE = 48;
+// Longest runtime (not literal) string argument in a binary record
+inline constexpr size_t LOGGER_BINARY_MAX_STRING = 16;
+
+/**
+ * Binary log record format (little endian)
+ *
+ * `SYNC`, size of the rest of the record (1 byte), level (1 byte),
+ * call site id (4 bytes), and then each argument as a tag followed by
+ * its value. String literals are not sent at all, the host decoder
+ * (python/log_decoder.py) takes them from the call site in the sources.
+ */
+namespace binary_log {
+
+inline constexpr uint8_t SYNC = 0xA5;
+inline constexpr size_t HEADER_SIZE = 7;
+
+enum tag_e : uint8_t {
+    TAG_LITERAL,    // No value, the text is in the sources
+    TAG_BOOL,       // 1 byte
+    TAG_INT,        // Zigzag encoded varint
+    TAG_UINT,       // Varint
+    TAG_FLOAT,      // 4 bytes
+    TAG_DOUBLE,     // 8 bytes
+    TAG_STRING      // Length (1 byte) and the characters
+};
+
+/**
+ * Identifier of a log call site, FNV-1a hash of the path of the file
+ * relative to `MP_SOURCE_ROOT` (with `/` separators) and the line number,
+ * so that files with the same name in different directories do not collide
+ */
+constexpr uint32_t site_id(const char* file, uint32_t line) noexcept
+{
+    // Files outside of the root are hashed with their full path
+    const char* path = file;
+    const char* root = MP_SOURCE_ROOT;
+    for (; *root && *path == *root; root++)
+        path++;
+    if (*root)
+        path = file;
+
+    uint32_t hash = 2166136261u;
+    for (const char* c = path; *c; c++)
+        hash = (hash ^ static_cast<uint8_t>(*c == '\\' ? '/' : *c)) * 16777619u;
+    for (size_t i = 0; i < 4; i++)
+        hash = (hash ^ static_cast<uint8_t>(line >> (8 * i))) * 16777619u;
+    return hash;
+}
+
+/**
+ * Record being encoded, once an argument does not fit the rest are dropped
+ */
+class record {
+
+public:
+    record(log_level_e level, uint32_t id) noexcept
+    {
+        m_data[0] = SYNC;
+        m_data[2] = static_cast<uint8_t>(level);
+        for (size_t i = 0; i < 4; i++)
+            m_data[3 + i] = static_cast<uint8_t>(id >> (8 * i));
+        m_size = HEADER_SIZE;
+    }
+
+    template <typename item_type>
+    void add(const item_type& item) noexcept
+    {
+        using type = std::decay_t<item_type>;
+
+        if constexpr (std::is_array_v<item_type> &&
+                      std::is_same_v<std::remove_cv_t<std::remove_extent_t<item_type>>, char>) {
+            put_tag(TAG_LITERAL, 0);
+        } else if constexpr (std::is_same_v<type, const char*> || std::is_same_v<type, char*>) {
+            const size_t length = strnlen(item, LOGGER_BINARY_MAX_STRING);
+            if (put_tag(TAG_STRING, 1 + length)) {
+                m_data[m_size++] = static_cast<uint8_t>(length);
+                std::memcpy(&m_data[m_size], item, length);
+                m_size += length;
+            }
+        } else if constexpr (std::is_same_v<type, bool>) {
+            if (put_tag(TAG_BOOL, 1))
+                m_data[m_size++] = item;
+        } else if constexpr (std::is_enum_v<type>) {
+            add(static_cast<std::underlying_type_t<type>>(item));
+        } else if constexpr (std::is_integral_v<type> && std::is_signed_v<type>) {
+            // Zigzag maps small negative numbers to small varints
+            const uint64_t value = static_cast<int64_t>(item);
+            put_varint(TAG_INT, (value << 1) ^ (item < 0 ? ~uint64_t(0) : 0));
+        } else if constexpr (std::is_integral_v<type>) {
+            put_varint(TAG_UINT, static_cast<uint64_t>(item));
+        } else if constexpr (std::is_same_v<type, float>) {
+            put_raw(TAG_FLOAT, item);
+        } else if constexpr (std::is_floating_point_v<type>) {
+            put_raw(TAG_DOUBLE, static_cast<double>(item));
+        } else {
+            static_assert(!sizeof(type), "Type not supported by the binary log");
+        }
+    }
+
+    /**
+     * Complete record, with the size filled in
+     */
+    const char* get_data() noexcept
+    {
+        m_data[1] = static_cast<uint8_t>(m_size - 2);
+        return reinterpret_cast<const char*>(m_data);
+    }
+
+    size_t get_size() const noexcept
+    {
+        return m_size;
+    }
+
+private:
+    // Reserve the tag and `size` bytes of the value
+    bool put_tag(tag_e tag, size_t size) noexcept
+    {
+        if (m_full || m_size + 1 + size > LOGGER_BINARY_MAX_SIZE) {
+            m_full = true;
+            return false;
+        }
+        m_data[m_size++] = tag;
+        return true;
+    }
+
+    void put_varint(tag_e tag, uint64_t value) noexcept
+    {
+        size_t size = 1;
+        for (uint64_t v = value >> 7; v; v >>= 7)
+            size++;
+        if (!put_tag(tag, size))
+            return;
+        for (; value >= 0x80; value >>= 7)
+            m_data[m_size++] = static_cast<uint8_t>(value | 0x80);
+        m_data[m_size++] = static_cast<uint8_t>(value);
+    }
+
+    template <typename value_type>
+    void put_raw(tag_e tag, value_type value) noexcept
+    {
+        // Targets and the host are little endian
+        if (put_tag(tag, sizeof(value))) {
+            std::memcpy(&m_data[m_size], &value, sizeof(value));
+            m_size += sizeof(value);
+        }
+    }
+
+private:
+    uint8_t m_data[LOGGER_BINARY_MAX_SIZE];
+    size_t m_size;
+    bool m_full = false;
+};
+
+}
+
 /**
  * Minipilot logger
  * 
  * Converts messages to a protobuf log message format
- * and sends them to a logging char dev
+ * and sends them to a logging char dev, or with `MP_LOGGER_BINARY`
+ * only encodes the arguments and leaves the formatting to the host
  */
 class logger : public emblib::logger<LOGGER_MAX_INPUT_SIZE> {
 
 public:
     static logger& get_instance() noexcept;
 
+#if MP_LOGGER_BINARY
+    /**
+     * Device and level are also kept here for the binary records
+     */
+    void set_output_device(emblib::char_dev& log_device) noexcept
+    {
+        m_binary_device = &log_device;
+        emblib::logger<LOGGER_MAX_INPUT_SIZE>::set_output_device(log_device);
+    }
+
+    void set_output_level(log_level_e level) noexcept
+    {
+        m_binary_level = level;
+        emblib::logger<LOGGER_MAX_INPUT_SIZE>::set_output_level(level);
+    }
+
+    /**
+     * Encode the arguments and write the record, without any formatting
+     * (the record is on the caller stack), so this is cheap enough for the
+     * realtime tasks. The log task copies the record into its ring without
+     * locking, see `byte_ring`, but other devices may block.
+     */
+    template <uint32_t ID, typename ...item_types>
+    void log_binary(log_level_e level, const item_types& ...items) noexcept
+    {
+        emblib::char_dev* log_device = m_binary_device;
+        if (!log_device || static_cast<int>(level) < static_cast<int>(m_binary_level))
+            return;
+
+        binary_log::record record(level, ID);
+        (record.add(items), ...);
+        log_device->write(record.get_data(), record.get_size(), std::chrono::milliseconds(0));
+    }
+#endif
+
 private:
     // Singleton
     logger() : emblib::logger<LOGGER_MAX_INPUT_SIZE>(nullptr) {}
 
     void flush(log_level_e level, const buffer_t& buffer, emblib::char_dev& log_device) noexcept override;
+
+#if MP_LOGGER_BINARY
+    emblib::char_dev* m_binary_device = nullptr;
+    log_level_e m_binary_level = log_level_e::DEBUG;
+#endif
 };
 
 static void log_set_level(log_level_e level) noexcept
@@ -39,6 +254,22 @@ static void log_set_level(log_level_e level) noexcept
     logger::get_instance().set_output_level(level);
 }
 
+#if MP_LOGGER_BINARY
+
+/**
+ * Logging calls are macros in the binary mode, so that the call site id
+ * is computed at compile time from the file and line of the call
+ */
+#define MP_LOG_BINARY(level, ...) \
+    ::mp::logger::get_instance().log_binary<::mp::binary_log::site_id(__FILE__, __LINE__)>(level, __VA_ARGS__)
+
+#define log_debug(...)      MP_LOG_BINARY(::mp::log_level_e::DEBUG, __VA_ARGS__)
+#define log_info(...)       MP_LOG_BINARY(::mp::log_level_e::INFO, __VA_ARGS__)
+#define log_warning(...)    MP_LOG_BINARY(::mp::log_level_e::WARNING, __VA_ARGS__)
+#define log_error(...)      MP_LOG_BINARY(::mp::log_level_e::ERROR, __VA_ARGS__)
+
+#else
+
 template <typename ...item_types>
 static void log_debug(item_types&& ...items) noexcept
 {
@@ -63,4 +294,6 @@ static void log_error(item_types&& ...items) noexcept
     logger::get_instance().log(log_level_e::ERROR, items...);
 }
 
+#endif
+
 }
\ No newline at end of file
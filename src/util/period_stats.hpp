@@ -0,0 +1,88 @@
+#pragma once
+
+#include "mp/drivers/clock.hpp"
+#include "util/seqlock.hpp"
+#include <cstdint>
+
+namespace mp {
+
+/**
+ * Statistics of the measured periods of a periodic task
+ */
+struct period_stats_s {
+    // Number of measured periods
+    uint32_t count = 0;
+    // Periods at least 1.5 times longer than planned, so at least one was missed
+    uint32_t overruns = 0;
+    timestamp_t min = timestamp_t::max();
+    timestamp_t max = timestamp_t::zero();
+    // Sum of all measured periods, used for the mean
+    timestamp_t total = timestamp_t::zero();
+    // Largest difference between the measured and the planned period
+    timestamp_t max_error = timestamp_t::zero();
+
+    timestamp_t get_mean() const noexcept
+    {
+        return count ? total / count : timestamp_t::zero();
+    }
+};
+
+/**
+ * Records the gap between the planned and the measured period of a task
+ *
+ * Updated by the task itself every iteration and
+ * published without locking for the other tasks to read
+ */
+class period_stats {
+
+public:
+    explicit period_stats(timestamp_t planned) noexcept :
+        m_planned(planned)
+    {}
+
+    /**
+     * Add a measured period
+     * @note Must only be called from the measured task
+     */
+    void record(timestamp_t measured) noexcept
+    {
+        const timestamp_t error = measured > m_planned ? measured - m_planned : m_planned - measured;
+
+        m_stats.count++;
+        if (2 * measured >= 3 * m_planned)
+            m_stats.overruns++;
+        if (measured < m_stats.min)
+            m_stats.min = measured;
+        if (measured > m_stats.max)
+            m_stats.max = measured;
+        if (error > m_stats.max_error)
+            m_stats.max_error = error;
+        m_stats.total += measured;
+
+        m_published.write(m_stats);
+    }
+
+    /**
+     * Planned period of the task
+     */
+    timestamp_t get_planned() const noexcept
+    {
+        return m_planned;
+    }
+
+    /**
+     * Consistent copy of the statistics
+     */
+    period_stats_s get() const noexcept
+    {
+        return m_published.read();
+    }
+
+private:
+    timestamp_t m_planned;
+    // Working copy, only accessed by the measured task
+    period_stats_s m_stats;
+    seqlock<period_stats_s> m_published;
+};
+
+}
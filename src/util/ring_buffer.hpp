@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace mp {
+
+/**
+ * Bounded single producer single consumer ring buffer
+ *
+ * Lock free, so the producer (usually a realtime sensor task) never
+ * blocks on the consumer. If the buffer is full, new items are dropped
+ * and counted, so the consumer can detect that it is not keeping up.
+ *
+ * @note Only one task may push and only one task may pop
+ */
+template <typename item_type, size_t SIZE>
+class ring_buffer {
+
+    // One slot is always kept empty to distinguish full from empty
+    static constexpr size_t CAPACITY = SIZE + 1;
+
+public:
+    /**
+     * Add an item to the buffer
+     * @returns false if the buffer is full and the item was dropped
+     */
+    bool push(const item_type& item) noexcept
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        const size_t next = (head + 1) % CAPACITY;
+
+        if (next == m_tail.load(std::memory_order_acquire)) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        m_items[head] = item;
+        m_head.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Take the oldest item from the buffer
+     * @returns false if the buffer is empty
+     */
+    bool pop(item_type& item) noexcept
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+
+        if (tail == m_head.load(std::memory_order_acquire))
+            return false;
+
+        item = m_items[tail];
+        m_tail.store((tail + 1) % CAPACITY, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Move up to `max_count` oldest items into `items`
+     * @returns Number of items read
+     */
+    size_t pop_all(item_type* items, size_t max_count) noexcept
+    {
+        size_t count = 0;
+        while (count < max_count && pop(items[count]))
+            count++;
+        return count;
+    }
+
+    /**
+     * Number of items dropped because the buffer was full
+     */
+    size_t get_dropped() const noexcept
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    item_type m_items[CAPACITY];
+    std::atomic<size_t> m_head {0};
+    std::atomic<size_t> m_tail {0};
+    std::atomic<size_t> m_dropped {0};
+};
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace mp {
+
+/**
+ * Single writer multiple reader snapshot of a value
+ *
+ * Lock free, so the writer (usually a realtime task) never blocks and
+ * never waits for the readers. Readers copy the value and retry if it
+ * was being written during the copy, which is detected with a sequence
+ * counter that is odd while a write is in progress.
+ *
+ * @note Only one task may write. Readers should not have a higher priority
+ * than the writer, since a reader which preempts an unfinished write
+ * spins until the writer gets to run again, such readers use `try_read`.
+ */
+template <typename value_type>
+class seqlock {
+
+public:
+    seqlock() = default;
+
+    explicit seqlock(const value_type& value) noexcept :
+        m_value(value)
+    {}
+
+    /**
+     * Publish a new value
+     */
+    void write(const value_type& value) noexcept
+    {
+        const uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        m_value = value;
+
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    /**
+     * Consistent copy of the last published value
+     */
+    value_type read() const noexcept
+    {
+        value_type value;
+        uint32_t begin, end;
+        do {
+            begin = m_sequence.load(std::memory_order_acquire);
+            value = m_value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            end = m_sequence.load(std::memory_order_relaxed);
+        } while ((begin & 1) || begin != end);
+
+        return value;
+    }
+
+    /**
+     * Copy the last published value without waiting
+     * @returns false if a write was in progress, leaving `value` unspecified
+     * @note Meant for readers with a higher priority than the writer
+     */
+    bool try_read(value_type& value) const noexcept
+    {
+        const uint32_t begin = m_sequence.load(std::memory_order_acquire);
+        value = m_value;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint32_t end = m_sequence.load(std::memory_order_relaxed);
+
+        return !(begin & 1) && begin == end;
+    }
+
+private:
+    value_type m_value;
+    std::atomic<uint32_t> m_sequence {0};
+};
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "mp/util/math.hpp"
+#include <cstddef>
+
+namespace mp {
+
+/**
+ * Symmetric matrix which stores only the upper triangle
+ *
+ * Elements are packed column by column (`(0,0), (0,1), (1,1), (0,2), ...`),
+ * so each column of the upper triangle is contiguous. Both `(i, j)` and
+ * `(j, i)` refer to the same element, so the matrix is always exactly
+ * symmetric and takes a bit more than half of the memory of a dense one.
+ */
+template <size_t N>
+class sym_matrix {
+
+public:
+    static constexpr size_t DIM = N;
+    static constexpr size_t PACKED_SIZE = N * (N + 1) / 2;
+
+    /**
+     * Matrix with `value` on the diagonal and zeros elsewhere
+     */
+    static sym_matrix diagonal(float value) noexcept
+    {
+        sym_matrix result;
+        for (size_t i = 0; i < PACKED_SIZE; i++)
+            result.m_data[i] = 0.f;
+        for (size_t i = 0; i < N; i++)
+            result(i, i) = value;
+        return result;
+    }
+
+    float operator()(size_t i, size_t j) const noexcept
+    {
+        return m_data[index(i, j)];
+    }
+
+    float& operator()(size_t i, size_t j) noexcept
+    {
+        return m_data[index(i, j)];
+    }
+
+    /**
+     * Elements `(0, j) ... (j, j)` of the upper triangle
+     */
+    float* column(size_t j) noexcept
+    {
+        return &m_data[j * (j + 1) / 2];
+    }
+
+    const float* column(size_t j) const noexcept
+    {
+        return &m_data[j * (j + 1) / 2];
+    }
+
+    /**
+     * Copy row (or column) `i` of the full matrix
+     */
+    void copy_row(size_t i, float (&row)[N]) const noexcept
+    {
+        const float* upper = column(i);
+        for (size_t j = 0; j <= i; j++)
+            row[j] = upper[j];
+        for (size_t j = i + 1; j < N; j++)
+            row[j] = m_data[j * (j + 1) / 2 + i];
+    }
+
+    /**
+     * Full (dense) matrix
+     * @note Only meant for debugging and interfacing with dense code
+     */
+    matrixf<N> as_dense() const noexcept
+    {
+        matrixf<N> result;
+        for (size_t i = 0; i < N; i++)
+            for (size_t j = 0; j < N; j++)
+                result(i, j) = (*this)(i, j);
+        return result;
+    }
+
+private:
+    static size_t index(size_t i, size_t j) noexcept
+    {
+        return i <= j ? j * (j + 1) / 2 + i : i * (i + 1) / 2 + j;
+    }
+
+private:
+    float m_data[PACKED_SIZE];
+};
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "mp/util/math.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace mp {
+
+/**
+ * Streaming mean and variance of vector samples (Welford's algorithm)
+ *
+ * Nothing is buffered, each sample updates the mean and the sum of squared
+ * differences from the mean, which is numerically stable even for samples
+ * with a large mean and a small variance (a sensor bias for example).
+ * Statistics of separate sample sets can be merged without the samples.
+ */
+template <size_t N>
+class welford {
+
+public:
+    using vector_t = vectorf<N>;
+
+    welford() noexcept
+    {
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        m_count = 0;
+        m_mean = vector_t(0);
+        m_m2 = vector_t(0);
+    }
+
+    /**
+     * Add a single sample
+     */
+    void add(const vector_t& sample) noexcept
+    {
+        m_count++;
+        const float inv_count = 1.f / static_cast<float>(m_count);
+        for (size_t i = 0; i < N; i++) {
+            const float delta = sample(i) - m_mean(i);
+            m_mean(i) += delta * inv_count;
+            m_m2(i) += delta * (sample(i) - m_mean(i));
+        }
+    }
+
+    /**
+     * Add all samples of another set (Chan's parallel update)
+     */
+    void merge(const welford& other) noexcept
+    {
+        if (other.m_count == 0)
+            return;
+
+        const float n_a = static_cast<float>(m_count);
+        const float n_b = static_cast<float>(other.m_count);
+        const float inv_n = 1.f / (n_a + n_b);
+        for (size_t i = 0; i < N; i++) {
+            const float delta = other.m_mean(i) - m_mean(i);
+            m_mean(i) += delta * n_b * inv_n;
+            m_m2(i) += other.m_m2(i) + delta * delta * n_a * n_b * inv_n;
+        }
+        m_count += other.m_count;
+    }
+
+    uint32_t get_count() const noexcept
+    {
+        return m_count;
+    }
+
+    vector_t get_mean() const noexcept
+    {
+        return m_mean;
+    }
+
+    /**
+     * Unbiased (sample) variance of each component
+     */
+    vector_t get_variance() const noexcept
+    {
+        return m_count > 1 ? m_m2 / static_cast<float>(m_count - 1) : vector_t(0);
+    }
+
+    /**
+     * Largest variance of all components
+     */
+    float get_max_variance() const noexcept
+    {
+        const vector_t variance = get_variance();
+        float result = variance(0);
+        for (size_t i = 1; i < N; i++)
+            result = variance(i) > result ? variance(i) : result;
+        return result;
+    }
+
+private:
+    uint32_t m_count;
+    vector_t m_mean;
+    // Sum of the squared differences from the mean
+    vector_t m_m2;
+};
+
+}
@@ -1,6 +1,8 @@
 #include "copter.hpp"
 #include "mp/util/constants.hpp"
 #include "util/logger.hpp"
+#include "util/pb_types.hpp"
+#include "model/model_jacobians.hpp"
 
 namespace mp {
 
@@ -56,28 +58,13 @@ copter::jacobian_s copter::get_jacobian(
 
     const float cd = m_params.lin_drag_c;
     const float m = m_params.mass;
-    const float T = get_thrust();
-
-    const auto& I = m_params.moment_of_inertia;
-    const float Ix = I(0, 0), Iy = I(1, 1), Iz = I(2, 2);
-    
-    const float qw = qv(0), qx = qv(1), qy = qv(2), qz = qv(3);
-    const float wx = w(0), wy = w(1), wz = w(2);
 
     // Simplified model of the inertia matrix is used (only diagonal elements)
     return jacobian_s {
         .da_dv = matrix3f::diagonal(-cd/m),
-        .da_dq = (2 * T / m) * matrixf<3, 4> {
-            {qy, qz, qw, qx},
-            {-qx, -qw, qz, qy},
-            {qw, -qx, -qy, qz}
-        },
+        .da_dq = model::copter_da_dq(get_thrust(), m, qv),
         .ddw_dv = matrixf<3>(0),
-        .ddw_dw = matrixf<3> {
-            {0, (Iy-Iz)*wz/Ix, (Iy-Iz)*wy/Ix},
-            {(Iz-Ix)*wz/Iy, 0, (Iz-Ix)*wx/Iy},
-            {(Ix-Iy)*wy/Iz, (Ix-Iy)*wx/Iz, 0}
-        },
+        .ddw_dw = model::copter_ddw_dw(m_params.moment_of_inertia, w),
         .ddw_dq = matrixf<3, 4>(0)
     };
 }
@@ -122,6 +109,25 @@ void copter::update(const state_s& state, float dt) noexcept
     actuate(m_controller.get_thrust(), m_controller.get_torque());
 }
 
+actuation_s copter::get_actuation() const noexcept
+{
+    actuation_s actuation;
+    actuation.thrust = m_controller.get_thrust();
+    actuation.torque = m_controller.get_torque();
+    return actuation;
+}
+
+bool copter::get_telemetry(const actuation_s& actuation, pb::TelemetryMessage& message) const noexcept
+{
+    pb::vehicles::CopterTelemetry* telemetry = message.mutable_copter();
+    telemetry->set_thrust(actuation.thrust);
+    set_pb_vector3f(telemetry->mutable_torque(), actuation.torque);
+    for (size_t i = 0; i < actuation.motor_count; i++) {
+        telemetry->add_motors(actuation.motors[i]);
+    }
+    return true;
+}
+
 bool copter::handle_command(const pb::Command& command) noexcept
 {
     if (!command.has_copter_command()) {
@@ -41,6 +41,17 @@ public:
      */
     bool handle_command(const pb::Command& command) noexcept override;
 
+    /**
+     * Thrust and torque of the controller, motor commands
+     * are added by the specific copter implementation
+     */
+    actuation_s get_actuation() const noexcept override;
+
+    /**
+     * Controller outputs and motor commands as `CopterTelemetry`
+     */
+    bool get_telemetry(const actuation_s& actuation, pb::TelemetryMessage& message) const noexcept override;
+
     /**
      * Returns the acceleration of the model in the global coordinate frame
      * assuming that thrust is produced in the model::UP direction
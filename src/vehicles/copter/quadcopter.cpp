@@ -34,6 +34,35 @@ quadcopter::motor_speeds_s quadcopter::read_motor_speeds(bool square) const noex
     return result;
 }
 
+motor_frequencies_s quadcopter::get_motor_frequencies() const noexcept
+{
+    motor_frequencies_s result;
+    if (m_params.motor_max_frequency <= 0.f)
+        return result;
+
+    const motor_speeds_s speeds = read_motor_speeds();
+    const float f = m_params.motor_max_frequency;
+    result.hz[0] = speeds.fl * f;
+    result.hz[1] = speeds.fr * f;
+    result.hz[2] = speeds.bl * f;
+    result.hz[3] = speeds.br * f;
+    result.count = 4;
+    return result;
+}
+
+actuation_s quadcopter::get_actuation() const noexcept
+{
+    actuation_s actuation = copter::get_actuation();
+
+    const motor_speeds_s speeds = read_motor_speeds();
+    actuation.motors[0] = speeds.fl;
+    actuation.motors[1] = speeds.fr;
+    actuation.motors[2] = speeds.bl;
+    actuation.motors[3] = speeds.br;
+    actuation.motor_count = 4;
+    return actuation;
+}
+
 quadcopter::motor_speeds_s quadcopter::get_motor_directions() const noexcept
 {
     motor_speeds_s result;
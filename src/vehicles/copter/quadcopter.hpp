@@ -14,6 +14,9 @@ struct quadcopter_params_s : public copter_params_s {
     float thrust_coeff;
     // Torque at max throttle (assuming Tau = torque_coeff * throttle^2)
     float torque_coeff;
+    // Motor rotation frequency in Hz at max throttle, 0 if unknown
+    // (speed is proportional to the throttle since T ~ speed^2)
+    float motor_max_frequency = 0.f;
 };
 
 struct quadcopter_actuators_s {
@@ -33,6 +36,16 @@ public:
         copter(params, controller), m_params(params), m_actuators(actuators)
     {}
 
+    /**
+     * Motor frequencies estimated from the throttles
+     */
+    motor_frequencies_s get_motor_frequencies() const noexcept override;
+
+    /**
+     * Controller outputs and the motor throttles
+     */
+    actuation_s get_actuation() const noexcept override;
+
 private:
     /**
      * Computes the needed speeds via inverse_mma and assigns them to the appropriate motors
@@ -62,7 +62,16 @@ public:
         const vector4f& qv
     ) const noexcept = 0;
 
-    /// @todo Add get_process_noise() which returns the covariance matrix
+    /**
+     * Process noise of the model, representing how well the model
+     * describes the actual motion of the vehicle
+     * @note Read once when the estimator is created, later changes
+     * should be passed to the estimator's `set_process_noise`
+     */
+    virtual process_noise_s get_process_noise() const noexcept
+    {
+        return process_noise_s {};
+    }
 };
 
 }
\ No newline at end of file
@@ -3,9 +3,34 @@
 #include "mp/util/math.hpp"
 #include "state/state_estimator.hpp"
 #include "pb/command.pb.h"
+#include "pb/telemetry.pb.h"
 
 namespace mp {
 
+/**
+ * Rotation frequencies of the vehicle motors in Hz
+ * @note Used for tracking the motor vibrations in the sensor data
+ */
+struct motor_frequencies_s {
+    static constexpr size_t MAX_MOTORS = 8;
+
+    float hz[MAX_MOTORS];
+    size_t count = 0;
+};
+
+/**
+ * Outputs of the last vehicle update
+ * @note Used for recording the control loop in the blackbox
+ */
+struct actuation_s {
+    // Thrust and torque requested by the controller
+    float thrust = 0.f;
+    vector3f torque {0, 0, 0};
+    // Command of each motor, usually the throttle
+    float motors[motor_frequencies_s::MAX_MOTORS];
+    size_t motor_count = 0;
+};
+
 /**
  * Base class for all vehicles
  * 
@@ -31,6 +56,34 @@ public:
      */
     virtual bool handle_command(const pb::Command& command) noexcept = 0;
 
+    /**
+     * Get the current rotation frequency of each motor
+     * @note Vehicles without (known) motor speeds return no motors
+     */
+    virtual motor_frequencies_s get_motor_frequencies() const noexcept
+    {
+        return {};
+    }
+
+    /**
+     * Get the control outputs and actuator commands of the last update
+     * @note Vehicles without a thrust and torque controller return zeros
+     */
+    virtual actuation_s get_actuation() const noexcept
+    {
+        return {};
+    }
+
+    /**
+     * Fill in the vehicle specific telemetry from the published outputs
+     * @note Called from the telemetry task, so it must only use `actuation`
+     * @returns false if the vehicle has no specific telemetry
+     */
+    virtual bool get_telemetry(const actuation_s& actuation, pb::TelemetryMessage& message) const noexcept
+    {
+        return false;
+    }
+
     /**
      * Get information about onboard sensors
      * @note Should provide a list of all available sensors and a task
@@ -0,0 +1,31 @@
+# Round trip of the binary log, the records written by minipilot-log-roundtrip
+# must be decoded by python/log_decoder.py into the text it expects
+#
+# Variables: PROGRAM, PYTHON, SOURCE_ROOT, WORK_DIR
+
+set(log_file "${WORK_DIR}/log_roundtrip.bin")
+set(expected_file "${WORK_DIR}/log_roundtrip.expected.txt")
+
+execute_process(
+    COMMAND "${PROGRAM}" "${log_file}" "${expected_file}"
+    RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Writing the binary log failed: ${result}")
+endif()
+
+execute_process(
+    COMMAND "${PYTHON}" "${SOURCE_ROOT}/python/log_decoder.py" "${log_file}"
+        --sources "${SOURCE_ROOT}/src" "${SOURCE_ROOT}/include" "${SOURCE_ROOT}/tools/bench/src"
+        --root "${SOURCE_ROOT}"
+    RESULT_VARIABLE result
+    OUTPUT_VARIABLE decoded
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Decoding the binary log failed: ${result}")
+endif()
+
+file(READ "${expected_file}" expected)
+if(NOT decoded STREQUAL expected)
+    message(FATAL_ERROR "Decoded log:\n${decoded}\ndiffers from the expected:\n${expected}")
+endif()
@@ -0,0 +1,114 @@
+#include "bench.hpp"
+#include <algorithm>
+#include <cstring>
+#include <ucontext.h>
+
+namespace mp::bench {
+
+// Size of the stack used for the stack measurement
+static constexpr size_t BENCH_STACK_SIZE = 256 * 1024;
+// Value used to paint the stack before running the operation
+static constexpr uint8_t BENCH_STACK_PATTERN = 0xa5;
+
+// Context switching state for the stack measurement
+static ucontext_t g_main_context;
+static ucontext_t g_op_context;
+static void (*g_op_fn)(void*);
+static void* g_op;
+
+static void op_trampoline() noexcept
+{
+    g_op_fn(g_op);
+}
+
+bench_runner::bench_runner(size_t iterations, std::string filter) noexcept :
+    m_iterations(iterations ? iterations : 1),
+    m_filter(std::move(filter)),
+    m_random(BENCH_SEED),
+    m_timer_overhead_ns(0)
+{
+    using clock = std::chrono::steady_clock;
+
+    // Minimum is used since the overhead is only ever increased by interrupts
+    double overhead = 1e9;
+    for (size_t i = 0; i < 10000; i++) {
+        const clock::time_point start = clock::now();
+        const double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        overhead = std::min(overhead, ns);
+    }
+    m_timer_overhead_ns = overhead;
+}
+
+bool bench_runner::is_enabled(const char* name) const noexcept
+{
+    return m_filter.empty() || std::strstr(name, m_filter.c_str());
+}
+
+size_t bench_runner::measure_stack(op_fn_t fn, void* op) noexcept
+{
+    static std::vector<uint8_t> stack(BENCH_STACK_SIZE);
+    std::fill(stack.begin(), stack.end(), BENCH_STACK_PATTERN);
+
+    g_op_fn = fn;
+    g_op = op;
+
+    getcontext(&g_op_context);
+    g_op_context.uc_stack.ss_sp = stack.data();
+    g_op_context.uc_stack.ss_size = stack.size();
+    g_op_context.uc_link = &g_main_context;
+    makecontext(&g_op_context, op_trampoline, 0);
+    swapcontext(&g_main_context, &g_op_context);
+
+    // Stack grows downwards, so the untouched part is at the beginning
+    size_t untouched = 0;
+    while (untouched < stack.size() && stack[untouched] == BENCH_STACK_PATTERN)
+        untouched++;
+
+    return stack.size() - untouched;
+}
+
+void bench_runner::add_result(const char* name, double ns_per_op, size_t stack_bytes) noexcept
+{
+    std::sort(m_samples.begin(), m_samples.end());
+    const size_t p999_index = std::min(m_samples.size() - 1, m_samples.size() * 999 / 1000);
+
+    const auto correct = [this](double ns) {return std::max(0.0, ns - m_timer_overhead_ns);};
+
+    m_results.push_back(bench_result_s {
+        .name = name,
+        .iterations = m_iterations,
+        .ns_per_op = ns_per_op,
+        .ns_p999 = correct(m_samples[p999_index]),
+        .ns_max = correct(m_samples.back()),
+        .stack_bytes = stack_bytes
+    });
+}
+
+void bench_runner::print_table(std::FILE* file) const noexcept
+{
+    std::fprintf(file, "%-40s %12s %12s %12s %10s\n", "benchmark", "ns/op", "p99.9 ns", "max ns", "stack B");
+    for (const bench_result_s& result : m_results) {
+        std::fprintf(file, "%-40s %12.1f %12.1f %12.1f %10zu\n",
+            result.name.c_str(), result.ns_per_op, result.ns_p999, result.ns_max, result.stack_bytes
+        );
+    }
+}
+
+void bench_runner::print_json(std::FILE* file) const noexcept
+{
+    std::fprintf(file, "{\n  \"seed\": %u,\n  \"timer_overhead_ns\": %.1f,\n  \"benchmarks\": [",
+        BENCH_SEED, m_timer_overhead_ns
+    );
+    for (size_t i = 0; i < m_results.size(); i++) {
+        const bench_result_s& result = m_results[i];
+        std::fprintf(file,
+            "%s\n    {\"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.2f, "
+            "\"ns_p999\": %.2f, \"ns_max\": %.2f, \"stack_bytes\": %zu}",
+            i ? "," : "", result.name.c_str(), result.iterations, result.ns_per_op,
+            result.ns_p999, result.ns_max, result.stack_bytes
+        );
+    }
+    std::fprintf(file, "\n  ]\n}\n");
+}
+
+}
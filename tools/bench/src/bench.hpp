@@ -0,0 +1,161 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace mp::bench {
+
+/**
+ * Seed of the random generator used for benchmark inputs, fixed
+ * so that results of different commits can be compared
+ */
+inline constexpr uint32_t BENCH_SEED = 0x6d70u;
+
+/**
+ * Measurements of a single benchmark
+ */
+struct bench_result_s {
+    std::string name;
+    size_t iterations;
+    // Mean time of a single operation
+    double ns_per_op;
+    // 99.9th percentile and maximum of individually timed operations,
+    // with the timer overhead removed, as an estimate of the worst case
+    double ns_p999;
+    double ns_max;
+    // Maximum stack usage of a single operation
+    size_t stack_bytes;
+};
+
+/**
+ * Runs benchmarks and collects their results
+ * 
+ * Every benchmark is run three times:
+ * - in a tight loop timed as a whole for the mean time per operation
+ * - timing every operation separately for the tail of the distribution
+ * - once on a separate painted stack to find the stack high-water mark
+ */
+class bench_runner {
+
+    // Type erased operation, used only for the stack measurement
+    using op_fn_t = void(*)(void* op);
+
+public:
+    /**
+     * @param iterations Number of operations in each timed run
+     * @param filter Only benchmarks whose name contains this string are run
+     */
+    explicit bench_runner(size_t iterations, std::string filter = {}) noexcept;
+
+    /**
+     * Benchmark a callable with no arguments
+     * @note `op` is called many times, so it should always
+     * do the same amount of work (cycle through prepared inputs)
+     */
+    template <typename op_type>
+    void run(const char* name, op_type&& op) noexcept
+    {
+        if (!is_enabled(name))
+            return;
+
+        using clock = std::chrono::steady_clock;
+
+        // Warm up caches and branch predictors
+        for (size_t i = 0; i < m_iterations / 10 + 1; i++)
+            op();
+
+        const clock::time_point start = clock::now();
+        for (size_t i = 0; i < m_iterations; i++)
+            op();
+        const double total_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+        m_samples.resize(m_iterations);
+        for (size_t i = 0; i < m_iterations; i++) {
+            const clock::time_point op_start = clock::now();
+            op();
+            m_samples[i] = std::chrono::duration<double, std::nano>(clock::now() - op_start).count();
+        }
+
+        const size_t stack_bytes = measure_stack(
+            [](void* op) {(*static_cast<std::remove_reference_t<op_type>*>(op))();},
+            &op
+        );
+
+        add_result(name, total_ns / m_iterations, stack_bytes);
+    }
+
+    /**
+     * Random generator to be used for benchmark inputs
+     */
+    std::mt19937& get_random() noexcept
+    {
+        return m_random;
+    }
+
+    const std::vector<bench_result_s>& get_results() const noexcept
+    {
+        return m_results;
+    }
+
+    /**
+     * Print results as an aligned table
+     */
+    void print_table(std::FILE* file) const noexcept;
+
+    /**
+     * Print results as a json object, used for tracking between commits
+     */
+    void print_json(std::FILE* file) const noexcept;
+
+private:
+    bool is_enabled(const char* name) const noexcept;
+
+    /**
+     * Run the operation once on a stack filled with a known pattern
+     * @returns Number of bytes of the stack which were overwritten
+     */
+    size_t measure_stack(op_fn_t fn, void* op) noexcept;
+
+    /**
+     * Compute the statistics of the individually timed operations and store the result
+     */
+    void add_result(const char* name, double ns_per_op, size_t stack_bytes) noexcept;
+
+private:
+    size_t m_iterations;
+    std::string m_filter;
+    std::mt19937 m_random;
+
+    // Time of an empty timed section, subtracted from individual samples
+    double m_timer_overhead_ns;
+    std::vector<double> m_samples;
+    std::vector<bench_result_s> m_results;
+};
+
+/**
+ * Benchmarks of the state estimators and the kalman filter kernels
+ */
+void bench_estimators(bench_runner& runner) noexcept;
+
+/**
+ * Benchmarks of the vehicle model, controller and mixer
+ */
+void bench_vehicles(bench_runner& runner) noexcept;
+
+/**
+ * Benchmarks of the sensor filter chains
+ */
+void bench_filters(bench_runner& runner) noexcept;
+
+/**
+ * Benchmarks of the blackbox recording
+ */
+void bench_blackbox(bench_runner& runner) noexcept;
+
+}
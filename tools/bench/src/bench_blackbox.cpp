@@ -0,0 +1,62 @@
+#include "bench.hpp"
+#include "bench_inputs.hpp"
+#include "blackbox/blackbox_encoder.hpp"
+
+namespace mp::bench {
+
+/**
+ * Cost of recording a sample in a realtime task (push into the channel)
+ * and of encoding the records in the blackbox task, where the samples are
+ * noisy readings of a still sensor and the states are random (the worst
+ * case for the delta encoding)
+ */
+void bench_blackbox(bench_runner& runner) noexcept
+{
+    std::mt19937& random = runner.get_random();
+
+    blackbox_sensor_s samples[BENCH_INPUTS];
+    state_s states[BENCH_INPUTS];
+    for (size_t i = 0; i < BENCH_INPUTS; i++) {
+        samples[i].raw = vector3f {0, 0, 9.81f} + random_vector(random, 0.05f);
+        samples[i].corrected = samples[i].raw;
+        samples[i].timestamp = timestamp_t(1000 * i);
+        states[i] = random_state(random);
+        states[i].timestamp = timestamp_t(20000 * i);
+    }
+
+    size_t index = 0;
+    blackbox_sensor_channel channel;
+    blackbox_sensor_s popped;
+    runner.run("blackbox.record_sensor", [&]() {
+        // Consumer keeps up, so that the push is never dropped
+        if (!channel.push(samples[index++ % BENCH_INPUTS]))
+            while (channel.pop(popped));
+    });
+
+    // Blocks are written out when full, as in the blackbox task
+    blackbox_encoder encoder;
+    volatile size_t sink;
+    const auto flush = [&]() {
+        const uint8_t* block;
+        sink = encoder.finish(block);
+        encoder.begin();
+    };
+
+    runner.run("blackbox_encoder.add_sensor", [&]() {
+        if (!encoder.add_sensor(BLACKBOX_ACCELEROMETER, 0, samples[index++ % BENCH_INPUTS]))
+            flush();
+    });
+    runner.run("blackbox_encoder.add_state", [&]() {
+        if (!encoder.add_state(states[index++ % BENCH_INPUTS]))
+            flush();
+    });
+
+    // Whole block of samples, including the CRC when it is finished
+    runner.run("blackbox_encoder.block", [&]() {
+        encoder.begin();
+        while (encoder.add_sensor(BLACKBOX_GYROSCOPE, 0, samples[index++ % BENCH_INPUTS]));
+        flush();
+    });
+}
+
+}
@@ -0,0 +1,276 @@
+#include "bench.hpp"
+#include "bench_inputs.hpp"
+#include "bench_quadcopter.hpp"
+#include "state/ekf_ahrs.hpp"
+#include "state/ekf_inertial.hpp"
+#include "state/ekf_error_state.hpp"
+#include "state/mahony_ahrs.hpp"
+#include "state/imu_preintegrator.hpp"
+#include "state/block_kalman.hpp"
+#include "emblib/dsp/kalman.hpp"
+#include <type_traits>
+
+namespace mp::bench {
+
+// Sensor rate and the number of samples fused per correction,
+// same as in the state estimator task
+static constexpr float SENSOR_DT = 0.005f;
+static constexpr size_t SAMPLES_PER_CORRECTION = 4;
+
+/**
+ * Sensor readings of a vehicle in flight
+ */
+struct sensor_inputs_s {
+    vector3f accelerometer[BENCH_INPUTS];
+    vector3f gyroscope[BENCH_INPUTS];
+    matrix3f accelerometer_cov;
+    matrix3f gyroscope_cov;
+
+    explicit sensor_inputs_s(std::mt19937& random) noexcept :
+        accelerometer_cov(matrix3f::diagonal(1e-2f)),
+        gyroscope_cov(matrix3f::diagonal(1e-4f))
+    {
+        for (size_t i = 0; i < BENCH_INPUTS; i++) {
+            const state_s state = random_state(random);
+            accelerometer[i] = state.rotationq.conjugate().rotate_vec(state.acceleration - GV);
+            gyroscope[i] = state.angular_velocity;
+        }
+    }
+
+    sensor_data_s get(size_t index) const noexcept
+    {
+        return sensor_data_s {
+            .accelerometer = &accelerometer[index % BENCH_INPUTS],
+            .accelerometer_cov = &accelerometer_cov,
+            .gyroscope = &gyroscope[index % BENCH_INPUTS],
+            .gyroscope_cov = &gyroscope_cov
+        };
+    }
+};
+
+/**
+ * Time update, measurement update and one period of the estimator task
+ * @param create Returns a new estimator, takes the `kalman_update_e`
+ * for the kalman filter based estimators, which are also run with
+ * the sequential update
+ * @note A new estimator is created for every benchmark so that earlier
+ * runs do not change the covariance seen by the later ones
+ */
+template <typename estimator_type, typename factory_type>
+static void bench_estimator(
+    bench_runner& runner,
+    const char* name,
+    const sensor_inputs_s& inputs,
+    factory_type&& create
+) noexcept
+{
+    constexpr bool HAS_UPDATE_MODES = std::is_invocable_v<factory_type, kalman_update_e>;
+    const auto create_default = [&]() {
+        if constexpr (HAS_UPDATE_MODES)
+            return create(kalman_update_e::BATCH);
+        else
+            return create();
+    };
+
+    size_t index = 0;
+    const std::string prefix = name;
+
+    {
+        estimator_type estimator = create_default();
+        runner.run((prefix + ".predict").c_str(), [&]() {
+            estimator.predict(inputs.get(index++), SENSOR_DT);
+        });
+    }
+    {
+        estimator_type estimator = create_default();
+        runner.run((prefix + ".correct").c_str(), [&]() {
+            estimator.correct(inputs.get(index++));
+        });
+    }
+    if constexpr (HAS_UPDATE_MODES) {
+        estimator_type estimator = create(kalman_update_e::SEQUENTIAL);
+        runner.run((prefix + ".correct.sequential").c_str(), [&]() {
+            estimator.correct(inputs.get(index++));
+        });
+    }
+    {
+        estimator_type estimator = create_default();
+        imu_preintegrator integrator;
+        runner.run((prefix + ".period").c_str(), [&]() {
+            integrator.reset();
+            for (size_t i = 0; i < SAMPLES_PER_CORRECTION; i++) {
+                const sensor_data_s sample = inputs.get(index++);
+                integrator.integrate(*sample.gyroscope, *sample.accelerometer, SENSOR_DT);
+            }
+            const imu_delta_s delta = integrator.get_delta();
+            estimator.predict(sensor_data_s {.imu_delta = &delta}, delta.dt);
+            estimator.correct(inputs.get(index++));
+        });
+    }
+}
+
+/**
+ * Covariance time update `F * P * F^T` with the block structured
+ * jacobian of `ekf_inertial` compared to the dense product
+ */
+static void bench_covariance_kernel(bench_runner& runner) noexcept
+{
+    constexpr size_t DIM = inertial_layout_t::DIM;
+
+    std::mt19937& random = runner.get_random();
+    const inertial_jacobian_t F = inertial_jacobian(random, 1.f, SENSOR_DT);
+
+    const matrixf<DIM> A = random_block<DIM, DIM>(random);
+    sym_matrix<DIM> P;
+    for (size_t i = 0; i < DIM; i++)
+        for (size_t j = i; j < DIM; j++)
+            P(i, j) = A(i, j) + A(j, i);
+    const matrixf<DIM> P_dense = P.as_dense();
+    const matrixf<DIM> F_dense = F.as_dense();
+    matrixf<DIM> FP;
+    sym_matrix<DIM> result;
+    matrixf<DIM> result_dense;
+    volatile float sink;
+
+    runner.run("block_kalman.covariance.block", [&]() {
+        F.multiply(P, FP);
+        F.multiply_transposed_symmetric(FP, result);
+        sink = result(0, 0);
+    });
+
+    runner.run("block_kalman.covariance.dense", [&]() {
+        result_dense = F_dense.matmul(P_dense).matmul(F_dense.transpose());
+        sink = result_dense(0, 0);
+    });
+}
+
+/**
+ * Full iteration (time and measurement update) of `block_kalman` compared to
+ * the dense `emblib::kalman` it replaced, both with the jacobian structure of
+ * `ekf_inertial` and an accelerometer and gyroscope observation
+ */
+static void bench_kalman_update(bench_runner& runner) noexcept
+{
+    constexpr size_t DIM = inertial_layout_t::DIM;
+    constexpr size_t OBS_DIM = 6;
+    using state_vec_t = vectorf<DIM>;
+    using obs_vec_t = vectorf<OBS_DIM>;
+
+    std::mt19937& random = runner.get_random();
+    const inertial_jacobian_t F = inertial_jacobian(random, 1e-3f, SENSOR_DT);
+    const matrixf<DIM> F_dense = F.as_dense();
+
+    // Accelerometer observes the acceleration and rotation, gyroscope the angular velocity and drift
+    matrixf<OBS_DIM, DIM> H(0);
+    H.set_submatrix(0, inertial_layout_t::offset(SEG_A), matrixf<3>::identity());
+    H.set_submatrix(0, inertial_layout_t::offset(SEG_Q), random_block<3, 4>(random));
+    H.set_submatrix(3, inertial_layout_t::offset(SEG_W), matrixf<3>::identity());
+    H.set_submatrix(3, inertial_layout_t::offset(SEG_WD), matrixf<3>::identity());
+
+    const state_vec_t Q(1e-2f);
+    const matrixf<DIM> Q_dense = Q.as_diagonal() * SENSOR_DT;
+    const matrixf<OBS_DIM> R = matrixf<OBS_DIM>::diagonal(1e-2f);
+
+    std::vector<obs_vec_t> observations(BENCH_INPUTS);
+    for (obs_vec_t& z : observations)
+        z = obs_vec_t(random_block<OBS_DIM, 1>(random));
+
+    const auto f = [&](const state_vec_t& x) {return state_vec_t(F_dense.matmul(x));};
+    const auto h = [&](const state_vec_t& x) {return obs_vec_t(H.matmul(x));};
+    const auto H_x = [&](const state_vec_t&) {return H;};
+    state_vec_t x0(0);
+    x0(inertial_layout_t::offset(SEG_Q)) = 1.f;
+    size_t index = 0;
+    volatile float sink;
+
+    block_kalman<inertial_layout_t, 7> block(x0);
+    runner.run("block_kalman.update.block", [&]() {
+        block.update<OBS_DIM>(f, [&](const state_vec_t&) {return F;}, h, H_x,
+            Q, SENSOR_DT, R, observations[index++ % BENCH_INPUTS]);
+        sink = block.get_state()(0);
+    });
+
+    emblib::kalman<DIM> dense(x0);
+    runner.run("block_kalman.update.dense", [&]() {
+        dense.update<OBS_DIM>(f, [&](const state_vec_t&) {return F_dense;}, h, H_x,
+            Q_dense, R, observations[index++ % BENCH_INPUTS]);
+        sink = dense.get_state()(0);
+    });
+}
+
+/**
+ * Coning and sculling compensated integration of a single IMU sample,
+ * which is done for every sample in the estimator task
+ */
+static void bench_preintegrator(bench_runner& runner, const sensor_inputs_s& inputs) noexcept
+{
+    imu_preintegrator integrator;
+    size_t index = 0;
+    volatile float sink;
+
+    runner.run("imu_preintegrator.integrate", [&]() {
+        const size_t i = index++ % BENCH_INPUTS;
+        integrator.integrate(inputs.gyroscope[i], inputs.accelerometer[i], SENSOR_DT);
+        sink = integrator.get_delta().dt;
+    });
+}
+
+/**
+ * Correction of `ekf_inertial` on an iteration where the slow sensors (magnetometer,
+ * GNSS and barometer) also have new data, to compare with `ekf_inertial.correct`
+ */
+static void bench_inertial_all_sensors(
+    bench_runner& runner,
+    const sensor_inputs_s& inputs,
+    const bench_quadcopter& quad
+) noexcept
+{
+    ekf_inertial estimator(quad.vehicle);
+    const vector3f field {0.2f, 0.f, -0.4f};
+    const matrix3f field_cov = matrix3f::diagonal(1e-4f);
+    const vector3f position(0), velocity(0);
+    const matrix3f position_cov = matrix3f::diagonal(4.f);
+    const matrix3f velocity_cov = matrix3f::diagonal(0.25f);
+    const float altitude = 0.f, altitude_var = 1.f;
+    size_t index = 0;
+
+    runner.run("ekf_inertial.correct.all_sensors", [&]() {
+        sensor_data_s input = inputs.get(index++);
+        input.magnetometer = &field;
+        input.magnetometer_cov = &field_cov;
+        input.gnss = &position;
+        input.gnss_cov = &position_cov;
+        input.gnss_velocity = &velocity;
+        input.gnss_velocity_cov = &velocity_cov;
+        input.barometer = &altitude;
+        input.barometer_var = &altitude_var;
+        estimator.correct(input);
+    });
+}
+
+void bench_estimators(bench_runner& runner) noexcept
+{
+    const sensor_inputs_s inputs(runner.get_random());
+    const bench_quadcopter quad;
+
+    bench_covariance_kernel(runner);
+    bench_kalman_update(runner);
+    bench_preintegrator(runner, inputs);
+
+    // Lightweight estimator for low-end targets next to its kalman filter counterpart
+    bench_estimator<mahony_ahrs>(runner, "mahony_ahrs", inputs, []() {
+        return mahony_ahrs();
+    });
+    bench_estimator<ekf_ahrs>(runner, "ekf_ahrs", inputs, [](kalman_update_e mode) {
+        return ekf_ahrs(mode);
+    });
+    bench_estimator<ekf_inertial>(runner, "ekf_inertial", inputs, [&](kalman_update_e mode) {
+        return ekf_inertial(quad.vehicle, mode);
+    });
+    bench_inertial_all_sensors(runner, inputs, quad);
+    bench_estimator<ekf_error_state>(runner, "ekf_error_state", inputs, [&](kalman_update_e mode) {
+        return ekf_error_state(quad.vehicle, mode);
+    });
+}
+
+}
@@ -0,0 +1,82 @@
+#include "bench.hpp"
+#include "bench_inputs.hpp"
+#include "util/biquad.hpp"
+#include "util/harmonic_notch.hpp"
+#include <cmath>
+#include <string>
+
+namespace mp::bench {
+
+static constexpr float SAMPLE_RATE = 1000.f;
+static constexpr size_t MAX_STAGES = 4;
+
+// Typical gyroscope chain, low-pass followed by the notches
+static constexpr biquad_spec_s FILTERS[MAX_STAGES] = {
+    {biquad_type_e::LOW_PASS, 80.f},
+    {biquad_type_e::NOTCH, 120.f, 5.f},
+    {biquad_type_e::NOTCH, 240.f, 5.f},
+    {biquad_type_e::BAND_PASS, 300.f, 2.f}
+};
+
+/**
+ * One three axis sample through a chain of 1 and `MAX_STAGES` stages,
+ * so that the cost per stage and the fixed overhead can be separated,
+ * and the per sample update of the notches following 4 motors
+ */
+void bench_filters(bench_runner& runner) noexcept
+{
+    std::mt19937& random = runner.get_random();
+
+    vector3f samples[BENCH_INPUTS];
+    int32_t samples_fixed[BENCH_INPUTS][3];
+    for (size_t i = 0; i < BENCH_INPUTS; i++) {
+        samples[i] = random_vector(random, 10.f);
+        for (size_t j = 0; j < 3; j++)
+            samples_fixed[i][j] = static_cast<int32_t>(samples[i](j) * 1000.f);
+    }
+
+    volatile float sink;
+    volatile int32_t sink_fixed;
+
+    for (size_t stages : {size_t(1), MAX_STAGES}) {
+        const std::string suffix = "." + std::to_string(stages);
+        size_t index = 0;
+
+        biquad_chain<MAX_STAGES> chain;
+        chain.configure(FILTERS, stages, SAMPLE_RATE);
+        runner.run(("biquad_chain.process" + suffix).c_str(), [&]() {
+            sink = chain.process(samples[index++ % BENCH_INPUTS])(0);
+        });
+
+        biquad_chain_fixed<MAX_STAGES> chain_fixed;
+        chain_fixed.configure(FILTERS, stages, SAMPLE_RATE);
+        runner.run(("biquad_chain_fixed.process" + suffix).c_str(), [&]() {
+            int32_t sample[3];
+            const int32_t* input = samples_fixed[index++ % BENCH_INPUTS];
+            sample[0] = input[0];
+            sample[1] = input[1];
+            sample[2] = input[2];
+            chain_fixed.process(sample);
+            sink_fixed = sample[0];
+        });
+    }
+
+    // Motor frequencies change slowly compared to the sample rate
+    float frequencies[BENCH_INPUTS][4];
+    for (size_t i = 0; i < BENCH_INPUTS; i++) {
+        for (size_t j = 0; j < 4; j++)
+            frequencies[i][j] = 150.f + 10.f * std::sin(0.01f * i + j);
+    }
+
+    size_t index = 0;
+    harmonic_notch<4, 3> notch;
+    notch.configure(SAMPLE_RATE, 5.f, 40.f);
+    runner.run("harmonic_notch.update", [&]() {
+        notch.update(frequencies[index++ % BENCH_INPUTS], 4);
+    });
+    runner.run("harmonic_notch.process", [&]() {
+        sink = notch.process(samples[index++ % BENCH_INPUTS])(0);
+    });
+}
+
+}
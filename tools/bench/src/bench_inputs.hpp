@@ -0,0 +1,83 @@
+#pragma once
+
+#include "state/state_estimator.hpp"
+#include "state/block_kalman.hpp"
+#include <random>
+
+namespace mp::bench {
+
+/**
+ * Number of prepared inputs each benchmark cycles through, so the
+ * input generation is not timed while the branches still see varied data
+ */
+inline constexpr size_t BENCH_INPUTS = 256;
+
+inline vector3f random_vector(std::mt19937& random, float scale) noexcept
+{
+    std::normal_distribution<float> dist(0.f, scale);
+    return vector3f {dist(random), dist(random), dist(random)};
+}
+
+inline quaternionf random_rotation(std::mt19937& random) noexcept
+{
+    std::normal_distribution<float> dist(0.f, 1.f);
+    vector4f qv {dist(random), dist(random), dist(random), dist(random)};
+    qv /= qv.norm();
+    return quaternionf(qv(0), qv(1), qv(2), qv(3));
+}
+
+/**
+ * State of a vehicle in flight
+ */
+inline state_s random_state(std::mt19937& random) noexcept
+{
+    return state_s {
+        .position = random_vector(random, 10.f),
+        .velocity = random_vector(random, 2.f),
+        .acceleration = random_vector(random, 1.f),
+        .angular_velocity = random_vector(random, 1.f),
+        .rotationq = random_rotation(random)
+    };
+}
+
+template <size_t R, size_t C>
+inline matrixf<R, C> random_block(std::mt19937& random) noexcept
+{
+    std::normal_distribution<float> dist(0.f, 1.f);
+    matrixf<R, C> block;
+    for (size_t i = 0; i < R; i++)
+        for (size_t j = 0; j < C; j++)
+            block(i, j) = dist(random);
+    return block;
+}
+
+// State layout and jacobian of `ekf_inertial`
+using inertial_layout_t = block_layout<3, 3, 4, 3, 3, 3>;
+using inertial_jacobian_t = block_jacobian<inertial_layout_t, 7>;
+enum inertial_segment_e : size_t {SEG_V, SEG_A, SEG_Q, SEG_W, SEG_WD, SEG_P};
+
+/**
+ * Jacobian with the same blocks as set by `ekf_inertial::state_transition_jacob`
+ * @param coupling Scale of the random dense blocks, which are added to the
+ * identity on the diagonal so that repeated propagation stays bounded
+ */
+inline inertial_jacobian_t inertial_jacobian(std::mt19937& random, float coupling, float dt) noexcept
+{
+    inertial_jacobian_t F;
+    F.set_identity(SEG_V, SEG_V);
+    F.set_identity(SEG_V, SEG_A, dt);
+    F.set_dense(SEG_A, SEG_V, random_block<3, 3>(random) * coupling);
+    F.set_dense(SEG_A, SEG_Q, random_block<3, 4>(random) * coupling);
+    F.set_dense(SEG_Q, SEG_Q, matrixf<4>::identity() + random_block<4, 4>(random) * coupling);
+    F.set_dense(SEG_Q, SEG_W, random_block<4, 3>(random) * coupling);
+    F.set_dense(SEG_W, SEG_V, random_block<3, 3>(random) * coupling);
+    F.set_dense(SEG_W, SEG_Q, random_block<3, 4>(random) * coupling);
+    F.set_dense(SEG_W, SEG_W, matrixf<3>::identity() + random_block<3, 3>(random) * coupling);
+    F.set_identity(SEG_WD, SEG_WD);
+    F.set_identity(SEG_P, SEG_P);
+    F.set_identity(SEG_P, SEG_V, dt);
+    F.set_identity(SEG_P, SEG_A, dt * dt / 2.f);
+    return F;
+}
+
+}
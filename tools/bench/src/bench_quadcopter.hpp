@@ -0,0 +1,65 @@
+#pragma once
+
+#include "stub_drivers.hpp"
+#include "mp/util/constants.hpp"
+#include "vehicles/copter/quadcopter.hpp"
+#include "vehicles/copter/control/copter_controller_pid.hpp"
+
+namespace mp::bench {
+
+// Designated initializers cannot be used with the copter base, so the fields are assigned
+inline const quadcopter_params_s BENCH_QUADCOPTER_PARAMS = []() {
+    quadcopter_params_s params;
+    params.mass = 1.f;
+    params.moment_of_inertia = matrix3f {
+        {0.01f, 0, 0},
+        {0, 0.01f, 0},
+        {0, 0, 0.02f}
+    };
+    params.lin_drag_c = 0.1f;
+    params.width_half = 0.1f;
+    params.length_half = 0.1f;
+    params.thrust_coeff = 8.f;
+    params.torque_coeff = 0.1f;
+    params.motor_max_frequency = 250.f;
+    return params;
+}();
+
+/**
+ * Quadcopter with nothing to initialize, as a port would provide
+ */
+class bench_quadcopter_vehicle : public quadcopter {
+
+public:
+    using quadcopter::quadcopter;
+
+    bool init() noexcept override
+    {
+        return true;
+    }
+};
+
+/**
+ * Quadcopter with the pid controller and stub motors, already in flight
+ * so that the full model is used instead of the grounded shortcuts
+ */
+struct bench_quadcopter {
+    static constexpr float DT = 0.01f;
+
+    stub_motor fl {true}, fr {false}, bl {false}, br {true};
+    copter_controller_pid controller;
+    bench_quadcopter_vehicle vehicle;
+
+    bench_quadcopter() noexcept :
+        controller(BENCH_QUADCOPTER_PARAMS),
+        vehicle(BENCH_QUADCOPTER_PARAMS, controller, {fl, fr, bl, br})
+    {
+        // Vehicle starts grounded, upwards acceleration switches it to flight
+        state_s takeoff_state;
+        takeoff_state.acceleration = UP;
+        controller.set_target_w(vector3f(0), 10.f);
+        vehicle.update(takeoff_state, DT);
+    }
+};
+
+}
@@ -0,0 +1,57 @@
+#include "bench.hpp"
+#include "bench_inputs.hpp"
+#include "bench_quadcopter.hpp"
+
+namespace mp::bench {
+
+void bench_vehicles(bench_runner& runner) noexcept
+{
+    std::mt19937& random = runner.get_random();
+
+    state_s states[BENCH_INPUTS];
+    for (state_s& state : states)
+        state = random_state(random);
+
+    size_t index = 0;
+    const auto next_state = [&]() -> const state_s& {return states[index++ % BENCH_INPUTS];};
+
+    bench_quadcopter quad;
+    copter_controller_pid& controller = quad.controller;
+    bench_quadcopter_vehicle& vehicle = quad.vehicle;
+    constexpr float dt = bench_quadcopter::DT;
+
+    controller.set_target_w(vector3f {0.1f, -0.2f, 0.3f}, 10.f);
+    runner.run("copter_controller_pid.update.angular", [&]() {
+        controller.update(next_state(), dt);
+    });
+
+    controller.set_target_v(vector3f {1.f, 0.5f, 0.f}, 0.f);
+    runner.run("copter_controller_pid.update.linear", [&]() {
+        controller.update(next_state(), dt);
+    });
+
+    // Controller, mixer (inverse_mma) and motor writes
+    controller.set_target_w(vector3f {0.1f, -0.2f, 0.3f}, 10.f);
+    runner.run("quadcopter.update", [&]() {
+        vehicle.update(next_state(), dt);
+    });
+
+    // Model functions used by the state estimator
+    volatile float sink;
+    runner.run("quadcopter.get_linear_acceleration", [&]() {
+        const state_s& state = next_state();
+        sink = vehicle.get_linear_acceleration(state.velocity, state.rotationq)(0);
+    });
+
+    runner.run("quadcopter.get_angular_acceleration", [&]() {
+        const state_s& state = next_state();
+        sink = vehicle.get_angular_acceleration(state.velocity, state.angular_velocity, state.rotationq)(0);
+    });
+
+    runner.run("quadcopter.get_jacobian", [&]() {
+        const state_s& state = next_state();
+        sink = vehicle.get_jacobian(state.velocity, state.angular_velocity, state.rotationq.as_vector()).da_dq(0, 0);
+    });
+}
+
+}
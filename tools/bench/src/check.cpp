@@ -0,0 +1,46 @@
+#include "check.hpp"
+#include <cstring>
+
+namespace mp::bench {
+
+check_runner::check_runner(std::string filter) noexcept :
+    m_filter(std::move(filter)),
+    m_random(CHECK_SEED)
+{}
+
+bool check_runner::is_enabled(const char* name) const noexcept
+{
+    return m_filter.empty() || std::strstr(name, m_filter.c_str());
+}
+
+void check_runner::add_result(const char* name, double value, double limit) noexcept
+{
+    // NaN never passes
+    m_results.push_back(check_result_s {
+        .name = name,
+        .value = value,
+        .limit = limit,
+        .passed = value <= limit
+    });
+}
+
+size_t check_runner::get_failures() const noexcept
+{
+    size_t failures = 0;
+    for (const check_result_s& result : m_results)
+        failures += result.passed ? 0 : 1;
+    return failures;
+}
+
+void check_runner::print_table(std::FILE* file) const noexcept
+{
+    std::fprintf(file, "%-48s %12s %12s %6s\n", "check", "value", "limit", "result");
+    for (const check_result_s& result : m_results) {
+        std::fprintf(file, "%-48s %12.3e %12.3e %6s\n",
+            result.name.c_str(), result.value, result.limit, result.passed ? "ok" : "FAIL"
+        );
+    }
+    std::fprintf(file, "%zu of %zu checks failed\n", get_failures(), m_results.size());
+}
+
+}
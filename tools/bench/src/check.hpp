@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace mp::bench {
+
+/**
+ * Seed of the random generator used for check inputs, fixed
+ * so that a failing check can be reproduced
+ */
+inline constexpr uint32_t CHECK_SEED = 0x6d71u;
+
+/**
+ * Outcome of a single check
+ */
+struct check_result_s {
+    std::string name;
+    // Measured error and the largest error which passes
+    double value;
+    double limit;
+    bool passed;
+};
+
+/**
+ * Runs numerical checks of the host compiled flight code and collects their results
+ *
+ * Every check measures an error (difference to a reference implementation or
+ * to a known answer) and passes when it is not above its limit. The results
+ * are printed as a table and the program fails if any check failed, so the
+ * checks can be run by ctest.
+ */
+class check_runner {
+
+public:
+    /**
+     * @param filter Only checks whose name contains this string are run
+     */
+    explicit check_runner(std::string filter = {}) noexcept;
+
+    /**
+     * Run a check
+     * @param limit Largest error which passes the check
+     * @param op Called as `double op()` returning the measured error,
+     * not called when the check is filtered out
+     */
+    template <typename op_type>
+    void run(const char* name, double limit, op_type&& op) noexcept
+    {
+        if (!is_enabled(name))
+            return;
+
+        add_result(name, op(), limit);
+    }
+
+    /**
+     * Random generator to be used for check inputs
+     */
+    std::mt19937& get_random() noexcept
+    {
+        return m_random;
+    }
+
+    const std::vector<check_result_s>& get_results() const noexcept
+    {
+        return m_results;
+    }
+
+    size_t get_failures() const noexcept;
+
+    /**
+     * Print results as an aligned table
+     */
+    void print_table(std::FILE* file) const noexcept;
+
+private:
+    bool is_enabled(const char* name) const noexcept;
+
+    void add_result(const char* name, double value, double limit) noexcept;
+
+private:
+    std::string m_filter;
+    std::mt19937 m_random;
+    std::vector<check_result_s> m_results;
+};
+
+/**
+ * Checks of the kalman filter kernels
+ */
+void check_kalman(check_runner& runner) noexcept;
+
+/**
+ * Checks of the state estimators on synthetic motion
+ */
+void check_estimators(check_runner& runner) noexcept;
+
+/**
+ * Checks of the IMU pre-integration on coning and sculling motion
+ */
+void check_preintegrator(check_runner& runner) noexcept;
+
+/**
+ * Checks of the frequency response of the sensor filter chains
+ */
+void check_filters(check_runner& runner) noexcept;
+
+/**
+ * Checks of the generated model jacobian kernels against central differences
+ */
+void check_jacobians(check_runner& runner) noexcept;
+
+/**
+ * Checks of the sensor calibration on synthetic samples and of its storage
+ */
+void check_calibration(check_runner& runner) noexcept;
+
+/**
+ * Checks of the redundant sensor voting on offset, disagreeing and stalled instances
+ */
+void check_voter(check_runner& runner) noexcept;
+
+/**
+ * Checks of the blackbox encoding against a mirror of the host decoder
+ */
+void check_blackbox(check_runner& runner) noexcept;
+
+}
@@ -0,0 +1,427 @@
+#include "check.hpp"
+#include "bench_inputs.hpp"
+#include "blackbox/blackbox_encoder.hpp"
+#include "util/crc32.hpp"
+#include <cmath>
+#include <iterator>
+#include <limits>
+
+namespace mp::bench {
+
+// Resolution of the quantized fields, as in python/blackbox_decoder.py
+static constexpr double SENSOR_RESOLUTION[] = {1e-3, 1e-4, 1e-3};
+static constexpr double STATE_RESOLUTION[16] = {
+    1e-3, 1e-3, 1e-3, 1e-3, 1e-3, 1e-3, 1e-3, 1e-3, 1e-3, 1e-4, 1e-4, 1e-4, 1e-5, 1e-5, 1e-5, 1e-5
+};
+static constexpr double THRUST_RESOLUTION = 1e-3;
+static constexpr double TORQUE_RESOLUTION = 1e-5;
+static constexpr double MOTOR_RESOLUTION = 1e-4;
+static constexpr int64_t QUANTIZED_NAN = INT32_MIN;
+
+static constexpr size_t RECORDS = 4000;
+// Share of the fields replaced by a not a number or a value out of the quantized range
+static constexpr float SPECIAL_PROBABILITY = 0.05f;
+
+/**
+ * Record as it was added to the encoder, or as it was decoded, with the
+ * fields in the order of the decoder csv columns (the dropped total is its
+ * only field, without a timestamp)
+ */
+struct record_s {
+    uint8_t header;
+    int64_t timestamp;
+    std::vector<double> values;
+    std::vector<double> resolutions;
+};
+
+/**
+ * Decoded recording and the number of blocks which failed to decode
+ */
+struct recording_s {
+    std::vector<record_s> records;
+    size_t bad_blocks = 0;
+};
+
+static bool read_varint(const uint8_t* data, size_t size, size_t& offset, uint64_t& value) noexcept
+{
+    value = 0;
+    for (size_t shift = 0; offset < size && shift < 64; shift += 7) {
+        const uint8_t byte = data[offset++];
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static bool read_delta(const uint8_t* data, size_t size, size_t& offset, int64_t& value) noexcept
+{
+    uint64_t zigzag;
+    if (!read_varint(data, size, offset, zigzag))
+        return false;
+    value += static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+    return true;
+}
+
+static double dequantize(int64_t value, double resolution) noexcept
+{
+    return value == QUANTIZED_NAN ? std::numeric_limits<double>::quiet_NaN() : value * resolution;
+}
+
+/**
+ * Records of a single block payload, mirrors `decode_payload` of the decoder
+ * @returns false if the payload is malformed
+ */
+static bool decode_payload(const uint8_t* payload, size_t size, std::vector<record_s>& records) noexcept
+{
+    // Previous timestamp and fields of each stream, by the record header
+    struct stream_s {
+        int64_t timestamp = 0;
+        int64_t values[blackbox_encoder::MAX_FIELDS] = {};
+    };
+    std::vector<stream_s> streams(256);
+
+    size_t offset = 0;
+    while (offset < size) {
+        const uint8_t header = payload[offset++];
+        const uint8_t type = header >> 4;
+
+        if (type == BLACKBOX_DROPPED) {
+            uint64_t dropped;
+            if (!read_varint(payload, size, offset, dropped))
+                return false;
+            records.push_back({header, 0, {double(dropped)}, {1.}});
+            continue;
+        }
+        if (type > BLACKBOX_CONTROL)
+            return false;
+
+        stream_s& stream = streams[header];
+        record_s record {header, 0, {}, {}};
+        if (!read_delta(payload, size, offset, stream.timestamp))
+            return false;
+        record.timestamp = stream.timestamp;
+
+        // Motors follow their count, so the count is read first
+        size_t count = type <= BLACKBOX_MAGNETOMETER ? 6 : type == BLACKBOX_STATE ? 16 : 5;
+        for (size_t i = 0; i < count; i++) {
+            if (!read_delta(payload, size, offset, stream.values[i]))
+                return false;
+            if (type == BLACKBOX_CONTROL && i == 4) {
+                if (stream.values[4] < 0 || stream.values[4] > motor_frequencies_s::MAX_MOTORS)
+                    return false;
+                count += static_cast<size_t>(stream.values[4]);
+            }
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            double resolution;
+            if (type <= BLACKBOX_MAGNETOMETER)
+                resolution = SENSOR_RESOLUTION[type];
+            else if (type == BLACKBOX_STATE)
+                resolution = STATE_RESOLUTION[i];
+            else
+                resolution = i == 0 ? THRUST_RESOLUTION : i < 4 ? TORQUE_RESOLUTION : MOTOR_RESOLUTION;
+
+            // Motor count is not a field of the csv
+            if (type == BLACKBOX_CONTROL && i == 4)
+                continue;
+            record.values.push_back(dequantize(stream.values[i], resolution));
+            record.resolutions.push_back(resolution);
+        }
+        records.push_back(std::move(record));
+    }
+    return true;
+}
+
+/**
+ * Records of all valid blocks of a recording, mirrors `decode` of the decoder
+ */
+static recording_s decode(const std::vector<uint8_t>& data) noexcept
+{
+    const uint8_t* sync = blackbox_encoder::SYNC;
+    const size_t header_size = blackbox_encoder::HEADER_SIZE;
+    const size_t crc_size = blackbox_encoder::CRC_SIZE;
+
+    recording_s recording;
+    size_t offset = 0;
+    while (offset + header_size <= data.size()) {
+        if (data[offset] != sync[0] || data[offset + 1] != sync[1]) {
+            offset++;
+            continue;
+        }
+
+        const size_t size = data[offset + 2] | data[offset + 3] << 8;
+        const size_t end = offset + header_size + size + crc_size;
+        if (end > data.size()) {
+            recording.bad_blocks++;
+            offset++;
+            continue;
+        }
+
+        const uint8_t* payload = &data[offset + header_size];
+        uint32_t crc = 0;
+        for (size_t i = 0; i < crc_size; i++)
+            crc |= static_cast<uint32_t>(data[end - crc_size + i]) << (8 * i);
+
+        // Records are only added once the whole block is decoded
+        std::vector<record_s> records;
+        if (crc32(payload, size) != crc || !decode_payload(payload, size, records)) {
+            recording.bad_blocks++;
+            offset++;
+            continue;
+        }
+        recording.records.insert(recording.records.end(), records.begin(), records.end());
+        offset = end;
+    }
+    return recording;
+}
+
+/**
+ * Field replaced by a not a number or a value out of the quantized range at the `SPECIAL_PROBABILITY`
+ */
+static float random_field(std::mt19937& random, float value) noexcept
+{
+    static constexpr float SPECIAL[] = {
+        std::numeric_limits<float>::quiet_NaN(),
+        std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity(),
+        1e12f,
+        -1e12f
+    };
+
+    std::uniform_real_distribution<float> chance(0.f, 1.f);
+    if (chance(random) >= SPECIAL_PROBABILITY)
+        return value;
+    return SPECIAL[std::uniform_int_distribution<size_t>(0, std::size(SPECIAL) - 1)(random)];
+}
+
+static vector3f random_fields(std::mt19937& random, const vector3f& value) noexcept
+{
+    return {random_field(random, value(0)), random_field(random, value(1)), random_field(random, value(2))};
+}
+
+/**
+ * Sensor samples of all types and two instances, states, control outputs with every
+ * motor count (including more than the recorded motors) and dropped totals in a random
+ * order, with fields which are not a number or out of range
+ */
+static std::vector<record_s> random_records(std::mt19937& random) noexcept
+{
+    std::uniform_int_distribution<size_t> kind(0, 9);
+    std::uniform_int_distribution<int64_t> jitter(-50, 50);
+    std::uniform_real_distribution<float> throttle(0.f, 1.f);
+
+    std::vector<record_s> records;
+    uint32_t dropped = 0;
+    for (size_t i = 0; i < RECORDS; i++) {
+        const int64_t timestamp = 1000 * static_cast<int64_t>(i) + jitter(random);
+        const size_t choice = kind(random);
+
+        if (choice < 6) {
+            const auto type = static_cast<blackbox_record_e>(choice / 2);
+            const float scale = type == BLACKBOX_GYROSCOPE ? 2.f : type == BLACKBOX_MAGNETOMETER ? 0.5f : 10.f;
+            const vector3f raw = random_fields(random, random_vector(random, scale));
+            const vector3f corrected = random_fields(random, random_vector(random, scale));
+            records.push_back({
+                static_cast<uint8_t>(type << 4 | choice % 2), timestamp,
+                {raw(0), raw(1), raw(2), corrected(0), corrected(1), corrected(2)},
+                std::vector<double>(6, SENSOR_RESOLUTION[type])
+            });
+        } else if (choice < 8) {
+            state_s state = random_state(random);
+            state.position = random_fields(random, state.position);
+            state.velocity = random_fields(random, state.velocity);
+            state.acceleration = random_fields(random, state.acceleration);
+            state.angular_velocity = random_fields(random, state.angular_velocity);
+            const vector4f q = state.rotationq.as_vector();
+
+            record_s record {BLACKBOX_STATE << 4, timestamp, {}, {}};
+            for (const vector3f* value : {&state.position, &state.velocity, &state.acceleration, &state.angular_velocity})
+                record.values.insert(record.values.end(), {(*value)(0), (*value)(1), (*value)(2)});
+            for (size_t k = 0; k < 4; k++)
+                record.values.push_back(random_field(random, q(k)));
+            record.resolutions.assign(STATE_RESOLUTION, STATE_RESOLUTION + 16);
+            records.push_back(std::move(record));
+        } else if (choice < 9) {
+            const size_t motor_count = std::uniform_int_distribution<size_t>(0, motor_frequencies_s::MAX_MOTORS + 2)(random);
+            const vector3f torque = random_fields(random, random_vector(random, 0.1f));
+
+            record_s record {BLACKBOX_CONTROL << 4, timestamp, {}, {}};
+            record.values = {random_field(random, throttle(random) * 20.f), torque(0), torque(1), torque(2)};
+            record.resolutions = {THRUST_RESOLUTION, TORQUE_RESOLUTION, TORQUE_RESOLUTION, TORQUE_RESOLUTION};
+            for (size_t k = 0; k < motor_count; k++) {
+                record.values.push_back(random_field(random, throttle(random)));
+                record.resolutions.push_back(MOTOR_RESOLUTION);
+            }
+            records.push_back(std::move(record));
+        } else {
+            dropped += std::uniform_int_distribution<uint32_t>(1, 1000)(random);
+            records.push_back({BLACKBOX_DROPPED << 4, 0, {double(dropped)}, {1.}});
+        }
+    }
+    return records;
+}
+
+/**
+ * Add a record to the encoder
+ * @returns false if the block is full
+ */
+static bool add_record(blackbox_encoder& encoder, const record_s& record) noexcept
+{
+    const auto type = static_cast<blackbox_record_e>(record.header >> 4);
+    const timestamp_t timestamp(record.timestamp);
+    const std::vector<double>& v = record.values;
+
+    if (type <= BLACKBOX_MAGNETOMETER) {
+        const blackbox_sensor_s sample {
+            .raw = vector3f {float(v[0]), float(v[1]), float(v[2])},
+            .corrected = vector3f {float(v[3]), float(v[4]), float(v[5])},
+            .timestamp = timestamp
+        };
+        return encoder.add_sensor(type, record.header & 0x0F, sample);
+    }
+    if (type == BLACKBOX_STATE) {
+        const state_s state {
+            .position = vector3f {float(v[0]), float(v[1]), float(v[2])},
+            .velocity = vector3f {float(v[3]), float(v[4]), float(v[5])},
+            .acceleration = vector3f {float(v[6]), float(v[7]), float(v[8])},
+            .angular_velocity = vector3f {float(v[9]), float(v[10]), float(v[11])},
+            .rotationq = quaternionf(float(v[12]), float(v[13]), float(v[14]), float(v[15])),
+            .timestamp = timestamp
+        };
+        return encoder.add_state(state);
+    }
+    if (type == BLACKBOX_CONTROL) {
+        blackbox_control_s control {};
+        control.actuation.thrust = float(v[0]);
+        control.actuation.torque = vector3f {float(v[1]), float(v[2]), float(v[3])};
+        control.actuation.motor_count = v.size() - 4;
+        for (size_t i = 0; i < v.size() - 4 && i < motor_frequencies_s::MAX_MOTORS; i++)
+            control.actuation.motors[i] = float(v[4 + i]);
+        control.timestamp = timestamp;
+        return encoder.add_control(control);
+    }
+    return encoder.add_dropped(static_cast<uint32_t>(v[0]));
+}
+
+/**
+ * Blocks of all records, a full block is finished and the record added to the next one
+ */
+static std::vector<uint8_t> encode(const std::vector<record_s>& records) noexcept
+{
+    std::vector<uint8_t> data;
+    blackbox_encoder encoder;
+    const auto flush = [&]() {
+        const uint8_t* block;
+        const size_t size = encoder.finish(block);
+        data.insert(data.end(), block, block + size);
+        encoder.begin();
+    };
+
+    for (const record_s& record : records) {
+        if (!add_record(encoder, record)) {
+            flush();
+            add_record(encoder, record);
+        }
+    }
+    if (!encoder.is_empty())
+        flush();
+    return data;
+}
+
+/**
+ * Added record as it has to be decoded, motors beyond the recorded ones are
+ * dropped and values out of the quantized range are clamped to its ends
+ */
+static record_s expected_record(const record_s& record, std::vector<bool>& special) noexcept
+{
+    record_s expected = record;
+    if (record.header >> 4 == BLACKBOX_CONTROL && record.values.size() > 4 + motor_frequencies_s::MAX_MOTORS) {
+        expected.values.resize(4 + motor_frequencies_s::MAX_MOTORS);
+        expected.resolutions.resize(4 + motor_frequencies_s::MAX_MOTORS);
+    }
+
+    special.assign(expected.values.size(), false);
+    for (size_t i = 0; i < expected.values.size(); i++) {
+        double& value = expected.values[i];
+        const double limit = INT32_MAX * expected.resolutions[i];
+        special[i] = !(std::abs(value) < limit);
+        if (special[i] && !std::isnan(value))
+            value = value > 0 ? limit : -limit;
+    }
+    return expected;
+}
+
+/**
+ * Checks of the blackbox encoder against a mirror of the host decoder
+ * (python/blackbox_decoder.py) on records of all types
+ */
+void check_blackbox(check_runner& runner) noexcept
+{
+    std::mt19937& random = runner.get_random();
+    const std::vector<record_s> records = random_records(random);
+    const recording_s recording = decode(encode(records));
+
+    // Records which were lost or damaged, in type, instance, timestamp or field
+    // count (which also has the recorded motor count) or in the dropped totals
+    runner.run("blackbox.roundtrip.wrong_records", 0, [&]() {
+        size_t wrong = recording.bad_blocks;
+        wrong += records.size() > recording.records.size() ? records.size() - recording.records.size() :
+            recording.records.size() - records.size();
+
+        for (size_t i = 0; i < records.size() && i < recording.records.size(); i++) {
+            std::vector<bool> special;
+            const record_s expected = expected_record(records[i], special);
+            const record_s& decoded = recording.records[i];
+            wrong += decoded.header != expected.header || decoded.timestamp != expected.timestamp ||
+                decoded.values.size() != expected.values.size();
+            if (expected.header >> 4 == BLACKBOX_DROPPED && decoded.values.size() == 1)
+                wrong += decoded.values[0] != expected.values[0];
+        }
+        return double(wrong);
+    });
+
+    // Largest difference of a decoded field in units of its resolution, half of it from the
+    // rounding and up to an ulp of the scaled value (at most 1e5 here) from the float division
+    runner.run("blackbox.roundtrip.field_error", 0.52, [&]() {
+        double error = 0;
+        for (size_t i = 0; i < records.size() && i < recording.records.size(); i++) {
+            std::vector<bool> special;
+            const record_s expected = expected_record(records[i], special);
+            const record_s& decoded = recording.records[i];
+            for (size_t k = 0; k < expected.values.size() && k < decoded.values.size(); k++) {
+                if (special[k])
+                    continue;
+                const double difference = std::abs(decoded.values[k] - expected.values[k]) / expected.resolutions[k];
+                // Not a number fails the check
+                if (!(difference <= error))
+                    error = difference;
+            }
+        }
+        return error;
+    });
+
+    // Fields which are not a number or out of range and were not decoded as
+    // not a number or the end of the quantized range
+    runner.run("blackbox.roundtrip.wrong_special", 0, [&]() {
+        size_t wrong = 0;
+        size_t count = 0;
+        for (size_t i = 0; i < records.size() && i < recording.records.size(); i++) {
+            std::vector<bool> special;
+            const record_s expected = expected_record(records[i], special);
+            const record_s& decoded = recording.records[i];
+            for (size_t k = 0; k < expected.values.size() && k < decoded.values.size(); k++) {
+                if (!special[k])
+                    continue;
+                count++;
+                const double value = expected.values[k];
+                wrong += std::isnan(value) ? !std::isnan(decoded.values[k]) :
+                    std::abs(decoded.values[k] - value) > 0.5 * expected.resolutions[k];
+            }
+        }
+        return count > 0 ? double(wrong) : std::numeric_limits<double>::quiet_NaN();
+    });
+}
+
+}
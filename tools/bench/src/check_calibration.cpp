@@ -0,0 +1,366 @@
+#include "check.hpp"
+#include "stub_drivers.hpp"
+#include "calibration/accel_calibrator.hpp"
+#include "calibration/gyro_bias_estimator.hpp"
+#include "calibration/mag_calibrator.hpp"
+#include "calibration/calibration_store.hpp"
+#include "util/crc32.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace mp::bench {
+
+// Samples at 1kHz with the windows and durations of `task_calibration`
+static constexpr uint32_t WINDOW_SAMPLES = 500;
+
+// Magnetometer at 100Hz with its own windows
+static constexpr mag_calibrator::params_s MAG_PARAMS {
+    .window_samples = 10,
+    .min_coverage = 0.8f,
+    .min_field = 0.1f,
+    .required_windows = 200
+};
+
+static constexpr accel_calibrator::params_s ACCEL_PARAMS {
+    .window_samples = WINDOW_SAMPLES,
+    .max_variance = 0.05f,
+    .gravity_tolerance = 0.1f,
+    .min_alignment = 0.95f,
+    .required_samples = 2000
+};
+
+static constexpr gyro_bias_estimator::params_s GYRO_PARAMS {
+    .window_samples = WINDOW_SAMPLES,
+    .max_variance = 1e-4f,
+    .max_bias = 0.2f,
+    .required_samples = 5000
+};
+
+// Sensor errors to be estimated, the raw reading is `true / scale + bias`
+static const sensor_calibration_s ACCEL_ERRORS {
+    .bias = {0.3f, -0.2f, 0.5f},
+    .scale = {1.02f, 0.98f, 1.01f}
+};
+static const vector3f GYRO_BIAS {0.02f, -0.015f, 0.01f};
+static const sensor_calibration_s MAG_ERRORS {
+    .bias = {0.1f, -0.2f, 0.05f},
+    .scale = {1.1f, 0.95f, 1.f}
+};
+static constexpr float MAG_FIELD = 0.45f; // gauss
+
+static constexpr float ACCEL_NOISE = 0.02f; // m/s^2
+static constexpr float GYRO_NOISE = 0.005f; // rad/s
+static constexpr float MAG_NOISE = 0.005f; // gauss
+
+static constexpr double NOT_DONE = std::numeric_limits<double>::quiet_NaN();
+
+static vector3f add_noise(std::mt19937& random, const vector3f& value, float deviation) noexcept
+{
+    std::normal_distribution<float> noise(0.f, deviation);
+    return {value(0) + noise(random), value(1) + noise(random), value(2) + noise(random)};
+}
+
+static vector3f distort(const vector3f& value, const sensor_calibration_s& errors) noexcept
+{
+    return {
+        value(0) / errors.scale(0) + errors.bias(0),
+        value(1) / errors.scale(1) + errors.bias(1),
+        value(2) / errors.scale(2) + errors.bias(2)
+    };
+}
+
+static vector3f raw_accel(const vector3f& specific_force) noexcept
+{
+    return distort(specific_force, ACCEL_ERRORS);
+}
+
+/**
+ * Six positions in a shuffled order, each after a tilted hold which matches
+ * no position and the motion of turning the sensor to the next position
+ */
+static accel_calibrator run_accel_calibration(std::mt19937& random) noexcept
+{
+    static constexpr size_t ORDER[accel_calibrator::POSITIONS] = {4, 1, 2, 5, 0, 3};
+    static constexpr size_t MOTION_SAMPLES = 700;
+    static constexpr size_t HOLD_SAMPLES = 3000;
+
+    accel_calibrator calibrator(ACCEL_PARAMS);
+    for (size_t position : ORDER) {
+        const float sign = position % 2 ? -1.f : 1.f;
+        vector3f gravity(0);
+        gravity(position / 2) = sign * G;
+
+        // Halfway between the axis and the next one
+        vector3f tilted = gravity * float(M_SQRT1_2);
+        tilted((position / 2 + 1) % 3) = G * float(M_SQRT1_2);
+        for (size_t i = 0; i < HOLD_SAMPLES; i++)
+            calibrator.add(raw_accel(add_noise(random, tilted, ACCEL_NOISE)));
+
+        for (size_t i = 0; i < MOTION_SAMPLES; i++) {
+            const float angle = float(M_PI_2) * i / MOTION_SAMPLES;
+            calibrator.add(raw_accel(add_noise(random, tilted * std::cos(angle) + gravity * std::sin(angle), ACCEL_NOISE)));
+        }
+
+        for (size_t i = 0; i < HOLD_SAMPLES; i++)
+            calibrator.add(raw_accel(add_noise(random, gravity, ACCEL_NOISE)));
+    }
+    return calibrator;
+}
+
+/**
+ * Rest periods interrupted by motion whose mean is a plausible bias, and by a
+ * steady rotation which has a low variance but an implausible mean
+ * @param rest Whether to include the rest periods
+ */
+static gyro_bias_estimator run_gyro_estimation(std::mt19937& random, bool rest) noexcept
+{
+    static constexpr size_t CYCLES = 8;
+    static constexpr size_t REST_SAMPLES = 1500;
+    static constexpr size_t MOTION_SAMPLES = 1000;
+    static constexpr size_t ROTATION_SAMPLES = 1000;
+
+    gyro_bias_estimator estimator(GYRO_PARAMS);
+    for (size_t cycle = 0; cycle < CYCLES; cycle++) {
+        for (size_t i = 0; rest && i < REST_SAMPLES; i++)
+            estimator.add(add_noise(random, GYRO_BIAS, GYRO_NOISE));
+
+        for (size_t i = 0; i < MOTION_SAMPLES; i++) {
+            const float s = 0.5f * std::sin(2.f * float(M_PI) * i / 200.f);
+            estimator.add(add_noise(random, GYRO_BIAS + vector3f {0.1f + s, s, -s}, GYRO_NOISE));
+        }
+
+        for (size_t i = 0; i < ROTATION_SAMPLES; i++)
+            estimator.add(add_noise(random, GYRO_BIAS + vector3f {0.f, 0.f, 0.5f}, GYRO_NOISE));
+    }
+    return estimator;
+}
+
+/**
+ * Field direction in the sensor frame along a spiral from pointing up to pointing down,
+ * so every axis points along the field and against it, as when turning the vehicle around
+ * while slowly tipping it over
+ */
+static mag_calibrator run_mag_calibration(std::mt19937& random) noexcept
+{
+    static constexpr size_t SAMPLES = 6000;
+    static constexpr float TURNS = 20.f;
+
+    mag_calibrator calibrator(MAG_PARAMS);
+    for (size_t i = 0; i < SAMPLES; i++) {
+        const float t = float(i) / SAMPLES;
+        const float polar = float(M_PI) * t;
+        const float azimuth = 2.f * float(M_PI) * TURNS * t;
+        const vector3f field = MAG_FIELD * vector3f {
+            std::sin(polar) * std::cos(azimuth),
+            std::sin(polar) * std::sin(azimuth),
+            std::cos(polar)
+        };
+        calibrator.add(distort(add_noise(random, field, MAG_NOISE), MAG_ERRORS));
+    }
+    return calibrator;
+}
+
+static vector3f random_vector(std::mt19937& random, float low, float high) noexcept
+{
+    std::uniform_real_distribution<float> uniform(low, high);
+    return {uniform(random), uniform(random), uniform(random)};
+}
+
+static calibration_s random_calibration(std::mt19937& random, bool has_magnetometer) noexcept
+{
+    calibration_s calibration;
+    for (size_t i = 0; i < MAX_SENSOR_INSTANCES; i++) {
+        calibration.accelerometers[i] = {random_vector(random, -1.f, 1.f), random_vector(random, 0.9f, 1.1f)};
+        calibration.gyroscopes[i] = {random_vector(random, -0.1f, 0.1f), random_vector(random, 0.9f, 1.1f)};
+    }
+    calibration.magnetometer = {random_vector(random, -0.2f, 0.2f), random_vector(random, 0.8f, 1.2f)};
+    calibration.has_magnetometer = has_magnetometer;
+    return calibration;
+}
+
+static double max_difference(const vector3f& a, const vector3f& b) noexcept
+{
+    double difference = 0.0;
+    for (size_t axis = 0; axis < 3; axis++)
+        difference = std::max<double>(difference, std::abs(a(axis) - b(axis)));
+    return difference;
+}
+
+static double max_difference(const sensor_calibration_s& a, const sensor_calibration_s& b) noexcept
+{
+    return std::max(max_difference(a.bias, b.bias), max_difference(a.scale, b.scale));
+}
+
+/**
+ * Largest difference of the values, infinite if the magnetometer flags differ
+ * (or any value is NaN, which fails the check either way)
+ */
+static double max_difference(const calibration_s& a, const calibration_s& b) noexcept
+{
+    if (a.has_magnetometer != b.has_magnetometer)
+        return std::numeric_limits<double>::infinity();
+
+    double difference = 0.0;
+    for (size_t i = 0; i < MAX_SENSOR_INSTANCES; i++) {
+        difference = std::max(difference, max_difference(a.accelerometers[i], b.accelerometers[i]));
+        difference = std::max(difference, max_difference(a.gyroscopes[i], b.gyroscopes[i]));
+    }
+    if (a.has_magnetometer)
+        difference = std::max(difference, max_difference(a.magnetometer, b.magnetometer));
+    return difference;
+}
+
+/**
+ * Whether `load` accepts the stored record or touches the calibration it is given
+ */
+static bool is_loaded(calibration_store& store, std::mt19937& random) noexcept
+{
+    const calibration_s before = random_calibration(random, true);
+    calibration_s loaded = before;
+    return store.load(loaded) || max_difference(loaded, before) != 0.0;
+}
+
+/**
+ * Rewrite the CRC at the end of a record after changing its contents
+ */
+static void update_crc(stub_storage& storage, size_t size) noexcept
+{
+    uint8_t* record = storage.get_data();
+    const uint32_t crc = crc32(record, size - sizeof(uint32_t));
+    std::memcpy(record + size - sizeof(crc), &crc, sizeof(crc));
+}
+
+void check_calibration(check_runner& runner) noexcept
+{
+    std::mt19937& random = runner.get_random();
+
+    // Mean of 2000 samples with the noise has an error of about 5e-4 m/s^2
+    runner.run("accel_calibrator.bias_error", 5e-3, [&]() {
+        const accel_calibrator calibrator = run_accel_calibration(random);
+        if (!calibrator.is_complete())
+            return NOT_DONE;
+
+        const sensor_calibration_s result = calibrator.get_result();
+        return max_difference(result.bias, ACCEL_ERRORS.bias);
+    });
+
+    runner.run("accel_calibrator.scale_error", 1e-3, [&]() {
+        const accel_calibrator calibrator = run_accel_calibration(random);
+        if (!calibrator.is_complete())
+            return NOT_DONE;
+
+        const sensor_calibration_s result = calibrator.get_result();
+        return max_difference(result.scale, ACCEL_ERRORS.scale);
+    });
+
+    // Accepting the motion windows would move the bias by about 0.03 rad/s
+    runner.run("gyro_bias_estimator.motion.bias_error", 1e-3, [&]() {
+        const gyro_bias_estimator estimator = run_gyro_estimation(random, true);
+        if (!estimator.is_converged())
+            return NOT_DONE;
+
+        return double((estimator.get_bias() - GYRO_BIAS).norm());
+    });
+
+    // Motion alone never converges, 1 if it did
+    runner.run("gyro_bias_estimator.motion_only.converged", 0, [&]() {
+        return run_gyro_estimation(random, false).is_converged() ? 1.0 : 0.0;
+    });
+
+    runner.run("mag_calibrator.bias_error", 5e-3, [&]() {
+        const mag_calibrator calibrator = run_mag_calibration(random);
+        if (!calibrator.is_complete())
+            return NOT_DONE;
+
+        return max_difference(calibrator.get_result().bias, MAG_ERRORS.bias);
+    });
+
+    // Scale is relative to the mean axis, so only the ratios of the axes are compared
+    runner.run("mag_calibrator.scale_error", 2e-2, [&]() {
+        const mag_calibrator calibrator = run_mag_calibration(random);
+        if (!calibrator.is_complete())
+            return NOT_DONE;
+
+        const vector3f scale = calibrator.get_result().scale;
+        const float ratio = scale(0) / MAG_ERRORS.scale(0);
+        double error = 0.0;
+        for (size_t axis = 1; axis < 3; axis++)
+            error = std::max<double>(error, std::abs(scale(axis) / MAG_ERRORS.scale(axis) / ratio - 1.f));
+        return error;
+    });
+
+    // Values are stored as they are, so they read back exactly
+    runner.run("calibration_store.roundtrip_error", 0, [&]() {
+        stub_storage storage(1024);
+        calibration_store store(storage, 100);
+
+        double error = 0.0;
+        for (bool has_magnetometer : {true, false}) {
+            const calibration_s saved = random_calibration(random, has_magnetometer);
+            calibration_s loaded = random_calibration(random, !has_magnetometer);
+            if (!store.save(saved) || !store.load(loaded))
+                return NOT_DONE;
+            error = std::max(error, max_difference(loaded, saved));
+        }
+        return error;
+    });
+
+    // Number of invalid records which were loaded
+    runner.run("calibration_store.invalid_loaded", 0, [&]() {
+        size_t loaded = 0;
+        const calibration_s valid = random_calibration(random, true);
+
+        // Erased storage
+        stub_storage storage(1024);
+        calibration_store store(storage);
+        loaded += is_loaded(store, random);
+
+        // Record which does not fit is neither written nor read
+        stub_storage small(64);
+        calibration_store small_store(small);
+        loaded += small_store.save(valid);
+        loaded += is_loaded(small_store, random);
+
+        if (!store.save(valid))
+            return NOT_DONE;
+        const size_t size = storage.get_last_write();
+
+        // Flipped bit in the values, a partial write
+        storage.get_data()[size / 2] ^= 0x04;
+        loaded += is_loaded(store, random);
+
+        // Record of another version with a valid CRC, the version follows the magic
+        store.save(valid);
+        uint32_t version;
+        std::memcpy(&version, storage.get_data() + sizeof(uint32_t), sizeof(version));
+        version--;
+        std::memcpy(storage.get_data() + sizeof(uint32_t), &version, sizeof(version));
+        update_crc(storage, size);
+        loaded += is_loaded(store, random);
+
+        // Non-finite values are stored with a valid CRC, but not loaded
+        for (float value : {std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::infinity()}) {
+            calibration_s invalid = valid;
+            invalid.gyroscopes[1].bias(2) = value;
+            store.save(invalid);
+            loaded += is_loaded(store, random);
+
+            invalid = valid;
+            invalid.magnetometer.scale(0) = value;
+            store.save(invalid);
+            loaded += is_loaded(store, random);
+        }
+
+        // Valid record is still loaded after all of them
+        store.save(valid);
+        calibration_s result;
+        if (!store.load(result) || max_difference(result, valid) != 0.0)
+            return NOT_DONE;
+
+        return double(loaded);
+    });
+}
+
+}
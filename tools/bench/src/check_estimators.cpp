@@ -0,0 +1,130 @@
+#include "check.hpp"
+#include "bench_inputs.hpp"
+#include "mp/util/constants.hpp"
+#include "state/ekf_inertial.hpp"
+#include "state/ekf_error_state.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace mp::bench {
+
+static constexpr float RAD_TO_DEG = 180.f / M_PI;
+
+/**
+ * Vehicle without actuators or rotational dynamics, only with linear drag,
+ * so that the estimators rely on the sensors instead of the vehicle model
+ */
+class drag_vehicle : public ekf_vehicle {
+
+public:
+    static constexpr float DRAG = 0.1f;
+
+    bool init() noexcept override
+    {
+        return true;
+    }
+
+    void update(const state_s& state, float dt) noexcept override {}
+
+    bool handle_command(const pb::Command& command) noexcept override
+    {
+        return false;
+    }
+
+    vector3f get_linear_acceleration(const vector3f& v, const quaternionf& q) const noexcept override
+    {
+        return v * -DRAG;
+    }
+
+    vector3f get_angular_acceleration(const vector3f& v, const vector3f& w, const quaternionf& q) const noexcept override
+    {
+        return vector3f(0);
+    }
+
+    jacobian_s get_jacobian(const vector3f& v, const vector3f& w, const vector4f& qv) const noexcept override
+    {
+        return jacobian_s {
+            .da_dv = matrix3f::diagonal(-DRAG),
+            .da_dq = matrixf<3, 4>(0),
+            .ddw_dv = matrix3f(0),
+            .ddw_dw = matrix3f(0),
+            .ddw_dq = matrixf<3, 4>(0)
+        };
+    }
+};
+
+/**
+ * Angle between the down direction in the local frames of the rotations in [deg]
+ */
+static double tilt_error(const quaternionf& a, const quaternionf& b) noexcept
+{
+    const float cos = a.conjugate().rotate_vec(DOWN).dot(b.conjugate().rotate_vec(DOWN));
+    return std::acos(std::clamp(cos, -1.f, 1.f)) * RAD_TO_DEG;
+}
+
+/**
+ * Mean tilt error of an estimator over the second half of a run on noisy accelerometer
+ * and gyroscope readings of a vehicle rotating in place at a constant body rate for 20 s at 50 Hz
+ * @note Heading is not observable without a magnetometer, so it is not compared
+ */
+template <typename estimator_type>
+static double rotation_tilt_error(std::mt19937& random) noexcept
+{
+    constexpr float DT = 0.02f;
+    constexpr size_t STEPS = 1000;
+    constexpr float ACCELEROMETER_NOISE = 0.05f;
+    constexpr float GYROSCOPE_NOISE = 0.01f;
+
+    const drag_vehicle vehicle;
+    estimator_type estimator(vehicle);
+
+    const vector3f w {0.3f, -0.2f, 0.5f};
+    const float angle = w.norm() * DT;
+    const vector3f axis = w / w.norm() * std::sin(angle / 2.f);
+    const quaternionf step(std::cos(angle / 2.f), axis(0), axis(1), axis(2));
+
+    // Covariances are the variance densities the drivers report
+    const matrix3f accelerometer_cov = matrix3f::diagonal(ACCELEROMETER_NOISE * ACCELEROMETER_NOISE / DT);
+    const matrix3f gyroscope_cov = matrix3f::diagonal(GYROSCOPE_NOISE * GYROSCOPE_NOISE / DT);
+
+    double error = 0.0;
+    quaternionf q(1, 0, 0, 0);
+    for (size_t i = 0; i < STEPS; i++) {
+        q = (q * step).normalized();
+        const vector3f accelerometer = q.conjugate().rotate_vec(-GV) + random_vector(random, ACCELEROMETER_NOISE);
+        const vector3f gyroscope = w + random_vector(random, GYROSCOPE_NOISE);
+        estimator.update(sensor_data_s {
+            .accelerometer = &accelerometer,
+            .accelerometer_cov = &accelerometer_cov,
+            .gyroscope = &gyroscope,
+            .gyroscope_cov = &gyroscope_cov
+        }, DT);
+
+        if (i >= STEPS / 2)
+            error += tilt_error(q, estimator.get_state().rotationq) / (STEPS / 2);
+    }
+    return error;
+}
+
+void check_estimators(check_runner& runner) noexcept
+{
+    // Errors of a single run depend a lot on the noise, so they are averaged
+    constexpr size_t RUNS = 16;
+
+    std::mt19937& random = runner.get_random();
+    double inertial = 0.0, error_state = 0.0;
+    for (size_t i = 0; i < RUNS; i++) {
+        // Both estimators get the same readings
+        const std::mt19937 start = random;
+        inertial += rotation_tilt_error<ekf_inertial>(random) / RUNS;
+        random = start;
+        error_state += rotation_tilt_error<ekf_error_state>(random) / RUNS;
+    }
+
+    runner.run("ekf_inertial.rotation.tilt_deg", 4.0, [&]() {return inertial;});
+    runner.run("ekf_error_state.rotation.tilt_deg", 1.0, [&]() {return error_state;});
+    // Error state filter should stay clearly more accurate than the filter it replaces
+    runner.run("ekf_error_state.rotation.tilt_vs_inertial", 0.5, [&]() {return error_state / inertial;});
+}
+
+}
@@ -0,0 +1,123 @@
+#include "check.hpp"
+#include "util/biquad.hpp"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+namespace mp::bench {
+
+static constexpr float SAMPLE_RATE = 1000.f;
+static constexpr size_t STAGES = 4;
+
+// Typical gyroscope chain, low-pass followed by the notches
+static constexpr biquad_spec_s FILTERS[STAGES] = {
+    {biquad_type_e::LOW_PASS, 80.f},
+    {biquad_type_e::NOTCH, 120.f, 5.f},
+    {biquad_type_e::NOTCH, 240.f, 5.f},
+    {biquad_type_e::BAND_PASS, 300.f, 2.f}
+};
+
+// Sine frequencies in [Hz], whole numbers so that the measurement
+// window of a second has a whole number of periods
+static constexpr float FREQUENCIES[] = {5, 40, 80, 110, 120, 130, 200, 240, 300, 400, 490};
+// Samples before the measurement, so that the transient of the notches decays
+static constexpr size_t SETTLE_SAMPLES = 2000;
+static constexpr size_t MEASURE_SAMPLES = 1000;
+// Amplitude of the fixed point input, about half of a 16 bit sensor range
+static constexpr float FIXED_AMPLITUDE = 16000.f;
+
+/**
+ * Gain of the chain at the frequency, the product of the magnitudes
+ * of `H(e^jw) = (b0 + b1*z^-1 + b2*z^-2) / (1 + a1*z^-1 + a2*z^-2)`
+ * of the designed stages, evaluated in double precision
+ */
+static double expected_gain(float frequency) noexcept
+{
+    const double w = 2.0 * M_PI * frequency / SAMPLE_RATE;
+    const std::complex<double> z1 = std::polar(1.0, -w);
+    const std::complex<double> z2 = z1 * z1;
+
+    double gain = 1.0;
+    for (const biquad_spec_s& spec : FILTERS) {
+        const biquad_coeffs_s c = biquad_coeffs_s::design(spec, SAMPLE_RATE);
+        gain *= std::abs(
+            (double(c.b0) + double(c.b1) * z1 + double(c.b2) * z2) /
+            (1.0 + double(c.a1) * z1 + double(c.a2) * z2)
+        );
+    }
+    return gain;
+}
+
+/**
+ * Amplitude of the sine at the frequency in the output of `filter`,
+ * by correlation with a sine and a cosine over the measurement window
+ * @param filter Called as `double filter(double input)`
+ */
+template <typename filter_type>
+static double measured_gain(float frequency, filter_type&& filter) noexcept
+{
+    const double w = 2.0 * M_PI * frequency / SAMPLE_RATE;
+    double in_phase = 0.0, quadrature = 0.0;
+    for (size_t i = 0; i < SETTLE_SAMPLES + MEASURE_SAMPLES; i++) {
+        const double y = filter(std::sin(w * i));
+        if (i >= SETTLE_SAMPLES) {
+            in_phase += y * std::sin(w * i);
+            quadrature += y * std::cos(w * i);
+        }
+    }
+    return 2.0 * std::hypot(in_phase, quadrature) / MEASURE_SAMPLES;
+}
+
+/**
+ * Largest difference of the measured to the expected gain over the frequencies
+ * @param create Returns a configured chain
+ * @param filter Called as `double filter(chain, double input)`
+ */
+template <typename create_type, typename filter_type>
+static double gain_error(create_type&& create, filter_type&& filter) noexcept
+{
+    double error = 0.0;
+    for (float frequency : FREQUENCIES) {
+        auto chain = create();
+        const double measured = measured_gain(frequency, [&](double input) {return filter(chain, input);});
+        error = std::max(error, std::abs(measured - expected_gain(frequency)));
+    }
+    return error;
+}
+
+void check_filters(check_runner& runner) noexcept
+{
+    // Gains of the chain are between 0 (notch centers) and 1
+    runner.run("biquad_chain.gain_error", 1e-5, [&]() {
+        return gain_error(
+            []() {
+                biquad_chain<STAGES> chain;
+                chain.configure(FILTERS, STAGES, SAMPLE_RATE);
+                return chain;
+            },
+            [](biquad_chain<STAGES>& chain, double input) {
+                // All three axes are filtered, only the first is measured
+                return double(chain.process(vector3f(float(input)))(0));
+            }
+        );
+    });
+
+    // Every stage rounds its output to an integer, and the coefficients to 29 fractional bits
+    runner.run("biquad_chain_fixed.gain_error", 2e-4, [&]() {
+        return gain_error(
+            []() {
+                biquad_chain_fixed<STAGES> chain;
+                chain.configure(FILTERS, STAGES, SAMPLE_RATE);
+                return chain;
+            },
+            [](biquad_chain_fixed<STAGES>& chain, double input) {
+                const int32_t value = static_cast<int32_t>(std::lround(input * FIXED_AMPLITUDE));
+                int32_t sample[3] = {value, value, value};
+                chain.process(sample);
+                return sample[0] / double(FIXED_AMPLITUDE);
+            }
+        );
+    });
+}
+
+}
@@ -0,0 +1,205 @@
+#include "check.hpp"
+#include "bench_quadcopter.hpp"
+#include "model/model_jacobians.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace mp::bench {
+
+// Random states at which the kernels are compared
+static constexpr size_t POINTS = 32;
+// Step of the central differences, the model functions are at most quadratic
+// in each argument so the differences are exact up to float rounding
+static constexpr float STEP = 0.1f;
+static constexpr float DT = 0.005f;
+
+/**
+ * Jacobian of `f` at `x` by central differences
+ * @param f Called as `vectorf<N> f(const vectorf<M>& x)`
+ */
+template <size_t N, size_t M, typename function_type>
+static matrixf<N, M> central_differences(const vectorf<M>& x, function_type&& f) noexcept
+{
+    matrixf<N, M> result(0);
+    for (size_t j = 0; j < M; j++) {
+        vectorf<M> x_high = x, x_low = x;
+        x_high(j) += STEP;
+        x_low(j) -= STEP;
+
+        const vectorf<N> derivative = (f(x_high) - f(x_low)) / (2.f * STEP);
+        for (size_t i = 0; i < N; i++)
+            result(i, j) = derivative(i);
+    }
+    return result;
+}
+
+/**
+ * Largest difference of the elements, relative to the largest element of the reference
+ */
+template <size_t N, size_t M>
+static double relative_error(const matrixf<N, M>& kernel, const matrixf<N, M>& reference) noexcept
+{
+    double error = 0.0, scale = 1.0;
+    for (size_t i = 0; i < N; i++) {
+        for (size_t j = 0; j < M; j++) {
+            error = std::max(error, double(std::abs(kernel(i, j) - reference(i, j))));
+            scale = std::max(scale, double(std::abs(reference(i, j))));
+        }
+    }
+    return error / scale;
+}
+
+/**
+ * Rotation model `f(q)` with the quaternion norm left free, as the kernels are
+ * derived: `q * v * q^-1` of the model does not divide by the norm, which is the
+ * rotation by the normalized quaternion scaled by the squared norm
+ * @param f Called as `vectorf<N> f(const quaternionf& q)` with a unit quaternion
+ */
+template <size_t N, typename function_type>
+static vectorf<N> unnormalized(const vector4f& qv, function_type&& f) noexcept
+{
+    const float norm_sq = qv.norm_sq();
+    const vector4f u = qv / std::sqrt(norm_sq);
+    return f(quaternionf(u(0), u(1), u(2), u(3))) * norm_sq;
+}
+
+/**
+ * Rotation after `dt` before the normalization, same as the prediction of the estimators
+ */
+static vector4f rotation_next(const vector4f& qv, const vector3f& w, float dt) noexcept
+{
+    const matrixf<4> b {
+        {0, -w(0), -w(1), -w(2)},
+        {w(0), 0, w(2), -w(1)},
+        {w(1), -w(2), 0, w(0)},
+        {w(2), w(1), -w(0), 0}
+    };
+    return qv + (dt / 2.f) * b.matmul(qv);
+}
+
+static float uniform(std::mt19937& random, float low, float high) noexcept
+{
+    return std::uniform_real_distribution<float>(low, high)(random);
+}
+
+static vector3f random_vector(std::mt19937& random, float range) noexcept
+{
+    return {uniform(random, -range, range), uniform(random, -range, range), uniform(random, -range, range)};
+}
+
+static vector4f random_rotation(std::mt19937& random) noexcept
+{
+    const vector4f qv {uniform(random, -1, 1), uniform(random, -1, 1), uniform(random, -1, 1), uniform(random, -1, 1)};
+    return qv / qv.norm();
+}
+
+/**
+ * Largest error of the kernel over random points
+ * @param op Called as `double op()` with a new random point every time
+ */
+template <typename op_type>
+static double max_error(op_type&& op) noexcept
+{
+    double error = 0.0;
+    for (size_t i = 0; i < POINTS; i++)
+        error = std::max(error, op());
+    return error;
+}
+
+void check_jacobians(check_runner& runner) noexcept
+{
+    std::mt19937& random = runner.get_random();
+    // Errors are of the float rounding in the differences, relative to the largest element
+    static constexpr double LIMIT = 1e-4;
+
+    // Copter kernels are compared through the vehicle, with the thrust of the motors
+    const bench_quadcopter quad;
+    const ekf_vehicle& vehicle = quad.vehicle;
+
+    runner.run("model.copter_da_dq", LIMIT, [&]() {
+        return max_error([&]() {
+            const vector3f v = random_vector(random, 5.f);
+            const vector4f qv = random_rotation(random);
+            const matrixf<3, 4> reference = central_differences<3, 4>(qv, [&](const vector4f& x) {
+                // Gravity and drag do not depend on the rotation
+                return unnormalized<3>(x, [&](const quaternionf& q) {
+                    return vector3f(vehicle.get_linear_acceleration(vector3f(0), q) - GV);
+                });
+            });
+            return relative_error(vehicle.get_jacobian(v, vector3f(0), qv).da_dq, reference);
+        });
+    });
+
+    runner.run("model.copter_ddw_dw", LIMIT, [&]() {
+        return max_error([&]() {
+            const vector3f w = random_vector(random, 10.f);
+            const vector4f qv = random_rotation(random);
+            const quaternionf q(qv(0), qv(1), qv(2), qv(3));
+            const matrixf<3> reference = central_differences<3, 3>(w, [&](const vector3f& x) {
+                return vehicle.get_angular_acceleration(vector3f(0), x, q);
+            });
+            return relative_error(vehicle.get_jacobian(vector3f(0), w, qv).ddw_dw, reference);
+        });
+    });
+
+    runner.run("model.rotation_dq_dq", LIMIT, [&]() {
+        return max_error([&]() {
+            const vector3f w = random_vector(random, 10.f);
+            const matrixf<4> reference = central_differences<4, 4>(random_rotation(random), [&](const vector4f& x) {
+                return rotation_next(x, w, DT);
+            });
+            return relative_error(model::rotation_dq_dq(w, DT), reference);
+        });
+    });
+
+    runner.run("model.rotation_dq_dw", LIMIT, [&]() {
+        return max_error([&]() {
+            const vector4f qv = random_rotation(random);
+            const matrixf<4, 3> reference = central_differences<4, 3>(random_vector(random, 10.f), [&](const vector3f& x) {
+                return rotation_next(qv, x, DT);
+            });
+            return relative_error(model::rotation_dq_dw(qv, DT), reference);
+        });
+    });
+
+    // Expected accelerometer reading, as in `state_to_obs` of the estimators
+    const auto accel_obs = [](const quaternionf& q, const vector3f& a) {
+        return q.conjugate().rotate_vec(a - GV);
+    };
+
+    runner.run("model.accel_obs_da_da", LIMIT, [&]() {
+        return max_error([&]() {
+            const vector4f qv = random_rotation(random);
+            const quaternionf q(qv(0), qv(1), qv(2), qv(3));
+            const matrixf<3> reference = central_differences<3, 3>(random_vector(random, 20.f), [&](const vector3f& x) {
+                return accel_obs(q, x);
+            });
+            return relative_error(model::accel_obs_da_da(qv), reference);
+        });
+    });
+
+    runner.run("model.accel_obs_da_dq", LIMIT, [&]() {
+        return max_error([&]() {
+            const vector3f a = random_vector(random, 20.f);
+            const vector4f qv = random_rotation(random);
+            const matrixf<3, 4> reference = central_differences<3, 4>(qv, [&](const vector4f& x) {
+                return unnormalized<3>(x, [&](const quaternionf& q) {return accel_obs(q, a);});
+            });
+            return relative_error(model::accel_obs_da_dq(qv, a), reference);
+        });
+    });
+
+    // Expected magnetometer reading, as in the magnetometer update of `ekf_inertial`
+    runner.run("model.mag_obs_dm_dq", LIMIT, [&]() {
+        return max_error([&]() {
+            const vector3f field = random_vector(random, 0.6f);
+            const vector4f qv = random_rotation(random);
+            const matrixf<3, 4> reference = central_differences<3, 4>(qv, [&](const vector4f& x) {
+                return unnormalized<3>(x, [&](const quaternionf& q) {return q.conjugate().rotate_vec(field);});
+            });
+            return relative_error(model::mag_obs_dm_dq(qv, field), reference);
+        });
+    });
+}
+
+}
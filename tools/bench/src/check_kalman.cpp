@@ -0,0 +1,223 @@
+#include "check.hpp"
+#include "bench_inputs.hpp"
+#include "bench_quadcopter.hpp"
+#include "state/ekf_inertial.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace mp::bench {
+
+static constexpr size_t DIM = inertial_layout_t::DIM;
+static constexpr size_t OBS_DIM = 6;
+static constexpr float SENSOR_DT = 0.005f;
+// Random states, covariances and observations tried by each check
+static constexpr size_t CHECK_TRIALS = 64;
+
+using kalman_t = block_kalman<inertial_layout_t, 7>;
+using state_vec_t = vectorf<DIM>;
+using obs_vec_t = vectorf<OBS_DIM>;
+
+/**
+ * Largest element difference relative to the largest element of the reference
+ */
+template <size_t N>
+static double relative_error(const vectorf<N>& value, const vectorf<N>& reference) noexcept
+{
+    double error = 0.0, scale = 0.0;
+    for (size_t i = 0; i < N; i++) {
+        error = std::max(error, std::abs(static_cast<double>(value(i)) - reference(i)));
+        scale = std::max(scale, std::abs(static_cast<double>(reference(i))));
+    }
+    return error / scale;
+}
+
+template <size_t N>
+static double relative_error(const sym_matrix<N>& value, const sym_matrix<N>& reference) noexcept
+{
+    double error = 0.0, scale = 0.0;
+    for (size_t i = 0; i < N; i++) {
+        for (size_t j = i; j < N; j++) {
+            error = std::max(error, std::abs(static_cast<double>(value(i, j)) - reference(i, j)));
+            scale = std::max(scale, std::abs(static_cast<double>(reference(i, j))));
+        }
+    }
+    return error / scale;
+}
+
+/**
+ * Filter with a random state and a correlated covariance, built
+ * by propagating through random jacobians of `ekf_inertial`
+ */
+static kalman_t random_kalman(std::mt19937& random, bool joseph_form) noexcept
+{
+    kalman_t kalman(state_vec_t(random_block<DIM, 1>(random)), 1.f, joseph_form);
+    const state_vec_t Q(1e-2f);
+    for (size_t i = 0; i < 8; i++) {
+        const inertial_jacobian_t F = inertial_jacobian(random, 0.1f, SENSOR_DT);
+        kalman.predict(
+            [&](const state_vec_t& x) {return state_vec_t(F.as_dense().matmul(x));},
+            [&](const state_vec_t&) {return F;},
+            Q, SENSOR_DT
+        );
+    }
+    return kalman;
+}
+
+/**
+ * Observation jacobian of the accelerometer and gyroscope with a random rotation part
+ */
+static matrixf<OBS_DIM, DIM> random_observation_jacobian(std::mt19937& random) noexcept
+{
+    matrixf<OBS_DIM, DIM> H(0);
+    H.set_submatrix(0, inertial_layout_t::offset(SEG_A), matrixf<3>::identity());
+    H.set_submatrix(0, inertial_layout_t::offset(SEG_Q), random_block<3, 4>(random));
+    H.set_submatrix(3, inertial_layout_t::offset(SEG_W), matrixf<3>::identity());
+    H.set_submatrix(3, inertial_layout_t::offset(SEG_WD), matrixf<3>::identity());
+    return H;
+}
+
+static obs_vec_t random_variances(std::mt19937& random) noexcept
+{
+    std::uniform_real_distribution<float> dist(1e-3f, 1e-1f);
+    obs_vec_t R;
+    for (size_t i = 0; i < OBS_DIM; i++)
+        R(i) = dist(random);
+    return R;
+}
+
+struct kalman_errors_s {
+    double state = 0.0;
+    double covariance = 0.0;
+};
+
+/**
+ * Sequential update compared to the batch update with a diagonal
+ * observation covariance, on the same random filters
+ */
+static kalman_errors_s sequential_errors(std::mt19937& random, bool joseph_form) noexcept
+{
+    kalman_errors_s errors;
+    for (size_t trial = 0; trial < CHECK_TRIALS; trial++) {
+        kalman_t batch = random_kalman(random, joseph_form);
+        kalman_t sequential = batch;
+        const matrixf<OBS_DIM, DIM> H = random_observation_jacobian(random);
+        const obs_vec_t R = random_variances(random);
+        const obs_vec_t z(random_block<OBS_DIM, 1>(random));
+
+        const auto h = [&](const state_vec_t& x) {return obs_vec_t(H.matmul(x));};
+        const auto H_x = [&](const state_vec_t&) {return H;};
+        const state_vec_t x0 = batch.get_state();
+        batch.correct<OBS_DIM>(h, H_x, R.as_diagonal(), z);
+        sequential.correct_sequential<OBS_DIM>(h, H_x, R, z);
+
+        // State is compared by its change, which is what the updates compute
+        errors.state = std::max(errors.state, relative_error<DIM>(
+            sequential.get_state() - x0, batch.get_state() - x0
+        ));
+        errors.covariance = std::max(errors.covariance, relative_error<DIM>(
+            sequential.get_covariance(), batch.get_covariance()
+        ));
+    }
+    return errors;
+}
+
+/**
+ * Sequential update with the gyroscope rows masked out compared
+ * to the batch update with only the accelerometer rows
+ */
+static kalman_errors_s partial_errors(std::mt19937& random) noexcept
+{
+    kalman_errors_s errors;
+    for (size_t trial = 0; trial < CHECK_TRIALS; trial++) {
+        kalman_t batch = random_kalman(random, false);
+        kalman_t sequential = batch;
+        const matrixf<OBS_DIM, DIM> H = random_observation_jacobian(random);
+        const obs_vec_t R = random_variances(random);
+        const obs_vec_t z(random_block<OBS_DIM, 1>(random));
+
+        matrixf<3, DIM> H_acc;
+        for (size_t i = 0; i < 3; i++)
+            for (size_t j = 0; j < DIM; j++)
+                H_acc(i, j) = H(i, j);
+        const vector3f z_acc {z(0), z(1), z(2)};
+        const vector3f R_acc {R(0), R(1), R(2)};
+        const state_vec_t x0 = batch.get_state();
+        batch.correct<3>(
+            [&](const state_vec_t& x) {return vector3f(H_acc.matmul(x));},
+            [&](const state_vec_t&) {return H_acc;},
+            R_acc.as_diagonal(), z_acc
+        );
+        sequential.correct_sequential<OBS_DIM>(
+            [&](const state_vec_t& x) {return obs_vec_t(H.matmul(x));},
+            [&](const state_vec_t&) {return H;},
+            R, z, std::bitset<OBS_DIM>(0b000111)
+        );
+
+        errors.state = std::max(errors.state, relative_error<DIM>(
+            sequential.get_state() - x0, batch.get_state() - x0
+        ));
+        errors.covariance = std::max(errors.covariance, relative_error<DIM>(
+            sequential.get_covariance(), batch.get_covariance()
+        ));
+    }
+    return errors;
+}
+
+/**
+ * Largest difference of the rotation and velocity of `ekf_inertial` in the
+ * sequential mode to the batch mode, over a run of noisy readings of a
+ * vehicle held still, with the diagonal sensor covariances the drivers report
+ */
+static double ekf_inertial_sequential_error(std::mt19937& random) noexcept
+{
+    const bench_quadcopter quad;
+    ekf_inertial batch(quad.vehicle, kalman_update_e::BATCH);
+    ekf_inertial sequential(quad.vehicle, kalman_update_e::SEQUENTIAL);
+
+    const matrix3f accelerometer_cov = matrix3f::diagonal(1e-2f);
+    const matrix3f gyroscope_cov = matrix3f::diagonal(1e-4f);
+    double error = 0.0;
+    for (size_t i = 0; i < 1000; i++) {
+        const vector3f accelerometer = -GV + random_vector(random, 0.1f);
+        const vector3f gyroscope = random_vector(random, 0.01f);
+        const sensor_data_s input {
+            .accelerometer = &accelerometer,
+            .accelerometer_cov = &accelerometer_cov,
+            .gyroscope = &gyroscope,
+            .gyroscope_cov = &gyroscope_cov
+        };
+
+        batch.predict(input, SENSOR_DT);
+        batch.correct(input);
+        sequential.predict(input, SENSOR_DT);
+        sequential.correct(input);
+
+        const state_s a = batch.get_state(), b = sequential.get_state();
+        error = std::max<double>(error, (a.rotationq.as_vector() - b.rotationq.as_vector()).norm());
+        error = std::max<double>(error, (a.velocity - b.velocity).norm());
+    }
+    return error;
+}
+
+void check_kalman(check_runner& runner) noexcept
+{
+    std::mt19937& random = runner.get_random();
+
+    // Single precision rounding of the two orders of operations
+    kalman_errors_s errors = sequential_errors(random, false);
+    runner.run("block_kalman.sequential.state", 1e-4, [&]() {return errors.state;});
+    runner.run("block_kalman.sequential.covariance", 1e-4, [&]() {return errors.covariance;});
+
+    errors = sequential_errors(random, true);
+    runner.run("block_kalman.sequential.joseph.state", 1e-4, [&]() {return errors.state;});
+    runner.run("block_kalman.sequential.joseph.covariance", 1e-4, [&]() {return errors.covariance;});
+
+    errors = partial_errors(random);
+    runner.run("block_kalman.sequential.partial.state", 1e-4, [&]() {return errors.state;});
+    runner.run("block_kalman.sequential.partial.covariance", 1e-4, [&]() {return errors.covariance;});
+
+    // Rounding differences are carried through the 1000 iterations of the run
+    runner.run("ekf_inertial.sequential.state", 1e-3, [&]() {return ekf_inertial_sequential_error(random);});
+}
+
+}
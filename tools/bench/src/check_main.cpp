@@ -0,0 +1,44 @@
+#include "check.hpp"
+#include <cstdlib>
+#include <string>
+
+using namespace mp::bench;
+
+static void print_usage(const char* program) noexcept
+{
+    std::fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -f <filter>    run only checks whose name contains <filter>\n",
+        program
+    );
+}
+
+int main(int argc, char** argv)
+{
+    std::string filter;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "-f" && has_value) {
+            filter = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    check_runner runner(filter);
+    check_kalman(runner);
+    check_estimators(runner);
+    check_preintegrator(runner);
+    check_filters(runner);
+    check_jacobians(runner);
+    check_calibration(runner);
+    check_voter(runner);
+    check_blackbox(runner);
+
+    runner.print_table(stdout);
+    return runner.get_failures() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
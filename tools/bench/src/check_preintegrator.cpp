@@ -0,0 +1,194 @@
+#include "check.hpp"
+#include "state/imu_preintegrator.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace mp::bench {
+
+// 20 Hz coning and sculling sampled at 1 kHz over a 20 ms interval, which is not
+// a whole number of motion periods (then the errors of a plain sum would cancel)
+static constexpr double MOTION_FREQUENCY = 2.0 * M_PI * 20.0;
+static constexpr double CONING_AMPLITUDE = 0.05;
+static constexpr double SCULLING_AMPLITUDE = 5.0;
+static constexpr double INTERVAL = 0.02;
+static constexpr size_t SAMPLES = 20;
+// Steps of the double precision reference within each sample
+static constexpr size_t REFERENCE_STEPS = 2000;
+// Intervals starting at different phases of the motion
+static constexpr size_t PHASES = 8;
+
+/**
+ * Double precision quaternion for the reference integration
+ */
+struct quaterniond_s {
+    double w, x, y, z;
+
+    quaterniond_s operator*(const quaterniond_s& b) const noexcept
+    {
+        return {
+            w * b.w - x * b.x - y * b.y - z * b.z,
+            w * b.x + x * b.w + y * b.z - z * b.y,
+            w * b.y - x * b.z + y * b.w + z * b.x,
+            w * b.z + x * b.y - y * b.x + z * b.w
+        };
+    }
+
+    void rotate(const double (&v)[3], double (&result)[3]) const noexcept
+    {
+        const quaterniond_s r = *this * quaterniond_s {0, v[0], v[1], v[2]} * quaterniond_s {w, -x, -y, -z};
+        result[0] = r.x;
+        result[1] = r.y;
+        result[2] = r.z;
+    }
+
+    static quaterniond_s from_rotation_vector(const double (&v)[3]) noexcept
+    {
+        const double angle = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        const double s = angle > 0.0 ? std::sin(angle / 2.0) / angle : 0.5;
+        return {std::cos(angle / 2.0), s * v[0], s * v[1], s * v[2]};
+    }
+};
+
+/**
+ * Angular velocity of the coning motion: the rate vector rotates in the
+ * x-y plane, so the local frame rotates around an axis which itself rotates
+ */
+static void coning_rate(double t, double (&w)[3]) noexcept
+{
+    w[0] = CONING_AMPLITUDE * MOTION_FREQUENCY * std::cos(MOTION_FREQUENCY * t);
+    w[1] = CONING_AMPLITUDE * MOTION_FREQUENCY * std::sin(MOTION_FREQUENCY * t);
+    w[2] = 0.0;
+}
+
+/**
+ * Specific force oscillating in phase with the rotation (sculling)
+ */
+static void sculling_force(double t, double (&a)[3]) noexcept
+{
+    a[0] = SCULLING_AMPLITUDE * std::sin(MOTION_FREQUENCY * t);
+    a[1] = SCULLING_AMPLITUDE * std::cos(MOTION_FREQUENCY * t);
+    a[2] = 9.80665;
+}
+
+static quaternionf to_quaternionf(const quaterniond_s& q) noexcept
+{
+    return quaternionf(q.w, q.x, q.y, q.z);
+}
+
+static quaternionf rotation_vector_to_quaternionf(const vector3f& v) noexcept
+{
+    const double rv[3] = {v(0), v(1), v(2)};
+    return to_quaternionf(quaterniond_s::from_rotation_vector(rv));
+}
+
+/**
+ * Angle of the rotation between the two rotations, from the vector part of
+ * the difference quaternion which keeps the precision for small angles
+ */
+static double rotation_error(const quaternionf& a, const quaternionf& b) noexcept
+{
+    const quaternionf d = a.conjugate() * b;
+    return 2.0 * std::asin(std::min(1.0, std::sqrt(double(d.x) * d.x + double(d.y) * d.y + double(d.z) * d.z)));
+}
+
+struct interval_errors_s {
+    // Rotation of the local frame over the interval in [rad]
+    double angle;
+    // Velocity change in the frame at the start of the interval in [m/s]
+    double velocity;
+};
+
+struct preintegrator_errors_s {
+    interval_errors_s preintegrated;
+    interval_errors_s per_sample;
+};
+
+/**
+ * Errors of the rotation and velocity increments over an interval of coning and
+ * sculling motion, compared to a double precision reference integrated at a much
+ * higher rate. Each sample is the mean rate and specific force over its period,
+ * as reported by a sensor with an internal low pass filter.
+ *
+ * The increments of `imu_preintegrator` are compared with the per sample path
+ * used before, a rotation and a rotated velocity step for every sample, as done
+ * by the estimators when each sample had its own prediction step.
+ * @param start Time of the start of the interval
+ */
+static preintegrator_errors_s preintegrator_errors(double start) noexcept
+{
+    const double dt = INTERVAL / SAMPLES;
+    const double h = dt / REFERENCE_STEPS;
+
+    quaterniond_s q {1, 0, 0, 0};
+    double velocity[3] = {0, 0, 0};
+
+    imu_preintegrator integrator;
+    quaternionf q_per_sample(1, 0, 0, 0);
+    vector3f v_per_sample(0);
+
+    for (size_t k = 0; k < SAMPLES; k++) {
+        double w_mean[3] = {0, 0, 0}, a_mean[3] = {0, 0, 0};
+        for (size_t step = 0; step < REFERENCE_STEPS; step++) {
+            const double t = start + (k * REFERENCE_STEPS + step + 0.5) * h;
+            double w[3], a[3], a_global[3];
+            coning_rate(t, w);
+            sculling_force(t, a);
+            q.rotate(a, a_global);
+            for (size_t i = 0; i < 3; i++) {
+                velocity[i] += a_global[i] * h;
+                w_mean[i] += w[i] / REFERENCE_STEPS;
+                a_mean[i] += a[i] / REFERENCE_STEPS;
+            }
+            const double dtheta[3] = {w[0] * h, w[1] * h, w[2] * h};
+            q = q * quaterniond_s::from_rotation_vector(dtheta);
+        }
+
+        const vector3f w {float(w_mean[0]), float(w_mean[1]), float(w_mean[2])};
+        const vector3f a {float(a_mean[0]), float(a_mean[1]), float(a_mean[2])};
+        integrator.integrate(w, a, float(dt));
+
+        v_per_sample += q_per_sample.rotate_vec(a * float(dt));
+        q_per_sample = (q_per_sample * rotation_vector_to_quaternionf(w * float(dt))).normalized();
+    }
+
+    const quaternionf q_reference = to_quaternionf(q);
+    const vector3f v_reference {float(velocity[0]), float(velocity[1]), float(velocity[2])};
+    const imu_delta_s delta = integrator.get_delta();
+
+    return preintegrator_errors_s {
+        .preintegrated = {
+            .angle = rotation_error(q_reference, rotation_vector_to_quaternionf(delta.delta_angle)),
+            .velocity = (delta.delta_velocity - v_reference).norm()
+        },
+        .per_sample = {
+            .angle = rotation_error(q_reference, q_per_sample),
+            .velocity = (v_per_sample - v_reference).norm()
+        }
+    };
+}
+
+void check_preintegrator(check_runner& runner) noexcept
+{
+    // Largest errors over the phases
+    preintegrator_errors_s errors {};
+    for (size_t i = 0; i < PHASES; i++) {
+        const double period = 2.0 * M_PI / MOTION_FREQUENCY;
+        const preintegrator_errors_s phase = preintegrator_errors(period * i / PHASES);
+        errors.preintegrated.angle = std::max(errors.preintegrated.angle, phase.preintegrated.angle);
+        errors.preintegrated.velocity = std::max(errors.preintegrated.velocity, phase.preintegrated.velocity);
+        errors.per_sample.angle = std::max(errors.per_sample.angle, phase.per_sample.angle);
+        errors.per_sample.velocity = std::max(errors.per_sample.velocity, phase.per_sample.velocity);
+    }
+
+    runner.run("imu_preintegrator.coning.angle_rad", 2e-6, [&]() {return errors.preintegrated.angle;});
+    runner.run("imu_preintegrator.sculling.velocity_mps", 5e-6, [&]() {return errors.preintegrated.velocity;});
+    // Single prediction with the increments has to be more accurate than a prediction for every sample
+    runner.run("imu_preintegrator.coning.vs_per_sample", 0.5, [&]() {
+        return errors.preintegrated.angle / errors.per_sample.angle;
+    });
+    runner.run("imu_preintegrator.sculling.vs_per_sample", 0.5, [&]() {
+        return errors.preintegrated.velocity / errors.per_sample.velocity;
+    });
+}
+
+}
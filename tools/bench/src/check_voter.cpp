@@ -0,0 +1,144 @@
+#include "check.hpp"
+#include "state/sensor_voter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace mp::bench {
+
+using voter_t = sensor_voter<3>;
+
+// Accelerometer voting of `task_state_estimator`
+static constexpr voter_t::params_s PARAMS {
+    .tolerance = 1.f,
+    .smoothing = 0.1f,
+    .max_missed = 5
+};
+
+static constexpr size_t ITERATIONS = 200;
+// Iterations for a persistent offset to drop an instance
+static constexpr size_t SETTLE_ITERATIONS = 10;
+// Noise of the mean readings, small compared to the tolerance
+static constexpr float NOISE = 0.1f;
+static const vector3f READING {0.2f, -0.1f, 9.8f};
+static const vector3f OFFSET {0.f, 3.f, 0.f};
+
+static vector3f add_noise(std::mt19937& random, const vector3f& value, float deviation) noexcept
+{
+    std::normal_distribution<float> noise(0.f, deviation);
+    return {value(0) + noise(random), value(1) + noise(random), value(2) + noise(random)};
+}
+
+void check_voter(check_runner& runner) noexcept
+{
+    std::mt19937& random = runner.get_random();
+
+    // Iterations where the offset instance was healthy, a good one was not, or the primary was not the first
+    runner.run("sensor_voter.offset.wrong_health", 0, [&]() {
+        voter_t voter(PARAMS, 3);
+        const bool valid[3] = {true, true, true};
+        size_t wrong = 0;
+        for (size_t i = 0; i < ITERATIONS; i++) {
+            const vector3f means[3] = {
+                add_noise(random, READING, NOISE),
+                add_noise(random, READING + OFFSET, NOISE),
+                add_noise(random, READING, NOISE)
+            };
+            const size_t primary = voter.update(means, valid);
+            if (i >= SETTLE_ITERATIONS)
+                wrong += voter.is_healthy(1) || !voter.is_healthy(0) || !voter.is_healthy(2) || primary != 0;
+        }
+        return double(wrong);
+    });
+
+    // The median is not moved by the offset instance, so the other two stay near 0 (the
+    // mean of the three would be a third of the offset away from them and drop them)
+    runner.run("sensor_voter.offset.good_metric", voter_t::RESTORE_METRIC, [&]() {
+        voter_t voter(PARAMS, 3);
+        const bool valid[3] = {true, true, true};
+        float metric = 0.f;
+        for (size_t i = 0; i < ITERATIONS; i++) {
+            const vector3f means[3] = {
+                add_noise(random, READING, NOISE),
+                add_noise(random, READING + OFFSET, NOISE),
+                add_noise(random, READING, NOISE)
+            };
+            voter.update(means, valid);
+            metric = std::max({metric, voter.get_metric(0), voter.get_metric(2)});
+        }
+        return double(metric);
+    });
+
+    // First instance stalls so the second becomes the primary, then it returns with an offset.
+    // Both disagreeing instances become suspect with equal metrics (the readings have no noise),
+    // and the second has to stay the primary: iterations where either of that did not hold.
+    runner.run("sensor_voter.disagree.wrong_primary", 0, [&]() {
+        voter_t voter(PARAMS, 2);
+        size_t wrong = 0;
+        for (size_t i = 0; i < ITERATIONS; i++) {
+            const bool stalled = i < PARAMS.max_missed + 5;
+            const vector3f means[2] = {READING + OFFSET, READING};
+            const bool valid[2] = {!stalled, true};
+            const size_t primary = voter.update(means, valid);
+
+            if (stalled)
+                continue;
+            wrong += primary != 1;
+            if (i >= PARAMS.max_missed + 5 + SETTLE_ITERATIONS)
+                wrong += voter.is_healthy(0) || voter.is_healthy(1);
+        }
+        return double(wrong);
+    });
+
+    // Iterations where the health of an instance which stalls for a while and then
+    // returns did not match: healthy until it missed more than `max_missed`
+    // iterations, and healthy again right after it returned in agreement
+    runner.run("sensor_voter.stall.wrong_health", 0, [&]() {
+        static constexpr size_t STALL_START = 20;
+        static constexpr size_t STALL_END = 60;
+
+        voter_t voter(PARAMS, 3);
+        size_t wrong = 0;
+        for (size_t i = 0; i < ITERATIONS; i++) {
+            const vector3f means[3] = {
+                add_noise(random, READING, NOISE),
+                add_noise(random, READING, NOISE),
+                add_noise(random, READING, NOISE)
+            };
+            const bool stalled = i >= STALL_START && i < STALL_END;
+            const bool valid[3] = {!stalled, true, true};
+            const size_t primary = voter.update(means, valid);
+
+            const bool expected = !stalled || i - STALL_START < PARAMS.max_missed;
+            wrong += voter.is_healthy(0) != expected || !voter.is_healthy(1) || !voter.is_healthy(2);
+            wrong += primary != (stalled ? 1 : 0);
+        }
+        return double(wrong);
+    });
+
+    // Iterations for an instance dropped with the largest metric to be restored once it agrees
+    // again, the moving average has to fall from `MAX_DEVIATION` below `RESTORE_METRIC`
+    // (without noise, which would add its own deviation to the bound)
+    const double restore_limit = std::ceil(
+        std::log(voter_t::RESTORE_METRIC / voter_t::MAX_DEVIATION) / std::log(1.f - PARAMS.smoothing)
+    ) + 1;
+    runner.run("sensor_voter.restore.iterations", restore_limit, [&]() {
+        static constexpr size_t OFFSET_ITERATIONS = 50;
+
+        voter_t voter(PARAMS, 3);
+        const bool valid[3] = {true, true, true};
+        bool dropped = false;
+        for (size_t i = 0; i < ITERATIONS; i++) {
+            const bool offset = i < OFFSET_ITERATIONS;
+            const vector3f means[3] = {READING, offset ? READING + OFFSET : READING, READING};
+            voter.update(means, valid);
+
+            dropped |= offset && !voter.is_healthy(1);
+            if (!offset && voter.is_healthy(1))
+                return dropped ? double(i + 1 - OFFSET_ITERATIONS) : std::numeric_limits<double>::quiet_NaN();
+        }
+        return std::numeric_limits<double>::quiet_NaN();
+    });
+}
+
+}
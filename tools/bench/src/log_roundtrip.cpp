@@ -0,0 +1,78 @@
+#include "util/logger.hpp"
+#include "emblib/driver/io/char_dev.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+// Writes binary log records from known call sites together with the text the
+// host decoder (python/log_decoder.py) has to produce for them, which is compared
+// by the `minipilot-log-roundtrip` test (log_roundtrip.cmake)
+
+static_assert(MP_LOGGER_BINARY, "The round trip needs the binary log");
+
+using namespace mp;
+
+/**
+ * Log device writing the records to a file
+ */
+class file_char_dev : public emblib::char_dev {
+
+public:
+    explicit file_char_dev(std::FILE* file) noexcept :
+        m_file(file)
+    {}
+
+    ssize_t write(const char* data, size_t size, emblib::milliseconds timeout) noexcept override
+    {
+        UNUSED(timeout);
+        return std::fwrite(data, 1, size, m_file) == size ? static_cast<ssize_t>(size) : -1;
+    }
+
+    ssize_t read(char* buffer, size_t size, emblib::milliseconds timeout) noexcept override
+    {
+        UNUSED(buffer);
+        UNUSED(size);
+        return -1;
+    }
+
+private:
+    std::FILE* m_file;
+};
+
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+        std::fprintf(stderr, "Usage: %s <log file> <expected text file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::FILE* log_file = std::fopen(argv[1], "wb");
+    std::FILE* expected_file = std::fopen(argv[2], "w");
+    if (!log_file || !expected_file) {
+        std::fprintf(stderr, "Opening the output files failed\n");
+        return EXIT_FAILURE;
+    }
+
+    file_char_dev device(log_file);
+    logger::get_instance().set_output_device(device);
+    logger::get_instance().set_output_level(log_level_e::DEBUG);
+
+    // Every type of argument, literals are taken from this file by the decoder
+    const char* sensor = "gyro";
+    log_info("Round trip started");
+    log_debug("Count ", 42, " of ", 100u);
+    log_warning("Offset ", -7, " at rate ", 2.5f);
+    log_error("Sensor ", sensor, " failed: ", false);
+    log_info("Ratio ", 0.125, " and ", true);
+
+    std::fputs(
+        "INFO: Round trip started\n"
+        "DEBUG: Count 42 of 100\n"
+        "WARNING: Offset -7 at rate 2.5\n"
+        "ERROR: Sensor gyro failed: false\n"
+        "INFO: Ratio 0.125 and true\n",
+        expected_file
+    );
+
+    const bool closed = std::fclose(log_file) == 0;
+    return std::fclose(expected_file) == 0 && closed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
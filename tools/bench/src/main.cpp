@@ -0,0 +1,64 @@
+#include "bench.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace mp::bench;
+
+static void print_usage(const char* program) noexcept
+{
+    std::fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -n <count>     operations per timed run (default 100000)\n"
+        "  -f <filter>    run only benchmarks whose name contains <filter>\n"
+        "  --json <file>  write results as json, '-' for stdout\n",
+        program
+    );
+}
+
+int main(int argc, char** argv)
+{
+    size_t iterations = 100000;
+    std::string filter;
+    std::string json_path;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "-n" && has_value) {
+            iterations = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-f" && has_value) {
+            filter = argv[++i];
+        } else if (arg == "--json" && has_value) {
+            json_path = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    bench_runner runner(iterations, filter);
+    bench_vehicles(runner);
+    bench_estimators(runner);
+    bench_filters(runner);
+    bench_blackbox(runner);
+
+    if (json_path == "-") {
+        runner.print_json(stdout);
+        return EXIT_SUCCESS;
+    }
+
+    runner.print_table(stdout);
+    if (!json_path.empty()) {
+        std::FILE* file = std::fopen(json_path.c_str(), "w");
+        if (!file) {
+            std::fprintf(stderr, "Cannot open %s\n", json_path.c_str());
+            return EXIT_FAILURE;
+        }
+        runner.print_json(file);
+        std::fclose(file);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "emblib/driver/actuator/motor.hpp"
+#include "mp/drivers/storage.hpp"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace mp::bench {
+
+/**
+ * Motor which only stores the last written throttle,
+ * so the benchmarks measure only the minipilot code
+ */
+class stub_motor : public emblib::motor {
+
+public:
+    explicit stub_motor(bool direction) noexcept :
+        m_direction(direction)
+    {}
+
+    bool write_throttle(float throttle) noexcept override
+    {
+        m_throttle = throttle;
+        return true;
+    }
+
+    bool read_throttle(float& throttle) const noexcept override
+    {
+        throttle = m_throttle;
+        return true;
+    }
+
+    bool get_direction() const noexcept override
+    {
+        return m_direction;
+    }
+
+private:
+    bool m_direction;
+    float m_throttle = 0.5f;
+};
+
+/**
+ * Storage in RAM, as a flash region which reads back what was written
+ */
+class stub_storage : public storage {
+
+public:
+    explicit stub_storage(size_t size) noexcept :
+        m_data(size, 0xFF)
+    {}
+
+    size_t get_size() const noexcept override
+    {
+        return m_data.size();
+    }
+
+    bool read(size_t address, void* data, size_t size) noexcept override
+    {
+        if (address + size > m_data.size())
+            return false;
+        std::memcpy(data, m_data.data() + address, size);
+        return true;
+    }
+
+    bool write(size_t address, const void* data, size_t size) noexcept override
+    {
+        if (address + size > m_data.size())
+            return false;
+        std::memcpy(m_data.data() + address, data, size);
+        m_last_write = size;
+        return true;
+    }
+
+    /**
+     * Raw bytes, to corrupt a stored record
+     */
+    uint8_t* get_data() noexcept
+    {
+        return m_data.data();
+    }
+
+    /**
+     * Size of the last successful write in bytes
+     */
+    size_t get_last_write() const noexcept
+    {
+        return m_last_write;
+    }
+
+private:
+    std::vector<uint8_t> m_data;
+    size_t m_last_write = 0;
+};
+
+}
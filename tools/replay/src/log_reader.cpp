@@ -0,0 +1,42 @@
+#include "log_reader.hpp"
+#include <cstdio>
+
+namespace mp::replay {
+
+bool log_reader::open(const std::string& path) noexcept
+{
+    m_file.open(path);
+    m_line = 0;
+    m_error = false;
+    return m_file.is_open();
+}
+
+bool log_reader::next(imu_sample_s& sample) noexcept
+{
+    while (std::getline(m_file, m_buffer)) {
+        m_line++;
+
+        // Skip comments and empty lines
+        const size_t start = m_buffer.find_first_not_of(" \t\r");
+        if (start == std::string::npos || m_buffer[start] == '#')
+            continue;
+
+        float a[3], w[3];
+        const int parsed = std::sscanf(
+            m_buffer.c_str() + start,
+            "%lf , %f , %f , %f , %f , %f , %f",
+            &sample.time, &a[0], &a[1], &a[2], &w[0], &w[1], &w[2]
+        );
+        if (parsed != 7) {
+            m_error = true;
+            return false;
+        }
+
+        sample.accelerometer = {a[0], a[1], a[2]};
+        sample.gyroscope = {w[0], w[1], w[2]};
+        return true;
+    }
+    return false;
+}
+
+}
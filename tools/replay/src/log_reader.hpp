@@ -0,0 +1,65 @@
+#pragma once
+
+#include "mp/util/math.hpp"
+#include <fstream>
+#include <string>
+
+namespace mp::replay {
+
+/**
+ * Single IMU sample from a recorded log
+ */
+struct imu_sample_s {
+    // Time of the sample in seconds
+    double time;
+    vector3f accelerometer;
+    vector3f gyroscope;
+};
+
+/**
+ * Streaming reader of recorded sensor logs
+ * 
+ * Log is a text file with one sample per line:
+ * `time, ax, ay, az, gx, gy, gz`
+ * with time in seconds, acceleration in m/s^2 and angular velocity
+ * in rad/s, both already corrected (in the minipilot frame).
+ * Empty lines and lines starting with `#` are skipped.
+ */
+class log_reader {
+
+public:
+    /**
+     * @returns false if the file cannot be opened
+     */
+    bool open(const std::string& path) noexcept;
+
+    /**
+     * Read the next sample
+     * @returns false at the end of the log or on a malformed line
+     */
+    bool next(imu_sample_s& sample) noexcept;
+
+    /**
+     * Line number of the last read line, for error reporting
+     */
+    size_t get_line() const noexcept
+    {
+        return m_line;
+    }
+
+    /**
+     * True if reading stopped on a malformed line instead of the end of the log
+     */
+    bool has_error() const noexcept
+    {
+        return m_error;
+    }
+
+private:
+    std::ifstream m_file;
+    std::string m_buffer;
+    size_t m_line = 0;
+    bool m_error = false;
+};
+
+}
@@ -0,0 +1,137 @@
+#include "replay.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mp::replay;
+
+static void print_usage(const char* program) noexcept
+{
+    std::fprintf(stderr,
+        "Usage: %s [options] log...\n"
+        "  -e <name>        estimator: ahrs, inertial, error_state, mahony\n"
+        "                   (default ahrs)\n"
+        "  -s               sequential (scalar) measurement update\n"
+        "  -n <count>       samples per correction step (default 4)\n"
+        "  -j <count>       worker threads (default number of cpus)\n"
+        "  -o <dir>         write trajectories to <dir>/<log>.<estimator>.csv\n"
+        "  --accel-var <v>  accelerometer sample variance\n"
+        "  --gyro-var <v>   gyroscope sample variance\n",
+        program
+    );
+}
+
+int main(int argc, char** argv)
+{
+    replay_config_s config;
+    size_t thread_count = std::thread::hardware_concurrency();
+    std::string output_dir;
+    std::vector<std::string> logs;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "-s") {
+            config.update_mode = mp::kalman_update_e::SEQUENTIAL;
+        } else if (arg == "-e" && has_value) {
+            if (!parse_estimator(argv[++i], config.estimator)) {
+                std::fprintf(stderr, "Unknown estimator %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "-n" && has_value) {
+            config.samples_per_correction = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-j" && has_value) {
+            thread_count = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-o" && has_value) {
+            output_dir = argv[++i];
+        } else if (arg == "--accel-var" && has_value) {
+            config.accel_variance = std::strtof(argv[++i], nullptr);
+        } else if (arg == "--gyro-var" && has_value) {
+            config.gyro_variance = std::strtof(argv[++i], nullptr);
+        } else if (arg[0] == '-') {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            logs.push_back(arg);
+        }
+    }
+
+    if (logs.empty()) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> outputs(logs.size());
+    if (!output_dir.empty()) {
+        std::filesystem::create_directories(output_dir);
+        for (size_t i = 0; i < logs.size(); i++) {
+            const std::filesystem::path log_path(logs[i]);
+            outputs[i] = (std::filesystem::path(output_dir) / log_path.stem()).string()
+                + "." + get_estimator_name(config.estimator) + ".csv";
+        }
+
+        // Logs with the same name in different directories would be written
+        // to the same output, possibly by two workers at the same time
+        std::set<std::string> names;
+        for (size_t i = 0; i < logs.size(); i++) {
+            if (!names.insert(outputs[i]).second) {
+                std::fprintf(stderr, "Log %s has the same output %s as another log\n",
+                    logs[i].c_str(), outputs[i].c_str()
+                );
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    // Each worker takes the next log which was not replayed yet,
+    // every replay has its own estimator so no state is shared
+    std::vector<replay_result_s> results(logs.size());
+    std::atomic<size_t> next_log {0};
+    const auto worker = [&]() {
+        for (size_t i = next_log++; i < logs.size(); i = next_log++)
+            results[i] = replay_log(logs[i], outputs[i], config);
+    };
+
+    thread_count = std::max<size_t>(1, std::min(thread_count, logs.size()));
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < thread_count; i++)
+        threads.emplace_back(worker);
+    for (auto& thread : threads)
+        thread.join();
+
+    const double wall_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+
+    size_t total_samples = 0;
+    size_t failed = 0;
+    for (size_t i = 0; i < logs.size(); i++) {
+        const replay_result_s& result = results[i];
+        total_samples += result.samples;
+        failed += !result.ok;
+
+        const double rate = result.estimator_seconds > 0 ? result.samples / result.estimator_seconds : 0;
+        std::printf("%s: %s, %zu samples, %zu corrections, %.0f samples/s in estimator\n",
+            logs[i].c_str(), result.ok ? "ok" : "failed",
+            result.samples, result.corrections, rate
+        );
+    }
+
+    std::printf("%s: %zu logs, %zu samples, %zu threads, %.3f s, %.0f samples/s\n",
+        get_estimator_name(config.estimator), logs.size(), total_samples, thread_count,
+        wall_seconds, wall_seconds > 0 ? total_samples / wall_seconds : 0
+    );
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+#include "replay.hpp"
+#include "log_reader.hpp"
+#include "replay_vehicle.hpp"
+#include "state/ekf_ahrs.hpp"
+#include "state/ekf_inertial.hpp"
+#include "state/ekf_error_state.hpp"
+#include "state/mahony_ahrs.hpp"
+#include "state/imu_preintegrator.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+namespace mp::replay {
+
+static constexpr struct {
+    estimator_e estimator;
+    const char* name;
+} ESTIMATOR_NAMES[] = {
+    {estimator_e::AHRS, "ahrs"},
+    {estimator_e::INERTIAL, "inertial"},
+    {estimator_e::ERROR_STATE, "error_state"},
+    {estimator_e::MAHONY, "mahony"}
+};
+
+bool parse_estimator(const std::string& name, estimator_e& estimator) noexcept
+{
+    for (const auto& entry : ESTIMATOR_NAMES) {
+        if (name == entry.name) {
+            estimator = entry.estimator;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* get_estimator_name(estimator_e estimator) noexcept
+{
+    for (const auto& entry : ESTIMATOR_NAMES) {
+        if (entry.estimator == estimator)
+            return entry.name;
+    }
+    return "unknown";
+}
+
+// Create a new estimator, `vehicle` must outlive it
+static std::unique_ptr<state_estimator> create_estimator(
+    const replay_config_s& config,
+    const ekf_vehicle& vehicle
+) noexcept
+{
+    switch (config.estimator) {
+    case estimator_e::INERTIAL:
+        return std::make_unique<ekf_inertial>(vehicle, config.update_mode);
+    case estimator_e::ERROR_STATE:
+        return std::make_unique<ekf_error_state>(vehicle, config.update_mode);
+    case estimator_e::MAHONY:
+        return std::make_unique<mahony_ahrs>();
+    default:
+        return std::make_unique<ekf_ahrs>(config.update_mode);
+    }
+}
+
+// Write a single trajectory point
+static void write_state(std::FILE* file, double time, const state_s& state) noexcept
+{
+    const vector4f q = state.rotationq.as_vector();
+    std::fprintf(
+        file,
+        "%.6f,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g\n",
+        time,
+        state.position(0), state.position(1), state.position(2),
+        state.velocity(0), state.velocity(1), state.velocity(2),
+        state.acceleration(0), state.acceleration(1), state.acceleration(2),
+        state.angular_velocity(0), state.angular_velocity(1), state.angular_velocity(2),
+        q(0), q(1), q(2), q(3)
+    );
+}
+
+replay_result_s replay_log(
+    const std::string& log_path,
+    const std::string& output_path,
+    const replay_config_s& config
+) noexcept
+{
+    using clock = std::chrono::steady_clock;
+    replay_result_s result;
+
+    log_reader reader;
+    if (!reader.open(log_path)) {
+        std::fprintf(stderr, "%s: cannot open log\n", log_path.c_str());
+        return result;
+    }
+
+    std::FILE* output = nullptr;
+    if (!output_path.empty()) {
+        output = std::fopen(output_path.c_str(), "w");
+        if (!output) {
+            std::fprintf(stderr, "%s: cannot open output file\n", output_path.c_str());
+            return result;
+        }
+        std::fputs("# time,px,py,pz,vx,vy,vz,ax,ay,az,wx,wy,wz,qw,qx,qy,qz\n", output);
+    }
+
+    // Each replay has its own estimator so that logs can run in parallel
+    const replay_vehicle vehicle;
+    const std::unique_ptr<state_estimator> estimator = create_estimator(config, vehicle);
+
+    const matrix3f accel_cov = matrix3f::diagonal(config.accel_variance);
+    const matrix3f gyro_cov = matrix3f::diagonal(config.gyro_variance);
+    const size_t samples_per_correction = config.samples_per_correction ? config.samples_per_correction : 1;
+
+    imu_sample_s sample;
+    double last_time = 0.0;
+    imu_preintegrator integrator;
+    vector3f a_sum(0);
+    vector3f w_sum(0);
+    size_t pending = 0;
+    clock::duration estimator_time {0};
+
+    while (reader.next(sample)) {
+        // First sample only sets the starting time
+        const float dt = result.samples ? static_cast<float>(sample.time - last_time) : 0.f;
+        last_time = sample.time;
+        result.samples++;
+
+        // Same sequence of steps as in the state estimator task: samples are
+        // pre-integrated, and each correction has a single prediction step before it
+        const clock::time_point start = clock::now();
+
+        integrator.integrate(sample.gyroscope, sample.accelerometer, dt);
+        a_sum += sample.accelerometer;
+        w_sum += sample.gyroscope;
+        if (++pending == samples_per_correction) {
+            const imu_delta_s delta = integrator.get_delta();
+            if (delta.dt > 0.f)
+                estimator->predict(sensor_data_s {.imu_delta = &delta}, delta.dt);
+
+            // Means over the interval come from the compensated increments if possible
+            const float n = static_cast<float>(pending);
+            const vector3f a_mean = delta.dt > 0.f ? delta.delta_velocity / delta.dt : a_sum / n;
+            const vector3f w_mean = delta.dt > 0.f ? delta.delta_angle / delta.dt : w_sum / n;
+            const matrix3f a_mean_cov = accel_cov / n;
+            const matrix3f w_mean_cov = gyro_cov / n;
+
+            const sensor_data_s correct_input {
+                .accelerometer = &a_mean,
+                .accelerometer_cov = &a_mean_cov,
+                .gyroscope = &w_mean,
+                .gyroscope_cov = &w_mean_cov
+            };
+            estimator->correct(correct_input);
+
+            integrator.reset();
+            a_sum = vector3f(0);
+            w_sum = vector3f(0);
+            pending = 0;
+            result.corrections++;
+        }
+
+        estimator_time += clock::now() - start;
+
+        if (output && pending == 0)
+            write_state(output, sample.time, estimator->get_state());
+    }
+
+    if (output)
+        std::fclose(output);
+
+    if (reader.has_error()) {
+        std::fprintf(stderr, "%s:%zu: malformed sample\n", log_path.c_str(), reader.get_line());
+        return result;
+    }
+
+    result.estimator_seconds = std::chrono::duration<double>(estimator_time).count();
+    result.ok = true;
+    return result;
+}
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "state/block_kalman.hpp"
+#include <string>
+
+namespace mp::replay {
+
+/**
+ * State estimators which can be replayed
+ */
+enum class estimator_e {
+    AHRS,
+    INERTIAL,
+    ERROR_STATE,
+    MAHONY
+};
+
+/**
+ * Replay settings, shared by all logs in a run
+ */
+struct replay_config_s {
+    estimator_e estimator = estimator_e::AHRS;
+    kalman_update_e update_mode = kalman_update_e::BATCH;
+    // Samples are pre-integrated and each correction, with the mean of this
+    // many samples, has a single prediction before it, same as
+    // `task_state_estimator` (200Hz / 50Hz)
+    size_t samples_per_correction = 4;
+    // Noise variance of a single sample of each sensor
+    float accel_variance = 1e-2f;
+    float gyro_variance = 1e-4f;
+};
+
+/**
+ * Outcome of a replay of a single log
+ */
+struct replay_result_s {
+    bool ok = false;
+    // Number of samples fed to the estimator
+    size_t samples = 0;
+    // Number of correction steps (= number of trajectory points written)
+    size_t corrections = 0;
+    // Time spent inside the estimator in seconds
+    double estimator_seconds = 0.0;
+};
+
+/**
+ * Parse the estimator name used on the command line
+ * @returns false if the name is not known
+ */
+bool parse_estimator(const std::string& name, estimator_e& estimator) noexcept;
+
+/**
+ * Name of the estimator used on the command line and in output file names
+ */
+const char* get_estimator_name(estimator_e estimator) noexcept;
+
+/**
+ * Run a new instance of the configured estimator over the whole log
+ * 
+ * Writes the state after every correction step to `output_path` as a csv:
+ * `time, p(3), v(3), a(3), w(3), q(4)`
+ * @param output_path Empty to only measure the throughput
+ * @note Safe to call from multiple threads with different paths
+ */
+replay_result_s replay_log(
+    const std::string& log_path,
+    const std::string& output_path,
+    const replay_config_s& config
+) noexcept;
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "vehicles/ekf_vehicle.hpp"
+
+namespace mp::replay {
+
+/**
+ * Vehicle model used when replaying logs through `ekf_inertial`
+ * 
+ * Actuator data is not recorded, so the model has no forces or torques
+ * and all changes of acceleration and angular velocity are left to the
+ * process noise of the estimator
+ */
+class replay_vehicle : public ekf_vehicle {
+
+public:
+    bool init() noexcept override
+    {
+        return true;
+    }
+
+    void update(const state_s& state, float dt) noexcept override {}
+
+    bool handle_command(const pb::Command& command) noexcept override
+    {
+        return false;
+    }
+
+    vector3f get_linear_acceleration(
+        const vector3f& v,
+        const quaternionf& q
+    ) const noexcept override
+    {
+        return vector3f(0);
+    }
+
+    vector3f get_angular_acceleration(
+        const vector3f& v,
+        const vector3f& w,
+        const quaternionf& q
+    ) const noexcept override
+    {
+        return vector3f(0);
+    }
+
+    jacobian_s get_jacobian(
+        const vector3f& v,
+        const vector3f& w,
+        const vector4f& qv
+    ) const noexcept override
+    {
+        return jacobian_s {
+            .da_dv = matrixf<3>(0),
+            .da_dq = matrixf<3, 4>(0),
+            .ddw_dv = matrixf<3>(0),
+            .ddw_dw = matrixf<3>(0),
+            .ddw_dq = matrixf<3, 4>(0)
+        };
+    }
+};
+
+}